@@ -34,6 +34,7 @@
 #include "common/history.h"
 #include "common/image.h"
 #include "common/image_cache.h"
+#include "common/metadata_export.h"
 #include "common/points.h"
 #include "control/conf.h"
 #include "develop/imageop.h"
@@ -41,11 +42,20 @@
 #include "imageio/imageio_jpeg.h"
 #include "imageio/imageio_module.h"
 
+#include <errno.h>
 #include <inttypes.h>
 #include <libintl.h>
+#include <stdarg.h>
 #include <sys/time.h>
 #include <unistd.h>
 
+#ifndef _WIN32
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
 #ifdef __APPLE__
 #include "osx/osx.h"
 #endif
@@ -75,6 +85,8 @@ fprintf(stderr, "darktable %s\n"
                 "  darktable-cli [IMAGE_FILE | IMAGE_FOLDER]\n"
                 "                [XMP_FILE] DIR [OPTIONS]\n"
                 "                [--core DARKTABLE_OPTIONS]\n"
+                "  darktable-cli --server [--socket <path>] [OPTIONS]\n"
+                "                [--core DARKTABLE_OPTIONS]\n"
                 "\n"
                 "Options:\n"
                 "   --apply-custom-presets <0|1|false|true>, default: true\n"
@@ -102,6 +114,13 @@ fprintf(stderr, "darktable %s\n"
                 "   --icc-file <file> specify icc filename, default to NONE\n"
                 "   --icc-intent <intent> specify icc intent, default to LAST\n"
                 "                     use --help icc-intent for list of supported intents\n"
+                "   --server read export jobs from stdin (or --socket), one per line\n"
+                "            as tab separated key=value pairs: input, output, xmp,\n"
+                "            format, width, height, style, style-overwrite, hq,\n"
+                "            upscale, id. other options give the defaults\n"
+                "   --socket <path> read jobs from clients of a unix socket\n"
+                "   --pipes <n> number of concurrent jobs in server mode\n"
+                "               default: plugins/lighttable/export/parallel_pipes\n"
                 "   --verbose\n"
                 "   -h, --help [option]\n"
                 "   -v, --version\n",
@@ -212,6 +231,701 @@ static gboolean _inputs_have_xmp_sidecar(const GList* inputs)
   return inputs != NULL;
 }
 
+static gchar *_normalize_ext(gchar *ext)
+{
+  const char *alias = !strcmp(ext, "jpg") ? "jpeg"
+                    : !strcmp(ext, "tif") ? "tiff"
+                    : !strcmp(ext, "jxl") ? "jpegxl"
+                    : NULL;
+  if(!alias) return ext;
+  g_free(ext);
+  return g_strdup(alias);
+}
+
+// the export size is the smallest of the requested one and the limits
+// of the storage and format modules
+static void _set_export_size(dt_imageio_module_storage_t *storage,
+                             dt_imageio_module_data_t *sdata,
+                             dt_imageio_module_format_t *format,
+                             dt_imageio_module_data_t *fdata,
+                             const int width,
+                             const int height)
+{
+  uint32_t w, h, fw, fh, sw, sh;
+  fw = fh = sw = sh = 0;
+  storage->dimension(storage, sdata, &sw, &sh);
+  format->dimension(format, fdata, &fw, &fh);
+
+  if(sw == 0 || fw == 0)
+    w = sw > fw ? sw : fw;
+  else
+    w = sw < fw ? sw : fw;
+
+  if(sh == 0 || fh == 0)
+    h = sh > fh ? sh : fh;
+  else
+    h = sh < fh ? sh : fh;
+
+  fdata->max_width = width;
+  fdata->max_height = height;
+  fdata->max_width = (w != 0 && fdata->max_width > w) ? w : fdata->max_width;
+  fdata->max_height = (h != 0 && fdata->max_height > h) ? h : fdata->max_height;
+}
+
+static void _export_metadata_init(dt_export_metadata_t *metadata,
+                                  const gboolean custom_presets)
+{
+  // TODO: have a parameter in command line to get the export presets
+  if(custom_presets)
+  {
+    metadata->flags = dt_lib_export_metadata_get_conf_flags();
+    metadata->list = dt_util_str_to_glist("\1", dt_lib_export_metadata_get_conf());
+    if(metadata->list)
+      metadata->list = g_list_remove(metadata->list, metadata->list->data);
+  }
+  else
+  {
+    metadata->flags = dt_lib_export_metadata_default_flags();
+    metadata->list = NULL;
+  }
+}
+
+/*
+ * server mode: darktable is initialized once and export jobs are read line
+ * by line from stdin or from the clients of a unix socket. a job is a list
+ * of tab separated key=value pairs:
+ *
+ *   input=<file>  output=<file or dir>  [xmp=<file>] [format=<ext>]
+ *   [width=<px>] [height=<px>] [style=<name>] [style-overwrite=<0|1>]
+ *   [hq=<0|1>] [upscale=<0|1>] [id=<string>]
+ *
+ * missing keys take the value given on the command line. the answer is
+ * written back on the same stream as "ok<TAB>id" or "error<TAB>id<TAB>message",
+ * the id defaulting to the line number. a line "quit" stops the server
+ * once all queued jobs are done.
+ */
+
+typedef struct dt_cli_client_t
+{
+  FILE *out;
+  dt_pthread_mutex_t lock;
+  gint refs;
+} dt_cli_client_t;
+
+typedef struct dt_cli_job_t
+{
+  dt_cli_client_t *client;
+  gchar *id;
+  gchar *input;
+  gchar *xmp;
+  gchar *output;
+  gchar *ext;
+  gchar *style;
+  int width, height;
+  gboolean high_quality, upscale, style_overwrite;
+} dt_cli_job_t;
+
+typedef struct dt_cli_server_t
+{
+  // defaults for the keys missing in a job
+  int width, height;
+  gboolean high_quality, upscale, style_overwrite;
+  const char *style;
+  const char *ext;
+
+  // settings shared by all jobs
+  gboolean export_masks, custom_presets, from_library;
+  dt_colorspaces_color_profile_type_t icc_type;
+  const gchar *icc_filename;
+  dt_iop_color_intent_t icc_intent;
+
+  GAsyncQueue *queue;
+  // serializes import, sidecar reading and removal of images
+  dt_pthread_mutex_t lock;
+  pthread_cond_t released;
+  // images currently processed, a second job on the same image (likely
+  // with another sidecar) has to wait for the history to be free
+  GHashTable *busy;
+  gint quit;
+  gint done, failed;
+} dt_cli_server_t;
+
+// pushed once per worker to stop it
+static dt_cli_job_t _server_stop;
+
+static dt_cli_client_t *_client_new(FILE *out)
+{
+  dt_cli_client_t *c = calloc(1, sizeof(dt_cli_client_t));
+  if(!c) return NULL;
+  c->out = out;
+  c->refs = 1;
+  dt_pthread_mutex_init(&c->lock, NULL);
+  return c;
+}
+
+static void _client_unref(dt_cli_client_t *c)
+{
+  if(!g_atomic_int_dec_and_test(&c->refs)) return;
+  if(c->out != stdout) fclose(c->out);
+  dt_pthread_mutex_destroy(&c->lock);
+  free(c);
+}
+
+static void _client_reply(dt_cli_client_t *c, const char *fmt, ...)
+  __attribute__((format(printf, 2, 3)));
+
+static void _client_reply(dt_cli_client_t *c, const char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  dt_pthread_mutex_lock(&c->lock);
+  vfprintf(c->out, fmt, ap);
+  fputc('\n', c->out);
+  fflush(c->out);
+  dt_pthread_mutex_unlock(&c->lock);
+  va_end(ap);
+}
+
+static void _job_free(dt_cli_job_t *job)
+{
+  _client_unref(job->client);
+  g_free(job->id);
+  g_free(job->input);
+  g_free(job->xmp);
+  g_free(job->output);
+  g_free(job->ext);
+  g_free(job->style);
+  free(job);
+}
+
+static void _replace_str(gchar **str, const char *value)
+{
+  g_free(*str);
+  *str = g_strdup(value);
+}
+
+static gboolean _parse_bool(const char *value, gboolean *res)
+{
+  if(!g_ascii_strcasecmp(value, "0") || !g_ascii_strcasecmp(value, "false"))
+    *res = FALSE;
+  else if(!g_ascii_strcasecmp(value, "1") || !g_ascii_strcasecmp(value, "true"))
+    *res = TRUE;
+  else
+    return FALSE;
+  return TRUE;
+}
+
+// fill in the output pattern and format the same way as on the command line
+static gboolean _job_resolve_output(dt_cli_job_t *job, gchar **error)
+{
+  if(g_file_test(job->output, G_FILE_TEST_IS_DIR))
+  {
+    if(!job->ext) job->ext = g_strdup("jpg");
+    gchar *dir = job->output;
+    if(g_str_has_suffix(dir, "/")) dir[strlen(dir) - 1] = '\0';
+    job->output = g_strconcat(dir, "/$(FILE_NAME)", NULL);
+    g_free(dir);
+  }
+  else
+  {
+    char *ext = strrchr(job->output, '.');
+    if(!job->ext)
+    {
+      if(!ext || strlen(ext) <= 1 || strlen(ext) > DT_MAX_OUTPUT_EXT_LENGTH)
+      {
+        *error = g_strdup_printf("no valid output file extension in '%s'", job->output);
+        return FALSE;
+      }
+      job->ext = g_strdup(ext + 1);
+      *ext = '\0';
+    }
+    else if(ext && !strcmp(job->ext, ext + 1))
+      *ext = '\0';
+  }
+
+  job->ext = _normalize_ext(job->ext);
+  return TRUE;
+}
+
+static dt_cli_job_t *_job_parse(dt_cli_server_t *s,
+                                dt_cli_client_t *client,
+                                const char *line,
+                                const int lineno,
+                                gchar **id,
+                                gchar **error)
+{
+  dt_cli_job_t *job = calloc(1, sizeof(dt_cli_job_t));
+  if(!job)
+  {
+    *error = g_strdup("out of memory");
+    return NULL;
+  }
+  job->width = s->width;
+  job->height = s->height;
+  job->high_quality = s->high_quality;
+  job->upscale = s->upscale;
+  job->style_overwrite = s->style_overwrite;
+  job->style = g_strdup(s->style);
+  job->ext = g_strdup(s->ext);
+
+  gboolean ok = TRUE;
+  gchar **fields = g_strsplit(line, "\t", -1);
+  for(gchar **f = fields; *f && ok; f++)
+  {
+    if(!**f) continue;
+    char *value = strchr(*f, '=');
+    if(!value)
+    {
+      *error = g_strdup_printf("expected key=value, got '%s'", *f);
+      ok = FALSE;
+      break;
+    }
+    *value++ = '\0';
+    const char *key = *f;
+
+    if(!strcmp(key, "id"))
+      _replace_str(&job->id, value);
+    else if(!strcmp(key, "input"))
+      _replace_str(&job->input, value);
+    else if(!strcmp(key, "xmp"))
+      _replace_str(&job->xmp, value);
+    else if(!strcmp(key, "output"))
+      _replace_str(&job->output, value);
+    else if(!strcmp(key, "format"))
+      _replace_str(&job->ext, value[0] == '.' ? value + 1 : value);
+    else if(!strcmp(key, "style"))
+      _replace_str(&job->style, value);
+    else if(!strcmp(key, "width"))
+      job->width = MAX(atoi(value), 0);
+    else if(!strcmp(key, "height"))
+      job->height = MAX(atoi(value), 0);
+    else if(!strcmp(key, "hq"))
+      ok = _parse_bool(value, &job->high_quality);
+    else if(!strcmp(key, "upscale"))
+      ok = _parse_bool(value, &job->upscale);
+    else if(!strcmp(key, "style-overwrite"))
+      ok = _parse_bool(value, &job->style_overwrite);
+    else
+    {
+      *error = g_strdup_printf("unknown key '%s'", key);
+      ok = FALSE;
+    }
+
+    if(!ok && !*error)
+      *error = g_strdup_printf("invalid value '%s' for '%s'", value, key);
+  }
+  g_strfreev(fields);
+
+  if(!job->id) job->id = g_strdup_printf("%d", lineno);
+
+  if(ok && (!job->input || !job->output))
+  {
+    *error = g_strdup("input and output must be given");
+    ok = FALSE;
+  }
+  if(ok && job->ext && strlen(job->ext) > DT_MAX_OUTPUT_EXT_LENGTH)
+  {
+    *error = g_strdup_printf("too long output file extension: %s", job->ext);
+    ok = FALSE;
+  }
+  if(ok) ok = _job_resolve_output(job, error);
+
+  job->client = client;
+  g_atomic_int_inc(&client->refs);
+  if(!ok)
+  {
+    // keep the id for the error message
+    *id = g_strdup(job->id);
+    _job_free(job);
+    return NULL;
+  }
+  return job;
+}
+
+// import the job input and take ownership of its history
+static dt_imgid_t _server_acquire_image(dt_cli_server_t *s,
+                                        dt_cli_job_t *job,
+                                        gchar **error)
+{
+  gchar *directory = g_path_get_dirname(job->input);
+  dt_imgid_t imgid = NO_IMGID;
+
+  dt_pthread_mutex_lock(&s->lock);
+  dt_film_t film;
+  const dt_filmid_t filmid = dt_film_new(&film, directory);
+  if(dt_is_valid_filmid(filmid))
+  {
+    while(TRUE)
+    {
+      // import again after waiting, the other job might have removed it
+      imgid = dt_image_import(filmid, job->input, TRUE, FALSE);
+      if(!dt_is_valid_imgid(imgid)
+         || !g_hash_table_contains(s->busy, GINT_TO_POINTER(imgid)))
+        break;
+      dt_pthread_cond_wait(&s->released, &s->lock);
+    }
+  }
+
+  if(!dt_is_valid_imgid(imgid))
+    *error = g_strdup_printf("can't open file %s", job->input);
+  else
+  {
+    g_hash_table_add(s->busy, GINT_TO_POINTER(imgid));
+    if(job->xmp)
+    {
+      dt_image_t *image = dt_image_cache_get(imgid, 'w');
+      const gboolean failed = dt_exif_xmp_read(image, job->xmp, FALSE);
+      // don't write new xmp:
+      dt_image_cache_write_release(image, DT_IMAGE_CACHE_RELAXED);
+      if(failed)
+      {
+        *error = g_strdup_printf("can't open XMP file %s", job->xmp);
+        g_hash_table_remove(s->busy, GINT_TO_POINTER(imgid));
+        if(!s->from_library) dt_image_remove(imgid);
+        pthread_cond_broadcast(&s->released);
+        imgid = NO_IMGID;
+      }
+    }
+  }
+  dt_pthread_mutex_unlock(&s->lock);
+
+  g_free(directory);
+  return imgid;
+}
+
+static void _server_release_image(dt_cli_server_t *s, const dt_imgid_t imgid)
+{
+  dt_pthread_mutex_lock(&s->lock);
+  g_hash_table_remove(s->busy, GINT_TO_POINTER(imgid));
+  // with the in-memory library the image is dropped so that the next job
+  // reads its sidecar again instead of reusing this history
+  if(!s->from_library) dt_image_remove(imgid);
+  pthread_cond_broadcast(&s->released);
+  dt_pthread_mutex_unlock(&s->lock);
+}
+
+static gboolean _server_process_job(dt_cli_server_t *s,
+                                    dt_cli_job_t *job,
+                                    gchar **error)
+{
+  if(!g_file_test(job->input, G_FILE_TEST_IS_REGULAR))
+  {
+    *error = g_strdup_printf("can't open file %s", job->input);
+    return FALSE;
+  }
+
+  dt_imageio_module_storage_t *storage = dt_imageio_get_storage_by_name("disk");
+  dt_imageio_module_format_t *format = dt_imageio_get_format_by_name(job->ext);
+  if(!storage || !format)
+  {
+    *error = storage ? g_strdup_printf("unknown extension '.%s'", job->ext)
+                     : g_strdup("cannot find disk storage module");
+    return FALSE;
+  }
+
+  const dt_imgid_t imgid = _server_acquire_image(s, job, error);
+  if(!dt_is_valid_imgid(imgid)) return FALSE;
+
+  // every job gets its own parameters, the format modules keep their
+  // encoder state in there
+  dt_imageio_module_data_t *sdata = storage->get_params(storage);
+  dt_imageio_module_data_t *fdata = format->get_params(format);
+
+  gboolean ok = FALSE;
+  if(!sdata || !fdata)
+    *error = g_strdup("failed to get module parameters");
+  else
+  {
+    g_strlcpy((char *)sdata, job->output, DT_MAX_PATH_FOR_PARAMS);
+    _set_export_size(storage, sdata, format, fdata, job->width, job->height);
+    fdata->style[0] = '\0';
+    fdata->style_append = !job->style_overwrite;
+    if(job->style)
+      g_strlcpy((char *)fdata->style, job->style, DT_MAX_STYLE_NAME_LENGTH);
+
+    dt_export_metadata_t metadata;
+    _export_metadata_init(&metadata, s->custom_presets);
+    ok = storage->store(storage, sdata, imgid, format, fdata, 1, 1,
+                        job->high_quality, job->upscale, FALSE, 1.0,
+                        s->export_masks, s->icc_type, s->icc_filename,
+                        s->icc_intent, &metadata) == 0;
+    g_list_free_full(metadata.list, g_free);
+    if(!ok) *error = g_strdup_printf("export of %s failed", job->input);
+  }
+
+  if(sdata) storage->free_params(storage, sdata);
+  if(fdata) format->free_params(format, fdata);
+  _server_release_image(s, imgid);
+  return ok;
+}
+
+static gpointer _server_worker(gpointer arg)
+{
+  dt_cli_server_t *s = arg;
+
+  while(TRUE)
+  {
+    dt_cli_job_t *job = g_async_queue_pop(s->queue);
+    if(job == &_server_stop) break;
+
+    gchar *error = NULL;
+    const double start = dt_get_wtime();
+    if(_server_process_job(s, job, &error))
+    {
+      g_atomic_int_inc(&s->done);
+      _client_reply(job->client, "ok\t%s", job->id);
+    }
+    else
+    {
+      g_atomic_int_inc(&s->failed);
+      _client_reply(job->client, "error\t%s\t%s", job->id, error);
+    }
+    dt_print(DT_DEBUG_PERF, "[darktable-cli] job %s took %.3f secs%s%s",
+             job->id, dt_get_wtime() - start, error ? ", " : "", error ? error : "");
+    g_free(error);
+    _job_free(job);
+  }
+  return NULL;
+}
+
+// read jobs until end of stream or "quit"
+static void _server_read_jobs(dt_cli_server_t *s, FILE *in, dt_cli_client_t *client)
+{
+  char line[4 * PATH_MAX];
+  int lineno = 0;
+
+  while(!g_atomic_int_get(&s->quit) && fgets(line, sizeof(line), in))
+  {
+    lineno++;
+    const size_t len = strlen(line);
+    if(len == sizeof(line) - 1 && line[len - 1] != '\n')
+    {
+      // skip the rest of an overlong line
+      int ch;
+      while((ch = fgetc(in)) != EOF && ch != '\n');
+      _client_reply(client, "error\t%d\tline too long", lineno);
+      continue;
+    }
+    g_strchomp(line);
+    if(line[0] == '\0' || line[0] == '#') continue;
+    if(!strcmp(line, "quit"))
+    {
+      g_atomic_int_set(&s->quit, TRUE);
+      break;
+    }
+
+    gchar *id = NULL;
+    gchar *error = NULL;
+    dt_cli_job_t *job = _job_parse(s, client, line, lineno, &id, &error);
+    if(job)
+    {
+      // no job must be queued behind the stop markers
+      dt_pthread_mutex_lock(&s->lock);
+      const gboolean accepted = !g_atomic_int_get(&s->quit);
+      if(accepted) g_async_queue_push(s->queue, job);
+      dt_pthread_mutex_unlock(&s->lock);
+      if(!accepted)
+      {
+        _client_reply(client, "error\t%s\tserver is shutting down", job->id);
+        _job_free(job);
+      }
+    }
+    else
+    {
+      _client_reply(client, "error\t%s\t%s", id ? id : "?", error);
+      g_free(id);
+      g_free(error);
+    }
+  }
+}
+
+#ifndef _WIN32
+typedef struct dt_cli_connection_t
+{
+  dt_cli_server_t *server;
+  int fd;
+  GThread *thread;
+  gboolean closed; // fd closed by the connection thread, protected by server->lock
+} dt_cli_connection_t;
+
+static gpointer _server_connection(gpointer arg)
+{
+  dt_cli_connection_t *conn = arg;
+  FILE *in = fdopen(conn->fd, "r");
+  const int out_fd = dup(conn->fd);
+  FILE *out = out_fd >= 0 ? fdopen(out_fd, "w") : NULL;
+  dt_cli_client_t *client = out ? _client_new(out) : NULL;
+
+  if(in && client)
+    _server_read_jobs(conn->server, in, client);
+  else if(out)
+    fclose(out);
+
+  // the client is closed when its last job has answered
+  if(client) _client_unref(client);
+
+  // the listener may shut the socket down until it is closed
+  dt_pthread_mutex_lock(&conn->server->lock);
+  if(in) fclose(in);
+  else close(conn->fd);
+  conn->closed = TRUE;
+  dt_pthread_mutex_unlock(&conn->server->lock);
+  return NULL;
+}
+
+// join the connection threads which are done, or all of them
+static GList *_server_join_connections(dt_cli_server_t *s,
+                                       GList *conns,
+                                       const gboolean all)
+{
+  GList *l = conns;
+  while(l)
+  {
+    GList *next = g_list_next(l);
+    dt_cli_connection_t *conn = l->data;
+    dt_pthread_mutex_lock(&s->lock);
+    const gboolean closed = conn->closed;
+    dt_pthread_mutex_unlock(&s->lock);
+    if(closed || all)
+    {
+      g_thread_join(conn->thread);
+      free(conn);
+      conns = g_list_delete_link(conns, l);
+    }
+    l = next;
+  }
+  return conns;
+}
+
+static int _server_listen(dt_cli_server_t *s, const char *path)
+{
+  struct sockaddr_un addr = { 0 };
+  if(strlen(path) >= sizeof(addr.sun_path))
+  {
+    fprintf(stderr, _("error: socket path '%s' is too long\n"), path);
+    return 1;
+  }
+
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(fd < 0)
+  {
+    fprintf(stderr, _("error: can't create socket: %s\n"), g_strerror(errno));
+    return 1;
+  }
+  addr.sun_family = AF_UNIX;
+  g_strlcpy(addr.sun_path, path, sizeof(addr.sun_path));
+  unlink(path);
+  if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, 16))
+  {
+    fprintf(stderr, _("error: can't listen on socket '%s': %s\n"), path, g_strerror(errno));
+    close(fd);
+    return 1;
+  }
+
+  // a client closing its connection early must not kill the server
+  signal(SIGPIPE, SIG_IGN);
+
+  // poll so that a "quit" from any client is noticed
+  struct pollfd pfd = { .fd = fd, .events = POLLIN };
+  GList *conns = NULL;
+  while(!g_atomic_int_get(&s->quit))
+  {
+    conns = _server_join_connections(s, conns, FALSE);
+
+    if(poll(&pfd, 1, 500) <= 0 || !(pfd.revents & POLLIN)) continue;
+    const int cfd = accept(fd, NULL, NULL);
+    if(cfd < 0) continue;
+
+    dt_cli_connection_t *conn = calloc(1, sizeof(dt_cli_connection_t));
+    if(!conn)
+    {
+      close(cfd);
+      continue;
+    }
+    conn->server = s;
+    conn->fd = cfd;
+    conn->thread = g_thread_new("cli-client", _server_connection, conn);
+    conns = g_list_prepend(conns, conn);
+  }
+
+  // stop reading from the clients still connected, their queued jobs
+  // can still answer. the threads must be gone before the server state
+  // is torn down.
+  dt_pthread_mutex_lock(&s->lock);
+  for(GList *l = conns; l; l = g_list_next(l))
+  {
+    dt_cli_connection_t *conn = l->data;
+    if(!conn->closed) shutdown(conn->fd, SHUT_RD);
+  }
+  dt_pthread_mutex_unlock(&s->lock);
+  _server_join_connections(s, conns, TRUE);
+
+  close(fd);
+  unlink(path);
+  return 0;
+}
+#endif
+
+static int _server_run(dt_cli_server_t *s, const char *socket_path, const int pipes)
+{
+  s->queue = g_async_queue_new();
+  s->busy = g_hash_table_new(NULL, NULL);
+  dt_pthread_mutex_init(&s->lock, NULL);
+  pthread_cond_init(&s->released, NULL);
+
+  dt_print(DT_DEBUG_PERF, "[darktable-cli] server ready with %d pipeline%s",
+           pipes, pipes > 1 ? "s" : "");
+
+  GThread **workers = calloc(pipes, sizeof(GThread *));
+  for(int i = 0; i < pipes; i++)
+    workers[i] = g_thread_new("cli-export", _server_worker, s);
+
+  const double start = dt_get_wtime();
+  int res = 0;
+  if(socket_path)
+  {
+#ifndef _WIN32
+    res = _server_listen(s, socket_path);
+#else
+    fprintf(stderr, "%s\n", _("error: --socket is not supported on this platform"));
+    res = 1;
+#endif
+  }
+  else
+  {
+    dt_cli_client_t *client = _client_new(stdout);
+    if(client)
+    {
+      _server_read_jobs(s, stdin, client);
+      _client_unref(client);
+    }
+  }
+
+  // let the workers drain the queue, then stop them
+  dt_pthread_mutex_lock(&s->lock);
+  g_atomic_int_set(&s->quit, TRUE);
+  dt_pthread_mutex_unlock(&s->lock);
+  for(int i = 0; i < pipes; i++)
+    g_async_queue_push(s->queue, &_server_stop);
+  for(int i = 0; i < pipes; i++)
+    g_thread_join(workers[i]);
+  free(workers);
+
+  const double elapsed = dt_get_wtime() - start;
+  const int total = s->done + s->failed;
+  if(total > 0 && elapsed > 0.0)
+    dt_print(DT_DEBUG_PERF,
+             "[darktable-cli] %d jobs (%d failed) in %.3f secs (%.2f images/s)",
+             total, s->failed, elapsed, total / elapsed);
+
+  pthread_cond_destroy(&s->released);
+  dt_pthread_mutex_destroy(&s->lock);
+  g_hash_table_destroy(s->busy);
+  g_async_queue_unref(s->queue);
+
+  return res ? res : (s->failed ? 1 : 0);
+}
+
 int main(int argc, char *arg[])
 {
 #ifdef __APPLE__
@@ -237,7 +951,9 @@ int main(int argc, char *arg[])
   int width = 0, height = 0, bpp = 0;
   gboolean verbose = FALSE, high_quality = TRUE, upscale = FALSE,
            style_overwrite = FALSE, custom_presets = TRUE, export_masks = FALSE,
-           output_to_dir = FALSE;
+           output_to_dir = FALSE, server = FALSE;
+  char *socket_path = NULL;
+  int pipes = 0;
 
   GList* inputs = NULL;
 
@@ -432,6 +1148,21 @@ int main(int argc, char *arg[])
           exit(1);
         }
       }
+      else if(!strcmp(arg[k], "--server"))
+      {
+        server = TRUE;
+      }
+      else if(!strcmp(arg[k], "--socket") && argc > k + 1)
+      {
+        k++;
+        server = TRUE;
+        socket_path = arg[k];
+      }
+      else if(!strcmp(arg[k], "--pipes") && argc > k + 1)
+      {
+        k++;
+        pipes = MAX(atoi(arg[k]), 1);
+      }
       else if(!strcmp(arg[k], "-v") || !strcmp(arg[k], "--verbose"))
       {
         verbose = TRUE;
@@ -472,7 +1203,15 @@ int main(int argc, char *arg[])
   m_arg[m_argc] = NULL;
 
   gboolean args_error = FALSE;
-  if(inputs && file_counter < 1)
+  if(server)
+  {
+    if(inputs || file_counter > 0)
+    {
+      fprintf(stderr, _("error: input and output files are given per job in server mode\n\n"));
+      args_error = TRUE;
+    }
+  }
+  else if(inputs && file_counter < 1)
   {
     fprintf(stderr, _("error: output file or directory must be specified\n\n"));
     args_error = TRUE;
@@ -506,6 +1245,45 @@ int main(int argc, char *arg[])
     exit(1);
   }
 
+  if(server)
+  {
+    // init dt once, the modules and the caches are shared by all jobs
+    if(dt_init(m_argc, m_arg, FALSE, custom_presets, NULL))
+    {
+      free(m_arg);
+      g_free(output_ext);
+      g_free(icc_filename);
+      exit(1);
+    }
+    darktable.prefer_library_history = (library != NULL);
+
+    dt_cli_server_t srv = { 0 };
+    srv.width = width;
+    srv.height = height;
+    srv.high_quality = high_quality;
+    srv.upscale = upscale;
+    srv.style_overwrite = style_overwrite;
+    srv.style = style;
+    srv.ext = output_ext;
+    srv.export_masks = export_masks;
+    srv.custom_presets = custom_presets;
+    srv.from_library = (library != NULL);
+    srv.icc_type = icc_type;
+    srv.icc_filename = icc_filename;
+    srv.icc_intent = icc_intent;
+
+    if(pipes == 0)
+      pipes = CLAMP(dt_conf_get_int("plugins/lighttable/export/parallel_pipes"),
+                    1, (int)dt_get_num_procs());
+    const int res = _server_run(&srv, socket_path, pipes);
+
+    g_free(output_ext);
+    g_free(icc_filename);
+    dt_cleanup();
+    free(m_arg);
+    exit(res);
+  }
+
   if(inputs && file_counter == 1)
   {
     //user specified inputs as options, and only dest is present
@@ -742,23 +1520,7 @@ int main(int argc, char *arg[])
     }
   }
 
-  if(!strcmp(output_ext, "jpg"))
-  {
-    g_free(output_ext);
-    output_ext = g_strdup("jpeg");
-  }
-
-  if(!strcmp(output_ext, "tif"))
-  {
-    g_free(output_ext);
-    output_ext = g_strdup("tiff");
-  }
-
-  if(!strcmp(output_ext, "jxl"))
-  {
-    g_free(output_ext);
-    output_ext = g_strdup("jpegxl");
-  }
+  output_ext = _normalize_ext(output_ext);
 
   // init the export data structures
   dt_imageio_module_format_t *format;
@@ -812,25 +1574,7 @@ int main(int argc, char *arg[])
     exit(1);
   }
 
-  uint32_t w, h, fw, fh, sw, sh;
-  fw = fh = sw = sh = 0;
-  storage->dimension(storage, sdata, &sw, &sh);
-  format->dimension(format, fdata, &fw, &fh);
-
-  if(sw == 0 || fw == 0)
-    w = sw > fw ? sw : fw;
-  else
-    w = sw < fw ? sw : fw;
-
-  if(sh == 0 || fh == 0)
-    h = sh > fh ? sh : fh;
-  else
-    h = sh < fh ? sh : fh;
-
-  fdata->max_width = width;
-  fdata->max_height = height;
-  fdata->max_width = (w != 0 && fdata->max_width > w) ? w : fdata->max_width;
-  fdata->max_height = (h != 0 && fdata->max_height > h) ? h : fdata->max_height;
+  _set_export_size(storage, sdata, format, fdata, width, height);
   fdata->style[0] = '\0';
   fdata->style_append = 1; // make append the default and override with --style-overwrite
 
@@ -857,19 +1601,7 @@ int main(int argc, char *arg[])
   {
     const int id = GPOINTER_TO_INT(iter->data);
     dt_export_metadata_t metadata;
-    // TODO: have a parameter in command line to get the export presets
-    if(custom_presets)
-    {
-      metadata.flags = dt_lib_export_metadata_get_conf_flags();
-      metadata.list = dt_util_str_to_glist("\1", dt_lib_export_metadata_get_conf());
-      if(metadata.list)
-        metadata.list = g_list_remove(metadata.list, metadata.list->data);
-    }
-    else
-    {
-      metadata.flags = dt_lib_export_metadata_default_flags();
-      metadata.list = NULL;
-    }
+    _export_metadata_init(&metadata, custom_presets);
     if(storage->store(storage, sdata, id, format, fdata, num, total, high_quality,
                       upscale, FALSE, 1.0, export_masks,
                       icc_type, icc_filename, icc_intent, &metadata) != 0)
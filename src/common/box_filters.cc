@@ -361,14 +361,18 @@ static void _box_mean(float *const buf,
                       const size_t height,
                       const size_t width,
                       const size_t radius,
-                      const uint32_t iterations)
+                      const uint32_t iterations,
+                      float *const __restrict__ user_scratch,
+                      const size_t user_padded_size)
 {
   // Compute in-place a box average (filter) on a multi-channel image over a window of size 2*radius + 1
   // We make use of the separable nature of the filter kernel to speed-up the computation
   // by convolving along columns and rows separately (complexity O(2 × radius) instead of O(radius²)).
 
-  size_t padded_size;
-  float *const __restrict__ scanlines = _alloc_scratch_space(N, height, width, radius, &padded_size);
+  size_t padded_size = user_padded_size;
+  float *const __restrict__ scanlines = user_scratch
+    ? user_scratch
+    : _alloc_scratch_space(N, height, width, radius, &padded_size);
   if(scanlines == NULL) return;
 
   for(uint32_t iteration = 0; iteration < iterations; iteration++)
@@ -382,7 +386,8 @@ static void _box_mean(float *const buf,
     // we need to multiply width by N to get the correct stride for the vertical blur
     _blur_vertical_1ch<compensated>(buf, height, N*width, radius, scanlines, padded_size);
   }
-  dt_free_align(scanlines);
+  if(!user_scratch)
+    dt_free_align(scanlines);
 }
 
 static inline float _window_max(const float *x, int n)
@@ -599,44 +604,91 @@ static void _box_min_1ch(float *const buf,
   dt_free_align(scratch_buffers);
 }
 
-void dt_box_mean(float *const buf,
-                 const size_t height,
-                 const size_t width,
-                 const uint32_t ch,
-                 const size_t radius,
-                 const uint32_t iterations)
+static void _box_mean_dispatch(float *const buf,
+                               const size_t height,
+                               const size_t width,
+                               const uint32_t ch,
+                               const size_t radius,
+                               const uint32_t iterations,
+                               float *const scratch,
+                               const size_t padded_size)
 {
   if(ch == 1)
   {
-    _box_mean<1>(buf,height,width,radius,iterations);
+    _box_mean<1>(buf,height,width,radius,iterations,scratch,padded_size);
   }
   else if(ch == 2) // used by fast_guided_filter.h
   {
-    _box_mean<2>(buf,height,width,radius,iterations);
+    _box_mean<2>(buf,height,width,radius,iterations,scratch,padded_size);
   }
   else if(ch == 4)
   {
-    _box_mean<4>(buf,height,width,radius,iterations);
+    _box_mean<4>(buf,height,width,radius,iterations,scratch,padded_size);
   }
   else if(ch == (2|BOXFILTER_KAHAN_SUM))
   {
-    _box_mean<2,true>(buf,height,width,radius,iterations);
+    _box_mean<2,true>(buf,height,width,radius,iterations,scratch,padded_size);
   }
   else if(ch == (4|BOXFILTER_KAHAN_SUM))
   {
-    _box_mean<4,true>(buf,height,width,radius,iterations);
+    _box_mean<4,true>(buf,height,width,radius,iterations,scratch,padded_size);
   }
   else
     dt_unreachable_codepath();
 }
 
+void dt_box_mean(float *const buf,
+                 const size_t height,
+                 const size_t width,
+                 const uint32_t ch,
+                 const size_t radius,
+                 const uint32_t iterations)
+{
+  _box_mean_dispatch(buf, height, width, ch, radius, iterations, NULL, 0);
+}
+
+size_t dt_box_mean_scratch_size(const size_t height,
+                                const size_t width,
+                                const uint32_t ch,
+                                const size_t radius)
+{
+  const size_t eff_height = _compute_effective_height(height,radius);
+  const size_t channels = ch & ~BOXFILTER_KAHAN_SUM;
+  return MAX(channels*width,MAX(height,MAX_VECT*eff_height));
+}
+
+void dt_box_mean_with_scratch(float *const buf,
+                              const size_t height,
+                              const size_t width,
+                              const uint32_t ch,
+                              const size_t radius,
+                              const uint32_t iterations,
+                              float *const scratch,
+                              const size_t padded_size)
+{
+  _box_mean_dispatch(buf, height, width, ch, radius, iterations, scratch, padded_size);
+}
+
 void dt_box_mean_horizontal(float *const __restrict__ buf,
     const size_t width,
     const uint32_t ch,
     const size_t radius,
     float *const __restrict__ user_scratch)
 {
-  if(ch == (4|BOXFILTER_KAHAN_SUM))
+  if(ch == 4)
+  {
+    float *const __restrict__ scratch
+       = user_scratch ? user_scratch : dt_alloc_align_float(4 * dt_round_size(width, MAX_VECT));
+    if(scratch)
+    {
+      _blur_horizontal<4>(buf, width, radius, scratch);
+      if(!user_scratch)
+        dt_free_align(scratch);
+    }
+    else
+      dt_print(DT_DEBUG_ALWAYS, "[box_mean] unable to allocate scratch memory");
+  }
+  else if(ch == (4|BOXFILTER_KAHAN_SUM))
   {
     float *const __restrict__ scratch
        = user_scratch ? user_scratch : dt_alloc_align_float(4 * dt_round_size(width, MAX_VECT));
@@ -666,26 +718,43 @@ void dt_box_mean_horizontal(float *const __restrict__ buf,
     dt_unreachable_codepath();
 }
 
-void dt_box_mean_vertical(float *const buf,
-    const size_t height,
-    const size_t width,
-    const uint32_t ch,
-    const size_t radius)
+void dt_box_mean_vertical_with_scratch(float *const buf,
+                                       const size_t height,
+                                       const size_t width,
+                                       const uint32_t ch,
+                                       const size_t radius,
+                                       float *const user_scratch,
+                                       const size_t user_padded_size)
 {
-  if((ch & BOXFILTER_KAHAN_SUM) && (ch & ~BOXFILTER_KAHAN_SUM) <= 16)
+  const size_t channels = ch & ~BOXFILTER_KAHAN_SUM;
+  if(channels >= 1 && channels <= 16)
   {
-    size_t channels = ch & ~BOXFILTER_KAHAN_SUM;
-    size_t padded_size;
-    float *const __restrict__ scratch_buf = _alloc_scratch_space(channels, height, width, radius, &padded_size);
+    size_t padded_size = user_padded_size;
+    float *const __restrict__ scratch_buf = user_scratch
+      ? user_scratch
+      : _alloc_scratch_space(channels, height, width, radius, &padded_size);
     if(scratch_buf == NULL) return;
 
-    _blur_vertical_1ch<true>(buf, height, channels*width, radius, scratch_buf, padded_size);
-    dt_free_align(scratch_buf);
+    if(ch & BOXFILTER_KAHAN_SUM)
+      _blur_vertical_1ch<true>(buf, height, channels*width, radius, scratch_buf, padded_size);
+    else
+      _blur_vertical_1ch<false>(buf, height, channels*width, radius, scratch_buf, padded_size);
+    if(!user_scratch)
+      dt_free_align(scratch_buf);
   }
   else
     dt_unreachable_codepath();
 }
 
+void dt_box_mean_vertical(float *const buf,
+    const size_t height,
+    const size_t width,
+    const uint32_t ch,
+    const size_t radius)
+{
+  dt_box_mean_vertical_with_scratch(buf, height, width, ch, radius, NULL, 0);
+}
+
 // in-place calculate the two-dimensional moving minimum over a box of size (2*radius+1) x (2*radius+1)
 void dt_box_min(float *const buf,
                 const size_t height,
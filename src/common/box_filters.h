@@ -35,12 +35,22 @@ extern "C" {
 // ch = number of channels per pixel.  Supported values: 1, 2, 4, and 4|Kahan
 void dt_box_mean(float *const buf, const size_t height, const size_t width, const uint32_t ch,
                  const size_t radius, const uint32_t interations);
-// run a single iteration horizonally over a single row.  Supported values for ch: 4|Kahan
+// number of floats per thread needed as scratch space by the *_with_scratch variants below,
+// allocate it with dt_alloc_perthread_float() and pass the returned padded size along
+size_t dt_box_mean_scratch_size(const size_t height, const size_t width, const uint32_t ch, const size_t radius);
+// same as dt_box_mean but using the caller's per-thread scratch space instead of allocating it
+void dt_box_mean_with_scratch(float *const buf, const size_t height, const size_t width, const uint32_t ch,
+                              const size_t radius, const uint32_t iterations,
+                              float *const scratch, const size_t padded_size);
+// run a single iteration horizonally over a single row.  Supported values for ch: 4, 4|Kahan, 9|Kahan
 // 'scratch' must point at a buffer large enough to hold ch*width floats, or be NULL
 void dt_box_mean_horizontal(float *const buf, const size_t width, const uint32_t ch, const size_t radius,
                             float *const scratch);
-// run a single iteration vertically over the entire image.  Supported values for ch: 4|Kahan
+// run a single iteration vertically over the entire image.  Supported values for ch: 1..16, with or without Kahan
 void dt_box_mean_vertical(float *const buf, const size_t height, const size_t width, const uint32_t ch, const size_t radius);
+// same as dt_box_mean_vertical but using the caller's per-thread scratch space (or allocating it if NULL)
+void dt_box_mean_vertical_with_scratch(float *const buf, const size_t height, const size_t width, const uint32_t ch,
+                                       const size_t radius, float *const scratch, const size_t padded_size);
 
 void dt_box_min(float *const buf, const size_t height, const size_t width, const uint32_t ch, const size_t radius);
 void dt_box_max(float *const buf, const size_t height, const size_t width, const uint32_t ch, const size_t radius);
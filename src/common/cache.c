@@ -25,54 +25,240 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-// this implements a concurrent LRU cache
+// this implements a concurrent LRU cache.
+//
+// keys are spread over DT_CACHE_SHARDS shards, each with its own mutex,
+// its own open addressing hash table and its own intrusive lru list.
+// the lru order is thus only maintained per shard, garbage collection
+// starts with the shard that needs room and then visits the others
+// without ever blocking on their locks.
+
+#define DT_CACHE_INITIAL_TABLE_SIZE 64
+
+// murmur3 finalizer, imgids and mipmap keys are mostly consecutive
+static inline uint32_t _cache_hash(uint32_t key)
+{
+  key ^= key >> 16;
+  key *= 0x85ebca6bu;
+  key ^= key >> 13;
+  key *= 0xc2b2ae35u;
+  key ^= key >> 16;
+  return key;
+}
+
+static inline dt_cache_shard_t *_cache_shard(dt_cache_t *cache,
+                                             const uint32_t hash)
+{
+  return &cache->shard[hash & (DT_CACHE_SHARDS - 1)];
+}
+
+static inline uint32_t _table_home(const dt_cache_shard_t *shard,
+                                   const uint32_t hash)
+{
+  return (hash >> DT_CACHE_SHARD_BITS) & (shard->table_size - 1);
+}
+
+static inline void _shard_lock(dt_cache_shard_t *shard)
+  ACQUIRE(&shard->lock) NO_THREAD_SAFETY_ANALYSIS
+{
+  if(dt_pthread_mutex_trylock(&shard->lock))
+  {
+    dt_pthread_mutex_lock(&shard->lock);
+    shard->contention++;
+  }
+}
+
+static inline void _shard_unlock(dt_cache_shard_t *shard)
+  RELEASE(&shard->lock)
+{
+  dt_pthread_mutex_unlock(&shard->lock);
+}
+
+static dt_cache_entry_t *_table_lookup(const dt_cache_shard_t *shard,
+                                       const uint32_t key,
+                                       const uint32_t hash)
+{
+  const uint32_t mask = shard->table_size - 1;
+  for(uint32_t i = _table_home(shard, hash);; i = (i + 1) & mask)
+  {
+    dt_cache_entry_t *entry = shard->table[i];
+    if(!entry || entry->key == key) return entry;
+  }
+}
+
+static void _table_place(dt_cache_entry_t **table,
+                         const uint32_t size,
+                         dt_cache_entry_t *entry)
+{
+  const uint32_t mask = size - 1;
+  uint32_t i = (_cache_hash(entry->key) >> DT_CACHE_SHARD_BITS) & mask;
+  while(table[i]) i = (i + 1) & mask;
+  table[i] = entry;
+}
+
+// make room for one more entry, returns FALSE if the table is full
+// and could not grow
+static gboolean _table_reserve(dt_cache_shard_t *shard)
+{
+  // keep the load factor below 1/2 so probe sequences stay short
+  if(2 * (shard->count + 1) > shard->table_size)
+  {
+    const uint32_t size = 2 * shard->table_size;
+    dt_cache_entry_t **table = calloc(size, sizeof(dt_cache_entry_t *));
+    if(table)
+    {
+      for(uint32_t i = 0; i < shard->table_size; i++)
+        if(shard->table[i]) _table_place(table, size, shard->table[i]);
+      free(shard->table);
+      shard->table = table;
+      shard->table_size = size;
+    }
+  }
+  // on allocation failure we only get slower, but at least one slot
+  // must stay empty to terminate the probe sequences
+  return shard->count + 2 <= shard->table_size;
+}
+
+static void _table_insert(dt_cache_shard_t *shard,
+                          dt_cache_entry_t *entry)
+{
+  _table_place(shard->table, shard->table_size, entry);
+  shard->count++;
+}
+
+// backward shift deletion, keeps the table free of tombstones
+static void _table_remove(dt_cache_shard_t *shard,
+                          const dt_cache_entry_t *entry)
+{
+  const uint32_t mask = shard->table_size - 1;
+  uint32_t i = _table_home(shard, _cache_hash(entry->key));
+  while(shard->table[i] != entry) i = (i + 1) & mask;
+
+  shard->table[i] = NULL;
+  shard->count--;
+
+  for(uint32_t j = (i + 1) & mask; shard->table[j]; j = (j + 1) & mask)
+  {
+    const uint32_t k = _table_home(shard, _cache_hash(shard->table[j]->key));
+    // the entry at j can stay if its home slot lies cyclically in (i, j]
+    const gboolean stays = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+    if(!stays)
+    {
+      shard->table[i] = shard->table[j];
+      shard->table[j] = NULL;
+      i = j;
+    }
+  }
+}
+
+static inline void _lru_unlink(dt_cache_shard_t *shard,
+                               dt_cache_entry_t *entry)
+{
+  if(entry->lru_prev) entry->lru_prev->lru_next = entry->lru_next;
+  else shard->lru_head = entry->lru_next;
+  if(entry->lru_next) entry->lru_next->lru_prev = entry->lru_prev;
+  else shard->lru_tail = entry->lru_prev;
+  entry->lru_prev = entry->lru_next = NULL;
+}
+
+static inline void _lru_append(dt_cache_shard_t *shard,
+                               dt_cache_entry_t *entry)
+{
+  entry->lru_prev = shard->lru_tail;
+  entry->lru_next = NULL;
+  if(shard->lru_tail) shard->lru_tail->lru_next = entry;
+  else shard->lru_head = entry;
+  shard->lru_tail = entry;
+}
+
+// bubble up in lru list
+static inline void _lru_touch(dt_cache_shard_t *shard,
+                              dt_cache_entry_t *entry)
+{
+  if(shard->lru_tail == entry) return;
+  _lru_unlink(shard, entry);
+  _lru_append(shard, entry);
+}
+
+static void _cache_free_entry(dt_cache_t *cache,
+                              dt_cache_entry_t *entry)
+{
+  if(cache->cleanup)
+  {
+    assert(entry->data_size);
+    ASAN_UNPOISON_MEMORY_REGION(entry->data, entry->data_size);
+
+    cache->cleanup(cache->cleanup_data, entry);
+  }
+  else
+    dt_free_align(entry->data);
+}
 
 void dt_cache_init(dt_cache_t *cache,
                    const size_t entry_size,
                    const size_t cost_quota)
 {
-  cache->cost = 0;
-  cache->lru = 0;
   cache->entry_size = entry_size;
   cache->cost_quota = cost_quota;
-  dt_pthread_mutex_init(&cache->lock, 0);
   cache->allocate = 0;
   cache->allocate_data = 0;
   cache->cleanup = 0;
   cache->cleanup_data = 0;
-  cache->hashtable = g_hash_table_new(0, 0);
+
+  for(int k = 0; k < DT_CACHE_SHARDS; k++)
+  {
+    dt_cache_shard_t *shard = &cache->shard[k];
+    dt_pthread_mutex_init(&shard->lock, 0);
+    shard->table = calloc(DT_CACHE_INITIAL_TABLE_SIZE, sizeof(dt_cache_entry_t *));
+    shard->table_size = DT_CACHE_INITIAL_TABLE_SIZE;
+    shard->count = 0;
+    shard->lru_head = shard->lru_tail = NULL;
+    shard->cost = 0;
+    shard->hits = shard->misses = shard->contention = shard->retries = 0;
+  }
 }
 
 void dt_cache_cleanup(dt_cache_t *cache)
 {
-  g_hash_table_destroy(cache->hashtable);
-  for(GList *l = cache->lru; l; l = g_list_next(l))
+  for(int k = 0; k < DT_CACHE_SHARDS; k++)
   {
-    dt_cache_entry_t *entry = l->data;
-
-    if(cache->cleanup)
+    dt_cache_shard_t *shard = &cache->shard[k];
+    dt_cache_entry_t *entry = shard->lru_head;
+    while(entry)
     {
-      assert(entry->data_size);
-      ASAN_UNPOISON_MEMORY_REGION(entry->data, entry->data_size);
-
-      cache->cleanup(cache->cleanup_data, entry);
+      dt_cache_entry_t *next = entry->lru_next;
+      _cache_free_entry(cache, entry);
+      dt_pthread_rwlock_destroy(&entry->lock);
+      g_slice_free1(sizeof(*entry), entry);
+      entry = next;
     }
-    else
-      dt_free_align(entry->data);
-
-    dt_pthread_rwlock_destroy(&entry->lock);
-    g_slice_free1(sizeof(*entry), entry);
+    free(shard->table);
+    shard->table = NULL;
+    shard->lru_head = shard->lru_tail = NULL;
+    shard->count = 0;
+    shard->cost = 0;
+    dt_pthread_mutex_destroy(&shard->lock);
   }
-  g_list_free(cache->lru);
-  dt_pthread_mutex_destroy(&cache->lock);
+}
+
+size_t dt_cache_get_cost(const dt_cache_t *cache)
+{
+  // shard costs are only ever written with their shard lock held,
+  // reading them relaxed from here gives a good enough snapshot
+  size_t cost = 0;
+  for(int k = 0; k < DT_CACHE_SHARDS; k++)
+    cost += __atomic_load_n(&cache->shard[k].cost, __ATOMIC_RELAXED);
+  return cost;
 }
 
 gboolean dt_cache_contains(dt_cache_t *cache,
                           const uint32_t key)
 {
-  dt_pthread_mutex_lock(&cache->lock);
-  const gboolean result = g_hash_table_contains(cache->hashtable, GINT_TO_POINTER(key));
-  dt_pthread_mutex_unlock(&cache->lock);
+  const uint32_t hash = _cache_hash(key);
+  dt_cache_shard_t *shard = _cache_shard(cache, hash);
+  _shard_lock(shard);
+  const gboolean result = _table_lookup(shard, key, hash) != NULL;
+  _shard_unlock(shard);
   return result;
 }
 
@@ -82,16 +268,13 @@ dt_cache_entry_t *dt_cache_testget(dt_cache_t *cache,
                                    const uint32_t key,
                                    const char mode)
 {
-  gpointer orig_key, value;
   const double start = dt_get_debug_wtime();
-  dt_pthread_mutex_lock(&cache->lock);
-  const gboolean res = g_hash_table_lookup_extended(cache->hashtable,
-                                                    GINT_TO_POINTER(key),
-                                                    &orig_key,
-                                                    &value);
-  if(res)
+  const uint32_t hash = _cache_hash(key);
+  dt_cache_shard_t *shard = _cache_shard(cache, hash);
+  _shard_lock(shard);
+  dt_cache_entry_t *entry = _table_lookup(shard, key, hash);
+  if(entry)
   {
-    dt_cache_entry_t *entry = (dt_cache_entry_t *)value;
     // lock the cache entry
     const int result = (mode == 'w')
       ? dt_pthread_rwlock_trywrlock(&entry->lock)
@@ -99,13 +282,13 @@ dt_cache_entry_t *dt_cache_testget(dt_cache_t *cache,
     if(result)
     { // need to give up mutex so other threads have a chance to get in between and
       // free the lock we're trying to acquire:
-      dt_pthread_mutex_unlock(&cache->lock);
+      shard->retries++;
+      _shard_unlock(shard);
       return NULL;
     }
-    // bubble up in lru list:
-    cache->lru = g_list_remove_link(cache->lru, entry->link);
-    cache->lru = g_list_concat(cache->lru, entry->link);
-    dt_pthread_mutex_unlock(&cache->lock);
+    shard->hits++;
+    _lru_touch(shard, entry);
+    _shard_unlock(shard);
     const double end = dt_get_debug_wtime();
     if(end - start > 0.1)
       dt_print(DT_DEBUG_ALWAYS, "try+ wait time %.06fs mode %c", end - start, mode);
@@ -120,47 +303,138 @@ dt_cache_entry_t *dt_cache_testget(dt_cache_t *cache,
 
     return entry;
   }
-  dt_pthread_mutex_unlock(&cache->lock);
+  shard->misses++;
+  _shard_unlock(shard);
   const double end = dt_get_debug_wtime();
   if(end - start > 0.1)
     dt_print(DT_DEBUG_ALWAYS, "try- wait time %.06fs", end - start);
   return NULL;
 }
 
+// remove the entry if nobody holds it, returns TRUE if it has been freed.
+// the shard lock has to be held by the caller, as for the functions below.
+static gboolean _shard_try_evict(dt_cache_t *cache,
+                                 dt_cache_shard_t *shard,
+                                 dt_cache_entry_t *entry)
+{
+  // if still locked by anyone else give up:
+  if(dt_pthread_rwlock_trywrlock(&entry->lock))
+    return FALSE;
+
+  if(entry->_lock_demoting)
+  {
+    // oops, we are currently demoting (rw -> r) lock to this entry
+    // in some thread. do not touch!
+    dt_pthread_rwlock_unlock(&entry->lock);
+    return FALSE;
+  }
+
+  // delete!
+  _table_remove(shard, entry);
+  _lru_unlink(shard, entry);
+  __atomic_fetch_sub(&shard->cost, entry->cost, __ATOMIC_RELAXED);
+
+  _cache_free_entry(cache, entry);
+
+  dt_pthread_rwlock_unlock(&entry->lock);
+  dt_pthread_rwlock_destroy(&entry->lock);
+  g_slice_free1(sizeof(*entry), entry);
+  return TRUE;
+}
+
+// evict unlocked entries of one shard, starting at the least recently
+// used one, until the whole cache is below the fill ratio.
+static void _shard_gc(dt_cache_t *cache,
+                      dt_cache_shard_t *shard,
+                      const float fill_ratio)
+{
+  dt_cache_entry_t *entry = shard->lru_head;
+  while(entry)
+  {
+    dt_cache_entry_t *next = entry->lru_next; // we might remove this element
+    if(dt_cache_get_cost(cache) < cache->cost_quota * fill_ratio)
+      break;
+
+    _shard_try_evict(cache, shard, entry);
+    entry = next;
+  }
+}
+
+// evict the least recently used entry nobody holds, returns FALSE if
+// all entries of the shard are in use
+static gboolean _shard_evict_one(dt_cache_t *cache,
+                                 dt_cache_shard_t *shard)
+{
+  dt_cache_entry_t *entry = shard->lru_head;
+  while(entry)
+  {
+    dt_cache_entry_t *next = entry->lru_next;
+    if(_shard_try_evict(cache, shard, entry)) return TRUE;
+    entry = next;
+  }
+  return FALSE;
+}
+
+// visit all shards except the locked one, without blocking on their locks
+static void _cache_gc_others(dt_cache_t *cache,
+                             const dt_cache_shard_t *locked,
+                             const float fill_ratio)
+{
+  for(int k = 0; k < DT_CACHE_SHARDS; k++)
+  {
+    if(dt_cache_get_cost(cache) < cache->cost_quota * fill_ratio)
+      break;
+
+    dt_cache_shard_t *shard = &cache->shard[k];
+    if(shard == locked)
+      continue;
+    if(dt_pthread_mutex_trylock(&shard->lock))
+      continue;
+    _shard_gc(cache, shard, fill_ratio);
+    _shard_unlock(shard);
+  }
+}
+
 // if found, the data void* is returned. if not, it is set to be
 // the given *data and a new hash table entry is created, which can be
 // found using the given key later on.
-dt_cache_entry_t *dt_cache_get_with_caller(dt_cache_t *cache,
-                                           const uint32_t key,
-                                           const char mode,
-                                           const char *file,
-                                           const int line)
+// with only_new, NULL is returned instead of waiting if the key exists
+// already or there is no room for it.
+static dt_cache_entry_t *_cache_get(dt_cache_t *cache,
+                                    const uint32_t key,
+                                    const char mode,
+                                    const gboolean only_new,
+                                    const char *file,
+                                    const int line)
 {
-  gpointer orig_key, value;
   const double start = dt_get_debug_wtime();
+  const uint32_t hash = _cache_hash(key);
+  dt_cache_shard_t *shard = _cache_shard(cache, hash);
 restart:
-  dt_pthread_mutex_lock(&cache->lock);
-  const gboolean res = g_hash_table_lookup_extended(cache->hashtable,
-                                                    GINT_TO_POINTER(key),
-                                                    &orig_key,
-                                                    &value);
-  if(res)
+  _shard_lock(shard);
+  dt_cache_entry_t *entry = _table_lookup(shard, key, hash);
+  if(entry && only_new)
+  {
+    shard->hits++;
+    _shard_unlock(shard);
+    return NULL;
+  }
+  if(entry)
   { // yay, found. read lock and pass on.
-    dt_cache_entry_t *entry = (dt_cache_entry_t *)value;
     const int result = (mode == 'w')
                       ? dt_pthread_rwlock_trywrlock_with_caller(&entry->lock, file, line)
                       : dt_pthread_rwlock_tryrdlock_with_caller(&entry->lock, file, line);
     if(result)
     { // need to give up mutex so other threads have a chance to get in between and
       // free the lock we're trying to acquire:
-      dt_pthread_mutex_unlock(&cache->lock);
+      shard->retries++;
+      _shard_unlock(shard);
       g_usleep(5);
       goto restart;
     }
-    // bubble up in lru list:
-    cache->lru = g_list_remove_link(cache->lru, entry->link);
-    cache->lru = g_list_concat(cache->lru, entry->link);
-    dt_pthread_mutex_unlock(&cache->lock);
+    shard->hits++;
+    _lru_touch(shard, entry);
+    _shard_unlock(shard);
 
 #ifdef _DEBUG
     const pthread_t writer = dt_pthread_rwlock_get_writer(&entry->lock);
@@ -186,27 +460,38 @@ restart:
   }
 
   // else, not found, need to allocate.
+  shard->misses++;
 
-  // first try to clean up.
-  // also wait if we can't free more than the requested fill ratio.
-  if(cache->cost > 0.8f * cache->cost_quota)
+  // first try to clean up, starting with our own shard.
+  if(dt_cache_get_cost(cache) > 0.8f * cache->cost_quota)
   {
-    // need to roll back all the way to get a consistent lock state:
-    dt_cache_gc(cache, 0.8f);
+    _shard_gc(cache, shard, 0.8f);
+    _cache_gc_others(cache, shard, 0.8f);
+  }
+
+  // the table could not grow: make room in the shard or wait for other
+  // threads to release their entries
+  if(!_table_reserve(shard) && !_shard_evict_one(cache, shard))
+  {
+    shard->retries++;
+    _shard_unlock(shard);
+    if(only_new) return NULL;
+    g_usleep(5);
+    goto restart;
   }
 
   // here dies your 32-bit system:
-  dt_cache_entry_t *entry = g_slice_alloc(sizeof(dt_cache_entry_t));
+  entry = g_slice_alloc(sizeof(dt_cache_entry_t));
   dt_pthread_rwlock_init(&entry->lock, 0);
 
   entry->data = 0;
   entry->data_size = cache->entry_size;
   entry->cost = 1;
-  entry->link = g_list_append(0, entry);
+  entry->lru_prev = entry->lru_next = NULL;
   entry->key = key;
   entry->_lock_demoting = FALSE;
 
-  g_hash_table_insert(cache->hashtable, GINT_TO_POINTER(key), entry);
+  _table_insert(shard, entry);
 
   assert(cache->allocate || entry->data_size);
 
@@ -226,12 +511,12 @@ restart:
   else
     dt_pthread_rwlock_rdlock_with_caller(&entry->lock, file, line);
 
-  cache->cost += entry->cost;
+  __atomic_fetch_add(&shard->cost, entry->cost, __ATOMIC_RELAXED);
 
   // put at end of lru list (most recently used):
-  cache->lru = g_list_concat(cache->lru, entry->link);
+  _lru_append(shard, entry);
 
-  dt_pthread_mutex_unlock(&cache->lock);
+  _shard_unlock(shard);
   const double end = dt_get_debug_wtime();
   if(end - start > 0.1)
     dt_print(DT_DEBUG_ALWAYS, "wait time %.06fs", end - start);
@@ -241,28 +526,40 @@ restart:
   return entry;
 }
 
+dt_cache_entry_t *dt_cache_get_with_caller(dt_cache_t *cache,
+                                           const uint32_t key,
+                                           const char mode,
+                                           const char *file,
+                                           const int line)
+{
+  return _cache_get(cache, key, mode, FALSE, file, line);
+}
+
+dt_cache_entry_t *dt_cache_get_new(dt_cache_t *cache,
+                                   const uint32_t key)
+{
+  return _cache_get(cache, key, 'w', TRUE, __FILE__, __LINE__);
+}
+
 gboolean dt_cache_remove(dt_cache_t *cache,
                          const uint32_t key)
 {
-  dt_cache_entry_t *entry;
-  gpointer orig_key, value;
+  const uint32_t hash = _cache_hash(key);
+  dt_cache_shard_t *shard = _cache_shard(cache, hash);
 restart:
-  dt_pthread_mutex_lock(&cache->lock);
-
-  const gboolean res = g_hash_table_lookup_extended(cache->hashtable,
-                                                    GINT_TO_POINTER(key),
-                                                    &orig_key,
-                                                    &value);
-  entry = (dt_cache_entry_t *)value;
-  if(!res)
+  _shard_lock(shard);
+
+  dt_cache_entry_t *entry = _table_lookup(shard, key, hash);
+  if(!entry)
   { // not found in cache, not deleting.
-    dt_pthread_mutex_unlock(&cache->lock);
+    _shard_unlock(shard);
     return TRUE;
   }
   // need write lock to be able to delete:
   if(dt_pthread_rwlock_trywrlock(&entry->lock))
   {
-    dt_pthread_mutex_unlock(&cache->lock);
+    shard->retries++;
+    _shard_unlock(shard);
     g_usleep(5);
     goto restart;
   }
@@ -272,32 +569,22 @@ restart:
     // oops, we are currently demoting (rw -> r) lock to this entry in
     // some thread. do not touch!
     dt_pthread_rwlock_unlock(&entry->lock);
-    dt_pthread_mutex_unlock(&cache->lock);
+    _shard_unlock(shard);
     g_usleep(5);
     goto restart;
   }
 
-  const gboolean removed = g_hash_table_remove(cache->hashtable, GINT_TO_POINTER(key));
-  (void)removed; // make non-assert compile happy
-  assert(removed);
-  cache->lru = g_list_delete_link(cache->lru, entry->link);
+  _table_remove(shard, entry);
+  _lru_unlink(shard, entry);
 
-  if(cache->cleanup)
-  {
-    assert(entry->data_size);
-    ASAN_UNPOISON_MEMORY_REGION(entry->data, entry->data_size);
-
-    cache->cleanup(cache->cleanup_data, entry);
-  }
-  else
-    dt_free_align(entry->data);
+  _cache_free_entry(cache, entry);
 
   dt_pthread_rwlock_unlock(&entry->lock);
   dt_pthread_rwlock_destroy(&entry->lock);
-  cache->cost -= entry->cost;
+  __atomic_fetch_sub(&shard->cost, entry->cost, __ATOMIC_RELAXED);
   g_slice_free1(sizeof(*entry), entry);
 
-  dt_pthread_mutex_unlock(&cache->lock);
+  _shard_unlock(shard);
   return FALSE;
 }
 
@@ -306,47 +593,35 @@ restart:
 void dt_cache_gc(dt_cache_t *cache,
                  const float fill_ratio)
 {
-  GList *l = cache->lru;
-  while(l)
-  {
-    dt_cache_entry_t *entry = l->data;
-    assert(entry->link->data == entry);
-    l = g_list_next(l); // we might remove this element, so walk to
-                        // the next one while we still have the
-                        // pointer..
-    if(cache->cost < cache->cost_quota * fill_ratio)
-      break;
-
-    // if still locked by anyone else give up:
-    if(dt_pthread_rwlock_trywrlock(&entry->lock))
-      continue;
-
-    if(entry->_lock_demoting)
-    {
-      // oops, we are currently demoting (rw -> r) lock to this entry
-      // in some thread. do not touch!
-      dt_pthread_rwlock_unlock(&entry->lock);
-      continue;
-    }
-
-    // delete!
-    g_hash_table_remove(cache->hashtable, GINT_TO_POINTER(entry->key));
-    cache->lru = g_list_delete_link(cache->lru, entry->link);
-    cache->cost -= entry->cost;
+  _cache_gc_others(cache, NULL, fill_ratio);
+}
 
-    if(cache->cleanup)
-    {
-      assert(entry->data_size);
-      ASAN_UNPOISON_MEMORY_REGION(entry->data, entry->data_size);
+void dt_cache_print_stats(const dt_cache_t *cache,
+                          const char *name)
+{
+  uint64_t hits = 0, misses = 0, contention = 0, retries = 0;
+  for(int k = 0; k < DT_CACHE_SHARDS; k++)
+  {
+    const dt_cache_shard_t *shard = &cache->shard[k];
+    hits += shard->hits;
+    misses += shard->misses;
+    contention += shard->contention;
+    retries += shard->retries;
+  }
+  const uint64_t lookups = MAX(hits + misses, 1);
 
-      cache->cleanup(cache->cleanup_data, entry);
-    }
-    else
-      dt_free_align(entry->data);
+  dt_print(DT_DEBUG_ALWAYS,
+           "[%s] %"PRIu64" hits (%.2f%%), %"PRIu64" misses, %"PRIu64" contended, %"PRIu64" retries",
+           name, hits, 100.0 * hits / lookups, misses, contention, retries);
 
-    dt_pthread_rwlock_unlock(&entry->lock);
-    dt_pthread_rwlock_destroy(&entry->lock);
-    g_slice_free1(sizeof(*entry), entry);
+  for(int k = 0; k < DT_CACHE_SHARDS; k++)
+  {
+    const dt_cache_shard_t *shard = &cache->shard[k];
+    dt_print(DT_DEBUG_CACHE,
+             "[%s] shard %2d | %6u entries | %8"PRIu64" hits | %8"PRIu64" misses"
+             " | %8"PRIu64" contended | %8"PRIu64" retries",
+             name, k, shard->count, shard->hits, shard->misses,
+             shard->contention, shard->retries);
   }
 }
 
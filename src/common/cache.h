@@ -28,7 +28,8 @@ typedef struct dt_cache_entry_t
   void *data;
   size_t data_size;
   size_t cost;
-  GList *link;
+  struct dt_cache_entry_t *lru_prev; // intrusive lru list of the shard
+  struct dt_cache_entry_t *lru_next;
   dt_pthread_rwlock_t lock;
   gboolean _lock_demoting;
   uint32_t key;
@@ -37,17 +38,38 @@ typedef struct dt_cache_entry_t
 typedef void((*dt_cache_allocate_t)(void *userdata, dt_cache_entry_t *entry));
 typedef void((*dt_cache_cleanup_t)(void *userdata, dt_cache_entry_t *entry));
 
+// the cache is split into shards by key hash so that threads looking
+// up different keys don't serialize on a single mutex.
+#define DT_CACHE_SHARD_BITS 4
+#define DT_CACHE_SHARDS (1 << DT_CACHE_SHARD_BITS)
+
+typedef struct dt_cache_shard_t
+{
+  dt_pthread_mutex_t lock; // protects everything in this shard
+
+  dt_cache_entry_t **table; // open addressing with linear probing
+  uint32_t table_size;      // power of two
+  uint32_t count;
+
+  dt_cache_entry_t *lru_head; // least recently used, about to be kicked from cache.
+  dt_cache_entry_t *lru_tail; // most recently used
+
+  size_t cost;
+
+  // statistics, dumped by dt_cache_print_stats()
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t contention; // shard mutex was already taken
+  uint64_t retries;    // entry was locked in an incompatible mode
+} dt_cache_shard_t;
+
 typedef struct dt_cache_t
 {
-  dt_pthread_mutex_t lock; // big fat lock. we're only expecting a couple hand full of cpu threads to use this concurrently.
+  dt_cache_shard_t shard[DT_CACHE_SHARDS];
 
   size_t entry_size; // cache line allocation
-  size_t cost;       // user supplied cost per cache line (bytes?)
   size_t cost_quota; // quota to try and meet. but don't use as hard limit.
 
-  GHashTable *hashtable; // stores (key, entry) pairs
-  GList *lru;            // last element is most recently used, first is about to be kicked from cache.
-
   // callback functions for cache misses/garbage collection
   dt_cache_allocate_t allocate;
   dt_cache_allocate_t cleanup;
@@ -86,6 +108,9 @@ dt_cache_entry_t *dt_cache_get_with_caller(dt_cache_t *cache,
                                            const int line);
 // same but returns 0 if not allocated yet (both will block and wait for entry rw locks to be released)
 dt_cache_entry_t *dt_cache_testget(dt_cache_t *cache, const uint32_t key, char mode);
+// write locked new slot for this key, 0 if the key is already in the cache.
+// never waits for the lock of another entry.
+dt_cache_entry_t *dt_cache_get_new(dt_cache_t *cache, const uint32_t key);
 // release a lock on a cache entry. the cache knows which one you mean (r or w).
 #define dt_cache_release(A, B) dt_cache_release_with_caller(A, B, __FILE__, __LINE__)
 void dt_cache_release_with_caller(dt_cache_t *cache,
@@ -97,12 +122,18 @@ void dt_cache_release_with_caller(dt_cache_t *cache,
 gboolean dt_cache_contains(dt_cache_t *cache, const uint32_t key);
 // returns FALSE on success, TRUE if the key was not found.
 gboolean dt_cache_remove(dt_cache_t *cache, const uint32_t key);
-// removes from the tip of the lru list, until the fill ratio of the hashtable
+// removes from the tip of the lru lists, until the fill ratio of the cache
 // goes below the given parameter, in terms of the user defined cost measure.
-// will never lock and never fail, but sometimes not free memory (in case all
+// will never block and never fail, but sometimes not free memory (in case all
 // is locked)
 void dt_cache_gc(dt_cache_t *cache,
                  const float fill_ratio);
+// current fill of the cache in terms of the user defined cost
+// measure. shards are read without locking, so this is only approximate.
+size_t dt_cache_get_cost(const dt_cache_t *cache);
+// print per-shard hit/miss/contention counters
+void dt_cache_print_stats(const dt_cache_t *cache,
+                          const char *name);
 
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
@@ -78,6 +78,29 @@ static int dt_collection_image_offset_with_collection(const dt_collection_t *col
 /* update aspect ratio for the selected images */
 static void _collection_update_aspect_ratio(const dt_collection_t *collection);
 
+/* C side copy of memory.collected_images. The table is rebuilt with
+ * contiguous rowids starting at 1, so the image of a row is found at
+ * index rowid - 1 and the rowid of an image through a reverse array
+ * indexed by image id. */
+static struct
+{
+  GRWLock lock;
+  dt_imgid_t *imgid;   // per row, in collection order
+  int count;
+  int *rowid;          // per image id, 0 if not collected
+  dt_imgid_t max_imgid;
+} _index;
+
+static void _index_clear(void)
+{
+  g_free(_index.imgid);
+  g_free(_index.rowid);
+  _index.imgid = NULL;
+  _index.rowid = NULL;
+  _index.count = 0;
+  _index.max_imgid = NO_IMGID;
+}
+
 const dt_collection_t *dt_collection_new(const dt_collection_t *clone)
 {
   dt_collection_t *collection = g_malloc0(sizeof(dt_collection_t));
@@ -114,6 +137,13 @@ void dt_collection_free(const dt_collection_t *collection)
 {
   DT_CONTROL_SIGNAL_DISCONNECT_ALL(collection, "collection");
 
+  if(!collection->clone)
+  {
+    g_rw_lock_writer_lock(&_index.lock);
+    _index_clear();
+    g_rw_lock_writer_unlock(&_index.lock);
+  }
+
   g_free(collection->query);
   g_free(collection->query_no_group);
   g_strfreev(collection->where_ext);
@@ -147,6 +177,87 @@ static char * and_operator(int *term)
   assert(0); // Not reached.
 }
 
+static void _index_rebuild(void)
+{
+  dt_times_t start;
+  dt_get_perf_times(&start);
+
+  int count = 0;
+  dt_imgid_t max_imgid = NO_IMGID;
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT COUNT(*), MAX(imgid) FROM memory.collected_images",
+                              -1, &stmt, NULL);
+  if(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    count = sqlite3_column_int(stmt, 0);
+    max_imgid = sqlite3_column_int(stmt, 1);
+  }
+  sqlite3_finalize(stmt);
+
+  dt_imgid_t *imgid = g_new(dt_imgid_t, MAX(count, 1));
+  int *rowid = g_new0(int, MAX(max_imgid, 0) + 1);
+
+  int n = 0;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT rowid, imgid FROM memory.collected_images ORDER BY rowid",
+                              -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW && n < count)
+  {
+    const int row = sqlite3_column_int(stmt, 0);
+    const dt_imgid_t id = sqlite3_column_int(stmt, 1);
+    // rowids are contiguous as the table sequence is reset on update,
+    // anything else would break the position computations of the views
+    if(row != n + 1 || id <= NO_IMGID || id > max_imgid)
+    {
+      dt_print(DT_DEBUG_ALWAYS, "[collection index] unexpected row %d for image %d", row, id);
+      break;
+    }
+    imgid[n] = id;
+    rowid[id] = row;
+    n++;
+  }
+  sqlite3_finalize(stmt);
+
+  g_rw_lock_writer_lock(&_index.lock);
+  _index_clear();
+  _index.imgid = imgid;
+  _index.rowid = rowid;
+  _index.count = n;
+  _index.max_imgid = MAX(max_imgid, NO_IMGID);
+  g_rw_lock_writer_unlock(&_index.lock);
+
+  dt_show_times_f(&start, "[collection index]", "%d images", n);
+}
+
+int dt_collection_index_get_count(void)
+{
+  g_rw_lock_reader_lock(&_index.lock);
+  const int count = _index.count;
+  g_rw_lock_reader_unlock(&_index.lock);
+  return count;
+}
+
+dt_imgid_t dt_collection_index_get_imgid(const int rowid)
+{
+  dt_imgid_t id = NO_IMGID;
+  g_rw_lock_reader_lock(&_index.lock);
+  if(rowid >= 1 && rowid <= _index.count)
+    id = _index.imgid[rowid - 1];
+  g_rw_lock_reader_unlock(&_index.lock);
+  return id;
+}
+
+int dt_collection_index_get_rowid(const dt_imgid_t imgid)
+{
+  int row = 0;
+  g_rw_lock_reader_lock(&_index.lock);
+  if(imgid > NO_IMGID && imgid <= _index.max_imgid)
+    row = _index.rowid[imgid];
+  g_rw_lock_reader_unlock(&_index.lock);
+  return row;
+}
+
 void dt_collection_memory_update()
 {
   if(!darktable.collection || !darktable.db) return;
@@ -184,6 +295,9 @@ void dt_collection_memory_update()
 
   g_free(query);
   g_free(ins_query);
+
+  // 3. mirror the table for fast lookups by the views
+  _index_rebuild();
 }
 
 static void _dt_collection_set_selq_pre_sort(const dt_collection_t *collection,
@@ -921,15 +1035,7 @@ uint32_t dt_collection_get_selected_count(void)
 
 uint32_t dt_collection_get_collected_count(void)
 {
-  sqlite3_stmt *stmt = NULL;
-  uint32_t count = 0;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT COUNT(*) FROM memory.collected_images",
-                              -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-    count = sqlite3_column_int(stmt, 0);
-  sqlite3_finalize(stmt);
-  return count;
+  return dt_collection_index_get_count();
 }
 
 GList *dt_collection_get(const dt_collection_t *collection,
@@ -2952,31 +3058,9 @@ static int dt_collection_image_offset_with_collection(const dt_collection_t *col
   if(!dt_is_valid_imgid(imgid))
     return 0;
 
-  int offset = 0;
-  sqlite3_stmt *stmt;
-
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT imgid FROM memory.collected_images",
-                              -1, &stmt, NULL);
-
-  gboolean found = FALSE;
-
-  while(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    const int id = sqlite3_column_int(stmt, 0);
-    if(imgid == id)
-    {
-      found = TRUE;
-      break;
-    }
-    offset++;
-  }
-
-  if(!found) offset = 0;
-
-  sqlite3_finalize(stmt);
-
-  return offset;
+  // the offset is the position in memory.collected_images
+  const int rowid = dt_collection_index_get_rowid(imgid);
+  return rowid > 0 ? rowid - 1 : 0;
 }
 
 int dt_collection_image_offset(const dt_imgid_t imgid)
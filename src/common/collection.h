@@ -286,6 +286,15 @@ void dt_collection_move_before(const dt_imgid_t image_id, GList * selected_image
 /* initialize memory table */
 void dt_collection_memory_update();
 
+/* in-memory index of memory.collected_images, rebuilt by
+ * dt_collection_memory_update(). rowids start at 1, lookups are O(1) */
+/** number of images in the collection */
+int dt_collection_index_get_count(void);
+/** image at the given rowid or NO_IMGID if out of range */
+dt_imgid_t dt_collection_index_get_imgid(const int rowid);
+/** rowid of the image or 0 if it is not part of the collection */
+int dt_collection_index_get_rowid(const dt_imgid_t imgid);
+
 /** save the current collection for recentcollect module and collect history */
 void dt_collection_history_save();
 
@@ -33,6 +33,7 @@
 #include "common/pwstorage/pwstorage.h"
 #include "common/selection.h"
 #include "common/system_signal_handling.h"
+#include "common/trace.h"
 #ifdef HAVE_GPHOTO2
 #include "common/camera_control.h"
 #endif
@@ -43,6 +44,7 @@
 #include "common/grealpath.h"
 #include "common/image.h"
 #include "common/image_cache.h"
+#include "common/interpolation.h"
 #include "common/iop_order.h"
 #include "common/l10n.h"
 #include "common/mipmap_cache.h"
@@ -268,6 +270,11 @@ static int usage(const char *argv0)
          "\n"
          "--dumpdir DIR\n"
          "\n"
+         "--trace FILE\n"
+         "    Write the timing, device, tiling, cache and memory use of every\n"
+         "    pixelpipe run and module to FILE in chrome trace event format,\n"
+         "    to be opened in chrome://tracing or https://ui.perfetto.dev\n"
+         "\n"
          "-d CHANNEL\n"
          "    Enable debug output to the terminal (or to the log file if on Windows).\n"
          "    Valid channels are:\n\n"
@@ -1029,6 +1036,7 @@ int dt_init(int argc,
   char *tmpdir_from_command = NULL;
   char *configdir_from_command = NULL;
   char *cachedir_from_command = NULL;
+  char *trace_from_command = NULL;
 
   darktable.dump_pfm_module = NULL;
   darktable.dump_pfm_pipe = NULL;
@@ -1092,6 +1100,12 @@ int dt_init(int argc,
         argv[k-1] = NULL;
         argv[k] = NULL;
       }
+      else if(!strcmp(argv[k], "--trace") && argc > k + 1)
+      {
+        trace_from_command = argv[++k];
+        argv[k-1] = NULL;
+        argv[k] = NULL;
+      }
       else if(!strcmp(argv[k], "--dump-pipe") && argc > k + 1)
       {
         darktable.dump_pfm_pipe = argv[++k];
@@ -1502,6 +1516,9 @@ int dt_init(int argc,
              darktable.tmp_directory ? darktable.tmp_directory : "NOT AVAILABLE");
   }
 
+  if(trace_from_command)
+    dt_trace_open(trace_from_command);
+
   // Set directories as requested or default.
   // Set a result flag so if we can't create certain directories, we can
   // later, after initializing the GUI, show the user a message and exit.
@@ -2294,6 +2311,7 @@ void dt_cleanup()
 
   dt_image_cache_cleanup();
   dt_mipmap_cache_cleanup();
+  dt_interpolation_cleanup();
 
   dt_colorspaces_cleanup(darktable.color_profiles);
 #ifdef HAVE_AI
@@ -2376,6 +2394,8 @@ void dt_cleanup()
 
   dt_capabilities_cleanup();
 
+  dt_trace_close();
+
   if(darktable.tmp_directory)
     g_free(darktable.tmp_directory);
 
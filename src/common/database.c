@@ -59,6 +59,48 @@
 /* transaction id */
 static dt_atomic_int _trxid;
 
+// cache of prepared statements, see dt_database_prepare_cached()
+#define MAX_CACHED_STATEMENTS 256
+
+typedef struct dt_database_cached_stmt_t
+{
+  sqlite3_stmt *stmt;
+  gboolean in_use; // handed out to a caller
+} dt_database_cached_stmt_t;
+
+static struct
+{
+  GHashTable *stmts; // sql text -> dt_database_cached_stmt_t
+  uint64_t hits, misses, busy;
+} _stmt_cache;
+
+static GMutex _stmt_cache_lock;
+
+// execution counters per statement text, only collected with -d sql
+typedef struct dt_database_stmt_stats_t
+{
+  uint64_t runs;
+  uint64_t rows;
+  sqlite3_int64 total_ns, max_ns;
+} dt_database_stmt_stats_t;
+
+static GHashTable *_stmt_stats = NULL; // sql text -> dt_database_stmt_stats_t
+static GMutex _stmt_stats_lock;
+
+// latency of the statements modifying the databases, only collected with -d sql
+static struct
+{
+  uint64_t count;
+  sqlite3_int64 total_ns, max_ns;
+  uint64_t below_1ms, below_10ms, below_100ms, above_100ms;
+} _write_stats;
+
+// with write-ahead logging the checkpoint thread is woken up once the wal
+// of a database holds that many pages, or at least every checkpoint_interval
+#define WAL_CHECKPOINT_PAGES 1000
+// the wal file is truncated to that size after a checkpoint
+#define WAL_SIZE_LIMIT (64 * 1024 * 1024)
+
 typedef struct dt_database_t
 {
   gboolean lock_acquired;
@@ -74,6 +116,18 @@ typedef struct dt_database_t
 
   gchar *error_message, *error_dbfilename;
   int error_other_pid;
+
+  /* write-ahead logging, checkpoints are done by a dedicated thread */
+  gboolean wal;
+  sqlite3 *checkpoint_handle;
+  GThread *checkpoint_thread;
+  GMutex checkpoint_lock;
+  GCond checkpoint_cond;
+  gboolean checkpoint_stop, checkpoint_pending;
+
+  /* idle read-only connections, see dt_database_get_readonly() */
+  GQueue readonly;
+  GMutex readonly_lock;
 } dt_database_t;
 
 
@@ -4207,6 +4261,21 @@ void dt_database_backup(const char *filename)
     if(!copy_status)
       dt_print(DT_DEBUG_ALWAYS, "[backup failed] %s -> %s", filename, backup);
 
+    // a wal left by a crash holds committed changes not yet in the database
+    gchar *wal = g_strdup_printf("%s-wal", filename);
+    if(copy_status && g_file_test(wal, G_FILE_TEST_EXISTS))
+    {
+      gchar *backup_wal = g_strdup_printf("%s-wal", backup);
+      GFile *wal_src = g_file_new_for_path(wal);
+      GFile *wal_dest = g_file_new_for_path(backup_wal);
+      if(!g_file_copy(wal_src, wal_dest, G_FILE_COPY_NONE, NULL, NULL, NULL, NULL))
+        dt_print(DT_DEBUG_ALWAYS, "[backup failed] %s -> %s", wal, backup_wal);
+      g_object_unref(wal_src);
+      g_object_unref(wal_dest);
+      g_free(backup_wal);
+    }
+    g_free(wal);
+
     g_object_unref(src);
     g_object_unref(dest);
   }
@@ -4215,6 +4284,18 @@ void dt_database_backup(const char *filename)
   g_free(backup);
 }
 
+// remove the write-ahead log files of a deleted database, they must not be
+// applied to a new database created with the same name
+static void _unlink_wal(const char *filename)
+{
+  gchar *wal = g_strdup_printf("%s-wal", filename);
+  gchar *shm = g_strdup_printf("%s-shm", filename);
+  g_unlink(wal);
+  g_unlink(shm);
+  g_free(wal);
+  g_free(shm);
+}
+
 int _get_pragma_int_val(sqlite3 *db,
                         const char* pragma)
 {
@@ -4257,6 +4338,272 @@ gchar* _get_pragma_string_val(sqlite3 *db,
   return val;
 }
 
+static int _stmt_trace(const unsigned type,
+                       void *ctx,
+                       void *p,
+                       void *x)
+{
+  const char *sql = sqlite3_sql((sqlite3_stmt *)p);
+  if(!sql) return 0;
+
+  g_mutex_lock(&_stmt_stats_lock);
+  if(!_stmt_stats)
+    _stmt_stats = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  dt_database_stmt_stats_t *st = g_hash_table_lookup(_stmt_stats, sql);
+  if(!st)
+  {
+    st = g_new0(dt_database_stmt_stats_t, 1);
+    g_hash_table_insert(_stmt_stats, g_strdup(sql), st);
+  }
+  if(type == SQLITE_TRACE_ROW)
+    st->rows++;
+  else if(type == SQLITE_TRACE_PROFILE)
+  {
+    const sqlite3_int64 ns = *(sqlite3_int64 *)x;
+    st->runs++;
+    st->total_ns += ns;
+    st->max_ns = MAX(st->max_ns, ns);
+
+    // transaction control statements are read-only for sqlite but COMMIT is
+    // where the journal gets written and synced
+    if(!sqlite3_stmt_readonly((sqlite3_stmt *)p) || g_str_has_prefix(sql, "COMMIT"))
+    {
+      _write_stats.count++;
+      _write_stats.total_ns += ns;
+      _write_stats.max_ns = MAX(_write_stats.max_ns, ns);
+      if(ns < 1000000)
+        _write_stats.below_1ms++;
+      else if(ns < 10000000)
+        _write_stats.below_10ms++;
+      else if(ns < 100000000)
+        _write_stats.below_100ms++;
+      else
+        _write_stats.above_100ms++;
+    }
+  }
+  g_mutex_unlock(&_stmt_stats_lock);
+  return 0;
+}
+
+static gint _stmt_stats_cmp(gconstpointer a,
+                            gconstpointer b,
+                            gpointer user_data)
+{
+  const dt_database_stmt_stats_t *sa = g_hash_table_lookup(_stmt_stats, a);
+  const dt_database_stmt_stats_t *sb = g_hash_table_lookup(_stmt_stats, b);
+  return (sa->total_ns < sb->total_ns) - (sa->total_ns > sb->total_ns);
+}
+
+// print the statements which took the most time overall
+static void _stmt_stats_dump(void)
+{
+  g_mutex_lock(&_stmt_stats_lock);
+  if(_stmt_stats)
+  {
+    dt_print(DT_DEBUG_SQL,
+             "[sql stats] statement cache: %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64 " busy",
+             _stmt_cache.hits, _stmt_cache.misses, _stmt_cache.busy);
+    dt_print(DT_DEBUG_SQL,
+             "[sql stats] writes: %" PRIu64 " statements, %.3f ms total, %.3f ms max,"
+             " %" PRIu64 " <1ms, %" PRIu64 " <10ms, %" PRIu64 " <100ms, %" PRIu64 " >=100ms",
+             _write_stats.count, _write_stats.total_ns * 1e-6, _write_stats.max_ns * 1e-6,
+             _write_stats.below_1ms, _write_stats.below_10ms, _write_stats.below_100ms,
+             _write_stats.above_100ms);
+    dt_print(DT_DEBUG_SQL, "[sql stats]   total ms     max ms       runs       rows  statement");
+
+    GList *keys = g_list_sort_with_data(g_hash_table_get_keys(_stmt_stats), _stmt_stats_cmp, NULL);
+    int n = 0;
+    for(GList *k = keys; k && n < 50; k = g_list_next(k), n++)
+    {
+      const dt_database_stmt_stats_t *st = g_hash_table_lookup(_stmt_stats, k->data);
+      dt_print(DT_DEBUG_SQL, "[sql stats] %10.3f %10.3f %10" PRIu64 " %10" PRIu64 "  %s",
+               st->total_ns * 1e-6, st->max_ns * 1e-6, st->runs, st->rows, (const char *)k->data);
+    }
+    g_list_free(keys);
+    g_hash_table_destroy(_stmt_stats);
+    _stmt_stats = NULL;
+    memset(&_write_stats, 0, sizeof(_write_stats));
+  }
+  g_mutex_unlock(&_stmt_stats_lock);
+}
+
+static void _stmt_cache_flush(void)
+{
+  g_mutex_lock(&_stmt_cache_lock);
+  if(_stmt_cache.stmts)
+  {
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, _stmt_cache.stmts);
+    while(g_hash_table_iter_next(&iter, NULL, &value))
+    {
+      dt_database_cached_stmt_t *c = value;
+      if(c->in_use)
+        dt_print(DT_DEBUG_SQL, "[sql] cached statement not released: '%s'", sqlite3_sql(c->stmt));
+      sqlite3_finalize(c->stmt);
+    }
+    g_hash_table_destroy(_stmt_cache.stmts);
+    _stmt_cache.stmts = NULL;
+  }
+  g_mutex_unlock(&_stmt_cache_lock);
+}
+
+// open another connection to the library and data databases, for the
+// checkpoint thread and the read-only connections
+static sqlite3 *_open_connection(const dt_database_t *db,
+                                 const int flags)
+{
+  sqlite3 *handle = NULL;
+  if(sqlite3_open_v2(db->dbfilename_library, &handle, flags, NULL) != SQLITE_OK)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[sql] can't open a connection to `%s': %s",
+             db->dbfilename_library, sqlite3_errmsg(handle));
+    sqlite3_close(handle);
+    return NULL;
+  }
+
+  // the attached database is opened with the flags of the connection
+  sqlite3_stmt *stmt;
+  int rc = sqlite3_prepare_v2(handle, "ATTACH DATABASE ?1 AS data", -1, &stmt, NULL);
+  if(rc == SQLITE_OK)
+  {
+    sqlite3_bind_text(stmt, 1, db->dbfilename_data, -1, SQLITE_TRANSIENT);
+    rc = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+  }
+  sqlite3_finalize(stmt);
+  if(rc != SQLITE_OK)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[sql] can't attach `%s' to a new connection: %s",
+             db->dbfilename_data, sqlite3_errmsg(handle));
+    sqlite3_close(handle);
+    return NULL;
+  }
+
+  // a reader only waits for a wal recovery or a truncated wal to be reset
+  sqlite3_busy_timeout(handle, 1000);
+
+  if(darktable.unmuted & DT_DEBUG_SQL)
+    sqlite3_trace_v2(handle, SQLITE_TRACE_PROFILE | SQLITE_TRACE_ROW, _stmt_trace, NULL);
+
+  return handle;
+}
+
+// called by sqlite after each commit in wal mode, replaces the automatic checkpoints
+static int _wal_hook(void *data,
+                     sqlite3 *handle,
+                     const char *schema,
+                     const int pages)
+{
+  dt_database_t *db = (dt_database_t *)data;
+  if(pages >= WAL_CHECKPOINT_PAGES)
+  {
+    g_mutex_lock(&db->checkpoint_lock);
+    db->checkpoint_pending = TRUE;
+    g_cond_signal(&db->checkpoint_cond);
+    g_mutex_unlock(&db->checkpoint_lock);
+  }
+  return SQLITE_OK;
+}
+
+static void _wal_checkpoint(sqlite3 *handle,
+                            const char *schema)
+{
+  const double start = dt_get_wtime();
+  int frames = 0, done = 0;
+  // a passive checkpoint never waits for the readers nor blocks the writer
+  const int rc = sqlite3_wal_checkpoint_v2(handle, schema, SQLITE_CHECKPOINT_PASSIVE,
+                                           &frames, &done);
+  if(rc != SQLITE_OK)
+    dt_print(DT_DEBUG_SQL, "[sql] checkpoint of %s failed: %s", schema, sqlite3_errmsg(handle));
+  else if(frames > 0)
+    dt_print(DT_DEBUG_SQL, "[sql] checkpoint of %s: %d/%d frames in %.3f ms",
+             schema, done, frames, (dt_get_wtime() - start) * 1000.0);
+}
+
+static gpointer _checkpoint_thread(gpointer data)
+{
+  dt_database_t *db = (dt_database_t *)data;
+  const gint64 interval = MAX(1, dt_conf_get_int("database/checkpoint_interval")) * G_TIME_SPAN_SECOND;
+
+  g_mutex_lock(&db->checkpoint_lock);
+  while(!db->checkpoint_stop)
+  {
+    if(!db->checkpoint_pending)
+      g_cond_wait_until(&db->checkpoint_cond, &db->checkpoint_lock,
+                        g_get_monotonic_time() + interval);
+    if(db->checkpoint_stop) break;
+    db->checkpoint_pending = FALSE;
+    g_mutex_unlock(&db->checkpoint_lock);
+
+    _wal_checkpoint(db->checkpoint_handle, "main");
+    _wal_checkpoint(db->checkpoint_handle, "data");
+
+    g_mutex_lock(&db->checkpoint_lock);
+  }
+  g_mutex_unlock(&db->checkpoint_lock);
+
+  return NULL;
+}
+
+// switch both databases to write-ahead logging, returns FALSE if not possible
+// (in-memory or read-only databases, filesystems without shared memory)
+static gboolean _wal_init(dt_database_t *db)
+{
+  gchar *main_mode = _get_pragma_string_val(db->handle, "main.journal_mode = WAL");
+  gchar *data_mode = _get_pragma_string_val(db->handle, "data.journal_mode = WAL");
+  db->wal = !g_strcmp0(main_mode, "wal") && !g_strcmp0(data_mode, "wal");
+  if(!db->wal)
+    dt_print(DT_DEBUG_ALWAYS,
+             "[init sql] write-ahead logging not available (library: %s, data: %s)",
+             main_mode, data_mode);
+  g_free(main_mode);
+  g_free(data_mode);
+  if(!db->wal) return FALSE;
+
+  // commits only append to the wal, the databases are synced by the checkpoints
+  sqlite3_exec(db->handle, "PRAGMA main.synchronous = NORMAL", NULL, NULL, NULL);
+  sqlite3_exec(db->handle, "PRAGMA data.synchronous = NORMAL", NULL, NULL, NULL);
+  gchar *limit = g_strdup_printf("PRAGMA main.journal_size_limit = %d;"
+                                 "PRAGMA data.journal_size_limit = %d",
+                                 WAL_SIZE_LIMIT, WAL_SIZE_LIMIT);
+  sqlite3_exec(db->handle, limit, NULL, NULL, NULL);
+  g_free(limit);
+
+  // checkpoints are moved out of the committing thread. if the thread can't
+  // have its connection sqlite keeps doing them on commit.
+  db->checkpoint_handle = _open_connection(db, SQLITE_OPEN_READWRITE);
+  if(db->checkpoint_handle)
+  {
+    sqlite3_wal_hook(db->handle, _wal_hook, db);
+    db->checkpoint_thread = g_thread_new("db checkpoint", _checkpoint_thread, db);
+  }
+
+  dt_print(DT_DEBUG_SQL, "[init sql] write-ahead logging enabled%s",
+           db->checkpoint_thread ? ", checkpoints in background" : "");
+  return TRUE;
+}
+
+static void _wal_cleanup(dt_database_t *db)
+{
+  if(db->checkpoint_thread)
+  {
+    g_mutex_lock(&db->checkpoint_lock);
+    db->checkpoint_stop = TRUE;
+    g_cond_signal(&db->checkpoint_cond);
+    g_mutex_unlock(&db->checkpoint_lock);
+    g_thread_join(db->checkpoint_thread);
+    db->checkpoint_thread = NULL;
+  }
+  sqlite3_close(db->checkpoint_handle);
+  db->checkpoint_handle = NULL;
+
+  g_mutex_lock(&db->readonly_lock);
+  sqlite3 *handle;
+  while((handle = g_queue_pop_head(&db->readonly)))
+    sqlite3_close(handle);
+  g_mutex_unlock(&db->readonly_lock);
+}
+
 dt_database_t *dt_database_init(const char *alternative,
                                 const gboolean load_data,
                                 const gboolean has_gui)
@@ -4351,6 +4698,11 @@ start:
   db->dbfilename_data = g_strdup(dbfilename_data);
   db->dbfilename_library = g_strdup(dbfilename_library);
 
+  g_mutex_init(&db->checkpoint_lock);
+  g_cond_init(&db->checkpoint_cond);
+  g_mutex_init(&db->readonly_lock);
+  g_queue_init(&db->readonly);
+
   dt_atomic_set_int(&_trxid, 0);
 
   /* make sure the folder exists. this might not be the case for new databases */
@@ -4410,6 +4762,10 @@ start:
   */
   sqlite3_exec(db->handle, "attach database ':memory:' as memory", NULL, NULL, NULL);
 
+  // with -d sql time every statement to find the hot queries
+  if(darktable.unmuted & DT_DEBUG_SQL)
+    sqlite3_trace_v2(db->handle, SQLITE_TRACE_PROFILE | SQLITE_TRACE_ROW, _stmt_trace, NULL);
+
   // attach the data database which contains presets, styles, tags and similar things not tied to single images
   sqlite3_stmt *stmt;
   gboolean have_data_db = load_data && g_file_test(dbfilename_data, G_FILE_TEST_EXISTS);
@@ -4427,9 +4783,13 @@ start:
   sqlite3_finalize(stmt);
 
   // some sqlite3 config
-  sqlite3_exec(db->handle, "PRAGMA synchronous = OFF", NULL, NULL, NULL);
-  sqlite3_exec(db->handle, "PRAGMA journal_mode = MEMORY", NULL, NULL, NULL);
   sqlite3_exec(db->handle, "PRAGMA page_size = 32768", NULL, NULL, NULL);
+  if(!dt_conf_get_bool("database/write_ahead_log") || !_wal_init(db))
+  {
+    // this also switches back databases left in wal mode
+    sqlite3_exec(db->handle, "PRAGMA synchronous = OFF", NULL, NULL, NULL);
+    sqlite3_exec(db->handle, "PRAGMA journal_mode = MEMORY", NULL, NULL, NULL);
+  }
 
   // WARNING: the foreign_keys pragma must not be used, the integrity of the
   // database rely on it.
@@ -4583,6 +4943,7 @@ start:
       dt_print(DT_DEBUG_ALWAYS, "[init] deleting `%s' on user request: %s",
                dbfilename_data,
                g_unlink(dbfilename_data) == 0 ? "ok" : "failed" );
+      _unlink_wal(dbfilename_data);
 
       if(resp == GTK_RESPONSE_ACCEPT && data_snap)
       {
@@ -4755,6 +5116,7 @@ start:
 
     dt_print(DT_DEBUG_ALWAYS, "[init] deleting `%s' on user request ...%s",
       dbfilename_library, g_unlink(dbfilename_library) == 0 ? "OK" : "failed");
+    _unlink_wal(dbfilename_library);
 
     if(resp == GTK_RESPONSE_ACCEPT && data_snap)
     {
@@ -4896,6 +5258,9 @@ void dt_upgrade_maker_model(const dt_database_t *db)
 
 void dt_database_destroy(const dt_database_t *db)
 {
+  _wal_cleanup((dt_database_t *)db);
+  _stmt_cache_flush();
+  _stmt_stats_dump();
   sqlite3_close(db->handle);
   if(db->lockfile_data)
   {
@@ -4909,6 +5274,9 @@ void dt_database_destroy(const dt_database_t *db)
   }
   g_free(db->dbfilename_data);
   g_free(db->dbfilename_library);
+  g_mutex_clear((GMutex *)&db->checkpoint_lock);
+  g_cond_clear((GCond *)&db->checkpoint_cond);
+  g_mutex_clear((GMutex *)&db->readonly_lock);
   g_free((dt_database_t *)db);
 
   sqlite3_shutdown();
@@ -4919,6 +5287,36 @@ sqlite3 *dt_database_get(const dt_database_t *db)
   return db ? db->handle : NULL;
 }
 
+sqlite3 *dt_database_get_readonly(const dt_database_t *db)
+{
+  // without wal a reader would block the writer, share the main connection
+  if(!db || !db->wal) return dt_database_get(db);
+
+  dt_database_t *d = (dt_database_t *)db;
+  g_mutex_lock(&d->readonly_lock);
+  sqlite3 *handle = g_queue_pop_head(&d->readonly);
+  g_mutex_unlock(&d->readonly_lock);
+
+  if(!handle)
+  {
+    handle = _open_connection(db, SQLITE_OPEN_READONLY);
+    if(!handle) return dt_database_get(db);
+    sqlite3_exec(handle, "PRAGMA query_only = ON", NULL, NULL, NULL);
+  }
+  return handle;
+}
+
+void dt_database_release_readonly(const dt_database_t *db,
+                                  sqlite3 *handle)
+{
+  if(!handle || handle == dt_database_get(db)) return;
+
+  dt_database_t *d = (dt_database_t *)db;
+  g_mutex_lock(&d->readonly_lock);
+  g_queue_push_head(&d->readonly, handle);
+  g_mutex_unlock(&d->readonly_lock);
+}
+
 const gchar *dt_database_get_path(const dt_database_t *db)
 {
   return db->dbfilename_library;
@@ -4981,6 +5379,9 @@ gboolean dt_database_get_lock_acquired(const dt_database_t *db)
 
 void dt_database_cleanup_busy_statements(const dt_database_t *db)
 {
+  // cached statements are not leaks, release them before looking for those
+  _stmt_cache_flush();
+
   sqlite3_stmt *stmt = NULL;
   while( (stmt = sqlite3_next_stmt(db->handle, NULL)) != NULL)
   {
@@ -5928,6 +6329,71 @@ void dt_database_rollback_transaction(const dt_database_t *db)
 #endif
 }
 
+sqlite3_stmt *dt_database_prepare_cached(const dt_database_t *db,
+                                         const char *sql)
+{
+  g_mutex_lock(&_stmt_cache_lock);
+  if(!_stmt_cache.stmts)
+    _stmt_cache.stmts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+  dt_database_cached_stmt_t *c = g_hash_table_lookup(_stmt_cache.stmts, sql);
+  if(c && !c->in_use)
+  {
+    c->in_use = TRUE;
+    _stmt_cache.hits++;
+    g_mutex_unlock(&_stmt_cache_lock);
+    return c->stmt;
+  }
+
+  // used by another thread right now: give a private statement
+  const gboolean cacheable = !c && g_hash_table_size(_stmt_cache.stmts) < MAX_CACHED_STATEMENTS;
+  if(c)
+    _stmt_cache.busy++;
+  else
+    _stmt_cache.misses++;
+  g_mutex_unlock(&_stmt_cache_lock);
+
+  sqlite3_stmt *stmt = NULL;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(db), sql, -1, &stmt, NULL);
+
+  if(stmt && cacheable)
+  {
+    g_mutex_lock(&_stmt_cache_lock);
+    // another thread may have prepared the same statement meanwhile
+    if(_stmt_cache.stmts && !g_hash_table_contains(_stmt_cache.stmts, sql))
+    {
+      c = g_new(dt_database_cached_stmt_t, 1);
+      c->stmt = stmt;
+      c->in_use = TRUE;
+      g_hash_table_insert(_stmt_cache.stmts, g_strdup(sql), c);
+    }
+    g_mutex_unlock(&_stmt_cache_lock);
+  }
+  return stmt;
+}
+
+void dt_database_release_cached(const dt_database_t *db,
+                                sqlite3_stmt *stmt)
+{
+  if(!stmt) return;
+
+  g_mutex_lock(&_stmt_cache_lock);
+  dt_database_cached_stmt_t *c =
+    _stmt_cache.stmts ? g_hash_table_lookup(_stmt_cache.stmts, sqlite3_sql(stmt)) : NULL;
+  const gboolean cached = c && c->stmt == stmt;
+  if(cached)
+  {
+    // ready for the next user, without values kept from this one
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    c->in_use = FALSE;
+  }
+  g_mutex_unlock(&_stmt_cache_lock);
+
+  if(!cached)
+    sqlite3_finalize(stmt);
+}
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
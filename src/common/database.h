@@ -33,6 +33,14 @@ struct dt_database_t *dt_database_init(const char *alternative,
 void dt_database_destroy(const struct dt_database_t *);
 /** get handle */
 struct sqlite3 *dt_database_get(const struct dt_database_t *);
+/** get a read-only connection for background jobs, to be given back with
+ * dt_database_release_readonly(). with write-ahead logging these
+ * connections don't wait for the writer and see the last committed state,
+ * uncommitted changes of the main connection and the memory database are
+ * not visible. without write-ahead logging this is the main connection. */
+struct sqlite3 *dt_database_get_readonly(const struct dt_database_t *db);
+void dt_database_release_readonly(const struct dt_database_t *db,
+                                  struct sqlite3 *handle);
 /** Returns database path */
 const gchar *dt_database_get_path(const struct dt_database_t *db);
 /** test if database was already locked by another instance */
@@ -63,6 +71,17 @@ void dt_database_start_transaction(const struct dt_database_t *db);
 void dt_database_release_transaction(const struct dt_database_t *db);
 void dt_database_rollback_transaction(const struct dt_database_t *db);
 
+/** get a prepared statement for sql from the statement cache, for hot
+ * queries whose text does not change: values must be bound as
+ * parameters. the statement must be given back with
+ * dt_database_release_cached() by the same thread. */
+struct sqlite3_stmt *dt_database_prepare_cached(const struct dt_database_t *db,
+                                                const char *sql);
+/** reset a statement from dt_database_prepare_cached() and make it
+ * available again */
+void dt_database_release_cached(const struct dt_database_t *db,
+                                struct sqlite3_stmt *stmt);
+
 void dt_upgrade_maker_model(const struct dt_database_t *db);
 
 G_END_DECLS
@@ -66,7 +66,8 @@
  * - variance of guide
  * - average of mask
  * - covariance of mask and guide. */
-static inline void eigf_variance_analysis(const float *const restrict guide, // I
+static inline gboolean eigf_variance_analysis(dt_filter_workspace_t *const ws,
+                                    const float *const restrict guide, // I
                                     const float *const restrict mask, //p
                                     float *const restrict out,
                                     const size_t width, const size_t height,
@@ -74,7 +75,8 @@ static inline void eigf_variance_analysis(const float *const restrict guide, //
 {
   // We also use gaussian blurs instead of the square blurs of the guided filter
   const size_t Ndim = width * height;
-  float *const restrict in = dt_alloc_align_float(Ndim * 4);
+  float *const restrict in = dt_filter_workspace_get(ws, DT_FILTER_WS_PACKED, Ndim * 4);
+  if(!in) return TRUE;
 
   float ming = 10000000.0f;
   float maxg = 0.0f;
@@ -108,7 +110,7 @@ static inline void eigf_variance_analysis(const float *const restrict guide, //
   dt_aligned_pixel_t max = {maxg, maxg2, maxm, maxmg};
   dt_aligned_pixel_t min = {ming, ming2, minm, minmg};
   dt_gaussian_t *g = dt_gaussian_init(width, height, 4, max, min, sigma, 0);
-  if(!g) return;
+  if(!g) return TRUE;
   dt_gaussian_blur_4c(g, in, out);
   dt_gaussian_free(g);
 
@@ -119,19 +121,21 @@ static inline void eigf_variance_analysis(const float *const restrict guide, //
     out[4 * k + 3] -= out[4 * k] * out[4 * k + 2];
   }
 
-  dt_free_align(in);
+  return FALSE;
 }
 
 // same function as above, but specialized for the case where guide == mask
 // for increased performance
-static inline void eigf_variance_analysis_no_mask(const float *const restrict guide, // I
+static inline gboolean eigf_variance_analysis_no_mask(dt_filter_workspace_t *const ws,
+                                    const float *const restrict guide, // I
                                     float *const restrict out,
                                     const size_t width, const size_t height,
                                     const float sigma)
 {
   // We also use gaussian blurs instead of the square blurs of the guided filter
   const size_t Ndim = width * height;
-  float *const restrict in = dt_alloc_align_float(Ndim * 2);
+  float *const restrict in = dt_filter_workspace_get(ws, DT_FILTER_WS_PACKED, Ndim * 2);
+  if(!in) return TRUE;
 
   float ming = 10000000.0f;
   float maxg = 0.0f;
@@ -153,7 +157,7 @@ static inline void eigf_variance_analysis_no_mask(const float *const restrict gu
   float max[2] = {maxg, maxg2};
   float min[2] = {ming, ming2};
   dt_gaussian_t *g = dt_gaussian_init(width, height, 2, max, min, sigma, 0);
-  if(!g) return;
+  if(!g) return TRUE;
   dt_gaussian_blur(g, in, out);
   dt_gaussian_free(g);
 
@@ -164,7 +168,7 @@ static inline void eigf_variance_analysis_no_mask(const float *const restrict gu
     out[2 * k + 1] -= avg * avg;
   }
 
-  dt_free_align(in);
+  return FALSE;
 }
 
 void eigf_blending(float *const restrict image, const float *const restrict mask,
@@ -228,7 +232,8 @@ void eigf_blending_no_mask(float *const restrict image,
 }
 
 __DT_CLONE_TARGETS__
-static inline void fast_eigf_surface_blur(float *const restrict image,
+static inline void fast_eigf_surface_blur(dt_filter_workspace_t *const workspace,
+                                      float *const restrict image,
                                       const size_t width, const size_t height,
                                       const float sigma, float feathering, const int iterations,
                                       const dt_iop_guided_filter_blending_t filter, const float scale,
@@ -236,6 +241,7 @@ static inline void fast_eigf_surface_blur(float *const restrict image,
 {
   // Works in-place on a grey image
   // mostly similar with fast_surface_blur from fast_guided_filter.h
+  // workspace can be NULL, buffers are then only kept for this call
 
   // A down-scaling of 4 seems empirically safe and consistent no matter the image zoom level
   // see reference paper above for proof.
@@ -248,18 +254,22 @@ static inline void fast_eigf_surface_blur(float *const restrict image,
   const size_t num_elem_ds = ds_width * ds_height;
   const size_t num_elem = width * height;
 
-  float *const restrict mask = dt_alloc_align_float(num_elem);
-  float *const restrict ds_image = dt_alloc_align_float(num_elem_ds);
-  float *const restrict ds_mask = dt_alloc_align_float(num_elem_ds);
+  // the mask and 4 channel statistics are only needed with quantization
+  const gboolean masked = quantization != 0.0f;
+  const size_t av_ch = masked ? 4 : 2;
+
+  dt_filter_workspace_t local = { { NULL } };
+  dt_filter_workspace_t *const ws = workspace ? workspace : &local;
+
+  float *const restrict mask = masked ? dt_filter_workspace_get(ws, DT_FILTER_WS_MASK_FULL, num_elem) : NULL;
+  float *const restrict ds_mask = masked ? dt_filter_workspace_get(ws, DT_FILTER_WS_MASK, num_elem_ds) : NULL;
+  float *const restrict ds_image = dt_filter_workspace_get(ws, DT_FILTER_WS_IMAGE, num_elem_ds);
   // average - variance arrays: store the guide and mask averages and variances
-  float *const restrict ds_av = dt_alloc_align_float(num_elem_ds * 4);
-  float *const restrict av = dt_alloc_align_float(num_elem * 4);
+  float *const restrict ds_av = dt_filter_workspace_get(ws, DT_FILTER_WS_COEFFS, num_elem_ds * av_ch);
+  float *const restrict av = dt_filter_workspace_get(ws, DT_FILTER_WS_COEFFS_FULL, num_elem * av_ch);
 
-  if(!ds_image || !ds_mask || !ds_av || !av)
-  {
-    dt_control_log(_("fast exposure independent guided filter failed to allocate memory, check your RAM settings"));
-    goto clean;
-  }
+  if((masked && (!mask || !ds_mask)) || !ds_image || !ds_av || !av)
+    goto error;
 
   // Iterations of filter models the diffusion, sort of
   for(int i = 0; i < iterations; i++)
@@ -271,13 +281,14 @@ static inline void fast_eigf_surface_blur(float *const restrict image,
       blend = filter;
 
     interpolate_bilinear(image, width, height, ds_image, ds_width, ds_height, 1);
-    if(quantization != 0.0f)
+    if(masked)
     {
       // (Re)build the mask from the quantized image to help guiding
       quantize(image, mask, width * height, quantization, quantize_min, quantize_max);
       // Downsample the image for speed-up
       interpolate_bilinear(mask, width, height, ds_mask, ds_width, ds_height, 1);
-      eigf_variance_analysis(ds_mask, ds_image, ds_av, ds_width, ds_height, ds_sigma);
+      if(eigf_variance_analysis(ws, ds_mask, ds_image, ds_av, ds_width, ds_height, ds_sigma))
+        goto error;
       // Upsample the variances and averages
       interpolate_bilinear(ds_av, ds_width, ds_height, av, width, height, 4);
       // Blend the guided image
@@ -286,7 +297,8 @@ static inline void fast_eigf_surface_blur(float *const restrict image,
     else
     {
       // no need to build a mask.
-      eigf_variance_analysis_no_mask(ds_image, ds_av, ds_width, ds_height, ds_sigma);
+      if(eigf_variance_analysis_no_mask(ws, ds_image, ds_av, ds_width, ds_height, ds_sigma))
+        goto error;
       // Upsample the variances and averages
       interpolate_bilinear(ds_av, ds_width, ds_height, av, width, height, 2);
       // Blend the guided image
@@ -294,12 +306,12 @@ static inline void fast_eigf_surface_blur(float *const restrict image,
     }
   }
 
-clean:
-  dt_free_align(av);
-  dt_free_align(ds_av);
-  dt_free_align(ds_mask);
-  dt_free_align(ds_image);
-  dt_free_align(mask);
+  dt_filter_workspace_free(&local);
+  return;
+
+error:
+  dt_control_log(_("fast exposure independent guided filter failed to allocate memory, check your RAM settings"));
+  dt_filter_workspace_free(&local);
 }
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
@@ -4819,7 +4819,8 @@ static void _xmp_add_new(Exiv2::XmpData &xmpData, const char *key, const T &valu
 }
 
 // add history metadata to XmpData
-static void _set_xmp_dt_history(Exiv2::XmpData &xmpData,
+static void _set_xmp_dt_history(sqlite3 *db,
+                                Exiv2::XmpData &xmpData,
                                 const dt_imgid_t imgid,
                                 int history_end)
 {
@@ -4837,7 +4838,7 @@ static void _set_xmp_dt_history(Exiv2::XmpData &xmpData,
   xmpData.add(Exiv2::XmpKey("Xmp.darktable.masks_history"), &tvm);
   // clang-format off
   DT_DEBUG_SQLITE3_PREPARE_V2(
-      dt_database_get(darktable.db),
+      db,
       "SELECT imgid, formid, form, name, version, points, points_count, source, num"
       " FROM main.masks_history"
       " WHERE imgid = ?1"
@@ -4901,7 +4902,7 @@ static void _set_xmp_dt_history(Exiv2::XmpData &xmpData,
   xmpData.add(Exiv2::XmpKey("Xmp.darktable.history"), &tv);
   // clang-format off
   DT_DEBUG_SQLITE3_PREPARE_V2(
-      dt_database_get(darktable.db),
+      db,
       "SELECT module, operation, op_params, enabled, blendop_params, "
       "       blendop_version, multi_priority, multi_name, num, multi_name_hand_edited"
       " FROM main.history"
@@ -5347,7 +5348,7 @@ static void _exif_xmp_read_data(Exiv2::XmpData &xmpData,
     xmpData["Xmp.darktable.auto_presets_applied"] = 1;
   else
     xmpData["Xmp.darktable.auto_presets_applied"] = 0;
-  _set_xmp_dt_history(xmpData, imgid, history_end);
+  _set_xmp_dt_history(dt_database_get(darktable.db), xmpData, imgid, history_end);
 
   // We need to read the iop-order list
   xmpData["Xmp.darktable.iop_order_version"] = iop_order_version;
@@ -5405,11 +5406,14 @@ static void _exif_xmp_read_data_export(Exiv2::XmpData &xmpData,
   GTimeSpan gts = 0;
   gchar *iop_order_list = NULL;
 
+  // the export only reads committed rows, it doesn't need to wait for the writer
+  sqlite3 *db = dt_database_get_readonly(darktable.db);
+
   // Get stars and raw params from db
   sqlite3_stmt *stmt;
   // clang-format off
   DT_DEBUG_SQLITE3_PREPARE_V2
-    (dt_database_get(darktable.db),
+    (db,
      "SELECT filename, flags, raw_parameters, "
      "       longitude, latitude, altitude, history_end, datetime_taken"
      " FROM main.images"
@@ -5510,7 +5514,7 @@ static void _exif_xmp_read_data_export(Exiv2::XmpData &xmpData,
       xmpData["Xmp.darktable.auto_presets_applied"] = 1;
     else
       xmpData["Xmp.darktable.auto_presets_applied"] = 0;
-    _set_xmp_dt_history(xmpData, imgid, history_end);
+    _set_xmp_dt_history(db, xmpData, imgid, history_end);
 
     // We need to read the iop-order list
     xmpData["Xmp.darktable.iop_order_version"] = iop_order_version;
@@ -5518,6 +5522,7 @@ static void _exif_xmp_read_data_export(Exiv2::XmpData &xmpData,
   }
 
   sqlite3_finalize(stmt);
+  dt_database_release_readonly(darktable.db, db);
   g_free(iop_order_list);
 }
 
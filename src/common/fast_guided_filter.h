@@ -26,6 +26,7 @@
 
 #include "common/box_filters.h"
 #include "common/darktable.h"
+#include "common/filter_workspace.h"
 #include "common/imagebuf.h"
 
 
@@ -152,13 +153,14 @@ static inline void interpolate_bilinear(const float *const restrict in,
 
 
 __DT_CLONE_TARGETS__
-static inline void variance_analyse(const float *const restrict guide, // I
-                                    const float *const restrict mask, //p
-                                    float *const restrict ab,
-                                    const size_t width,
-                                    const size_t height,
-                                    const int radius,
-                                    const float feathering)
+static inline gboolean variance_analyse(dt_filter_workspace_t *const ws,
+                                        const float *const restrict guide, // I
+                                        const float *const restrict mask, //p
+                                        float *const restrict ab,
+                                        const size_t width,
+                                        const size_t height,
+                                        const int radius,
+                                        const float feathering)
 {
   // Compute a box average (filter) on a grey image over a window of size 2*radius + 1
   // then get the variance of the guide and covariance with its mask
@@ -171,21 +173,33 @@ static inline void variance_analyse(const float *const restrict guide, // I
   /*
   * input is array of struct : { { guide , mask, guide * guide, guide * mask } }
   */
-  float *const restrict input = dt_alloc_align_float(Ndimch);
-
-  // Pre-multiply guide and mask and pack all inputs into an array of 4×1 SIMD struct
-  DT_OMP_FOR_SIMD()
-  for(size_t k = 0; k < Ndim; k++)
+  size_t padded_size;
+  float *const restrict input = dt_filter_workspace_get(ws, DT_FILTER_WS_PACKED, Ndimch);
+  float *const restrict scanlines =
+    dt_filter_workspace_get_perthread(ws, DT_FILTER_WS_SCANLINES,
+                                      dt_box_mean_scratch_size(height, width, 4, radius), &padded_size);
+  if(!input || !scanlines) return TRUE;
+
+  // Pre-multiply guide and mask and pack all inputs into an array of 4×1 SIMD struct,
+  // then blur the four channels horizontally while the row is still in cache
+  DT_OMP_FOR()
+  for(size_t row = 0; row < height; row++)
   {
-    const size_t index = k * 4;
-    input[index] = guide[k];
-    input[index + 1] = mask[k];
-    input[index + 2] = guide[k] * guide[k];
-    input[index + 3] = guide[k] * mask[k];
+    float *const restrict in_row = input + row * width * 4;
+    const float *const restrict guide_row = guide + row * width;
+    const float *const restrict mask_row = mask + row * width;
+    for(size_t k = 0; k < width; k++)
+    {
+      in_row[4 * k] = guide_row[k];
+      in_row[4 * k + 1] = mask_row[k];
+      in_row[4 * k + 2] = guide_row[k] * guide_row[k];
+      in_row[4 * k + 3] = guide_row[k] * mask_row[k];
+    }
+    dt_box_mean_horizontal(in_row, width, 4, radius, dt_get_perthread(scanlines, padded_size));
   }
 
-  // blur the guide and mask as a four-channel image to exploit data locality and SIMD
-  dt_box_mean(input, height, width, 4, radius, 1);
+  // vertical pass of the box mean: means, variance and covariance come out of a single sweep
+  dt_box_mean_vertical_with_scratch(input, height, width, 4, radius, scanlines, padded_size);
 
   // blend the result and store in output buffer
   DT_OMP_FOR()
@@ -198,7 +212,7 @@ static inline void variance_analyse(const float *const restrict guide, // I
     ab[2*idx+1] = b;
   }
 
-  if(input != NULL) dt_free_align(input);
+  return FALSE;
 }
 
 
@@ -264,19 +278,21 @@ static inline void quantize(const float *const restrict image,
 
 
 __DT_CLONE_TARGETS__
-static inline void fast_surface_blur(float *const restrict image,
-                                      const size_t width,
-                                      const size_t height,
-                                      const int radius,
-                                      float feathering,
-                                      const int iterations,
-                                      const dt_iop_guided_filter_blending_t filter,
-                                      const float scale,
-                                      const float quantization,
-                                      const float quantize_min,
-                                      const float quantize_max)
+static inline void fast_surface_blur(dt_filter_workspace_t *const workspace,
+                                     float *const restrict image,
+                                     const size_t width,
+                                     const size_t height,
+                                     const int radius,
+                                     float feathering,
+                                     const int iterations,
+                                     const dt_iop_guided_filter_blending_t filter,
+                                     const float scale,
+                                     const float quantization,
+                                     const float quantize_min,
+                                     const float quantize_max)
 {
   // Works in-place on a grey image
+  // workspace can be NULL, buffers are then only kept for this call
 
   // A down-scaling of 4 seems empirically safe and consistent no matter the image zoom level
   // see reference paper above for proof.
@@ -289,17 +305,16 @@ static inline void fast_surface_blur(float *const restrict image,
   const size_t num_elem_ds = ds_width * ds_height;
   const size_t num_elem = width * height;
 
-  float *const restrict ds_image = dt_alloc_align_float(num_elem_ds);
-  float *const restrict ds_mask = dt_alloc_align_float(num_elem_ds);
-  float *const restrict ds_ab = dt_alloc_align_float(num_elem_ds * 2);
-  float *const restrict ab = dt_alloc_align_float(num_elem * 2);
+  dt_filter_workspace_t local = { { NULL } };
+  dt_filter_workspace_t *const ws = workspace ? workspace : &local;
+
+  float *const restrict ds_image = dt_filter_workspace_get(ws, DT_FILTER_WS_IMAGE, num_elem_ds);
+  float *const restrict ds_mask = dt_filter_workspace_get(ws, DT_FILTER_WS_MASK, num_elem_ds);
+  float *const restrict ds_ab = dt_filter_workspace_get(ws, DT_FILTER_WS_COEFFS, num_elem_ds * 2);
+  float *const restrict ab = dt_filter_workspace_get(ws, DT_FILTER_WS_COEFFS_FULL, num_elem * 2);
 
   if(!ds_image || !ds_mask || !ds_ab || !ab)
-  {
-    dt_print(DT_DEBUG_PIPE, "fast guided filter failed to allocate memory");
-    dt_control_log(_("fast guided filter failed to allocate memory, check your RAM settings"));
-    goto clean;
-  }
+    goto error;
 
   // Downsample the image for speed-up
   interpolate_bilinear(image, width, height, ds_image, ds_width, ds_height, 1);
@@ -312,10 +327,17 @@ static inline void fast_surface_blur(float *const restrict image,
 
     // Perform the patch-wise variance analyse to get
     // the a and b parameters for the linear blending s.t. mask = a * I + b
-    variance_analyse(ds_mask, ds_image, ds_ab, ds_width, ds_height, ds_radius, feathering);
+    if(variance_analyse(ws, ds_mask, ds_image, ds_ab, ds_width, ds_height, ds_radius, feathering))
+      goto error;
 
     // Compute the patch-wise average of parameters a and b
-    dt_box_mean(ds_ab, ds_height, ds_width, 2, ds_radius, 1);
+    // the scan lines of the variance analysis are large enough for 2 channels
+    size_t padded_size;
+    float *const restrict scanlines =
+      dt_filter_workspace_get_perthread(ws, DT_FILTER_WS_SCANLINES,
+                                        dt_box_mean_scratch_size(ds_height, ds_width, 2, ds_radius),
+                                        &padded_size);
+    dt_box_mean_with_scratch(ds_ab, ds_height, ds_width, 2, ds_radius, 1, scanlines, padded_size);
 
     if(i != iterations - 1)
     {
@@ -333,11 +355,13 @@ static inline void fast_surface_blur(float *const restrict image,
   else if(filter == DT_GF_BLENDING_GEOMEAN)
     apply_linear_blending_w_geomean(image, ab, num_elem);
 
-clean:
-  dt_free_align(ab);
-  dt_free_align(ds_ab);
-  dt_free_align(ds_mask);
-  dt_free_align(ds_image);
+  dt_filter_workspace_free(&local);
+  return;
+
+error:
+  dt_print(DT_DEBUG_PIPE, "fast guided filter failed to allocate memory");
+  dt_control_log(_("fast guided filter failed to allocate memory, check your RAM settings"));
+  dt_filter_workspace_free(&local);
 }
 
 // clang-format off
@@ -0,0 +1,99 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+
+/***
+ * Scratch memory shared by the box, guided and exposure-independent guided filters.
+ *
+ * Each filter pass needs a handful of temporary planes (downscaled guide and mask,
+ * packed channels for the box/gaussian means, the linear coefficients at low and
+ * full resolution, and per-thread scan lines for the box passes). Allocating them on
+ * every call costs page faults on large buffers, so a module can keep one workspace
+ * in its piece data: buffers only grow, are reused across runs and are released by
+ * dt_filter_workspace_free() in cleanup_pipe().
+ *
+ * All filters accept a NULL workspace and then use a temporary one for the call.
+ * A workspace must not be shared by filters running concurrently.
+ **/
+
+typedef enum dt_filter_workspace_slot_t
+{
+  DT_FILTER_WS_IMAGE = 0,   // downscaled guide
+  DT_FILTER_WS_MASK,        // downscaled mask
+  DT_FILTER_WS_MASK_FULL,   // full resolution mask
+  DT_FILTER_WS_PACKED,      // interleaved channels fed to the box or gaussian means
+  DT_FILTER_WS_COEFFS,      // linear coefficients or local statistics, downscaled
+  DT_FILTER_WS_COEFFS_FULL, // same, upscaled to full resolution
+  DT_FILTER_WS_SCANLINES,   // per-thread scratch of the box mean passes
+  DT_FILTER_WS_LAST
+} dt_filter_workspace_slot_t;
+
+typedef struct dt_filter_workspace_t
+{
+  float *buf[DT_FILTER_WS_LAST];
+  size_t size[DT_FILTER_WS_LAST]; // in floats
+  int allocations;                // number of (re)allocations, for benchmarking
+} dt_filter_workspace_t;
+
+// get a buffer of at least n floats from the given slot, content is undefined.
+// Returns NULL if out of memory.
+static inline float *dt_filter_workspace_get(dt_filter_workspace_t *ws,
+                                             const dt_filter_workspace_slot_t slot,
+                                             const size_t n)
+{
+  if(ws->size[slot] < n || !ws->buf[slot])
+  {
+    dt_free_align(ws->buf[slot]);
+    ws->buf[slot] = dt_alloc_align_float(n);
+    ws->size[slot] = ws->buf[slot] ? n : 0;
+    ws->allocations++;
+  }
+  return ws->buf[slot];
+}
+
+// same as above for a dt_alloc_perthread_float() style buffer, to be accessed
+// with dt_get_perthread(buf, *padded_size)
+static inline float *dt_filter_workspace_get_perthread(dt_filter_workspace_t *ws,
+                                                       const dt_filter_workspace_slot_t slot,
+                                                       const size_t n,
+                                                       size_t *padded_size)
+{
+  const size_t cache_lines = (n * sizeof(float) + DT_CACHELINE_BYTES - 1) / DT_CACHELINE_BYTES;
+  *padded_size = DT_CACHELINE_BYTES * cache_lines / sizeof(float);
+  return dt_filter_workspace_get(ws, slot, *padded_size * dt_get_num_threads());
+}
+
+static inline void dt_filter_workspace_free(dt_filter_workspace_t *ws)
+{
+  if(!ws) return;
+  for(int k = 0; k < DT_FILTER_WS_LAST; k++)
+  {
+    dt_free_align(ws->buf[k]);
+    ws->buf[k] = NULL;
+    ws->size[k] = 0;
+  }
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -97,7 +97,7 @@ static inline void dt_focuspeaking(cairo_t *cr,
     }
 
   // Prefilter noise
-  fast_surface_blur(luma, buf_width, buf_height, 12, 0.00001f, 4, DT_GF_BLENDING_LINEAR, 1, 0.0f, exp2f(-8.0f), 1.0f);
+  fast_surface_blur(NULL, luma, buf_width, buf_height, 12, 0.00001f, 4, DT_GF_BLENDING_LINEAR, 1, 0.0f, exp2f(-8.0f), 1.0f);
 
   // Compute the gradients magnitudes
   float *const restrict luma_ds =  dt_alloc_align_float((size_t)buf_width * buf_height);
@@ -157,7 +157,7 @@ static inline void dt_focuspeaking(cairo_t *cr,
   const float two_sigma = TV_sum + 2.5f * sigma;
 
   // Postfilter to connect isolated dots and draw lines
-  fast_surface_blur(luma_ds, buf_width, buf_height, 12, 0.00001f, 4, DT_GF_BLENDING_LINEAR, 1, 0.0f, exp2f(-8.0f), 1.0f);
+  fast_surface_blur(NULL, luma_ds, buf_width, buf_height, 12, 0.00001f, 4, DT_GF_BLENDING_LINEAR, 1, 0.0f, exp2f(-8.0f), 1.0f);
 
   // Prepare the focus-peaking image overlay
   DT_OMP_FOR(collapse(2))
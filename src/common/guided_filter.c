@@ -29,6 +29,7 @@
 */
 
 #include "common/box_filters.h"
+#include "common/filter_workspace.h"
 #include "common/guided_filter.h"
 #include "common/math.h"
 #include "common/opencl.h"
@@ -54,17 +55,13 @@ typedef struct color_image
   int width, height, stride;
 } color_image;
 
-// allocate space for n-component image of size width x height
-static inline color_image _new_color_image(int width, int height, int ch)
+// get space for n-component image of size width x height, the memory is kept
+// in the workspace slot for the next tiles
+static inline color_image _new_color_image(dt_filter_workspace_t *ws,
+                                           const dt_filter_workspace_slot_t slot,
+                                           int width, int height, int ch)
 {
-  return (color_image){ dt_alloc_align_float((size_t)width * height * ch), width, height, ch };
-}
-
-// free space for n-component image
-static inline void _free_color_image(color_image *img_p)
-{
-  dt_free_align(img_p->data);
-  img_p->data = NULL;
+  return (color_image){ dt_filter_workspace_get(ws, slot, (size_t)width * height * ch), width, height, ch };
 }
 
 // get a pointer to pixel number 'i' within the image
@@ -83,15 +80,16 @@ static inline float *_get_color_pixel(color_image img, size_t i)
 // for computational efficiency, we'll pack them into a four-channel image and a 9-channel image
 // image instead of running 13 separate box filters: guide+input, R/G/B/R-R/R-G/R-B/G-G/G-B/B-B.
 // make sure the tiles are always aligned for 16 floats
-static void _guided_filter_tiling(color_image imgg,
-                                  gray_image img,
-                                  gray_image img_out,
-                                  tile target,
-                                  const int w,
-                                  const float eps,
-                                  const float guide_weight,
-                                  const float min,
-                                  const float max)
+static gboolean _guided_filter_tiling(dt_filter_workspace_t *ws,
+                                      color_image imgg,
+                                      gray_image img,
+                                      gray_image img_out,
+                                      tile target,
+                                      const int w,
+                                      const float eps,
+                                      const float guide_weight,
+                                      const float min,
+                                      const float max)
 {
   const int overlap = dt_round_size(3 * w, 16);
   const tile source = { MAX(target.left - overlap, 0),  MIN(target.right + overlap, imgg.width),
@@ -114,11 +112,16 @@ static void _guided_filter_tiling(color_image imgg,
 #define VAR_GG 6
 #define VAR_BB 8
 #define VAR_GB 7
-  color_image mean = _new_color_image(width, height, 4);
-  color_image variance = _new_color_image(width, height, 9);
+  color_image mean = _new_color_image(ws, DT_FILTER_WS_COEFFS, width, height, 4);
+  color_image variance = _new_color_image(ws, DT_FILTER_WS_PACKED, width, height, 9);
   const size_t img_dimen = dt_round_size(mean.width, 16);
   size_t img_bak_sz;
-  float *img_bak = dt_alloc_perthread_float(9*img_dimen, &img_bak_sz);
+  // the scan lines are shared by the horizontal and the vertical box passes
+  float *img_bak = dt_filter_workspace_get_perthread(ws, DT_FILTER_WS_SCANLINES,
+                                                     MAX(9 * img_dimen,
+                                                         dt_box_mean_scratch_size(height, width, 9, w)),
+                                                     &img_bak_sz);
+  if(!mean.data || !variance.data || !img_bak) return TRUE;
   DT_OMP_FOR(shared(img, imgg, mean, variance, img_bak) dt_omp_sharedconst(source))
   for(int j_imgg = source.lower; j_imgg < source.upper; j_imgg++)
   {
@@ -151,9 +154,10 @@ static void _guided_filter_tiling(color_image imgg,
     dt_box_mean_horizontal(meanpx, mean.width, 4|BOXFILTER_KAHAN_SUM, w, scratch);
     dt_box_mean_horizontal(varpx, variance.width, 9|BOXFILTER_KAHAN_SUM, w, scratch);
   }
-  dt_free_align(img_bak);
-  dt_box_mean_vertical(mean.data, mean.height, mean.width, 4|BOXFILTER_KAHAN_SUM, w);
-  dt_box_mean_vertical(variance.data, variance.height, variance.width, 9|BOXFILTER_KAHAN_SUM, w);
+  dt_box_mean_vertical_with_scratch(mean.data, mean.height, mean.width, 4|BOXFILTER_KAHAN_SUM, w,
+                                    img_bak, img_bak_sz);
+  dt_box_mean_vertical_with_scratch(variance.data, variance.height, variance.width, 9|BOXFILTER_KAHAN_SUM, w,
+                                    img_bak, img_bak_sz);
   // we will recycle memory of 'mean' for the new coefficient arrays a_? and b to reduce memory foot print
   color_image a_b = mean;
   #define A_RED 0
@@ -214,9 +218,8 @@ static void _guided_filter_tiling(color_image imgg,
     a_b.data[4*i+A_BLUE] = a_b_;
     a_b.data[4*i+B] = b_;
   }
-  _free_color_image(&variance);
-
-  dt_box_mean(a_b.data, a_b.height, a_b.width, a_b.stride|BOXFILTER_KAHAN_SUM, w, 1);
+  dt_box_mean_with_scratch(a_b.data, a_b.height, a_b.width, a_b.stride|BOXFILTER_KAHAN_SUM, w, 1,
+                           img_bak, img_bak_sz);
 
   DT_OMP_FOR(shared(target, imgg, a_b, img_out) dt_omp_sharedconst(source))
   for(int j_imgg = target.lower; j_imgg < target.upper; j_imgg++)
@@ -236,7 +239,7 @@ static void _guided_filter_tiling(color_image imgg,
       img_out.data[i_imgg + (size_t)j_imgg * imgg.width] = CLAMP(res, min, max);
     }
   }
-  _free_color_image(&mean);
+  return FALSE;
 }
 
 void guided_filter(const float *const guide,
@@ -260,15 +263,22 @@ void guided_filter(const float *const guide,
   const int tile_dim = MAX(dt_round_size(3 * w, 16), GF_TILE_SIZE);
   const float eps = sqrt_eps * sqrt_eps; // this is the regularization parameter of the original papers
 
-  for(int j = 0; j < height; j += tile_dim)
+  // the buffers grow to the size of the largest tile and are reused by all the others
+  dt_filter_workspace_t ws = { { NULL } };
+  gboolean failed = FALSE;
+  for(int j = 0; j < height && !failed; j += tile_dim)
   {
-    for(int i = 0; i < width; i += tile_dim)
+    for(int i = 0; i < width && !failed; i += tile_dim)
     {
       tile target = { i, MIN(i + tile_dim, width),
                       j, MIN(j + tile_dim, height) };
-      _guided_filter_tiling(img_guide, img_in, img_out, target, w, eps, guide_weight, min, max);
+      failed = _guided_filter_tiling(&ws, img_guide, img_in, img_out, target, w, eps, guide_weight, min, max);
     }
   }
+  dt_filter_workspace_free(&ws);
+
+  if(failed)
+    dt_print(DT_DEBUG_ALWAYS, "[guided filter] unable to allocate memory");
 }
 
 #ifdef HAVE_OPENCL
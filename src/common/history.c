@@ -1887,30 +1887,30 @@ dt_history_hash_t dt_history_hash_get_status(const dt_imgid_t imgid)
 {
   dt_history_hash_t status = DT_HISTORY_HASH_NONE;
   if(!dt_is_valid_imgid(imgid)) return status;
-  sqlite3_stmt *stmt;
+  // asked for every thumbnail, so keep the statement prepared
   // clang-format off
-  char *query =
-    g_strdup_printf("SELECT CASE"
-                    "  WHEN basic_hash == current_hash THEN %d"
-                    "  WHEN auto_hash == current_hash THEN %d"
-                    "  WHEN (basic_hash IS NULL OR current_hash != basic_hash) AND"
-                    "       (auto_hash IS NULL OR current_hash != auto_hash) THEN %d"
-                    "  ELSE %d END AS status"
-                    " FROM main.history_hash"
-                    " WHERE imgid = %d",
-                    DT_HISTORY_HASH_BASIC, DT_HISTORY_HASH_AUTO,
-                    DT_HISTORY_HASH_CURRENT, DT_HISTORY_HASH_BASIC, imgid);
+  sqlite3_stmt *stmt = dt_database_prepare_cached
+    (darktable.db,
+     "SELECT CASE"
+     "  WHEN basic_hash == current_hash THEN ?2"
+     "  WHEN auto_hash == current_hash THEN ?3"
+     "  WHEN (basic_hash IS NULL OR current_hash != basic_hash) AND"
+     "       (auto_hash IS NULL OR current_hash != auto_hash) THEN ?4"
+     "  ELSE ?2 END AS status"
+     " FROM main.history_hash"
+     " WHERE imgid = ?1");
   // clang-format on
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              query, -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, DT_HISTORY_HASH_BASIC);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 3, DT_HISTORY_HASH_AUTO);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 4, DT_HISTORY_HASH_CURRENT);
   if(sqlite3_step(stmt) == SQLITE_ROW)
   {
     status = sqlite3_column_int(stmt, 0);
   }
   // if no history_hash basic status
   else status = DT_HISTORY_HASH_BASIC;
-  sqlite3_finalize(stmt);
-  g_free(query);
+  dt_database_release_cached(darktable.db, stmt);
   return status;
 }
 
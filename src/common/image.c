@@ -1814,11 +1814,39 @@ static int _image_read_duplicates(const uint32_t id,
   return count_xmps_processed;
 }
 
+// raise the lua event and the signals for a newly imported image
+static void _image_import_notify(const dt_imgid_t id,
+                                 const gboolean lua_locking,
+                                 const gboolean raise_signals)
+{
+#ifdef USE_LUA
+  //Synchronous calling of lua post-import-image events
+  if(lua_locking)
+    dt_lua_lock();
+
+  lua_State *L = darktable.lua_state.state;
+
+  luaA_push(L, dt_lua_image_t, &id);
+  dt_lua_event_trigger(L, "post-import-image", 1);
+
+  if(lua_locking)
+    dt_lua_unlock();
+#endif
+
+  if(raise_signals)
+  {
+    DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_IMAGE_IMPORT, id);
+    GList *imgs = g_list_prepend(NULL, GINT_TO_POINTER(id));
+    DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_GEOTAG_CHANGED, imgs, 0);
+  }
+}
+
 static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
                                          const char *filename,
                                          const gboolean override_ignore_nonraws,
                                          const gboolean lua_locking,
-                                         const gboolean raise_signals)
+                                         const gboolean raise_signals,
+                                         GList **batch)
 {
   char *normalized_filename = dt_util_normalize_path(filename);
   if(!normalized_filename || !dt_util_test_image_file(normalized_filename))
@@ -1914,16 +1942,20 @@ static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
     g_free(extra_file);
   }
 
+  // the record and its grouping are written by several statements, commit
+  // them at once. nothing in between raises signals or lua events which
+  // could run other transactions on the shared connection.
+  dt_database_start_transaction(darktable.db);
+
   //insert a v0 record (which may be updated later if no v0 xmp exists)
   // clang-format off
-  DT_DEBUG_SQLITE3_PREPARE_V2
-    (dt_database_get(darktable.db),
+  stmt = dt_database_prepare_cached
+    (darktable.db,
      "INSERT INTO main.images (id, film_id, filename, flags, version, "
      "                         max_version, history_end, position, import_timestamp)"
      " SELECT NULL, ?1, ?2, ?3, 0, 0, 0,"
      "        (IFNULL(MAX(position),0) & 0xFFFFFFFF00000000)  + (1 << 32), ?4"
-     " FROM images",
-     -1, &stmt, NULL);
+     " FROM images");
   // clang-format on
 
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, film_id);
@@ -1935,7 +1967,7 @@ static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
   if(rc != SQLITE_DONE)
     dt_print(DT_DEBUG_ALWAYS,
              "[image_import_internal] sqlite3 error %d in `%s`", rc, filename);
-  sqlite3_finalize(stmt);
+  dt_database_release_cached(darktable.db, stmt);
 
   id = dt_image_get_id(film_id, imgfname);
 
@@ -1951,14 +1983,12 @@ static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
   // we need to change group representative
   if(dt_imageio_is_raw_by_extension(ext) || !strcmp(ext, "dng"))
   {
-    sqlite3_stmt *stmt2;
     // clang-format off
-    DT_DEBUG_SQLITE3_PREPARE_V2
-      (dt_database_get(darktable.db),
+    sqlite3_stmt *stmt2 = dt_database_prepare_cached
+      (darktable.db,
        "SELECT group_id"
        " FROM main.images"
-       " WHERE film_id = ?1 AND filename LIKE ?2 AND id = group_id", -1, &stmt2,
-      NULL);
+       " WHERE film_id = ?1 AND filename LIKE ?2 AND id = group_id");
     // clang-format on
     DT_DEBUG_SQLITE3_BIND_INT(stmt2, 1, film_id);
     DT_DEBUG_SQLITE3_BIND_TEXT(stmt2, 2, sql_pattern, -1, SQLITE_TRANSIENT);
@@ -1979,10 +2009,8 @@ static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
       {
         other_img->group_id = id;
         dt_image_cache_write_release_info(other_img, DT_IMAGE_CACHE_SAFE, "_image_import_internal");
-        sqlite3_stmt *stmt3;
-        DT_DEBUG_SQLITE3_PREPARE_V2
-          (dt_database_get(darktable.db),
-           "SELECT id FROM main.images WHERE group_id = ?1 AND id != ?1", -1, &stmt3, NULL);
+        sqlite3_stmt *stmt3 = dt_database_prepare_cached
+          (darktable.db, "SELECT id FROM main.images WHERE group_id = ?1 AND id != ?1");
         DT_DEBUG_SQLITE3_BIND_INT(stmt3, 1, other_id);
         while(sqlite3_step(stmt3) == SQLITE_ROW)
         {
@@ -1993,7 +2021,7 @@ static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
           dt_image_cache_write_release_info(group_img, DT_IMAGE_CACHE_SAFE, "_image_import_internal");
         }
         group_id = id;
-        sqlite3_finalize(stmt3);
+        dt_database_release_cached(darktable.db, stmt3);
       }
       else
       {
@@ -2007,17 +2035,16 @@ static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
     {
       group_id = id;
     }
-    sqlite3_finalize(stmt2);
+    dt_database_release_cached(darktable.db, stmt2);
   }
   else
   {
-    sqlite3_stmt *stmt2;
     // clang-format off
-    DT_DEBUG_SQLITE3_PREPARE_V2
-      (dt_database_get(darktable.db),
+    sqlite3_stmt *stmt2 = dt_database_prepare_cached
+      (darktable.db,
        "SELECT group_id"
        " FROM main.images"
-       " WHERE film_id = ?1 AND filename LIKE ?2 AND id != ?3", -1, &stmt2, NULL);
+       " WHERE film_id = ?1 AND filename LIKE ?2 AND id != ?3");
     // clang-format on
     DT_DEBUG_SQLITE3_BIND_INT(stmt2, 1, film_id);
     DT_DEBUG_SQLITE3_BIND_TEXT(stmt2, 2, sql_pattern, -1, SQLITE_TRANSIENT);
@@ -2026,16 +2053,16 @@ static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
       group_id = sqlite3_column_int(stmt2, 0);
     else
       group_id = id;
-    sqlite3_finalize(stmt2);
+    dt_database_release_cached(darktable.db, stmt2);
   }
-  DT_DEBUG_SQLITE3_PREPARE_V2
-    (dt_database_get(darktable.db),
-     "UPDATE main.images SET group_id = ?1 WHERE id = ?2",
-     -1, &stmt, NULL);
+  stmt = dt_database_prepare_cached
+    (darktable.db, "UPDATE main.images SET group_id = ?1 WHERE id = ?2");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, group_id);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, id);
   sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+  dt_database_release_cached(darktable.db, stmt);
+
+  dt_database_release_transaction(darktable.db);
 
   // printf("[image_import] importing `%s' to img id %d\n", imgfname, id);
 
@@ -2090,26 +2117,12 @@ static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
   g_free(sql_pattern);
   g_free(normalized_filename);
 
-#ifdef USE_LUA
-  //Synchronous calling of lua post-import-image events
-  if(lua_locking)
-    dt_lua_lock();
-
-  lua_State *L = darktable.lua_state.state;
-
-  luaA_push(L, dt_lua_image_t, &id);
-  dt_lua_event_trigger(L, "post-import-image", 1);
-
-  if(lua_locking)
-    dt_lua_unlock();
-#endif
-
-  if(raise_signals)
-  {
-    DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_IMAGE_IMPORT, id);
-    GList *imgs = g_list_prepend(NULL, GINT_TO_POINTER(id));
-    DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_GEOTAG_CHANGED, imgs, 0);
-  }
+  // within a batch the caller's transaction is still open, the lua
+  // event runs once it has been committed
+  if(batch)
+    *batch = g_list_prepend(*batch, GINT_TO_POINTER(id));
+  else
+    _image_import_notify(id, lua_locking, raise_signals);
 
   // the following line would look logical with new_tags_set being the
   // return value from dt_tag_new above, but this could lead to too
@@ -2150,16 +2163,13 @@ dt_imgid_t dt_image_get_id(const dt_filmid_t film_id,
                            const gchar *filename)
 {
   dt_imgid_t id = NO_IMGID;
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2
-    (dt_database_get(darktable.db),
-     "SELECT id FROM main.images WHERE film_id = ?1 AND filename = ?2",
-     -1, &stmt, NULL);
+  sqlite3_stmt *stmt = dt_database_prepare_cached
+    (darktable.db, "SELECT id FROM main.images WHERE film_id = ?1 AND filename = ?2");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, film_id);
   DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, filename, -1, SQLITE_TRANSIENT);
   if(sqlite3_step(stmt) == SQLITE_ROW)
     id=sqlite3_column_int(stmt, 0);
-  sqlite3_finalize(stmt);
+  dt_database_release_cached(darktable.db, stmt);
   return id;
 }
 
@@ -2169,14 +2179,30 @@ dt_imgid_t dt_image_import(const dt_filmid_t film_id,
                            const gboolean raise_signals)
 {
   return _image_import_internal(film_id, filename, override_ignore_nonraws,
-                                TRUE, raise_signals);
+                                TRUE, raise_signals, NULL);
+}
+
+dt_imgid_t dt_image_import_batched(const dt_filmid_t film_id,
+                                   const char *filename,
+                                   GList **batch)
+{
+  return _image_import_internal(film_id, filename, FALSE, TRUE, FALSE, batch);
+}
+
+void dt_image_import_batch_notify(GList **batch)
+{
+  // the images have been prepended, notify them in import order
+  for(GList *l = g_list_last(*batch); l; l = g_list_previous(l))
+    _image_import_notify(GPOINTER_TO_INT(l->data), TRUE, FALSE);
+  g_list_free(*batch);
+  *batch = NULL;
 }
 
 dt_imgid_t dt_image_import_lua(const dt_filmid_t film_id,
                                const char *filename,
                                const gboolean override_ignore_nonraws)
 {
-  return _image_import_internal(film_id, filename, override_ignore_nonraws, FALSE, TRUE);
+  return _image_import_internal(film_id, filename, override_ignore_nonraws, FALSE, TRUE, NULL);
 }
 
 void dt_image_init(dt_image_t *img)
@@ -468,6 +468,15 @@ dt_imgid_t dt_image_import(dt_filmid_t film_id,
                            const char *filename,
                            const gboolean override_ignore_nonraws,
                            const gboolean raise_signals);
+/** imports a new image like dt_image_import() as part of a batch written
+ * in the caller's transaction, without raising signals. new images are
+ * added to batch, the lua event is raised by dt_image_import_batch_notify()
+ * once the transaction has been committed. */
+dt_imgid_t dt_image_import_batched(const dt_filmid_t film_id,
+                                   const char *filename,
+                                   GList **batch);
+/** raises the lua event of the images of a committed batch and empties it */
+void dt_image_import_batch_notify(GList **batch);
 /** imports a new image from raw/etc file and adds it to the data base
  * and image cache. Use from lua thread.*/
 dt_imgid_t dt_image_import_lua(const dt_filmid_t film_id,
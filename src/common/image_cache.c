@@ -234,9 +234,9 @@ void dt_image_cache_cleanup()
   if(!cache) return;
   dt_print(DT_DEBUG_CACHE,
            "[image cache cleaup report] fill %.2f/%.2f MB (%.2f%%)",
-           cache->cache.cost / (1024.0 * 1024.0),
+           dt_cache_get_cost(&cache->cache) / (1024.0 * 1024.0),
            cache->cache.cost_quota / (1024.0 * 1024.0),
-           (float)cache->cache.cost / (float)cache->cache.cost_quota);
+           (float)dt_cache_get_cost(&cache->cache) / (float)cache->cache.cost_quota);
   dt_cache_cleanup(&cache->cache);
   free(cache);
   darktable.image_cache = NULL;
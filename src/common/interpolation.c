@@ -976,6 +976,145 @@ static gboolean _prepare_resampling_plan(const dt_interpolation_t *itor,
   return FALSE;
 }
 
+/* --------------------------------------------------------------------------
+ * Resampling plans depend on the interpolator, the sizes and the shift only,
+ * so they are kept for the next image. Thumbnails and exports mostly reuse
+ * a small number of sizes.
+ * ------------------------------------------------------------------------*/
+
+#define DT_INTERPOLATION_PLANS 16
+
+typedef struct dt_interpolation_plan_t
+{
+  enum dt_interpolation_type id;
+  int in;
+  int out;
+  int shift;
+  float scale;
+  int *length;
+  float *kernel;
+  int *index;
+  int *meta;
+  int maxlength;
+  int users;
+  gboolean cached;
+  uint64_t used;
+} dt_interpolation_plan_t;
+
+static GMutex _plans_lock;
+static dt_interpolation_plan_t *_plans[DT_INTERPOLATION_PLANS];
+static uint64_t _plans_used;
+
+static void _plan_free(dt_interpolation_plan_t *plan)
+{
+  dt_free_align(plan->length);
+  g_free(plan);
+}
+
+static dt_interpolation_plan_t *_plan_get(const dt_interpolation_t *itor,
+                                          const int in,
+                                          const int out,
+                                          const int shift,
+                                          const float scale)
+{
+  g_mutex_lock(&_plans_lock);
+  for(int k = 0; k < DT_INTERPOLATION_PLANS; k++)
+  {
+    dt_interpolation_plan_t *plan = _plans[k];
+    if(plan && plan->id == itor->id && plan->in == in && plan->out == out
+       && plan->shift == shift && plan->scale == scale)
+    {
+      plan->users++;
+      plan->used = ++_plans_used;
+      g_mutex_unlock(&_plans_lock);
+      return plan;
+    }
+  }
+  g_mutex_unlock(&_plans_lock);
+
+  dt_interpolation_plan_t *plan = g_new0(dt_interpolation_plan_t, 1);
+  plan->id = itor->id;
+  plan->in = in;
+  plan->out = out;
+  plan->shift = shift;
+  plan->scale = scale;
+  plan->users = 1;
+  if(_prepare_resampling_plan(itor, in, out, shift, scale,
+                              &plan->length, &plan->kernel, &plan->index, &plan->meta)
+     || !plan->length)
+  {
+    g_free(plan);
+    return NULL;
+  }
+  for(int k = 0; k < out; k++)
+    plan->maxlength = MAX(plan->maxlength, plan->length[k]);
+
+  // replace the least recently used plan nobody works with
+  g_mutex_lock(&_plans_lock);
+  int slot = -1;
+  for(int k = 0; k < DT_INTERPOLATION_PLANS; k++)
+  {
+    if(!_plans[k])
+    {
+      slot = k;
+      break;
+    }
+    if(_plans[k]->users == 0 && (slot < 0 || _plans[k]->used < _plans[slot]->used))
+      slot = k;
+  }
+  if(slot >= 0)
+  {
+    if(_plans[slot]) _plan_free(_plans[slot]);
+    _plans[slot] = plan;
+    plan->cached = TRUE;
+    plan->used = ++_plans_used;
+  }
+  g_mutex_unlock(&_plans_lock);
+  return plan;
+}
+
+static void _plan_release(dt_interpolation_plan_t *plan)
+{
+  if(!plan) return;
+  g_mutex_lock(&_plans_lock);
+  plan->users--;
+  const gboolean cached = plan->cached;
+  g_mutex_unlock(&_plans_lock);
+  if(!cached) _plan_free(plan);
+}
+
+void dt_interpolation_cleanup(void)
+{
+  g_mutex_lock(&_plans_lock);
+  for(int k = 0; k < DT_INTERPOLATION_PLANS; k++)
+  {
+    if(_plans[k]) _plan_free(_plans[k]);
+    _plans[k] = NULL;
+  }
+  g_mutex_unlock(&_plans_lock);
+}
+
+// first and last input line needed for output lines [oy_first, oy_last)
+static void _band_lines(const dt_interpolation_plan_t *vplan,
+                        const int oy_first,
+                        const int oy_last,
+                        int *first,
+                        int *last)
+{
+  *first = INT_MAX;
+  *last = 0;
+  for(int oy = oy_first; oy < oy_last; oy++)
+  {
+    const int *const vindex = vplan->index + vplan->meta[3 * oy + 2];
+    for(int iy = 0; iy < vplan->length[oy]; iy++)
+    {
+      *first = MIN(*first, vindex[iy]);
+      *last = MAX(*last, vindex[iy]);
+    }
+  }
+  if(*first > *last) *first = *last;
+}
+
 /** Applies resampling (re-scaling) on *full* input and output buffers.
  *  roi_in and roi_out define the part of the buffers that is affected.
  */
@@ -991,13 +1130,8 @@ void dt_interpolation_resample(const dt_interpolation_t *itor,
     return;
   }
 
-  int *hindex = NULL;
-  int *hlength = NULL;
-  float *hkernel = NULL;
-  int *vindex = NULL;
-  int *vlength = NULL;
-  float *vkernel = NULL;
-  int *vmeta = NULL;
+  dt_interpolation_plan_t *hplan = NULL;
+  dt_interpolation_plan_t *vplan = NULL;
 
   const size_t in_stride_floats = roi_in->width * 4;
   const size_t out_stride_floats = roi_out->width * 4;
@@ -1045,88 +1179,105 @@ void dt_interpolation_resample(const dt_interpolation_t *itor,
 
   // Generic non 1:1 case... much more complicated :D
 
-  // Prepare resampling plans once and for all
-  if(_prepare_resampling_plan(itor, roi_in->width, roi_out->width, dx, roi_out->scale,
-                              &hlength, &hkernel, &hindex, NULL))
-    goto exit;
-
-  if(_prepare_resampling_plan(itor, roi_in->height, roi_out->height, dy, roi_out->scale,
-                              &vlength, &vkernel, &vindex, &vmeta))
+  // Resampling plans, most likely from the previous image
+  hplan = _plan_get(itor, roi_in->width, roi_out->width, dx, roi_out->scale);
+  vplan = _plan_get(itor, roi_in->height, roi_out->height, dy, roi_out->scale);
+  if(!hplan || !vplan)
     goto exit;
 
   dt_get_perf_times(&mid);
 
-  // Process each output line
-  DT_OMP_FOR()
-  for(size_t oy = 0; oy < (size_t)roi_out->height; oy++)
+  /* The filter is separable, so the output is processed in bands of lines:
+     the input lines a band needs are filtered horizontally first, then
+     vertically. Each input pixel is thus visited for every output column
+     only instead of every output pixel. A band should be large compared to
+     the lines shared with its neighbours, but there should be enough of them
+     to keep all threads busy.
+  */
+  const int out_width = roi_out->width;
+  const int out_height = roi_out->height;
+  const int vmax = vplan->maxlength;
+  const int band = MAX(4, MIN((int)ceilf(8.0f * vmax * MIN(1.0f, roi_out->scale)),
+                              out_height / (2 * (int)dt_get_num_threads())));
+  const int bands = (out_height + band - 1) / band;
+
+  // we need the number of input lines of the largest band for the scratch buffers
+  int maxlines = 0;
+  for(int b = 0; b < bands; b++)
   {
-    // Initialize column resampling indexes
-    int vlidx = vmeta[3 * oy + 0]; // V(ertical) L(ength) I(n)d(e)x
-    int vkidx = vmeta[3 * oy + 1]; // V(ertical) K(ernel) I(n)d(e)x
-    int viidx = vmeta[3 * oy + 2]; // V(ertical) I(ndex) I(n)d(e)x
-
-    // Initialize row resampling indexes
-    int hlidx = 0; // H(orizontal) L(ength) I(n)d(e)x
-    int hkidx = 0; // H(orizontal) K(ernel) I(n)d(e)x
+    int first, last;
+    _band_lines(vplan, b * band, MIN((b + 1) * band, out_height), &first, &last);
+    maxlines = MAX(maxlines, last - first + 1);
+  }
 
-    // Number of lines contributing to the output line
-    const int vl = vlength[vlidx++]; // V(ertical) L(ength)
+  size_t padded;
+  float *const scratch = dt_alloc_perthread_float(out_stride_floats * maxlines, &padded);
+  if(!scratch)
+    goto exit;
 
-    // Process each output column
-    for(size_t ox = 0; ox < (size_t)roi_out->width; ox++)
+  DT_OMP_FOR()
+  for(int b = 0; b < bands; b++)
+  {
+    float *const restrict hbuf = dt_get_perthread(scratch, padded);
+    const int oy_first = b * band;
+    const int oy_last = MIN(oy_first + band, out_height);
+    int first, last;
+    _band_lines(vplan, oy_first, oy_last, &first, &last);
+
+    // Horizontal pass on the input lines of this band
+    for(int iy = first; iy <= last; iy++)
     {
-      // This will hold the resulting pixel
-      dt_aligned_pixel_t vs = { 0.0f, 0.0f, 0.0f, 0.0f };
-
-      // Number of horizontal samples contributing to the output
-      const int hl = hlength[hlidx++]; // H(orizontal) L(ength)
-
-      for(size_t iy = 0; iy < vl; iy++)
+      const float *const irow = in + (size_t)iy * in_stride_floats;
+      float *const hrow = hbuf + (size_t)(iy - first) * out_stride_floats;
+      int hkidx = 0; // H(orizontal) K(ernel) I(n)d(e)x
+      for(int ox = 0; ox < out_width; ox++)
       {
-        // This is our input line
-        const size_t baseidx_vindex = (size_t)vindex[viidx++] * in_stride_floats;
-
+        // Number of horizontal samples contributing to the output
+        const int hl = hplan->length[ox];
         dt_aligned_pixel_t vhs = { 0.0f, 0.0f, 0.0f, 0.0f };
-
-        for(size_t ix = 0; ix < hl; ix++)
+        for(int ix = 0; ix < hl; ix++, hkidx++)
         {
           // Apply the precomputed filter kernel
-          const size_t baseidx = baseidx_vindex + (size_t)hindex[hkidx] * 4;
-          const float htap = hkernel[hkidx++];
+          const float htap = hplan->kernel[hkidx];
           dt_aligned_pixel_t tmp;
-          copy_pixel(tmp, in + baseidx);
+          copy_pixel(tmp, irow + (size_t)hplan->index[hkidx] * 4);
           for_each_channel(c, aligned(tmp,vhs:16))
             vhs[c] += tmp[c] * htap;
         }
-
-        // Accumulate contribution from this line
-        const float vtap = vkernel[vkidx++];
-        for_each_channel(c, aligned(vhs,vs:16)) vs[c] += vhs[c] * vtap;
-
-        // Reset horizontal resampling context
-        hkidx -= hl;
+        copy_pixel(hrow + (size_t)ox * 4, vhs);
       }
+    }
 
-      // Output pixel is ready
-      const size_t baseidx = (size_t)oy * out_stride_floats + (size_t)ox * 4;
-      copy_pixel_nontemporal(out + baseidx, vs);
-
-      // Reset vertical resampling context
-      viidx -= vl;
-      vkidx -= vl;
-
-      // Progress in horizontal context
-      hkidx += hl;
+    // Vertical pass from the horizontally filtered lines
+    for(int oy = oy_first; oy < oy_last; oy++)
+    {
+      // Number of lines contributing to the output line
+      const int vl = vplan->length[oy];
+      const float *const vkernel = vplan->kernel + vplan->meta[3 * oy + 1];
+      const int *const vindex = vplan->index + vplan->meta[3 * oy + 2];
+      float *const orow = out + (size_t)oy * out_stride_floats;
+      for(int ox = 0; ox < out_width; ox++)
+      {
+        // This will hold the resulting pixel
+        dt_aligned_pixel_t vs = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for(int iy = 0; iy < vl; iy++)
+        {
+          const float *const hs = hbuf + (size_t)(vindex[iy] - first) * out_stride_floats + (size_t)ox * 4;
+          const float vtap = vkernel[iy];
+          for_each_channel(c, aligned(vs:16))
+            vs[c] += hs[c] * vtap;
+        }
+        // Output pixel is ready
+        copy_pixel_nontemporal(orow + (size_t)ox * 4, vs);
+      }
     }
   }
   dt_omploop_sfence();
+  dt_free_align(scratch);
 
 exit:
-  /* Free the resampling plans. It's nasty to optimize allocs like that, but
-   * it simplifies the code :-D. The length array is in fact the only memory
-   * allocated. */
-  dt_free_align(hlength);
-  dt_free_align(vlength);
+  _plan_release(hplan);
+  _plan_release(vplan);
   _show_2_times(&start, &mid, "resample_plain");
 }
 
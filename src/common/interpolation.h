@@ -187,6 +187,9 @@ void dt_interpolation_resample_roi_mask(const dt_interpolation_t *itor,
                                       float *out, const dt_iop_roi_t *const roi_out,
                                       const float *const in, const dt_iop_roi_t *const roi_in);
 
+/** Free the resampling plans kept for the next images, at shutdown */
+void dt_interpolation_cleanup(void);
+
 G_END_DECLS
 
 // clang-format off
@@ -377,7 +377,9 @@ void local_laplacian_internal(
     const float shadows,        // user param: lift shadows
     const float highlights,     // user param: compress highlights
     const float clarity,        // user param: increase clarity/local contrast
-    local_laplacian_boundary_t *b)
+    local_laplacian_boundary_t *b,
+    local_laplacian_cache_t *c,
+    const dt_hash_t hash)
 {
   if(wd <= 1 || ht <= 1) return;
 
@@ -389,14 +391,35 @@ void local_laplacian_internal(
   const int max_supp = 1<<last_level;
   int w, h;
   float *padded[max_levels] = {0};
-  if(b && b->mode == 2)
-    padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h, b);
+  float *output[max_levels] = {0};
+
+  // the padding of the preview pass depends on more than the input, and the
+  // padded input is passed out for the full pass.
+  const gboolean use_cache = c && (!b || b->mode == 0);
+  const gboolean cached = use_cache && c->hash != DT_INVALID_HASH && c->hash == hash
+                          && c->wd == wd && c->ht == ht && c->last_level == last_level;
+  if(cached)
+  {
+    // take over the input pyramid, it is handed back to the cache below
+    w = c->pwd;
+    h = c->pht;
+    for(int l=0;l<=last_level;l++)
+      padded[l] = c->padded[l];
+    output[last_level] = c->coarse;
+    memset(c, 0, sizeof(*c));
+  }
   else
-    padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h, 0);
+  {
+    if(use_cache) local_laplacian_cache_free(c);
+    if(b && b->mode == 2)
+      padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h, b);
+    else
+      padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h, 0);
+  }
 
   // allocate pyramid pointers for padded input
   gboolean success = padded[0] != NULL;
-  for(int l=1;l<=last_level;l++)
+  for(int l=1;l<=last_level && !cached;l++)
   {
     padded[l] = dt_alloc_align_float((size_t)dl(w,l) * dl(h,l));
     if(!padded[l])
@@ -407,9 +430,9 @@ void local_laplacian_internal(
   }
 
   // allocate pyramid pointers for output
-  float *output[max_levels] = {0};
-  for(int l=0;l<=last_level;l++)
+  for(int l=0;l<=last_level && success;l++)
   {
+    if(output[l]) continue;
     output[l] = dt_alloc_align_float((size_t)dl(w,l) * dl(h,l));
     if(!output[l])
     {
@@ -436,9 +459,12 @@ void local_laplacian_internal(
   }
 
   // create gauss pyramid of padded input, write coarse directly to output
-  for(int l=1;l<last_level;l++)
-    gauss_reduce(padded[l-1], padded[l], dl(w,l-1), dl(h,l-1));
-  gauss_reduce(padded[last_level-1], output[last_level], dl(w,last_level-1), dl(h,last_level-1));
+  if(!cached)
+  {
+    for(int l=1;l<last_level;l++)
+      gauss_reduce(padded[l-1], padded[l], dl(w,l-1), dl(h,l-1));
+    gauss_reduce(padded[last_level-1], output[last_level], dl(w,last_level-1), dl(h,last_level-1));
+  }
 
   // evenly sample brightness [0,1]:
   float gamma[num_gamma] = {0.0f};
@@ -575,6 +601,22 @@ void local_laplacian_internal(
     b->num_levels = num_levels;
     for(int l=0;l<num_levels;l++) b->output[l] = output[l];
   }
+  else if(use_cache)
+  { // keep the input pyramid for the next run, only the curve dependent pyramids need recomputing
+    c->hash = hash;
+    c->wd = wd;
+    c->ht = ht;
+    c->pwd = w;
+    c->pht = h;
+    c->last_level = last_level;
+    for(int l=0;l<=last_level;l++)
+    {
+      c->padded[l] = padded[l];
+      padded[l] = NULL;
+    }
+    c->coarse = output[last_level];
+    output[last_level] = NULL;
+  }
   // free all buffers except the ones passed out for preview rendering
 cleanup:
   for(int l=0;l<max_levels;l++)
@@ -45,6 +45,30 @@ void local_laplacian_boundary_free(
   memset(b, 0, sizeof(*b));
 }
 
+// input pyramid of the last run, kept by the caller so that it isn't rebuilt
+// if only the curve parameters change. it is identified by a hash of the
+// input buffer provided by the caller, typically the pixelpipe cache hash.
+typedef struct local_laplacian_cache_t
+{
+  dt_hash_t hash;          // DT_INVALID_HASH if empty
+  int wd;                  // input width
+  int ht;                  // input height
+  int pwd;                 // padded width
+  int pht;                 // padded height
+  int last_level;          // coarsest level of the pyramid
+  float *padded[30];       // gaussian pyramid of the padded input (allocated via dt_alloc_align)
+  float *coarse;           // coarsest level of the input pyramid as used for the output
+}
+local_laplacian_cache_t;
+
+void local_laplacian_cache_free(
+    local_laplacian_cache_t *c)
+{
+  for(int l=0;l<=c->last_level;l++) dt_free_align(c->padded[l]);
+  dt_free_align(c->coarse);
+  memset(c, 0, sizeof(*c));
+}
+
 void local_laplacian_internal(
     const float *const input,   // input buffer in some Labx or yuvx format
     float *const out,           // output buffer with colour
@@ -55,7 +79,10 @@ void local_laplacian_internal(
     const float highlights,     // user param: compress highlights
     const float clarity,        // user param: increase clarity/local contrast
     // the following is just needed for clipped roi with boundary conditions from coarse buffer (can be 0)
-    local_laplacian_boundary_t *b);
+    local_laplacian_boundary_t *b,
+    // reuse the input pyramid if the hash of the input is unchanged (can be 0)
+    local_laplacian_cache_t *c,
+    const dt_hash_t hash);
 
 void local_laplacian(
     const float *const input,   // input buffer in some Labx or yuvx format
@@ -66,9 +93,11 @@ void local_laplacian(
     const float shadows,        // user param: lift shadows
     const float highlights,     // user param: compress highlights
     const float clarity,        // user param: increase clarity/local contrast
-    local_laplacian_boundary_t *b) // can be 0
+    local_laplacian_boundary_t *b, // can be 0
+    local_laplacian_cache_t *c,    // can be 0
+    const dt_hash_t hash)          // of the input buffer if c is given
 {
-  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, b);
+  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, b, c, hash);
 }
 
 size_t local_laplacian_memory_use(const int width,      // width of input image
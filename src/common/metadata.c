@@ -369,9 +369,8 @@ GList *dt_metadata_get_list_id(const dt_imgid_t imgid)
   if(!dt_is_valid_imgid(imgid))
     return NULL;
 
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT key, value FROM main.meta_data WHERE id=?1", -1, &stmt, NULL);
+  sqlite3_stmt *stmt = dt_database_prepare_cached
+    (darktable.db, "SELECT key, value FROM main.meta_data WHERE id=?1");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   while(sqlite3_step(stmt) == SQLITE_ROW)
   {
@@ -381,7 +380,7 @@ GList *dt_metadata_get_list_id(const dt_imgid_t imgid)
     metadata = g_list_append(metadata, (gpointer)ckey);
     metadata = g_list_append(metadata, (gpointer)cvalue);
   }
-  sqlite3_finalize(stmt);
+  dt_database_release_cached(darktable.db, stmt);
   return metadata;
 }
 
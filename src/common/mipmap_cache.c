@@ -23,6 +23,8 @@
 #include "common/file_location.h"
 #include "common/grealpath.h"
 #include "common/image_cache.h"
+#include "common/mipmap_pack.h"
+#include "common/utility.h"
 #include "control/conf.h"
 #include "control/jobs.h"
 #include "develop/imageop_math.h"
@@ -182,6 +184,7 @@ typedef struct dt_mipmap_buffer_dsc_t
   size_t size;
   dt_mipmap_buffer_dsc_flags flags;
   dt_colorspaces_color_profile_type_t color_space;
+  dt_hash_t history_hash; // history the thumbnail was developed from, 0 if unknown
 
 #if __has_feature(address_sanitizer) || defined(__SANITIZE_ADDRESS__)
   // do not touch!
@@ -462,6 +465,81 @@ void *dt_mipmap_cache_alloc(dt_mipmap_buffer_t *buf,
 }
 
 // callback for the cache backend to initialize payload pointers
+// the pack of a thumbnail size if the disk backend is set to store packs,
+// NULL for jpeg files
+static dt_mipmap_pack_t *_get_pack(dt_mipmap_cache_t *cache,
+                                   const dt_mipmap_size_t mip)
+{
+  if(!cache->cachedir[0] || mip > DT_MIPMAP_LDR_MAX
+     || !strcmp(dt_conf_get_string_const("cache_disk_backend_format"), "jpeg"))
+    return NULL;
+
+  dt_pthread_mutex_lock(&cache->pack_lock);
+  if(!cache->pack[mip])
+  {
+    char name[PATH_MAX] = { 0 };
+    snprintf(name, sizeof(name), "%s.d", cache->cachedir);
+    if(!g_mkdir_with_parents(name, 0750))
+    {
+      snprintf(name, sizeof(name), "%s.d/%d", cache->cachedir, (int)mip);
+      cache->pack[mip] = dt_mipmap_pack_open(name);
+    }
+  }
+  dt_pthread_mutex_unlock(&cache->pack_lock);
+  return cache->pack[mip];
+}
+
+// packed thumbnails are only valid for the history they were developed from,
+// the workers read it through a read-only connection to not wait for the writer
+static dt_hash_t _history_hash(const dt_imgid_t imgid)
+{
+  dt_hash_t h = DT_INITHASH;
+  sqlite3 *db = dt_database_get_readonly(darktable.db);
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "SELECT current_hash FROM main.history_hash WHERE imgid = ?1",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  if(sqlite3_step(stmt) == SQLITE_ROW)
+    h = dt_hash(DT_INITHASH, sqlite3_column_blob(stmt, 0), sqlite3_column_bytes(stmt, 0));
+  sqlite3_finalize(stmt);
+  dt_database_release_readonly(darktable.db, db);
+  return h;
+}
+
+// read the thumbnail from the disk pack if it has been developed from the
+// current history, which is kept in dsc for writing the pack on eviction.
+// this queries the database so it must not be called from the cache
+// callbacks, which run with the shard locked.
+static gboolean _pack_read(dt_mipmap_cache_t *cache,
+                           dt_mipmap_buffer_dsc_t *dsc,
+                           dt_colorspaces_color_profile_type_t *color_space,
+                           const dt_imgid_t imgid,
+                           const dt_mipmap_size_t mip)
+{
+  if(!cache->cachedir[0]
+     || !((dt_conf_get_bool("cache_disk_backend") && mip < DT_MIPMAP_LDR_MAX)
+          || (dt_conf_get_bool("cache_disk_backend_full") && mip == DT_MIPMAP_LDR_MAX)))
+    return FALSE;
+
+  dt_mipmap_pack_t *pack = _get_pack(cache, mip);
+  if(!pack)
+    return FALSE;
+
+  dsc->history_hash = _history_hash(imgid);
+  int cs = DT_COLORSPACE_NONE;
+  if(!dt_mipmap_pack_read(pack, imgid, dsc->history_hash,
+                          (uint8_t *)(dsc + 1), dsc->size - sizeof(*dsc),
+                          &dsc->width, &dsc->height, &cs))
+    return FALSE;
+
+  dt_print(DT_DEBUG_CACHE,
+           "[mipmap_cache] grab mip %d for ID=%d from disk pack", mip, imgid);
+  dsc->iscale = 1.0f;
+  *color_space = cs;
+  return TRUE;
+}
+
 static void _mipmap_cache_allocate_dynamic(void *data,
                                            dt_cache_entry_t *entry)
 {
@@ -521,6 +599,7 @@ static void _mipmap_cache_allocate_dynamic(void *data,
   }
 
   assert(dsc->size >= sizeof(*dsc));
+  dsc->history_hash = 0;
 
   int loaded_from_disk = 0;
   if(mip <= DT_MIPMAP_LDR_MAX)
@@ -529,12 +608,15 @@ static void _mipmap_cache_allocate_dynamic(void *data,
        && ((dt_conf_get_bool("cache_disk_backend") && mip < DT_MIPMAP_LDR_MAX)
            || (dt_conf_get_bool("cache_disk_backend_full") && mip == DT_MIPMAP_LDR_MAX)))
     {
+      // packed thumbnails are looked up once the entry is set up, see _pack_read()
+      dt_mipmap_pack_t *pack = _get_pack(cache, mip);
+      const dt_imgid_t imgid = _get_imgid(entry->key);
+
       // try and load from disk, if successful set flag
       char filename[PATH_MAX] = {0};
       snprintf(filename, sizeof(filename),
-               "%s.d/%d/%" PRIu32 ".jpg", cache->cachedir, (int)mip,
-               _get_imgid(entry->key));
-      FILE *f = g_fopen(filename, "rb");
+               "%s.d/%d/%" PRIu32 ".jpg", cache->cachedir, (int)mip, imgid);
+      FILE *f = pack ? NULL : g_fopen(filename, "rb");
       if(f)
       {
         uint8_t *blob = 0;
@@ -607,6 +689,9 @@ static void _mipmap_cache_unlink_ondisk_thumbnail(void *data,
     snprintf(filename, sizeof(filename),
              "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, imgid);
     g_unlink(filename);
+
+    dt_mipmap_pack_t *pack = _get_pack(cache, mip);
+    if(pack) dt_mipmap_pack_remove(pack, imgid);
   }
 }
 
@@ -621,15 +706,26 @@ static void _mipmap_cache_deallocate_dynamic(void *data,
     // don't write skulls:
     if(dsc->width > ERR_IMG_MAX_DIM || dsc->height > ERR_IMG_MAX_DIM)
     {
+      const gboolean to_disk = cache->cachedir[0]
+        && ((dt_conf_get_bool("cache_disk_backend")
+             && mip < DT_MIPMAP_LDR_MAX)
+            || (dt_conf_get_bool("cache_disk_backend_full")
+                && mip == DT_MIPMAP_LDR_MAX));
+      dt_mipmap_pack_t *pack = to_disk ? _get_pack(cache, mip) : NULL;
       if(dsc->flags & DT_MIPMAP_BUFFER_DSC_FLAG_INVALIDATE)
       {
         _mipmap_cache_unlink_ondisk_thumbnail(data, _get_imgid(entry->key), mip);
       }
-      else if(cache->cachedir[0]
-              && ((dt_conf_get_bool("cache_disk_backend")
-                   && mip < DT_MIPMAP_LDR_MAX)
-                  || (dt_conf_get_bool("cache_disk_backend_full")
-                      && mip == DT_MIPMAP_LDR_MAX)))
+      else if(pack)
+      {
+        // lossless and only written once per history
+        if(dsc->history_hash)
+          dt_mipmap_pack_write(pack, _get_imgid(entry->key), dsc->history_hash,
+                               (uint8_t *)entry->data + sizeof(*dsc),
+                               dsc->width, dsc->height, dsc->color_space,
+                               !strcmp(dt_conf_get_string_const("cache_disk_backend_format"), "qoi"));
+      }
+      else if(to_disk)
       {
         // serialize to disk
         char filename[PATH_MAX] = {0};
@@ -712,6 +808,7 @@ void dt_mipmap_cache_init()
   darktable.mipmap_cache = cache;
 
   _mipmap_cache_get_filename(cache->cachedir, sizeof(cache->cachedir));
+  dt_pthread_mutex_init(&cache->pack_lock, NULL);
   // make sure static memory is initialized
   dt_mipmap_buffer_dsc_t *dsc = (dt_mipmap_buffer_dsc_t *)_mipmap_cache_static_dead_image;
   _dead_image_f((dt_mipmap_buffer_t *)(dsc + 1));
@@ -808,6 +905,10 @@ void dt_mipmap_cache_cleanup()
   dt_cache_cleanup(&cache->mip_thumbs.cache);
   dt_cache_cleanup(&cache->mip_full.cache);
   dt_cache_cleanup(&cache->mip_f.cache);
+  // after the caches, evicting thumbnails writes to the packs
+  for(int k = 0; k < DT_MIPMAP_F; k++)
+    dt_mipmap_pack_close(cache->pack[k]);
+  dt_pthread_mutex_destroy(&cache->pack_lock);
   darktable.mipmap_cache = NULL;
   free(cache);
 }
@@ -817,16 +918,24 @@ void dt_mipmap_cache_print()
   dt_mipmap_cache_t *cache = darktable.mipmap_cache;
   if(!cache) return;
 
+  const size_t thumbs_cost = dt_cache_get_cost(&cache->mip_thumbs.cache);
+  const size_t f_cost = dt_cache_get_cost(&cache->mip_f.cache);
+  const size_t full_cost = dt_cache_get_cost(&cache->mip_full.cache);
   dt_print(DT_DEBUG_ALWAYS,"[mipmap_cache] thumbs fill %.2f/%.2f MB (%.2f%%)",
-           cache->mip_thumbs.cache.cost / (1024.0 * 1024.0),
+           thumbs_cost / (1024.0 * 1024.0),
            cache->mip_thumbs.cache.cost_quota / (1024.0 * 1024.0),
-           100.0f * (float)cache->mip_thumbs.cache.cost / (float)cache->mip_thumbs.cache.cost_quota);
+           100.0f * (float)thumbs_cost / (float)cache->mip_thumbs.cache.cost_quota);
   dt_print(DT_DEBUG_ALWAYS,"[mipmap_cache] float fill %"PRIu32"/%"PRIu32" slots (%.2f%%)",
-           (uint32_t)cache->mip_f.cache.cost, (uint32_t)cache->mip_f.cache.cost_quota,
-           100.0f * (float)cache->mip_f.cache.cost / (float)cache->mip_f.cache.cost_quota);
+           (uint32_t)f_cost, (uint32_t)cache->mip_f.cache.cost_quota,
+           100.0f * (float)f_cost / (float)cache->mip_f.cache.cost_quota);
   dt_print(DT_DEBUG_ALWAYS,"[mipmap_cache] full  fill %"PRIu32"/%"PRIu32" slots (%.2f%%)",
-           (uint32_t)cache->mip_full.cache.cost, (uint32_t)cache->mip_full.cache.cost_quota,
-           100.0f * (float)cache->mip_full.cache.cost / (float)cache->mip_full.cache.cost_quota);
+           (uint32_t)full_cost, (uint32_t)cache->mip_full.cache.cost_quota,
+           100.0f * (float)full_cost / (float)cache->mip_full.cache.cost_quota);
+  dt_cache_print_stats(&cache->mip_thumbs.cache, "mipmap_cache thumbs");
+  dt_cache_print_stats(&cache->mip_f.cache, "mipmap_cache float");
+  dt_cache_print_stats(&cache->mip_full.cache, "mipmap_cache full");
+  if(darktable.image_cache)
+    dt_cache_print_stats(&darktable.image_cache->cache, "image_cache");
 
   uint64_t sum = 0;
   uint64_t sum_fetches = 0;
@@ -883,6 +992,66 @@ static dt_mipmap_cache_one_t *_get_cache(dt_mipmap_cache_t *cache,
   }
 }
 
+// the size at which thumbnails are developed at least when the pipe has
+// to run, DT_MIPMAP_0 to only cascade from the requested size and
+// DT_MIPMAP_NONE if cascading is disabled
+static dt_mipmap_size_t _cascade_size(void)
+{
+  return dt_mipmap_cache_get_min_mip_from_pref(dt_conf_get_string_const("cache_mipmap_cascade"));
+}
+
+// fill the smaller thumbnail sizes of imgid which aren't cached yet from a
+// freshly generated buffer of size mip. each level is downsampled from the
+// next larger one, as the sizes are at most a factor two apart this keeps
+// the 2x2 average of flip_and_zoom a proper box filter.
+static void _cascade_8(dt_mipmap_cache_t *cache,
+                       const dt_imgid_t imgid,
+                       const dt_mipmap_size_t mip,
+                       const dt_mipmap_buffer_dsc_t *top)
+{
+  const dt_mipmap_buffer_dsc_t *src = top;
+  dt_cache_entry_t *src_entry = NULL;
+  int filled = 0;
+  for(int k = mip - 1; k >= DT_MIPMAP_0; k--)
+  {
+    dt_cache_t *c = &_get_cache(cache, k)->cache;
+    const uint32_t key = _get_key(imgid, k);
+    // stop at the first size which is cached or being generated already,
+    // the ones below have been cascaded from it. we hold larger sizes
+    // for writing while _init_8() may hold a smaller one and wait for a
+    // larger one, so we must never wait for an entry here.
+    dt_cache_entry_t *entry = dt_cache_get_new(c, key);
+    if(!entry) break;
+
+    ASAN_UNPOISON_MEMORY_REGION(entry->data, dt_mipmap_buffer_dsc_size);
+    dt_mipmap_buffer_dsc_t *dsc = (dt_mipmap_buffer_dsc_t *)entry->data;
+    if(dsc->flags & DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE)
+    {
+      ASAN_UNPOISON_MEMORY_REGION(dsc + 1, dsc->size - sizeof(dt_mipmap_buffer_dsc_t));
+      dt_iop_flip_and_zoom_8((const uint8_t *)(src + 1), src->width, src->height,
+                             (uint8_t *)(dsc + 1), cache->max_width[k], cache->max_height[k],
+                             ORIENTATION_NONE, &dsc->width, &dsc->height);
+      dsc->iscale = 1.0f;
+      dsc->color_space = top->color_space;
+      dsc->history_hash = top->history_hash;
+      dsc->flags &= ~DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE;
+      filled++;
+    }
+
+    // keep the level we just wrote locked as source for the next one
+    if(src_entry) dt_cache_release(&_get_cache(cache, k + 1)->cache, src_entry);
+    src_entry = entry;
+    src = dsc;
+  }
+  if(src_entry)
+    dt_cache_release(&_get_cache(cache, _get_size(src_entry->key))->cache, src_entry);
+
+  if(filled)
+    dt_print(DT_DEBUG_CACHE,
+             "[mipmap_cache] cascaded mip %d for ID=%d into %d smaller sizes",
+             mip, imgid, filled);
+}
+
 void dt_mipmap_cache_get_with_caller(dt_mipmap_buffer_t *buf,
                                     const dt_imgid_t imgid,
                                     const dt_mipmap_size_t mip,
@@ -949,11 +1118,8 @@ void dt_mipmap_cache_get_with_caller(dt_mipmap_buffer_t *buf,
     if(!cache->cachedir[0]) return;
     if(mip > DT_MIPMAP_FULL || mip < DT_MIPMAP_0)
       return;
-    char filename[PATH_MAX] = {0};
-    snprintf(filename, sizeof(filename),
-             "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, key);
     // don't attempt to load if disk cache doesn't exist
-    if(!g_file_test(filename, G_FILE_TEST_EXISTS)) return;
+    if(!dt_mipmap_cache_is_on_disk(imgid, mip)) return;
     dt_control_add_job(DT_JOB_QUEUE_SYSTEM_FG, dt_image_load_job_create(imgid, mip));
   }
   else if(flags == DT_MIPMAP_BLOCKING)
@@ -1047,11 +1213,17 @@ void dt_mipmap_cache_get_with_caller(dt_mipmap_buffer_t *buf,
       {
         // 8-bit thumbs
         ASAN_UNPOISON_MEMORY_REGION(dsc + 1, dsc->size - sizeof(dt_mipmap_buffer_dsc_t));
-        _init_8((uint8_t *)(dsc + 1),
-                &dsc->width, &dsc->height, &dsc->iscale, &buf->color_space, imgid, mip);
+        if(!_pack_read(cache, dsc, &buf->color_space, imgid, mip))
+          _init_8((uint8_t *)(dsc + 1),
+                  &dsc->width, &dsc->height, &dsc->iscale, &buf->color_space, imgid, mip);
       }
       dsc->color_space = buf->color_space;
       dsc->flags &= ~DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE;
+
+      if(mip > DT_MIPMAP_0 && mip <= DT_MIPMAP_LDR_MAX
+         && (dsc->width > ERR_IMG_MAX_DIM || dsc->height > ERR_IMG_MAX_DIM)
+         && _cascade_size() != DT_MIPMAP_NONE)
+        _cascade_8(cache, imgid, mip, dsc);
     }
 
     // image cache is leaving the write lock in place in case the
@@ -1199,14 +1371,8 @@ void dt_mipmap_cache_get_with_caller(dt_mipmap_buffer_t *buf,
     __sync_fetch_and_add(&(_get_cache(cache, mip)->stats_misses), 1);
     // in case we don't even have a disk cache for our requested thumbnail,
     // prefetch at least mip0, in case we have that in the disk caches:
-    if(cache->cachedir[0])
-    {
-      char filename[PATH_MAX] = {0};
-      snprintf(filename, sizeof(filename),
-               "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, key);
-      if(g_file_test(filename, G_FILE_TEST_EXISTS))
-        dt_mipmap_cache_get(0, imgid, DT_MIPMAP_0, DT_MIPMAP_PREFETCH_DISK, 0);
-    }
+    if(dt_mipmap_cache_is_on_disk(imgid, mip))
+      dt_mipmap_cache_get(0, imgid, DT_MIPMAP_0, DT_MIPMAP_PREFETCH_DISK, 0);
     // nothing found :(
     buf->buf = NULL;
     buf->imgid = NO_IMGID;
@@ -1629,6 +1795,27 @@ static void _init_8(uint8_t *buf,
     }
   }
 
+  const dt_mipmap_size_t cascade = _cascade_size();
+  if(res && cascade != DT_MIPMAP_NONE && cascade > size && cascade < DT_MIPMAP_LDR_MAX)
+  {
+    // develop at the cascade size instead, it comes with all smaller sizes
+    // (this one is skipped as we hold it) and is read from the disk cache
+    // if it was developed before.
+    dt_mipmap_buffer_t tmp;
+    dt_mipmap_cache_get(&tmp, imgid, cascade, DT_MIPMAP_BLOCKING, 'r');
+    if(tmp.buf && (tmp.width > ERR_IMG_MAX_DIM || tmp.height > ERR_IMG_MAX_DIM))
+    {
+      dt_print(DT_DEBUG_CACHE,
+               "[mipmap_cache] generate mip %d for ID=%d from cascade level %d",
+               size, imgid, cascade);
+      *color_space = tmp.color_space;
+      dt_iop_flip_and_zoom_8(tmp.buf, tmp.width, tmp.height, buf,
+                             wd, ht, ORIENTATION_NONE, width, height);
+      res = FALSE;
+    }
+    dt_mipmap_cache_release(&tmp);
+  }
+
   if(res)
   {
     // try the real thing: rawspeed + pixelpipe
@@ -1676,11 +1863,25 @@ static void _init_8(uint8_t *buf,
   }
 
   // TODO: various speed optimizations:
-  // TODO: also init all smaller mips!
   // TODO: use mipf, but:
   // TODO: if output is cropped, don't use mipf!
 }
 
+gboolean dt_mipmap_cache_is_on_disk(const dt_imgid_t imgid,
+                                    const dt_mipmap_size_t mip)
+{
+  dt_mipmap_cache_t *cache = darktable.mipmap_cache;
+  if(!cache || !cache->cachedir[0] || mip > DT_MIPMAP_LDR_MAX) return FALSE;
+
+  dt_mipmap_pack_t *pack = _get_pack(cache, mip);
+  if(pack) return dt_mipmap_pack_contains(pack, imgid);
+
+  char filename[PATH_MAX] = { 0 };
+  snprintf(filename, sizeof(filename),
+           "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, imgid);
+  return dt_util_test_image_file(filename);
+}
+
 dt_colorspaces_color_profile_type_t dt_mipmap_cache_get_colorspace()
 {
   if(dt_conf_get_bool("cache_color_managed"))
@@ -1701,6 +1902,13 @@ void dt_mipmap_cache_copy_thumbnails(const dt_imgid_t dst_imgid,
   {
     for(dt_mipmap_size_t mip = DT_MIPMAP_0; mip <= DT_MIPMAP_LDR_MAX; mip++)
     {
+      dt_mipmap_pack_t *pack = _get_pack(cache, mip);
+      if(pack)
+      {
+        dt_mipmap_pack_copy(pack, dst_imgid, src_imgid);
+        continue;
+      }
+
       // try and load from disk, if successful set flag
       char srcpath[PATH_MAX] = {0};
       char dstpath[PATH_MAX] = {0};
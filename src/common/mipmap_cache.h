@@ -110,6 +110,9 @@ typedef struct dt_mipmap_cache_t
   dt_mipmap_cache_one_t mip_f;
   dt_mipmap_cache_one_t mip_full;
   char cachedir[PATH_MAX]; // cached sha1sum filename for faster access
+  // packed disk backend per thumbnail size, opened on first use
+  struct dt_mipmap_pack_t *pack[DT_MIPMAP_F];
+  dt_pthread_mutex_t pack_lock;
 } dt_mipmap_cache_t;
 
 // dynamic memory allocation interface for imageio backend: a write locked
@@ -157,8 +160,11 @@ dt_mipmap_size_t dt_mipmap_cache_get_matching_size(const int32_t width, const in
 // returns the colorspace to use for created thumbnails, takes config into account
 dt_colorspaces_color_profile_type_t dt_mipmap_cache_get_colorspace(void);
 
+// TRUE if the disk backend holds a thumbnail of the image at this size
+gboolean dt_mipmap_cache_is_on_disk(const dt_imgid_t imgid, const dt_mipmap_size_t mip);
+
 // copy over thumbnails. used by file operation that copies raw files, to speed up thumbnail generation.
-// only copies over the jpg backend on disk, doesn't directly affect the in-memory cache.
+// only copies over the disk backend, doesn't directly affect the in-memory cache.
 void dt_mipmap_cache_copy_thumbnails(const dt_imgid_t dst_imgid, const dt_imgid_t src_imgid);
 
 // return the mipmap corresponding to text value saved in prefs
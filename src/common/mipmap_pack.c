@@ -0,0 +1,458 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/mipmap_pack.h"
+#include "common/debug.h"
+
+// the implementation lives in imageio_qoi.c
+#define QOI_NO_STDIO
+#include "imageio/qoi.h"
+
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+
+#define DT_MIPMAP_PACK_MAGIC "DTMP"
+#define DT_MIPMAP_PACK_VERSION 1
+// don't bother compacting packs with less unused space than this
+#define DT_MIPMAP_PACK_MIN_COMPACT ((uint64_t)64 << 20)
+
+typedef enum dt_mipmap_pack_codec_t
+{
+  DT_MIPMAP_PACK_RAW = 0,
+  DT_MIPMAP_PACK_QOI = 1,
+  DT_MIPMAP_PACK_REMOVED = 255
+} dt_mipmap_pack_codec_t;
+
+typedef struct dt_mipmap_pack_header_t
+{
+  char magic[4];
+  uint32_t version;
+} dt_mipmap_pack_header_t;
+
+// one entry of the index file, also kept in memory per image
+typedef struct dt_mipmap_pack_record_t
+{
+  int32_t imgid;
+  uint32_t width;
+  uint32_t height;
+  uint8_t codec;
+  uint8_t color_space;
+  uint8_t reserved[2];
+  uint64_t hash;
+  uint64_t offset;  // of the pixel data in the pack
+  uint64_t length;
+} dt_mipmap_pack_record_t;
+
+struct dt_mipmap_pack_t
+{
+  gchar *data_filename;
+  gchar *index_filename;
+  FILE *data;              // append handles
+  FILE *index;
+  uint64_t size;           // bytes written to the pack
+  uint64_t unused;         // ... of which no record refers to anymore
+  GMappedFile *map;        // read only view of the first map_size bytes
+  uint64_t map_size;
+  GHashTable *records;     // imgid -> dt_mipmap_pack_record_t
+  dt_pthread_rwlock_t lock;
+};
+
+static const dt_mipmap_pack_header_t _header = { DT_MIPMAP_PACK_MAGIC, DT_MIPMAP_PACK_VERSION };
+
+static gboolean _header_valid(const gchar *content, const gsize length)
+{
+  return length >= sizeof(_header) && !memcmp(content, &_header, sizeof(_header));
+}
+
+static FILE *_create(const char *filename)
+{
+  FILE *f = g_fopen(filename, "wb");
+  if(f && fwrite(&_header, sizeof(_header), 1, f) != 1)
+  {
+    fclose(f);
+    f = NULL;
+  }
+  return f;
+}
+
+// insert or replace the record of an image, keeping track of the space
+// which isn't referenced anymore. copies share their pixel data, so this
+// can overestimate the unused space, which only makes compacting earlier.
+static void _set_record(dt_mipmap_pack_t *pack, const dt_mipmap_pack_record_t *rec)
+{
+  dt_mipmap_pack_record_t *old = g_hash_table_lookup(pack->records, GINT_TO_POINTER(rec->imgid));
+  if(old) pack->unused += old->length;
+
+  if(rec->codec == DT_MIPMAP_PACK_REMOVED)
+    g_hash_table_remove(pack->records, GINT_TO_POINTER(rec->imgid));
+  else
+  {
+    dt_mipmap_pack_record_t *copy = g_new(dt_mipmap_pack_record_t, 1);
+    *copy = *rec;
+    g_hash_table_insert(pack->records, GINT_TO_POINTER(rec->imgid), copy);
+  }
+}
+
+// load the index, dropping records which point behind the end of the pack
+// (an interrupted write)
+static gboolean _load(dt_mipmap_pack_t *pack)
+{
+  GStatBuf st;
+  if(g_stat(pack->data_filename, &st) || st.st_size < (goffset)sizeof(_header)) return FALSE;
+  pack->size = st.st_size;
+
+  gchar *content = NULL;
+  gsize length = 0;
+  if(!g_file_get_contents(pack->index_filename, &content, &length, NULL)) return FALSE;
+  if(!_header_valid(content, length))
+  {
+    g_free(content);
+    return FALSE;
+  }
+
+  FILE *f = g_fopen(pack->data_filename, "rb");
+  char magic[sizeof(_header)] = { 0 };
+  const gboolean data_valid = f && fread(magic, sizeof(magic), 1, f) == 1
+                              && _header_valid(magic, sizeof(magic));
+  if(f) fclose(f);
+  if(!data_valid)
+  {
+    g_free(content);
+    return FALSE;
+  }
+
+  const size_t count = (length - sizeof(_header)) / sizeof(dt_mipmap_pack_record_t);
+  const gsize complete = sizeof(_header) + count * sizeof(dt_mipmap_pack_record_t);
+  // cut off a partially written record, following ones are appended after it
+  if(complete != length && !g_file_set_contents(pack->index_filename, content, complete, NULL))
+  {
+    g_free(content);
+    return FALSE;
+  }
+
+  const dt_mipmap_pack_record_t *rec = (const dt_mipmap_pack_record_t *)(content + sizeof(_header));
+  for(size_t i = 0; i < count; i++)
+  {
+    if(rec[i].codec != DT_MIPMAP_PACK_REMOVED
+       && (rec[i].offset < sizeof(_header) || rec[i].offset + rec[i].length > pack->size))
+      continue;
+    _set_record(pack, &rec[i]);
+  }
+  g_free(content);
+
+  // data appended after the last record is lost too
+  uint64_t referenced = sizeof(_header);
+  GHashTableIter it;
+  gpointer value;
+  g_hash_table_iter_init(&it, pack->records);
+  while(g_hash_table_iter_next(&it, NULL, &value))
+    referenced += ((dt_mipmap_pack_record_t *)value)->length;
+  pack->unused = pack->size > referenced ? pack->size - referenced : 0;
+  return TRUE;
+}
+
+// rewrite the pack with the referenced thumbnails only
+static void _compact(dt_mipmap_pack_t *pack)
+{
+  GMappedFile *map = g_mapped_file_new(pack->data_filename, FALSE, NULL);
+  if(!map) return;
+  const uint8_t *src = (const uint8_t *)g_mapped_file_get_contents(map);
+
+  gchar *data_tmp = g_strconcat(pack->data_filename, ".tmp", NULL);
+  gchar *index_tmp = g_strconcat(pack->index_filename, ".tmp", NULL);
+  FILE *data = _create(data_tmp);
+  FILE *index = _create(index_tmp);
+  gboolean ok = data && index;
+
+  uint64_t offset = sizeof(_header);
+  GHashTableIter it;
+  gpointer value;
+  g_hash_table_iter_init(&it, pack->records);
+  while(ok && g_hash_table_iter_next(&it, NULL, &value))
+  {
+    dt_mipmap_pack_record_t *rec = value;
+    ok = fwrite(src + rec->offset, 1, rec->length, data) == rec->length;
+    rec->offset = offset;
+    offset += rec->length;
+    ok = ok && fwrite(rec, sizeof(*rec), 1, index) == 1;
+  }
+  if(data) ok = !fclose(data) && ok;
+  if(index) ok = !fclose(index) && ok;
+  g_mapped_file_unref(map);
+
+  const gboolean data_renamed = ok && !g_rename(data_tmp, pack->data_filename);
+  if(data_renamed && !g_rename(index_tmp, pack->index_filename))
+  {
+    dt_print(DT_DEBUG_CACHE, "[mipmap_pack] compacted %s from %.1f to %.1f MB",
+             pack->data_filename, pack->size / (1024.0 * 1024.0), offset / (1024.0 * 1024.0));
+    pack->size = offset;
+    pack->unused = 0;
+  }
+  else
+  {
+    // records may point into the new file now, start over from disk. the
+    // old index doesn't fit a replaced pack, which makes _load() fail.
+    g_unlink(data_tmp);
+    g_unlink(index_tmp);
+    if(data_renamed) g_unlink(pack->index_filename);
+    g_hash_table_remove_all(pack->records);
+    if(!_load(pack)) pack->size = 0;
+  }
+  g_free(data_tmp);
+  g_free(index_tmp);
+}
+
+// start with an empty pack
+static gboolean _reset(dt_mipmap_pack_t *pack)
+{
+  g_hash_table_remove_all(pack->records);
+  FILE *data = _create(pack->data_filename);
+  FILE *index = _create(pack->index_filename);
+  const gboolean ok = data && index;
+  if(data) fclose(data);
+  if(index) fclose(index);
+  pack->size = ok ? sizeof(_header) : 0;
+  pack->unused = 0;
+  return ok;
+}
+
+dt_mipmap_pack_t *dt_mipmap_pack_open(const char *name)
+{
+  dt_mipmap_pack_t *pack = g_new0(dt_mipmap_pack_t, 1);
+  pack->data_filename = g_strconcat(name, ".pack", NULL);
+  pack->index_filename = g_strconcat(name, ".index", NULL);
+  pack->records = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+  dt_pthread_rwlock_init(&pack->lock, NULL);
+
+  // missing, of another version or broken packs are started over
+  if(!_load(pack))
+    _reset(pack);
+  else if(pack->unused > DT_MIPMAP_PACK_MIN_COMPACT && pack->unused > pack->size / 2)
+  {
+    _compact(pack);
+    if(pack->size == 0) _reset(pack);
+  }
+
+  pack->data = g_fopen(pack->data_filename, "ab");
+  pack->index = g_fopen(pack->index_filename, "ab");
+  if(!pack->data || !pack->index || pack->size < sizeof(_header))
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[mipmap_pack] can't open %s", pack->data_filename);
+    dt_mipmap_pack_close(pack);
+    return NULL;
+  }
+
+  dt_print(DT_DEBUG_CACHE, "[mipmap_pack] opened %s with %u thumbnails, %.1f MB (%.1f MB unused)",
+           pack->data_filename, g_hash_table_size(pack->records),
+           pack->size / (1024.0 * 1024.0), pack->unused / (1024.0 * 1024.0));
+  return pack;
+}
+
+void dt_mipmap_pack_close(dt_mipmap_pack_t *pack)
+{
+  if(!pack) return;
+  if(pack->data) fclose(pack->data);
+  if(pack->index) fclose(pack->index);
+  if(pack->map) g_mapped_file_unref(pack->map);
+  g_hash_table_destroy(pack->records);
+  dt_pthread_rwlock_destroy(&pack->lock);
+  g_free(pack->data_filename);
+  g_free(pack->index_filename);
+  g_free(pack);
+}
+
+gboolean dt_mipmap_pack_contains(dt_mipmap_pack_t *pack, const dt_imgid_t imgid)
+{
+  dt_pthread_rwlock_rdlock(&pack->lock);
+  const gboolean found = g_hash_table_contains(pack->records, GINT_TO_POINTER(imgid));
+  dt_pthread_rwlock_unlock(&pack->lock);
+  return found;
+}
+
+// map the pack again if it grew past the current mapping, write locked
+static void _remap(dt_mipmap_pack_t *pack, const uint64_t needed)
+{
+  dt_pthread_rwlock_wrlock(&pack->lock);
+  if(pack->map_size < needed)
+  {
+    if(pack->map) g_mapped_file_unref(pack->map);
+    pack->map = g_mapped_file_new(pack->data_filename, FALSE, NULL);
+    pack->map_size = pack->map ? g_mapped_file_get_length(pack->map) : 0;
+  }
+  dt_pthread_rwlock_unlock(&pack->lock);
+}
+
+gboolean dt_mipmap_pack_read(dt_mipmap_pack_t *pack,
+                             const dt_imgid_t imgid,
+                             const dt_hash_t hash,
+                             uint8_t *buf,
+                             const size_t buf_size,
+                             uint32_t *width,
+                             uint32_t *height,
+                             int *color_space)
+{
+  dt_pthread_rwlock_rdlock(&pack->lock);
+  const dt_mipmap_pack_record_t *rec = g_hash_table_lookup(pack->records, GINT_TO_POINTER(imgid));
+  if(rec && rec->offset + rec->length > pack->map_size)
+  {
+    const uint64_t needed = rec->offset + rec->length;
+    dt_pthread_rwlock_unlock(&pack->lock);
+    _remap(pack, needed);
+    dt_pthread_rwlock_rdlock(&pack->lock);
+    rec = g_hash_table_lookup(pack->records, GINT_TO_POINTER(imgid));
+    if(rec && rec->offset + rec->length > pack->map_size) rec = NULL;
+  }
+
+  const size_t bytes = rec ? (size_t)rec->width * rec->height * 4 : 0;
+  gboolean ok = rec && rec->hash == hash && bytes <= buf_size;
+  if(ok)
+  {
+    const uint8_t *data = (const uint8_t *)g_mapped_file_get_contents(pack->map) + rec->offset;
+    if(rec->codec == DT_MIPMAP_PACK_RAW)
+    {
+      ok = rec->length == bytes;
+      if(ok) memcpy(buf, data, bytes);
+    }
+    else
+    {
+      qoi_desc desc;
+      uint8_t *pixels = qoi_decode(data, (int)rec->length, &desc, 4);
+      ok = pixels && desc.width == rec->width && desc.height == rec->height;
+      if(ok) memcpy(buf, pixels, bytes);
+      free(pixels);
+    }
+    if(ok)
+    {
+      *width = rec->width;
+      *height = rec->height;
+      *color_space = rec->color_space;
+    }
+  }
+  dt_pthread_rwlock_unlock(&pack->lock);
+  return ok;
+}
+
+// append a record to the index, the pack lock is write locked
+static gboolean _append_record(dt_mipmap_pack_t *pack, const dt_mipmap_pack_record_t *rec)
+{
+  if(fwrite(rec, sizeof(*rec), 1, pack->index) != 1 || fflush(pack->index))
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[mipmap_pack] failed to write to %s", pack->index_filename);
+    return FALSE;
+  }
+  _set_record(pack, rec);
+  return TRUE;
+}
+
+gboolean dt_mipmap_pack_write(dt_mipmap_pack_t *pack,
+                              const dt_imgid_t imgid,
+                              const dt_hash_t hash,
+                              const uint8_t *buf,
+                              const uint32_t width,
+                              const uint32_t height,
+                              const int color_space,
+                              const gboolean compress)
+{
+  // thumbnails read from the pack come back here when they are evicted
+  dt_pthread_rwlock_rdlock(&pack->lock);
+  const dt_mipmap_pack_record_t *old = g_hash_table_lookup(pack->records, GINT_TO_POINTER(imgid));
+  const gboolean stored = old && old->hash == hash
+                          && old->width == width && old->height == height;
+  dt_pthread_rwlock_unlock(&pack->lock);
+  if(stored) return TRUE;
+
+  dt_mipmap_pack_record_t rec = { 0 };
+  rec.imgid = imgid;
+  rec.width = width;
+  rec.height = height;
+  rec.color_space = color_space;
+  rec.hash = hash;
+
+  const void *data = buf;
+  void *encoded = NULL;
+  rec.codec = DT_MIPMAP_PACK_RAW;
+  rec.length = (uint64_t)width * height * 4;
+  if(compress)
+  {
+    const qoi_desc desc = { .width = width, .height = height, .channels = 4, .colorspace = QOI_SRGB };
+    int length = 0;
+    encoded = qoi_encode(buf, &desc, &length);
+    if(encoded)
+    {
+      data = encoded;
+      rec.codec = DT_MIPMAP_PACK_QOI;
+      rec.length = length;
+    }
+  }
+
+  dt_pthread_rwlock_wrlock(&pack->lock);
+  rec.offset = pack->size;
+  gboolean ok = fwrite(data, 1, rec.length, pack->data) == rec.length && !fflush(pack->data);
+  if(ok)
+  {
+    pack->size += rec.length;
+    ok = _append_record(pack, &rec);
+  }
+  else
+  {
+    // whatever made it into the pack is unused from now on
+    dt_print(DT_DEBUG_ALWAYS, "[mipmap_pack] failed to write to %s", pack->data_filename);
+    const long end = ftell(pack->data);
+    if(end > 0 && (uint64_t)end > rec.offset)
+    {
+      pack->unused += end - rec.offset;
+      pack->size = end;
+    }
+  }
+  dt_pthread_rwlock_unlock(&pack->lock);
+  free(encoded);
+  return ok;
+}
+
+void dt_mipmap_pack_remove(dt_mipmap_pack_t *pack, const dt_imgid_t imgid)
+{
+  dt_pthread_rwlock_wrlock(&pack->lock);
+  if(g_hash_table_contains(pack->records, GINT_TO_POINTER(imgid)))
+  {
+    const dt_mipmap_pack_record_t rec = { .imgid = imgid, .codec = DT_MIPMAP_PACK_REMOVED };
+    _append_record(pack, &rec);
+  }
+  dt_pthread_rwlock_unlock(&pack->lock);
+}
+
+void dt_mipmap_pack_copy(dt_mipmap_pack_t *pack,
+                         const dt_imgid_t dst_imgid,
+                         const dt_imgid_t src_imgid)
+{
+  dt_pthread_rwlock_wrlock(&pack->lock);
+  const dt_mipmap_pack_record_t *src = g_hash_table_lookup(pack->records, GINT_TO_POINTER(src_imgid));
+  if(src)
+  {
+    dt_mipmap_pack_record_t rec = *src;
+    rec.imgid = dst_imgid;
+    _append_record(pack, &rec);
+  }
+  dt_pthread_rwlock_unlock(&pack->lock);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,85 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+
+G_BEGIN_DECLS
+
+/**
+ * packed disk backend for one thumbnail size of the mipmap cache.
+ *
+ * instead of one jpeg file per image, all thumbnails of a size are appended
+ * to a single <name>.pack file, either as raw 8-bit pixels or qoi
+ * compressed, both lossless. a <name>.index file next to it gets a fixed
+ * size record per write or removal, the last record of an image wins. the
+ * pack is memory mapped for reading, so a thumbnail is copied (or decoded)
+ * straight out of the page cache.
+ *
+ * every record carries a hash of the image history it was developed from,
+ * a thumbnail is only handed out if it matches the hash of the caller.
+ * space of replaced or removed thumbnails is reclaimed when opening a pack
+ * with more than half of it unused.
+ */
+
+typedef struct dt_mipmap_pack_t dt_mipmap_pack_t;
+
+/** open or create the pack stored at <name>.pack / <name>.index, NULL on failure */
+dt_mipmap_pack_t *dt_mipmap_pack_open(const char *name);
+void dt_mipmap_pack_close(dt_mipmap_pack_t *pack);
+
+/** TRUE if there is a thumbnail of imgid, whatever history it was developed from */
+gboolean dt_mipmap_pack_contains(dt_mipmap_pack_t *pack, const dt_imgid_t imgid);
+
+/** copy the thumbnail of imgid developed with history hash into buf of
+    buf_size bytes (4 bytes per pixel), returns TRUE on success */
+gboolean dt_mipmap_pack_read(dt_mipmap_pack_t *pack,
+                             const dt_imgid_t imgid,
+                             const dt_hash_t hash,
+                             uint8_t *buf,
+                             const size_t buf_size,
+                             uint32_t *width,
+                             uint32_t *height,
+                             int *color_space);
+
+/** store a thumbnail, nothing is written if the same one is stored already */
+gboolean dt_mipmap_pack_write(dt_mipmap_pack_t *pack,
+                              const dt_imgid_t imgid,
+                              const dt_hash_t hash,
+                              const uint8_t *buf,
+                              const uint32_t width,
+                              const uint32_t height,
+                              const int color_space,
+                              const gboolean compress);
+
+/** forget the thumbnail of imgid */
+void dt_mipmap_pack_remove(dt_mipmap_pack_t *pack, const dt_imgid_t imgid);
+
+/** make the thumbnail of src_imgid available for dst_imgid too */
+void dt_mipmap_pack_copy(dt_mipmap_pack_t *pack,
+                         const dt_imgid_t dst_imgid,
+                         const dt_imgid_t src_imgid);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
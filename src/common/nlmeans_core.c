@@ -18,6 +18,7 @@
 
 #include "common/math.h"
 #include "common/opencl.h"
+#include "control/conf.h"
 #include "control/control.h"
 #include "develop/imageop.h"
 #include "develop/imageop_math.h"
@@ -50,6 +51,11 @@
 // architectures with slower multiplication.
 //#define CACHE_PIXDIFFS
 
+// edge length of the square blocks processed by the block engine.  A block of 32x32 pixels with the
+//   patch radius added on all sides needs about 56KB of scratch space for the differences and their row
+//   sums of four patches at a time, which stays in L2 while all patches are run over the block
+#define BLOCK_SIZE 32
+
 // number of intermediate buffers used by OpenCL code path.  If you change this, you must also change
 //   the definition in src/iop/nlmeans.c and src/iop/denoiseprofile.c
 #define NUM_BUCKETS 4
@@ -321,8 +327,55 @@ static int compute_slice_width(const int width)
   return sl_width;
 }
 
+// divide the accumulated pixels by their total weight and apply chroma/luma blending if needed
+static inline void normalize_chunk(
+        const float *const inbuf,
+        float *const outbuf,
+        const size_t stride,
+        const int width,
+        const int chunk_top,
+        const int chunk_bot,
+        const int chunk_left,
+        const int chunk_right,
+        const dt_aligned_pixel_t weight,
+        const dt_aligned_pixel_t invert,
+        const gboolean skip_blend)
+{
+  if(skip_blend)
+  {
+    // normalize the pixels
+    for(int row = chunk_top; row < chunk_bot; row++)
+    {
+      float *const out = outbuf + (size_t)4 * row * width;
+      for(int col = chunk_left; col < chunk_right; col++)
+      {
+        for_each_channel(c,aligned(out:16))
+        {
+          out[4*col+c] /= out[4*col+3];
+        }
+      }
+    }
+  }
+  else
+  {
+    // normalize and apply chroma/luma blending
+    for(int row = chunk_top; row < chunk_bot; row++)
+    {
+      const float *in = inbuf + row * stride;
+      float *out = outbuf + (size_t)4 * row * width;
+      for(int col = chunk_left; col < chunk_right; col++)
+      {
+        for_each_channel(c,aligned(in,out,weight,invert:16))
+        {
+          out[4*col+c] = (in[4*col+c] * invert[c]) + (out[4*col+c] / out[4*col+3] * weight[c]);
+        }
+      }
+    }
+  }
+}
+
 __DT_CLONE_TARGETS__
-void nlmeans_denoise(
+static void nlmeans_denoise_slices(
         const float *const inbuf,
         float *const outbuf,
         const dt_iop_roi_t *const roi_in,
@@ -502,44 +555,255 @@ void nlmeans_denoise(
           }
         }
       }
-      if(skip_blend)
+      normalize_chunk(inbuf, outbuf, stride, roi_out->width, chunk_top, chunk_bot, chunk_left, chunk_right,
+                      weight, invert, skip_blend);
+    }
+  }
+
+  // clean up: free the work space
+  dt_free_align(patches);
+  dt_free_align(scratch_buf);
+  return;
+}
+
+// alternate engine: instead of sliding one patch at a time over a slice of the image, run all patches over
+//   a small block of the image, four patches at a time.  The differences and box sums of the four patches
+//   are stored interleaved, so that summing, weighting and accumulation work on one vector per pixel, and
+//   every patch distance is summed from scratch, so there is no accumulation of rounding errors
+__DT_CLONE_TARGETS__
+static void nlmeans_denoise_blocks(
+        const float *const inbuf,
+        float *const outbuf,
+        const dt_iop_roi_t *const roi_in,
+        const dt_iop_roi_t *const roi_out,
+        const dt_nlmeans_param_t *const params)
+{
+  const dt_aligned_pixel_t weight = { params->luma, params->chroma, params->chroma, 1.0f };
+  const dt_aligned_pixel_t invert = { 1.0f - params->luma, 1.0f - params->chroma, 1.0f - params->chroma, 0.0f };
+  const gboolean skip_blend = (params->luma == 1.0 && params->chroma == 1.0);
+
+  const float cp_norm = compute_center_pixel_norm(params->center_weight,params->patch_radius);
+  const dt_aligned_pixel_t center_norm = { cp_norm, cp_norm, cp_norm, 1.0f };
+
+  const size_t stride = 4 * roi_in->width;
+  int num_patches;
+  int max_shift;
+  struct patch_t* patches = define_patches(params,stride,&num_patches,&max_shift);
+
+  const int radius = params->patch_radius;
+  const int width = roi_out->width;
+  const int height = roi_out->height;
+  const int ext = BLOCK_SIZE + 2 * radius;
+  // pixel differences over the block plus its border, and their sums along the rows of each patch
+  const size_t scratch_size = (size_t)4 * ext * (ext + BLOCK_SIZE);
+  size_t padded_scratch_size;
+  float *const restrict scratch_buf = dt_alloc_perthread_float(scratch_size, &padded_scratch_size);
+
+  const float sharpness = params->sharpness;
+  const float center_weight = params->center_weight;
+  const gboolean nonlocal = center_weight < 0.0f;
+
+  DT_OMP_FOR(collapse(2))
+  for(int block_top = 0; block_top < height; block_top += BLOCK_SIZE)
+  {
+    for(int block_left = 0; block_left < width; block_left += BLOCK_SIZE)
+    {
+      float *const restrict diffs = dt_get_perthread(scratch_buf, padded_scratch_size);
+      float *const restrict row_sums = diffs + (size_t)4 * ext * ext;
+      const int block_bot = MIN(block_top + BLOCK_SIZE, height);
+      const int block_right = MIN(block_left + BLOCK_SIZE, width);
+      const int bw = block_right - block_left;
+      const int bh = block_bot - block_top;
+      const int ew = bw + 2 * radius;
+      const int eh = bh + 2 * radius;
+
+      for(int i = block_top; i < block_bot; i++)
+      {
+        memset(outbuf + 4*((size_t)i*width+block_left), '\0', sizeof(float) * 4 * bw);
+      }
+
+      for(int p0 = 0; p0 < num_patches; p0 += 4)
       {
-        // normalize the pixels
-        for(int row = chunk_top; row < chunk_bot; row++)
+        const int lanes = MIN(4, num_patches - p0);
+        const patch_t *const patch = patches + p0;
+        // unused lanes get a zero shift, their weights are set to zero below
+        int DT_ALIGNED_PIXEL offset[4] = { 0, 0, 0, 0 };
+        int DT_ALIGNED_PIXEL srow[4] = { 0, 0, 0, 0 };
+        int DT_ALIGNED_PIXEL scol[4] = { 0, 0, 0, 0 };
+        // no bounds checks needed if the block and its border are inside the RoI for all of the patches
+        gboolean interior = block_top >= radius && block_left >= radius
+                            && block_bot + radius <= height && block_right + radius <= width;
+        for(int k = 0; k < lanes; k++)
         {
-          float *const out = outbuf + 4 * row * roi_out->width;
-          for(int col = chunk_left; col < chunk_right; col++)
+          offset[k] = patch[k].offset;
+          srow[k] = patch[k].rows;
+          scol[k] = patch[k].cols;
+          interior = interior && block_top - radius + srow[k] >= 0 && block_bot + radius + srow[k] <= height
+                              && block_left - radius + scol[k] >= 0 && block_right + radius + scol[k] <= width;
+        }
+
+        // channel-normed squared differences, zero where either pixel is outside the RoI
+        for(int y = 0; y < eh; y++)
+        {
+          const int row = block_top - radius + y;
+          float *const d = diffs + (size_t)4 * y * ew;
+          for(int x = 0; x < ew; x++)
           {
-            for_each_channel(c,aligned(out:16))
+            const int col = block_left - radius + x;
+            const gboolean inside = interior || (row >= 0 && row < height && col >= 0 && col < width);
+            const float *const px = inside ? inbuf + row * stride + 4 * col : inbuf;
+            for(int k = 0; k < 4; k++)
             {
-              out[4*col+c] /= out[4*col+3];
+              const gboolean valid = k < lanes && inside
+                && (interior || (row + srow[k] >= 0 && row + srow[k] < height
+                                 && col + scol[k] >= 0 && col + scol[k] < width));
+              d[4*x+k] = valid ? pixel_difference(px, px + offset[k], params->norm) : 0.0f;
             }
           }
         }
-      }
-      else
-      {
-        // normalize and apply chroma/luma blending
-        for(int row = chunk_top; row < chunk_bot; row++)
+
+        // sum the differences along the rows of the patches
+        for(int y = 0; y < eh; y++)
         {
-          const float *in = inbuf + row * stride;
-          float *out = outbuf + row * 4 * roi_out->width;
-          for(int col = chunk_left; col < chunk_right; col++)
+          const float *const d = diffs + (size_t)4 * y * ew;
+          float *const rs = row_sums + (size_t)4 * y * bw;
+          for(int x = 0; x < bw; x++)
           {
-            for_each_channel(c,aligned(in,out,weight,invert:16))
+            dt_aligned_pixel_t sum = { 0.0f, 0.0f, 0.0f, 0.0f };
+            for(int j = 0; j <= 2 * radius; j++)
             {
-              out[4*col+c] = (in[4*col+c] * invert[c]) + (out[4*col+c] / out[4*col+3] * weight[c]);
+              for_four_channels(k,aligned(sum:16))
+                sum[k] += d[4*(x+j)+k];
             }
+            copy_pixel(rs + 4*x, sum);
+          }
+        }
+
+        // sum the rows of the patches, weight the shifted pixels and add them to the output
+        for(int y = 0; y < bh; y++)
+        {
+          const int row = block_top + y;
+          for(int x = 0; x < bw; x++)
+          {
+            const int col = block_left + x;
+            dt_aligned_pixel_t distortion = { 0.0f, 0.0f, 0.0f, 0.0f };
+            for(int i = 0; i <= 2 * radius; i++)
+            {
+              const float *const rs = row_sums + (size_t)4 * ((y + i) * bw + x);
+              for_four_channels(k,aligned(distortion:16))
+                distortion[k] += rs[k];
+            }
+
+            const float *const inpx = inbuf + row * stride + 4 * col;
+            gboolean valid[4];
+            dt_aligned_pixel_t dissimilarity;
+            for(int k = 0; k < 4; k++)
+            {
+              valid[k] = k < lanes
+                && (interior || (row + srow[k] >= 0 && row + srow[k] < height
+                                 && col + scol[k] >= 0 && col + scol[k] < width));
+              if(nonlocal)
+                // computation as used by denoise(non-local) iop
+                dissimilarity[k] = distortion[k] * sharpness;
+              else
+              {
+                // computation as used by denoiseprofiled iop with non-local means
+                const float center = valid[k] ? pixel_difference(inpx, inpx + offset[k], center_norm) : 0.0f;
+                dissimilarity[k] = fmaxf(0.0f, (distortion[k] + center) / (1.0f + center_weight) * sharpness - 2.0f);
+              }
+            }
+            dt_aligned_pixel_t wt;
+            for_four_channels(k,aligned(wt,dissimilarity:16))
+              wt[k] = gh(dissimilarity[k]);
+
+            dt_aligned_pixel_t sum = { 0.0f, 0.0f, 0.0f, 0.0f };
+            for(int k = 0; k < 4; k++)
+            {
+              if(!valid[k]) continue;
+              const float *const shifted = inpx + offset[k];
+              const dt_aligned_pixel_t pixel = { shifted[0], shifted[1], shifted[2], 1.0f };
+              for_four_channels(c,aligned(pixel,sum:16))
+                sum[c] += pixel[c] * wt[k];
+            }
+            float *const out = outbuf + 4 * ((size_t)row * width + col);
+            for_four_channels(c,aligned(sum,out:16))
+              out[c] += sum[c];
           }
         }
       }
+      normalize_chunk(inbuf, outbuf, stride, width, block_top, block_bot, block_left, block_right,
+                      weight, invert, skip_blend);
     }
   }
 
   // clean up: free the work space
   dt_free_align(patches);
   dt_free_align(scratch_buf);
-  return;
+}
+
+void nlmeans_denoise(
+        const float *const inbuf,
+        float *const outbuf,
+        const dt_iop_roi_t *const roi_in,
+        const dt_iop_roi_t *const roi_out,
+        const dt_nlmeans_param_t *const params)
+{
+  if(params->engine == DT_NLMEANS_ENGINE_BLOCKS)
+    nlmeans_denoise_blocks(inbuf, outbuf, roi_in, roi_out, params);
+  else
+    nlmeans_denoise_slices(inbuf, outbuf, roi_in, roi_out, params);
+}
+
+dt_nlmeans_engine_t nlmeans_preferred_engine(void)
+{
+  return dt_conf_get_bool("nlmeans/block_engine") ? DT_NLMEANS_ENGINE_BLOCKS : DT_NLMEANS_ENGINE_SLICES;
+}
+
+void nlmeans_benchmark(
+        const float *const inbuf,
+        float *const outbuf,
+        const dt_iop_roi_t *const roi_in,
+        const dt_iop_roi_t *const roi_out,
+        const dt_nlmeans_param_t *const params)
+{
+  const size_t npixels = (size_t)roi_out->width * roi_out->height;
+  float *const ref = dt_alloc_align_float(4 * npixels);
+  if(!ref) return;
+
+  dt_nlmeans_param_t bench = *params;
+  const int old_muted = darktable.unmuted;
+  darktable.unmuted = 0;
+  dt_times_t start, mid, end;
+  dt_get_times(&start);
+  bench.engine = DT_NLMEANS_ENGINE_SLICES;
+  nlmeans_denoise(inbuf, ref, roi_in, roi_out, &bench);
+  dt_get_times(&mid);
+  bench.engine = DT_NLMEANS_ENGINE_BLOCKS;
+  nlmeans_denoise(inbuf, outbuf, roi_in, roi_out, &bench);
+  dt_get_times(&end);
+  darktable.unmuted = old_muted;
+
+  float max_diff = 0.0f;
+  double sum_diff = 0.0;
+  DT_OMP_FOR(reduction(max : max_diff) reduction(+ : sum_diff))
+  for(size_t k = 0; k < 4 * npixels; k += 4)
+  {
+    for(int c = 0; c < 3; c++)
+    {
+      const float diff = fabsf(outbuf[k + c] - ref[k + c]);
+      max_diff = fmaxf(max_diff, diff);
+      sum_diff += diff;
+    }
+  }
+  dt_free_align(ref);
+
+  const float slices = mid.clock - start.clock;
+  const float blocks = end.clock - mid.clock;
+  dt_print(DT_DEBUG_ALWAYS,
+           "[nlmeans_benchmark] %7.2fmpix, patch radius %i, search radius %i: slices %.3fs,"
+           " blocks %.3fs (%.2fx), max difference %g, mean %g",
+           npixels / 1.0e6, params->patch_radius, params->search_radius, slices, blocks,
+           slices / fmaxf(blocks, 1e-6f), max_diff, sum_diff / (3.0 * npixels));
 }
 
 /**************************************************************/
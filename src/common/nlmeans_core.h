@@ -19,6 +19,13 @@
 
 #include "iop/iop_api.h"
 
+// CPU implementations, producing the same result up to rounding
+typedef enum dt_nlmeans_engine_t
+{
+  DT_NLMEANS_ENGINE_SLICES = 0, // one patch at a time over slices of the image using running sums
+  DT_NLMEANS_ENGINE_BLOCKS = 1  // all patches over small blocks of the image, four patches at a time
+} dt_nlmeans_engine_t;
+
 struct dt_nlmeans_param_t
 {
   float scattering;	// scattering factor for patches (default 0 = densest possible)
@@ -31,6 +38,7 @@ struct dt_nlmeans_param_t
   int search_radius;	// radius around a pixel in which to compare patches (default = 7)
   int decimate;         // set to 1 to search only half the patches in the neighborhood (default = 0)
   const float* const norm; // array of four per-channel weight factors
+  dt_nlmeans_engine_t engine; // CPU implementation to use
   dt_dev_pixelpipe_type_t pipetype;
   int kernel_dist;	// CL: compute channel-normed squared pixel differences (runs for each patch)
   int kernel_horiz;	// CL: horizontal sum (runs for each patch)
@@ -39,10 +47,22 @@ struct dt_nlmeans_param_t
 };
 typedef struct dt_nlmeans_param_t dt_nlmeans_param_t;
 
+typedef void((*nlmeans_denoise_t)(const float *const inbuf, float *const outbuf,
+                                  const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
+                                  const dt_nlmeans_param_t *const params));
+
 void nlmeans_denoise(const float *const inbuf, float *const outbuf,
                      const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
                      const dt_nlmeans_param_t *const params);
 
+// CPU implementation selected in the preferences
+dt_nlmeans_engine_t nlmeans_preferred_engine(void);
+
+// time both CPU implementations and print the difference of their results, outbuf is overwritten
+void nlmeans_benchmark(const float *const inbuf, float *const outbuf,
+                       const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
+                       const dt_nlmeans_param_t *const params);
+
 #ifdef HAVE_OPENCL
 int nlmeans_denoise_cl(const dt_nlmeans_param_t *const params, const int devid,
                        cl_mem dev_in, cl_mem dev_out, const dt_iop_roi_t *const roi_in);
@@ -17,6 +17,7 @@
 */
 
 #include "common/profiling.h"
+#include "common/trace.h"
 
 dt_timer_t *dt_timer_start_with_name(const char *file,
                                      const char *function,
@@ -27,6 +28,7 @@ dt_timer_t *dt_timer_start_with_name(const char *file,
   t->function = function;
   t->timer = g_timer_new();
   t->description = description;
+  t->trace_start = dt_trace_now();
   return t;
 }
 
@@ -39,6 +41,8 @@ void dt_timer_stop_with_name(dt_timer_t *t)
            "Timer %s in function %s took %.3f seconds to execute",
            t->description, t->function,
            g_timer_elapsed(t->timer, &ms));
+  dt_trace_complete("timers", "timer", t->description, t->trace_start,
+                    "\"function\":\"%s\"", t->function);
   g_timer_destroy(t->timer);
   g_free(t);
 }
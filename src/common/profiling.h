@@ -45,6 +45,7 @@ typedef struct dt_timer_t
   const char *function;
   const char *description;
   GTimer *timer;
+  gint64 trace_start;
 } dt_timer_t;
 
 dt_timer_t *dt_timer_start_with_name(const char *file,
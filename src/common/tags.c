@@ -703,25 +703,54 @@ uint32_t dt_tag_count_attached(const dt_imgid_t imgid,
   if(!dt_is_valid_imgid(imgid))
     return 0;
 
-  sqlite3_stmt *stmt;
-
-  gchar *query = g_strdup_printf
-    ("SELECT COUNT(tagid)"
-     " FROM main.tagged_images"
-     " WHERE imgid = %d"
-     "       %s",
-     imgid,
-     ignore_dt_tags ? " AND tagid NOT IN memory.darktable_tags" : "");
-
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  g_free(query);
+  sqlite3_stmt *stmt = dt_database_prepare_cached
+    (darktable.db,
+     ignore_dt_tags
+     ? "SELECT COUNT(tagid)"
+       " FROM main.tagged_images"
+       " WHERE imgid = ?1"
+       "       AND tagid NOT IN memory.darktable_tags"
+     : "SELECT COUNT(tagid)"
+       " FROM main.tagged_images"
+       " WHERE imgid = ?1");
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
 
   int32_t count = 0;
 
   if(sqlite3_step(stmt) == SQLITE_ROW)
     count = sqlite3_column_int(stmt, 0);
 
-  sqlite3_finalize(stmt);
+  dt_database_release_cached(darktable.db, stmt);
+  return count;
+}
+
+static uint32_t _tag_read_attached(sqlite3_stmt *stmt,
+                                   const uint32_t nb_selected,
+                                   GList **result)
+{
+  uint32_t count = 0;
+  *result = NULL;
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    dt_tag_t *t = g_malloc0(sizeof(dt_tag_t));
+    t->id = sqlite3_column_int(stmt, 0);
+    t->tag = g_strdup((char *)sqlite3_column_text(stmt, 1));
+    t->leave = g_strrstr(t->tag, "|");
+    t->leave = t->leave ? t->leave + 1 : t->tag;
+    t->flags = sqlite3_column_int(stmt, 2);
+    t->synonym = g_strdup((char *)sqlite3_column_text(stmt, 3));
+    const uint32_t imgnb = sqlite3_column_int(stmt, 4);
+    t->count = imgnb;
+    t->select = (nb_selected == 0)
+                ? DT_TS_NO_IMAGE
+                : (imgnb == nb_selected)
+                  ? DT_TS_ALL_IMAGES
+                  : (imgnb == 0)
+                    ? DT_TS_NO_IMAGE
+                    : DT_TS_SOME_IMAGES;
+    *result = g_list_append(*result, t);
+    count++;
+  }
   return count;
 }
 
@@ -730,70 +759,68 @@ uint32_t dt_tag_get_attached(const dt_imgid_t imgid,
                              const gboolean ignore_dt_tags)
 {
   sqlite3_stmt *stmt;
-  uint32_t nb_selected = 0;
-  char *images = NULL;
-  if(dt_is_valid_imgid(imgid))
-  {
-    images = g_strdup_printf("%d", imgid);
-    nb_selected = 1;
-  }
-  else
-  {
-    // we get the query used to retrieve the list of select images
-    images = dt_selection_get_list_query(darktable.selection, FALSE, FALSE);
-    // and we retrieve the number of image in the selection
-    gchar *query = g_strdup_printf("SELECT COUNT(*)"
-                                   " FROM (%s)",
-                                   images);
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-    if(sqlite3_step(stmt) == SQLITE_ROW)
-      nb_selected = sqlite3_column_int(stmt, 0);
-    sqlite3_finalize(stmt);
-    g_free(query);
-  }
   uint32_t count = 0;
-  if(images)
+
+  if(dt_is_valid_imgid(imgid))
   {
+    // single image, e.g. for the thumbnail tooltips: constant query
     // clang-format off
-    gchar *query = g_strdup_printf
-      ("SELECT DISTINCT I.tagid, T.name, T.flags, T.synonyms,"
-       " COUNT(DISTINCT I.imgid) AS inb"
-       " FROM main.tagged_images AS I"
-       " JOIN data.tags AS T ON T.id = I.tagid"
-       " WHERE I.imgid IN (%s)%s"
-       " GROUP BY I.tagid "
-       " ORDER by T.name",
-       images, ignore_dt_tags ? " AND T.id NOT IN memory.darktable_tags" : "");
+    stmt = dt_database_prepare_cached
+      (darktable.db,
+       ignore_dt_tags
+       ? "SELECT DISTINCT I.tagid, T.name, T.flags, T.synonyms,"
+         " COUNT(DISTINCT I.imgid) AS inb"
+         " FROM main.tagged_images AS I"
+         " JOIN data.tags AS T ON T.id = I.tagid"
+         " WHERE I.imgid = ?1 AND T.id NOT IN memory.darktable_tags"
+         " GROUP BY I.tagid "
+         " ORDER by T.name"
+       : "SELECT DISTINCT I.tagid, T.name, T.flags, T.synonyms,"
+         " COUNT(DISTINCT I.imgid) AS inb"
+         " FROM main.tagged_images AS I"
+         " JOIN data.tags AS T ON T.id = I.tagid"
+         " WHERE I.imgid = ?1"
+         " GROUP BY I.tagid "
+         " ORDER by T.name");
     // clang-format on
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-    g_free(images);
-
-    // Create result
-    *result = NULL;
-    while(sqlite3_step(stmt) == SQLITE_ROW)
-    {
-      dt_tag_t *t = g_malloc0(sizeof(dt_tag_t));
-      t->id = sqlite3_column_int(stmt, 0);
-      t->tag = g_strdup((char *)sqlite3_column_text(stmt, 1));
-      t->leave = g_strrstr(t->tag, "|");
-      t->leave = t->leave ? t->leave + 1 : t->tag;
-      t->flags = sqlite3_column_int(stmt, 2);
-      t->synonym = g_strdup((char *)sqlite3_column_text(stmt, 3));
-      const uint32_t imgnb = sqlite3_column_int(stmt, 4);
-      t->count = imgnb;
-      t->select = (nb_selected == 0)
-                  ? DT_TS_NO_IMAGE
-                  : (imgnb == nb_selected)
-                    ? DT_TS_ALL_IMAGES
-                    : (imgnb == 0)
-                      ? DT_TS_NO_IMAGE
-                      : DT_TS_SOME_IMAGES;
-      *result = g_list_append(*result, t);
-      count++;
-    }
-    sqlite3_finalize(stmt);
-    g_free(query);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+    count = _tag_read_attached(stmt, 1, result);
+    dt_database_release_cached(darktable.db, stmt);
+    return count;
   }
+
+  // we get the query used to retrieve the list of select images
+  char *images = dt_selection_get_list_query(darktable.selection, FALSE, FALSE);
+  if(!images) return 0;
+
+  // and we retrieve the number of image in the selection
+  uint32_t nb_selected = 0;
+  gchar *query = g_strdup_printf("SELECT COUNT(*)"
+                                 " FROM (%s)",
+                                 images);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  if(sqlite3_step(stmt) == SQLITE_ROW)
+    nb_selected = sqlite3_column_int(stmt, 0);
+  sqlite3_finalize(stmt);
+  g_free(query);
+
+  // clang-format off
+  query = g_strdup_printf
+    ("SELECT DISTINCT I.tagid, T.name, T.flags, T.synonyms,"
+     " COUNT(DISTINCT I.imgid) AS inb"
+     " FROM main.tagged_images AS I"
+     " JOIN data.tags AS T ON T.id = I.tagid"
+     " WHERE I.imgid IN (%s)%s"
+     " GROUP BY I.tagid "
+     " ORDER by T.name",
+     images, ignore_dt_tags ? " AND T.id NOT IN memory.darktable_tags" : "");
+  // clang-format on
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  g_free(images);
+
+  count = _tag_read_attached(stmt, nb_selected, result);
+  sqlite3_finalize(stmt);
+  g_free(query);
   return count;
 }
 
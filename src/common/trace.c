@@ -0,0 +1,189 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/trace.h"
+#include "common/darktable.h"
+
+#include <glib/gstdio.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+// a single trace per process, the lock is static so that threads still
+// writing events while the trace gets closed are safe
+static struct
+{
+  FILE *f;            // NULL if not tracing
+  gint64 origin;      // timestamps are written relative to this
+  GHashTable *tracks; // track name -> tid
+  int next_tid;
+} _trace = { NULL };
+
+static GMutex _trace_lock;
+
+gboolean dt_trace_enabled(void)
+{
+  return _trace.f != NULL;
+}
+
+gint64 dt_trace_now(void)
+{
+  return g_get_monotonic_time();
+}
+
+gchar *dt_trace_escape(const char *str)
+{
+  // same rules as a json string: escape quotes, backslash and control characters
+  GString *s = g_string_sized_new(str ? strlen(str) : 0);
+  for(const char *c = str; c && *c; c++)
+  {
+    if(*c == '"' || *c == '\\')
+      g_string_append_printf(s, "\\%c", *c);
+    else if((unsigned char)*c < 0x20)
+      g_string_append_printf(s, "\\u%04x", (unsigned char)*c);
+    else
+      g_string_append_c(s, *c);
+  }
+  return g_string_free(s, FALSE);
+}
+
+// must be called with the lock held
+static int _track_tid(const char *track)
+{
+  gpointer tid = g_hash_table_lookup(_trace.tracks, track);
+  if(tid) return GPOINTER_TO_INT(tid);
+
+  const int new_tid = ++_trace.next_tid;
+  g_hash_table_insert(_trace.tracks, g_strdup(track), GINT_TO_POINTER(new_tid));
+  gchar *name = dt_trace_escape(track);
+  fprintf(_trace.f,
+          "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n",
+          new_tid, name);
+  g_free(name);
+  return new_tid;
+}
+
+static void _write_event(const char *track,
+                         const char *category,
+                         const char *name,
+                         const char phase,
+                         const gint64 start,
+                         const gint64 end,
+                         const char *args_fmt,
+                         va_list ap)
+{
+  gchar *args = args_fmt ? g_strdup_vprintf(args_fmt, ap) : NULL;
+  gchar *ename = dt_trace_escape(name);
+
+  g_mutex_lock(&_trace_lock);
+  if(_trace.f)
+  {
+    const int tid = _track_tid(track);
+    fprintf(_trace.f, "{\"ph\":\"%c\",\"cat\":\"%s\",\"name\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%" G_GINT64_FORMAT,
+            phase, category, ename, tid, start - _trace.origin);
+    if(phase == 'X')
+      fprintf(_trace.f, ",\"dur\":%" G_GINT64_FORMAT, end - start);
+    else
+      fprintf(_trace.f, ",\"s\":\"t\"");
+    fprintf(_trace.f, ",\"args\":{%s}},\n", args ? args : "");
+  }
+  g_mutex_unlock(&_trace_lock);
+
+  g_free(ename);
+  g_free(args);
+}
+
+void dt_trace_complete(const char *track,
+                       const char *category,
+                       const char *name,
+                       const gint64 start,
+                       const char *args_fmt,
+                       ...)
+{
+  if(!dt_trace_enabled()) return;
+
+  const gint64 end = dt_trace_now();
+  va_list ap;
+  va_start(ap, args_fmt);
+  _write_event(track, category, name, 'X', start, end, args_fmt, ap);
+  va_end(ap);
+}
+
+void dt_trace_instant(const char *track,
+                      const char *category,
+                      const char *name,
+                      const char *args_fmt,
+                      ...)
+{
+  if(!dt_trace_enabled()) return;
+
+  const gint64 now = dt_trace_now();
+  va_list ap;
+  va_start(ap, args_fmt);
+  _write_event(track, category, name, 'i', now, now, args_fmt, ap);
+  va_end(ap);
+}
+
+gboolean dt_trace_open(const char *filename)
+{
+  if(!filename || dt_trace_enabled()) return FALSE;
+
+  FILE *f = g_fopen(filename, "wb");
+  if(!f)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[trace] can't open `%s' for writing", filename);
+    return FALSE;
+  }
+
+  g_mutex_lock(&_trace_lock);
+  _trace.origin = dt_trace_now();
+  _trace.tracks = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  _trace.next_tid = 0;
+
+  // the version allows to tell traces of different releases apart
+  gchar *version = dt_trace_escape(darktable_package_string);
+  fprintf(f, "[\n{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"args\":{\"name\":\"%s\"}},\n", version);
+  g_free(version);
+  _trace.f = f;
+  g_mutex_unlock(&_trace_lock);
+
+  dt_print(DT_DEBUG_ALWAYS, "[trace] writing chrome trace events to `%s'", filename);
+  return TRUE;
+}
+
+void dt_trace_close(void)
+{
+  g_mutex_lock(&_trace_lock);
+  if(_trace.f)
+  {
+    // a last event without trailing comma closes the array
+    fprintf(_trace.f,
+            "{\"ph\":\"M\",\"name\":\"trace_end\",\"pid\":1,\"args\":{\"duration_us\":%" G_GINT64_FORMAT "}}\n]\n",
+            dt_trace_now() - _trace.origin);
+    fclose(_trace.f);
+    _trace.f = NULL;
+    g_hash_table_destroy(_trace.tracks);
+    _trace.tracks = NULL;
+  }
+  g_mutex_unlock(&_trace_lock);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
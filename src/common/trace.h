@@ -0,0 +1,72 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * structured timing traces, enabled with --trace FILE.
+ *
+ * events are written in the chrome trace event format (a json array) which
+ * can be loaded into chrome://tracing, perfetto or speedscope. every event
+ * belongs to a named track (one timeline row, e.g. one per pipe type) and
+ * carries a json object of arguments. as the array is written while
+ * darktable runs, a trace cut short by a crash is still readable.
+ */
+
+/** open the trace file, returns TRUE on success */
+gboolean dt_trace_open(const char *filename);
+/** terminate the json array and close the file */
+void dt_trace_close(void);
+
+/** TRUE if events are recorded, cheap enough for hot paths */
+gboolean dt_trace_enabled(void);
+
+/** monotonic timestamp in microseconds to be passed as start of an event */
+gint64 dt_trace_now(void);
+
+/** record an event that started at start (from dt_trace_now()) and ends now.
+    args_fmt is a printf format for the members of the json "args" object,
+    e.g. "\"width\":%d,\"height\":%d", or NULL */
+void dt_trace_complete(const char *track,
+                       const char *category,
+                       const char *name,
+                       const gint64 start,
+                       const char *args_fmt,
+                       ...) G_GNUC_PRINTF(5, 6);
+
+/** record an event without duration */
+void dt_trace_instant(const char *track,
+                      const char *category,
+                      const char *name,
+                      const char *args_fmt,
+                      ...) G_GNUC_PRINTF(4, 5);
+
+/** escape a string for use inside a json string in args, returns a newly allocated string */
+gchar *dt_trace_escape(const char *str);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
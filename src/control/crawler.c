@@ -450,17 +450,19 @@ static dt_crawler_item_t *_crawler_collect_items(const dt_filmid_t filmid,
                                                  dt_crawler_dir_t **dirs_out,
                                                  int *num_dirs_out)
 {
+  // the scan must not hold back the writes done from the user interface
+  sqlite3 *handle = dt_database_get_readonly(darktable.db);
   sqlite3_stmt *stmt;
   int capacity = 1024;
 
   // reserve based on the number of images we expect to see
   // clang-format off
   if(dt_is_valid_filmid(filmid))
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+    DT_DEBUG_SQLITE3_PREPARE_V2(handle,
                                 "SELECT COUNT(*) FROM main.images WHERE film_id = ?1",
                                 -1, &stmt, 0);
   else
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+    DT_DEBUG_SQLITE3_PREPARE_V2(handle,
                                 "SELECT COUNT(*) FROM main.images", -1, &stmt, 0);
   // clang-format on
   if(dt_is_valid_filmid(filmid)) DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, filmid);
@@ -471,6 +473,7 @@ static dt_crawler_item_t *_crawler_collect_items(const dt_filmid_t filmid,
   dt_crawler_item_t *items = calloc(capacity, sizeof(dt_crawler_item_t));
   if(!items)
   {
+    dt_database_release_readonly(darktable.db, handle);
     *num_items = 0;
     *num_dirs_out = 0;
     *dirs_out = NULL;
@@ -482,7 +485,7 @@ static dt_crawler_item_t *_crawler_collect_items(const dt_filmid_t filmid,
   // time against a single listing of it
   // clang-format off
   if(dt_is_valid_filmid(filmid))
-    sqlite3_prepare_v2(dt_database_get(darktable.db),
+    sqlite3_prepare_v2(handle,
                        "SELECT i.id, write_timestamp, version,"
                        "       folder, filename, flags"
                        " FROM main.images i, main.film_rolls f"
@@ -491,7 +494,7 @@ static dt_crawler_item_t *_crawler_collect_items(const dt_filmid_t filmid,
                        " ORDER BY f.id, filename",
                        -1, &stmt, NULL);
   else
-    sqlite3_prepare_v2(dt_database_get(darktable.db),
+    sqlite3_prepare_v2(handle,
                        "SELECT i.id, write_timestamp, version,"
                        "       folder, filename, flags"
                        " FROM main.images i, main.film_rolls f"
@@ -557,6 +560,7 @@ static dt_crawler_item_t *_crawler_collect_items(const dt_filmid_t filmid,
     count++;
   }
   sqlite3_finalize(stmt);
+  dt_database_release_readonly(darktable.db, handle);
 
   *num_items = count;
   *num_dirs_out = num_dirs;
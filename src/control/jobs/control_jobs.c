@@ -2030,6 +2030,227 @@ static int32_t _control_apply_styles_job_run(dt_job_t *job)
   return 0;
 }
 
+// shared state of one export job when several pipelines run concurrently.
+// the admission controller only lets a new image start if its estimated
+// host memory still fits into the budget next to the images in flight.
+typedef struct dt_control_export_sched_t
+{
+  dt_job_t *job;
+  dt_control_export_t *settings;
+  dt_imageio_module_format_t *mformat;
+  dt_imageio_module_storage_t *mstorage;
+  dt_imageio_module_data_t *sdata;
+  dt_imageio_module_data_t *fdata;
+  dt_export_metadata_t *metadata;
+  dt_imgid_t *imgs;
+  guint total;
+  guint tagid, etagid;
+  gint next;
+  int omp_threads; // per pipeline
+
+  dt_pthread_mutex_t lock;
+  pthread_cond_t freed;
+  size_t budget;
+  size_t in_use;
+  int running;
+  guint done;
+  gboolean tag_change;
+  double fraction;
+  double prev_time;
+} dt_control_export_sched_t;
+
+// export a single image, returns FALSE if the storage failed and the
+// job has to be cancelled.
+static gboolean _control_export_image(dt_control_export_t *settings,
+                                      dt_imageio_module_storage_t *mstorage,
+                                      dt_imageio_module_data_t *sdata,
+                                      dt_imageio_module_format_t *mformat,
+                                      dt_imageio_module_data_t *fdata,
+                                      dt_export_metadata_t *metadata,
+                                      const dt_imgid_t imgid,
+                                      const guint num,
+                                      const guint total,
+                                      gboolean *stored)
+{
+  *stored = FALSE;
+
+  // check if image still exists:
+  const dt_image_t *image = dt_image_cache_get(imgid, 'r');
+  if(!image) return TRUE;
+
+  char imgfilename[PATH_MAX] = { 0 };
+  gboolean from_cache = TRUE;
+  dt_image_full_path(image->id, imgfilename, sizeof(imgfilename), &from_cache);
+  if(!g_file_test(imgfilename, G_FILE_TEST_IS_REGULAR))
+  {
+    dt_control_log(_("image `%s' is currently unavailable"), image->filename);
+    dt_print(DT_DEBUG_ALWAYS, "image `%s' is currently unavailable", imgfilename);
+    // dt_image_remove(imgid);
+    dt_image_cache_read_release(image);
+    return TRUE;
+  }
+  dt_image_cache_read_release(image);
+
+  if(mstorage->store(mstorage, sdata, imgid, mformat, fdata,
+                     num, total, settings->high_quality, settings->upscale,
+                     settings->is_scaling, settings->scale_factor,
+                     settings->export_masks, settings->icc_type,
+                     settings->icc_filename, settings->icc_intent,
+                     metadata) != 0)
+    return FALSE;
+
+  *stored = TRUE;
+  return TRUE;
+}
+
+static gboolean _control_export_mark_exported(const dt_imgid_t imgid,
+                                              const guint tagid,
+                                              const guint etagid)
+{
+  gboolean tag_change = FALSE;
+
+  // remove 'changed' tag from image
+  if(dt_tag_detach(tagid, imgid, FALSE, FALSE)) tag_change = TRUE;
+
+  // make sure the 'exported' tag is set on the image
+  if(dt_tag_attach(etagid, imgid, FALSE, FALSE)) tag_change = TRUE;
+
+  /* register export timestamp in cache */
+  dt_image_cache_set_export_timestamp(imgid);
+
+  return tag_change;
+}
+
+static int _control_export_num_pipes(const guint total,
+                                     dt_imageio_module_storage_t *mstorage,
+                                     dt_imageio_module_format_t *mformat,
+                                     dt_imageio_module_data_t *fdata)
+{
+  // formats and storages keeping state across the images (a pdf document,
+  // an index page...) have to be called in order from a single pipe
+  if(!(mformat->flags(fdata) & FORMAT_FLAGS_PARALLEL_SAFE)
+     || !mstorage->parallel_safe
+     || !mstorage->parallel_safe(mstorage))
+    return 1;
+
+  const int pipes = dt_conf_get_int("plugins/lighttable/export/parallel_pipes");
+  return CLAMP(pipes, 1, MIN(MAX((int)total, 1), (int)dt_get_num_procs()));
+}
+
+// host memory needed to export one image: the tiling code assumes an
+// input and an output float4 buffer at full size (factor 2) for most
+// modules, the pipe cache keeps one more, and the final scaled output
+// is added on top.
+static size_t _control_export_mem_estimate(const dt_imgid_t imgid,
+                                           const dt_imageio_module_data_t *fdata)
+{
+  const dt_image_t *image = dt_image_cache_get(imgid, 'r');
+  if(!image) return 0;
+  const size_t full = (size_t)image->width * image->height;
+  dt_image_cache_read_release(image);
+
+  const size_t scaled = (fdata->max_width > 0 && fdata->max_height > 0)
+    ? MIN(full, (size_t)fdata->max_width * fdata->max_height)
+    : full;
+
+  return sizeof(float) * 4 * (3 * full + scaled);
+}
+
+static gpointer _control_export_worker(gpointer arg)
+{
+  dt_control_export_sched_t *s = arg;
+
+  // share the cores between the pipelines instead of running a full
+  // openmp team in each of them
+#ifdef _OPENMP
+  omp_set_num_threads(s->omp_threads);
+#endif
+
+  // every pipeline needs its own format data as the format modules
+  // keep their encoder state in there
+  dt_imageio_module_data_t *fdata = s->mformat->get_params(s->mformat);
+  if(!fdata) return NULL;
+  memcpy(fdata, s->fdata, s->mformat->params_size(s->mformat));
+
+  while(!_job_cancelled(s->job))
+  {
+    const gint idx = g_atomic_int_add(&s->next, 1);
+    if(idx >= (gint)s->total) break;
+
+    const dt_imgid_t imgid = s->imgs[idx];
+    // keep the numbering of the serial export so that $(SEQUENCE) and
+    // ordered storages (gallery, latex) get the same result
+    const guint num = idx + 1;
+    const size_t cost = MIN(_control_export_mem_estimate(imgid, fdata), s->budget);
+
+    // admission: wait until the image fits next to the ones in flight,
+    // but never block if nothing else is running
+    dt_pthread_mutex_lock(&s->lock);
+    while(s->running > 0 && s->in_use + cost > s->budget && !_job_cancelled(s->job))
+      dt_pthread_cond_wait(&s->freed, &s->lock);
+    s->in_use += cost;
+    s->running++;
+    dt_pthread_mutex_unlock(&s->lock);
+
+    gboolean stored = FALSE;
+    const gboolean ok = _control_export_image(s->settings, s->mstorage, s->sdata,
+                                              s->mformat, fdata, s->metadata,
+                                              imgid, num, s->total, &stored);
+
+    dt_pthread_mutex_lock(&s->lock);
+    s->in_use -= cost;
+    s->running--;
+    if(!ok)
+      dt_control_job_cancel(s->job);
+    else if(stored && _control_export_mark_exported(imgid, s->tagid, s->etagid))
+      s->tag_change = TRUE;
+
+    s->done++;
+    dt_control_job_set_progress_message(s->job, _("exporting %d / %d to %s"),
+                                        s->done, s->total,
+                                        s->mstorage->name(s->mstorage));
+    s->fraction += 1.0 / s->total;
+    _update_progress(s->job, s->fraction, &s->prev_time);
+    pthread_cond_broadcast(&s->freed);
+    dt_pthread_mutex_unlock(&s->lock);
+  }
+
+  s->mformat->free_params(s->mformat, fdata);
+  return NULL;
+}
+
+// run the export over several pipelines at once. returns TRUE if
+// any tag has been changed.
+static gboolean _control_export_parallel(dt_control_export_sched_t *s,
+                                         const int num_pipes)
+{
+  s->budget = dt_get_available_pipe_mem(NULL);
+  s->omp_threads = MAX(1, (int)dt_get_num_procs() / num_pipes);
+
+  dt_pthread_mutex_init(&s->lock, NULL);
+  pthread_cond_init(&s->freed, NULL);
+
+  dt_print(DT_DEBUG_IMAGEIO | DT_DEBUG_PERF,
+           "[export_job] %d pipelines of %d threads for %u images, memory budget %zuMB",
+           num_pipes, s->omp_threads, s->total, s->budget / DT_MEGA);
+
+  GThread **threads = calloc(num_pipes, sizeof(GThread *));
+  if(threads)
+  {
+    for(int t = 0; t < num_pipes; t++)
+      threads[t] = g_thread_new("export", _control_export_worker, s);
+    for(int t = 0; t < num_pipes; t++)
+      if(threads[t]) g_thread_join(threads[t]);
+    free(threads);
+  }
+  else
+    _control_export_worker(s);
+
+  pthread_cond_destroy(&s->freed);
+  dt_pthread_mutex_destroy(&s->lock);
+  return s->tag_change;
+}
+
 static int32_t _control_export_job_run(dt_job_t *job)
 {
   dt_stop_backthumbs_crawler(FALSE);
@@ -2119,61 +2340,68 @@ static int32_t _control_export_job_run(dt_job_t *job)
     metadata.list = g_list_remove(metadata.list, metadata.list->data);
   }
 
-  GList *t = params->index;
-  double prev_time = 0;
-
-  while(t && !_job_cancelled(job))
+  const int num_pipes = _control_export_num_pipes(total, mstorage, mformat, fdata);
+  const double start_time = dt_get_wtime();
+
+  if(num_pipes > 1)
+  {
+    dt_control_export_sched_t sched = { 0 };
+    sched.job = job;
+    sched.settings = settings;
+    sched.mformat = mformat;
+    sched.mstorage = mstorage;
+    sched.sdata = sdata;
+    sched.fdata = fdata;
+    sched.metadata = &metadata;
+    sched.total = total;
+    sched.tagid = tagid;
+    sched.etagid = etagid;
+    sched.imgs = malloc(sizeof(dt_imgid_t) * total);
+    if(sched.imgs)
+    {
+      int k = 0;
+      for(GList *l = params->index; l; l = g_list_next(l))
+        sched.imgs[k++] = GPOINTER_TO_INT(l->data);
+      tag_change = _control_export_parallel(&sched, num_pipes);
+      free(sched.imgs);
+    }
+    else
+      dt_control_job_cancel(job);
+  }
+  else
   {
-    const dt_imgid_t imgid = GPOINTER_TO_INT(t->data);
-    t = g_list_next(t);
-    const guint num = total - g_list_length(t);
-
-    // progress message
-    // update the message. initialize_store() might have changed the number of images
-    dt_control_job_set_progress_message(job, _("exporting %d / %d to %s"),
-                                             num, total, mstorage->name(mstorage));
+    GList *t = params->index;
+    double prev_time = 0;
 
-    // check if image still exists:
-    const dt_image_t *image = dt_image_cache_get(imgid, 'r');
-    if(image)
+    while(t && !_job_cancelled(job))
     {
-      char imgfilename[PATH_MAX] = { 0 };
-      gboolean from_cache = TRUE;
-      dt_image_full_path(image->id, imgfilename, sizeof(imgfilename), &from_cache);
-      if(!g_file_test(imgfilename, G_FILE_TEST_IS_REGULAR))
-      {
-        dt_control_log(_("image `%s' is currently unavailable"), image->filename);
-        dt_print(DT_DEBUG_ALWAYS, "image `%s' is currently unavailable", imgfilename);
-        // dt_image_remove(imgid);
-        dt_image_cache_read_release(image);
-      }
-      else
-      {
-        dt_image_cache_read_release(image);
-        if(mstorage->store(mstorage, sdata, imgid, mformat, fdata,
-                           num, total, settings->high_quality, settings->upscale,
-                           settings->is_scaling, settings->scale_factor,
-                           settings->export_masks, settings->icc_type,
-                           settings->icc_filename, settings->icc_intent,
-                           &metadata) != 0)
-          dt_control_job_cancel(job);
-        else
-        {
-          // remove 'changed' tag from image
-          if(dt_tag_detach(tagid, imgid, FALSE, FALSE)) tag_change = TRUE;
-
-          // make sure the 'exported' tag is set on the image
-          if(dt_tag_attach(etagid, imgid, FALSE, FALSE)) tag_change = TRUE;
-
-          /* register export timestamp in cache */
-          dt_image_cache_set_export_timestamp(imgid);
-        }
-      }
+      const dt_imgid_t imgid = GPOINTER_TO_INT(t->data);
+      t = g_list_next(t);
+      const guint num = total - g_list_length(t);
+
+      // progress message
+      // update the message. initialize_store() might have changed the number of images
+      dt_control_job_set_progress_message(job, _("exporting %d / %d to %s"),
+                                               num, total, mstorage->name(mstorage));
+
+      gboolean stored = FALSE;
+      if(!_control_export_image(settings, mstorage, sdata, mformat, fdata,
+                                &metadata, imgid, num, total, &stored))
+        dt_control_job_cancel(job);
+      else if(stored && _control_export_mark_exported(imgid, tagid, etagid))
+        tag_change = TRUE;
+
+      fraction += 1.0 / total;
+      _update_progress(job, fraction, &prev_time);
     }
-
-    fraction += 1.0 / total;
-    _update_progress(job, fraction, &prev_time);
   }
+
+  const double elapsed = dt_get_wtime() - start_time;
+  if(total > 0 && elapsed > 0.0)
+    dt_print(DT_DEBUG_IMAGEIO | DT_DEBUG_PERF,
+             "[export_job] %u images in %.3f secs (%.2f images/s) using %d pipeline%s",
+             total, elapsed, total / elapsed, num_pipes, num_pipes > 1 ? "s" : "");
+
   g_list_free_full(metadata.list, g_free);
 
   if(mstorage->finalize_store) mstorage->finalize_store(mstorage, sdata);
@@ -19,8 +19,19 @@
 #include "common/darktable.h"
 #include "common/collection.h"
 #include "common/film.h"
+#include <glib/gstdio.h>
 #include <stdlib.h>
 
+// the import reads the metadata of each file in turn, which is mostly
+// waiting for the storage (memory cards, network shares). a pool of
+// workers reads the head of the next files and their sidecars so that
+// the import loop finds them in the page cache.
+#define MAX_IMPORT_PREFETCH_THREADS 32
+#define IMPORT_PREFETCH_WINDOW 64            // files read ahead of the import loop
+#define IMPORT_PREFETCH_BYTES (1024 * 1024)  // enough to cover the metadata of raw files
+// maximum number of images written in one database transaction
+#define IMPORT_BATCH_SIZE 256
+
 typedef struct dt_film_import1_t
 {
   dt_film_t *film;
@@ -227,6 +238,83 @@ static int _film_filename_cmp(gchar *a, gchar *b)
   return ret;
 }
 
+typedef struct dt_film_import_prefetch_t
+{
+  gchar **files;
+  int count;
+  int next;     // next file to be read by a worker
+  int limit;    // files up to this one may be read
+  gboolean stop;
+  GMutex lock;
+  GCond cond;
+} dt_film_import_prefetch_t;
+
+static void _prefetch_file(const char *filename,
+                           const size_t max_bytes,
+                           char *buf,
+                           const size_t buf_size)
+{
+  FILE *f = g_fopen(filename, "rb");
+  if(!f) return;
+  size_t total = 0;
+  size_t rd;
+  while(total < max_bytes && (rd = fread(buf, 1, buf_size, f)) > 0)
+    total += rd;
+  fclose(f);
+}
+
+static gpointer _prefetch_thread(gpointer arg)
+{
+  dt_film_import_prefetch_t *pf = (dt_film_import_prefetch_t *)arg;
+  const size_t buf_size = 64 * 1024;
+  char *buf = g_malloc(buf_size);
+
+  while(TRUE)
+  {
+    g_mutex_lock(&pf->lock);
+    while(!pf->stop && pf->next >= pf->limit)
+      g_cond_wait(&pf->cond, &pf->lock);
+    const int idx = pf->stop || pf->next >= pf->count ? -1 : pf->next++;
+    g_mutex_unlock(&pf->lock);
+    if(idx < 0) break;
+
+    _prefetch_file(pf->files[idx], IMPORT_PREFETCH_BYTES, buf, buf_size);
+    gchar *xmp = g_strconcat(pf->files[idx], ".xmp", NULL);
+    _prefetch_file(xmp, IMPORT_PREFETCH_BYTES, buf, buf_size);
+    g_free(xmp);
+  }
+
+  g_free(buf);
+  return NULL;
+}
+
+// allow the workers to read ahead of the image about to be imported
+static void _prefetch_advance(dt_film_import_prefetch_t *pf,
+                              const int current)
+{
+  g_mutex_lock(&pf->lock);
+  pf->limit = MIN(current + IMPORT_PREFETCH_WINDOW, pf->count);
+  g_cond_broadcast(&pf->cond);
+  g_mutex_unlock(&pf->lock);
+}
+
+static int _prefetch_num_threads(const int count)
+{
+  const int num_threads = dt_conf_get_int("import_prefetch_threads");
+  return MIN(MIN(num_threads, MAX_IMPORT_PREFETCH_THREADS), count);
+}
+
+// commit the images written since the last call, then raise their lua
+// events which must not run inside the import transaction
+static void _import_commit(GList **batch,
+                           int *in_batch)
+{
+  if(*in_batch == 0) return;
+  dt_database_release_transaction(darktable.db);
+  *in_batch = 0;
+  dt_image_import_batch_notify(batch);
+}
+
 static void _film_import1(dt_job_t *job, dt_film_t *film, GList *images)
 {
   // first, gather all images to import if not already given
@@ -299,10 +387,33 @@ static void _film_import1(dt_job_t *job, dt_film_t *film, GList *images)
   GList *imgs = NULL;
   GList *all_imgs = NULL;
 
-  /* loop thru the images and import to current film roll */
+  /* start reading ahead of the import */
+  dt_film_import_prefetch_t pf = { 0 };
+  pf.files = g_new(gchar *, total);
+  pf.count = total;
+  for(GList *image = images; image; image = g_list_next(image))
+    pf.files[pf.next++] = image->data;
+  pf.next = 0;
+  g_mutex_init(&pf.lock);
+  g_cond_init(&pf.cond);
+  _prefetch_advance(&pf, 0);
+
+  const int num_threads = _prefetch_num_threads(total);
+  GThread **threads = num_threads > 0 ? g_new0(GThread *, num_threads) : NULL;
+  for(int t = 0; t < num_threads; t++)
+    threads[t] = g_thread_new("import prefetch", _prefetch_thread, &pf);
+
+  /* loop thru the images and import to current film roll. this job is the
+     only writer of the import: the rows of up to IMPORT_BATCH_SIZE images
+     are written in one transaction, committed at the latest with each
+     interface update so that the lighttable sees them */
   dt_film_t *cfr = film;
+  GList *batch = NULL;
+  int in_batch = 0;
   int pending = 0;
-  double last_update = dt_get_wtime();
+  int done = 0;
+  const double start_time = dt_get_wtime();
+  double last_update = start_time;
   for(GList *image = images; image; image = g_list_next(image))
   {
     gchar *cdn = g_path_get_dirname((const gchar *)image->data);
@@ -310,6 +421,7 @@ static void _film_import1(dt_job_t *job, dt_film_t *film, GList *images)
     /* check if we need to initialize a new filmroll */
     if(!cfr || g_strcmp0(cfr->dirname, cdn) != 0)
     {
+      _import_commit(&batch, &in_batch);
       _apply_filmroll_gpx(cfr);
 
       /* cleanup previously imported filmroll*/
@@ -333,7 +445,10 @@ static void _film_import1(dt_job_t *job, dt_film_t *film, GList *images)
     g_free(cdn);
 
     /* import image */
-    const dt_imgid_t imgid = dt_image_import(cfr->id, (const gchar *)image->data, FALSE, FALSE);
+    if(in_batch == 0) dt_database_start_transaction(darktable.db);
+    const dt_imgid_t imgid = dt_image_import_batched(cfr->id, (const gchar *)image->data, &batch);
+    in_batch++;
+    _prefetch_advance(&pf, ++done);
     pending++;  // we have another image which hasn't been reported yet
     fraction += 1.0 / total;
     dt_control_job_set_progress(job, fraction);
@@ -343,8 +458,15 @@ static void _film_import1(dt_job_t *job, dt_film_t *film, GList *images)
     const double curr_time = dt_get_wtime();
     // if we've imported at least four images without an update, and it's been at least half a second since the last
     //   one, update the interface
-    if(pending >= 4 && curr_time - last_update > 0.5)
+    const gboolean update = pending >= 4 && curr_time - last_update > 0.5;
+    if(update || in_batch >= IMPORT_BATCH_SIZE)
+      _import_commit(&batch, &in_batch);
+    if(update)
     {
+      dt_control_job_set_progress_message
+        (job, ngettext("importing %d/%d image, %.1f images/s",
+                       "importing %d/%d images, %.1f images/s", total),
+         done, total, done / (curr_time - start_time));
       dt_collection_update_query(darktable.collection, DT_COLLECTION_CHANGE_RELOAD, DT_COLLECTION_PROP_UNDEF,
                                  g_list_copy(imgs));
       g_list_free(imgs);
@@ -357,6 +479,24 @@ static void _film_import1(dt_job_t *job, dt_film_t *film, GList *images)
       break;
   }
 
+  _import_commit(&batch, &in_batch);
+
+  g_mutex_lock(&pf.lock);
+  pf.stop = TRUE;
+  g_cond_broadcast(&pf.cond);
+  g_mutex_unlock(&pf.lock);
+  for(int t = 0; t < num_threads; t++)
+    g_thread_join(threads[t]);
+  g_free(threads);
+  g_mutex_clear(&pf.lock);
+  g_cond_clear(&pf.cond);
+  g_free(pf.files);
+
+  const double elapsed = dt_get_wtime() - start_time;
+  dt_print(DT_DEBUG_PERF,
+           "[film_import] %d images in %.3f secs (%.1f images/s) using %d prefetch threads",
+           done, elapsed, elapsed > 0.0 ? done / elapsed : 0.0, num_threads);
+
   g_list_free_full(images, g_free);
   all_imgs = g_list_reverse(all_imgs);
 
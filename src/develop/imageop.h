@@ -107,6 +107,7 @@ typedef enum dt_iop_flags_t
   IOP_FLAGS_WRITE_RASTER = 1 << 19,      // modules not supporting blending might still advertise a raster mask
   IOP_FLAGS_WRITE_PIPECACHE = 1 << 20,   // enforce pipecache writing
   IOP_FLAGS_WRITE_PIPECACHE_IN = 1 << 21, // makes input cacheline important, also ensure input pipecache writing for OpenCL code
+  IOP_FLAGS_ROW_STREAMING = 1 << 22,     // point-wise, exports may process it in row bands together with its neighbours
 } dt_iop_flags_t;
 
 /** status of a module*/
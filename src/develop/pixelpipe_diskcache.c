@@ -0,0 +1,442 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "develop/pixelpipe_diskcache.h"
+#include "common/file_location.h"
+#include "common/image.h"
+#include "control/conf.h"
+#include "develop/format.h"
+#include "develop/pixelpipe.h"
+
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#ifdef HAVE_IMATH
+#include "Imath/half.h"
+#endif
+
+#define DT_PIPECACHE_DISK_MAGIC "DTPC"
+#define DT_PIPECACHE_DISK_VERSION 1
+#define DT_PIPECACHE_DISK_CHUNK ((size_t)1 << 20)
+
+typedef struct dt_pipecache_disk_header_t
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t dsc_size;      // sizeof(dt_iop_buffer_dsc_t) of the writer
+  uint32_t half;          // float data is stored as float16
+  uint64_t size;          // uncompressed size of the buffer in the pipe
+  dt_iop_buffer_dsc_t dsc;
+} dt_pipecache_disk_header_t;
+
+static GMutex _diskcache_lock;
+static gboolean _diskcache_scanned = FALSE;
+static size_t _diskcache_usage = 0;
+
+static gchar *_diskcache_dir(void)
+{
+  char cachedir[PATH_MAX] = { 0 };
+  dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+  return g_build_filename(cachedir, "pipecache", NULL);
+}
+
+static gchar *_diskcache_filename(const dt_hash_t hash)
+{
+  gchar *dir = _diskcache_dir();
+  gchar *name = g_strdup_printf("%016" PRIx64 ".dtpc", hash);
+  gchar *filename = g_build_filename(dir, name, NULL);
+  g_free(name);
+  g_free(dir);
+  return filename;
+}
+
+static size_t _diskcache_quota(void)
+{
+  return (size_t)MAX(dt_conf_get_int("pixelpipe/diskcache/quota"), 0) * DT_MEGA;
+}
+
+gboolean dt_dev_pixelpipe_diskcache_wanted(dt_dev_pixelpipe_t *pipe,
+                                           const dt_iop_module_t *module,
+                                           const int position)
+{
+  if(!module
+     || !dt_pipe_is_export(pipe)
+     || pipe->nocache
+     || pipe->want_detail_mask
+     || !dt_conf_get_bool("pixelpipe/diskcache/enabled"))
+    return FALSE;
+
+  const char *modules = dt_conf_get_string_const("pixelpipe/diskcache/modules");
+  if(!dt_str_commasubstring(modules, module->op))
+    return FALSE;
+
+  // a raster mask written before this position would not be restored
+  // from the disk cache, so don't take any risk
+  GList *pieces = pipe->nodes;
+  for(int k = 0; k < position && pieces; k++)
+  {
+    const dt_dev_pixelpipe_iop_t *piece = pieces->data;
+    if(piece->enabled
+       && piece->module->raster_mask.source.users
+       && g_hash_table_size(piece->module->raster_mask.source.users) > 0)
+      return FALSE;
+    pieces = g_list_next(pieces);
+  }
+  return TRUE;
+}
+
+static dt_hash_t _diskcache_profile_hash(dt_hash_t hash,
+                                         const dt_iop_order_iccprofile_info_t *info)
+{
+  if(!info) return dt_hash(hash, "none", 4);
+  hash = dt_hash(hash, &info->type, sizeof(info->type));
+  hash = dt_hash(hash, info->filename, strlen(info->filename));
+  return dt_hash(hash, &info->intent, sizeof(info->intent));
+}
+
+dt_hash_t dt_dev_pixelpipe_diskcache_hash(dt_dev_pixelpipe_t *pipe,
+                                          const dt_iop_roi_t *roi,
+                                          const int position)
+{
+  /* unlike _dev_pixelpipe_cache_basichash() nothing here may depend on
+     the session:
+       1) the imgid is not stable for darktable-cli using an in-memory library,
+          use the source file with its size and modification time instead.
+       2) the profile infos are pointers, use their type, file and intent.
+       3) the darktable version as module algorithms might change.
+  */
+  dt_hash_t hash = dt_hash(DT_INITHASH, darktable_package_version,
+                           strlen(darktable_package_version));
+
+  char filename[PATH_MAX] = { 0 };
+  dt_image_full_path(pipe->image.id, filename, sizeof(filename), NULL);
+  hash = dt_hash(hash, filename, strlen(filename));
+  GStatBuf st;
+  if(g_stat(filename, &st) == 0)
+  {
+    const int64_t stat[2] = { (int64_t)st.st_size, (int64_t)st.st_mtime };
+    hash = dt_hash(hash, stat, sizeof(stat));
+  }
+
+  const uint32_t pipemode[4] = { (uint32_t)pipe->type,
+                                 (uint32_t)pipe->want_detail_mask,
+                                 (uint32_t)pipe->iwidth,
+                                 (uint32_t)pipe->iheight };
+  hash = dt_hash(hash, pipemode, sizeof(pipemode));
+  hash = _diskcache_profile_hash(hash, pipe->input_profile_info);
+  hash = _diskcache_profile_hash(hash, pipe->work_profile_info);
+  hash = _diskcache_profile_hash(hash, pipe->output_profile_info);
+  hash = _diskcache_profile_hash(hash, pipe->export_profile_info);
+
+  // same pieces as taken into account by _dev_pixelpipe_cache_basichash()
+  GList *pieces = pipe->nodes;
+  for(int k = 0; k < position && pieces; k++)
+  {
+    dt_dev_pixelpipe_iop_t *piece = pieces->data;
+    if(piece->module->enabled || piece->enabled)
+      hash = dt_hash(hash, &piece->hash, sizeof(piece->hash));
+    pieces = g_list_next(pieces);
+  }
+
+  return dt_hash(hash, roi, sizeof(dt_iop_roi_t));
+}
+
+static gboolean _diskcache_read_header(FILE *f,
+                                       dt_pipecache_disk_header_t *header,
+                                       const size_t size)
+{
+  return fread(header, sizeof(dt_pipecache_disk_header_t), 1, f) == 1
+    && !memcmp(header->magic, DT_PIPECACHE_DISK_MAGIC, 4)
+    && header->version == DT_PIPECACHE_DISK_VERSION
+    && header->dsc_size == sizeof(dt_iop_buffer_dsc_t)
+    && header->size == size;
+}
+
+gboolean dt_dev_pixelpipe_diskcache_available(const dt_hash_t hash,
+                                              const size_t size)
+{
+  gchar *filename = _diskcache_filename(hash);
+  FILE *f = g_fopen(filename, "rb");
+  g_free(filename);
+  if(!f) return FALSE;
+
+  dt_pipecache_disk_header_t header = { 0 };
+  const gboolean valid = _diskcache_read_header(f, &header, size);
+  fclose(f);
+  return valid;
+}
+
+gboolean dt_dev_pixelpipe_diskcache_load(const dt_hash_t hash,
+                                         void *data,
+                                         const size_t size,
+                                         dt_iop_buffer_dsc_t *dsc)
+{
+  gchar *filename = _diskcache_filename(hash);
+  FILE *f = g_fopen(filename, "rb");
+  if(!f)
+  {
+    g_free(filename);
+    return FALSE;
+  }
+
+  dt_pipecache_disk_header_t header = { 0 };
+  gboolean success = _diskcache_read_header(f, &header, size);
+#ifndef HAVE_IMATH
+  if(header.half) success = FALSE;
+#endif
+
+  uint8_t *in = success ? malloc(DT_PIPECACHE_DISK_CHUNK) : NULL;
+  // float16 data is inflated into a bounce buffer and expanded from there
+  uint16_t *half = success && header.half ? malloc(DT_PIPECACHE_DISK_CHUNK) : NULL;
+  z_stream zs = { 0 };
+  success = in && (!header.half || half) && inflateInit(&zs) == Z_OK;
+
+  const size_t stored = header.half ? size / 2 : size;
+  size_t done = 0;
+  while(success && done < stored)
+  {
+    const size_t chunk = MIN(stored - done, DT_PIPECACHE_DISK_CHUNK);
+    zs.next_out = header.half ? (Bytef *)half : (Bytef *)data + done;
+    zs.avail_out = chunk;
+    // fill the whole chunk so that float16 values are never split
+    while(success && zs.avail_out > 0)
+    {
+      if(zs.avail_in == 0)
+      {
+        zs.avail_in = fread(in, 1, DT_PIPECACHE_DISK_CHUNK, f);
+        zs.next_in = in;
+      }
+      const int ret = inflate(&zs, Z_NO_FLUSH);
+      if(ret == Z_STREAM_END) break;
+      if(ret != Z_OK) success = FALSE; // also Z_BUF_ERROR for a truncated file
+    }
+    if(zs.avail_out > 0) success = FALSE;
+#ifdef HAVE_IMATH
+    if(success && header.half)
+    {
+      float *out = (float *)data + done / sizeof(uint16_t);
+      for(size_t k = 0; k < chunk / sizeof(uint16_t); k++)
+        out[k] = imath_half_to_float(half[k]);
+    }
+#endif
+    done += chunk;
+  }
+  success = success && done == stored;
+
+  inflateEnd(&zs);
+  free(half);
+  free(in);
+  fclose(f);
+
+  if(success)
+  {
+    *dsc = header.dsc;
+    // mark as recently used for the lru eviction
+    g_utime(filename, NULL);
+  }
+  g_free(filename);
+  return success;
+}
+
+typedef struct _diskcache_file_t
+{
+  gchar *path;
+  size_t size;
+  time_t mtime;
+} _diskcache_file_t;
+
+static gint _diskcache_sort_mtime(gconstpointer a, gconstpointer b)
+{
+  const _diskcache_file_t *fa = a;
+  const _diskcache_file_t *fb = b;
+  return (fa->mtime > fb->mtime) - (fa->mtime < fb->mtime);
+}
+
+static void _diskcache_free_file(gpointer data)
+{
+  _diskcache_file_t *file = data;
+  g_free(file->path);
+  g_free(file);
+}
+
+// scans the cache directory, returns the total size and optionally the
+// files sorted from least to most recently used. call with lock held.
+static size_t _diskcache_scan(GList **files)
+{
+  size_t total = 0;
+  gchar *dirname = _diskcache_dir();
+  GDir *dir = g_dir_open(dirname, 0, NULL);
+  if(dir)
+  {
+    const gchar *name;
+    while((name = g_dir_read_name(dir)))
+    {
+      if(!g_str_has_suffix(name, ".dtpc")) continue;
+      gchar *path = g_build_filename(dirname, name, NULL);
+      GStatBuf st;
+      if(g_stat(path, &st) == 0)
+      {
+        total += st.st_size;
+        if(files)
+        {
+          _diskcache_file_t *file = g_malloc(sizeof(_diskcache_file_t));
+          file->path = path;
+          file->size = st.st_size;
+          file->mtime = st.st_mtime;
+          *files = g_list_prepend(*files, file);
+          path = NULL;
+        }
+      }
+      g_free(path);
+    }
+    g_dir_close(dir);
+  }
+  g_free(dirname);
+  if(files) *files = g_list_sort(*files, _diskcache_sort_mtime);
+  return total;
+}
+
+// drop least recently used files until we are 10% below quota. call with lock held.
+static void _diskcache_evict(const size_t quota)
+{
+  GList *files = NULL;
+  _diskcache_usage = _diskcache_scan(&files);
+  const size_t target = quota / 10 * 9;
+  for(GList *l = files; l && _diskcache_usage > target; l = g_list_next(l))
+  {
+    const _diskcache_file_t *file = l->data;
+    if(g_unlink(file->path) == 0)
+      _diskcache_usage -= MIN(file->size, _diskcache_usage);
+  }
+  g_list_free_full(files, _diskcache_free_file);
+}
+
+void dt_dev_pixelpipe_diskcache_store(const dt_hash_t hash,
+                                      const void *data,
+                                      const size_t size,
+                                      const dt_iop_buffer_dsc_t *dsc)
+{
+  const size_t quota = _diskcache_quota();
+  if(size == 0 || size > quota) return;
+
+  gchar *dir = _diskcache_dir();
+  const int err = g_mkdir_with_parents(dir, 0750);
+  g_free(dir);
+  if(err) return;
+
+  dt_pipecache_disk_header_t header = { 0 };
+  memcpy(header.magic, DT_PIPECACHE_DISK_MAGIC, 4);
+  header.version = DT_PIPECACHE_DISK_VERSION;
+  header.dsc_size = sizeof(dt_iop_buffer_dsc_t);
+  header.size = size;
+  header.dsc = *dsc;
+#ifdef HAVE_IMATH
+  header.half = dsc->datatype == TYPE_FLOAT
+                && dt_conf_get_bool("pixelpipe/diskcache/half_float");
+#endif
+
+  gchar *filename = _diskcache_filename(hash);
+  // write to a temporary file first so that concurrent exports never
+  // see a partial file
+  gchar *tmpname = g_strdup_printf("%s.%p.tmp", filename, (void *)g_thread_self());
+  FILE *f = g_fopen(tmpname, "wb");
+
+  uint8_t *out = f ? malloc(DT_PIPECACHE_DISK_CHUNK) : NULL;
+  uint16_t *half = out && header.half ? malloc(DT_PIPECACHE_DISK_CHUNK) : NULL;
+  z_stream zs = { 0 };
+  gboolean success = out
+                     && (!header.half || half)
+                     && fwrite(&header, sizeof(header), 1, f) == 1
+                     && deflateInit(&zs, Z_BEST_SPEED) == Z_OK;
+
+  const size_t floats_per_chunk = DT_PIPECACHE_DISK_CHUNK / sizeof(uint16_t);
+  size_t done = 0;
+  size_t written = sizeof(header);
+  while(success)
+  {
+    const gboolean last = header.half
+      ? done + floats_per_chunk * sizeof(float) >= size
+      : done + DT_PIPECACHE_DISK_CHUNK >= size;
+    if(header.half)
+    {
+#ifdef HAVE_IMATH
+      const size_t n = MIN(floats_per_chunk, (size - done) / sizeof(float));
+      const float *in = (const float *)((const uint8_t *)data + done);
+      for(size_t k = 0; k < n; k++)
+        half[k] = imath_float_to_half(in[k]);
+      zs.next_in = (Bytef *)half;
+      zs.avail_in = n * sizeof(uint16_t);
+      done += n * sizeof(float);
+#endif
+    }
+    else
+    {
+      const size_t n = MIN(DT_PIPECACHE_DISK_CHUNK, size - done);
+      zs.next_in = (Bytef *)data + done;
+      zs.avail_in = n;
+      done += n;
+    }
+
+    do
+    {
+      zs.next_out = out;
+      zs.avail_out = DT_PIPECACHE_DISK_CHUNK;
+      const int ret = deflate(&zs, last ? Z_FINISH : Z_NO_FLUSH);
+      const size_t have = DT_PIPECACHE_DISK_CHUNK - zs.avail_out;
+      if(ret == Z_STREAM_ERROR || fwrite(out, 1, have, f) != have)
+        success = FALSE;
+      written += have;
+    } while(success && zs.avail_out == 0);
+
+    if(last) break;
+  }
+  if(out) deflateEnd(&zs);
+  free(half);
+  free(out);
+  if(f && fclose(f)) success = FALSE;
+
+  if(success && g_rename(tmpname, filename) == 0)
+  {
+    g_mutex_lock(&_diskcache_lock);
+    if(!_diskcache_scanned)
+    {
+      _diskcache_usage = _diskcache_scan(NULL);
+      _diskcache_scanned = TRUE;
+    }
+    else
+      _diskcache_usage += written;
+    if(_diskcache_usage > quota)
+      _diskcache_evict(quota);
+    g_mutex_unlock(&_diskcache_lock);
+
+    dt_print(DT_DEBUG_PIPE | DT_DEBUG_CACHE,
+             "[pixelpipe_diskcache] stored %" PRIx64 " %zuMB -> %zuMB, usage %zuMB",
+             hash, size / DT_MEGA, written / DT_MEGA, _diskcache_usage / DT_MEGA);
+  }
+  else if(f)
+    g_unlink(tmpname);
+
+  g_free(tmpname);
+  g_free(filename);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,73 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <inttypes.h>
+
+struct dt_dev_pixelpipe_t;
+struct dt_iop_buffer_dsc_t;
+struct dt_iop_roi_t;
+struct dt_iop_module_t;
+
+/**
+ * optional persistent tier below the in-memory pixelpipe cache.
+ *
+ * the output of a few expensive modules at the head of the pipe (demosaic,
+ * denoiseprofile, lens by default) is written to the user cache directory
+ * when processed in an export pipe, so that re-exporting the same images
+ * with a different size, format or watermark - or a darktable-cli rerun -
+ * can start after those modules.
+ *
+ * the in-memory cache hash can't be used as key as it includes pointers, so
+ * a key that is stable across sessions is built from the image file, the
+ * piece hashes, the profiles and the roi. files are zlib compressed and the
+ * directory is kept below a size quota by evicting least recently used files.
+ */
+
+/** TRUE if the output of module at position should be looked up in / written to the disk cache */
+gboolean dt_dev_pixelpipe_diskcache_wanted(struct dt_dev_pixelpipe_t *pipe,
+                                           const struct dt_iop_module_t *module,
+                                           const int position);
+
+/** session independent hash of the pipe up to position, same meaning as in dt_dev_pixelpipe_cache_hash() */
+dt_hash_t dt_dev_pixelpipe_diskcache_hash(struct dt_dev_pixelpipe_t *pipe,
+                                          const struct dt_iop_roi_t *roi,
+                                          const int position);
+
+/** TRUE if there is a cache file for hash holding exactly size bytes */
+gboolean dt_dev_pixelpipe_diskcache_available(const dt_hash_t hash,
+                                              const size_t size);
+
+/** reads the cached buffer into data, returns TRUE on success */
+gboolean dt_dev_pixelpipe_diskcache_load(const dt_hash_t hash,
+                                         void *data,
+                                         const size_t size,
+                                         struct dt_iop_buffer_dsc_t *dsc);
+
+/** writes the buffer and evicts old files if above quota */
+void dt_dev_pixelpipe_diskcache_store(const dt_hash_t hash,
+                                      const void *data,
+                                      const size_t size,
+                                      const struct dt_iop_buffer_dsc_t *dsc);
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -22,6 +22,7 @@
 #include "common/opencl.h"
 #include "common/iop_order.h"
 #include "common/imagebuf.h"
+#include "common/trace.h"
 #include "control/control.h"
 #include "control/signal.h"
 #include "develop/blend.h"
@@ -84,6 +85,7 @@ typedef enum dt_pixelpipe_flow_t
 } dt_pixelpipe_flow_t;
 
 #include "develop/pixelpipe_cache.c"
+#include "develop/pixelpipe_diskcache.c"
 
 const char *dt_dev_pixelpipe_type_to_str(const dt_dev_pixelpipe_type_t pipe_type)
 {
@@ -351,7 +353,7 @@ size_t dt_get_available_pipe_mem(const dt_dev_pixelpipe_t *pipe)
       "allmem=%zuMB, cachemem=%zuMB, granted=%zuMB",
       allmem / DT_MEGA, cachemem / DT_MEGA, granted / DT_MEGA);
 
-  return granted / (dt_pipe_is_thumb(pipe) ? 3 : 1);
+  return granted / (pipe && dt_pipe_is_thumb(pipe) ? 3 : 1);
 }
 
 static void get_output_format(dt_iop_module_t *module,
@@ -1536,6 +1538,38 @@ static void _cpu_benchmark(dt_dev_pixelpipe_t *pipe,
       "[bench module %s plain] `%s' takes %8.5fs,%7.2fmpix,%9.3fpix/us",
       full ? "full" : "export", module->op, clock, mpix, mpix/clock);
   darktable.unmuted = old_muted;
+
+  if(module->benchmark)
+    module->benchmark(module, piece, in, out, roi_in, roi_out);
+}
+
+// one trace timeline row per pipe type and image
+static void _trace_track(const dt_dev_pixelpipe_t *pipe,
+                         char *track,
+                         const size_t size)
+{
+  snprintf(track, size, "%s pipe, image %d",
+           dt_dev_pixelpipe_type_to_str(pipe->type), pipe->image.id);
+}
+
+#define TRACE_ROI_FMT "[%d,%d,%d,%d,%.5f]"
+#define TRACE_ROI(roi) (roi)->x, (roi)->y, (roi)->width, (roi)->height, (roi)->scale
+
+static void _trace_cache_hit(const dt_dev_pixelpipe_t *pipe,
+                             const dt_iop_module_t *module,
+                             const dt_iop_roi_t *roi_out,
+                             const char *cache)
+{
+  if(!dt_trace_enabled()) return;
+
+  char track[128];
+  _trace_track(pipe, track, sizeof(track));
+  char name[64];
+  snprintf(name, sizeof(name), "%s%s",
+           module ? module->op : "input", module ? dt_iop_get_instance_id(module) : "");
+  dt_trace_instant(track, "module", name,
+                   "\"cache\":\"%s\",\"roi_out\":" TRACE_ROI_FMT,
+                   cache, TRACE_ROI(roi_out));
 }
 
 static gboolean _pixelpipe_process_on_CPU(dt_dev_pixelpipe_t *pipe,
@@ -1933,6 +1967,209 @@ static inline gboolean _dev_pixelpipe_early_exit(const dt_develop_t *dev,
       || (pipe->changed != DT_DEV_PIPE_UNCHANGED && pipe->changed != DT_DEV_PIPE_ZOOMED);
 }
 
+/* Row band streaming for exports.
+   A run of point-wise modules (IOP_FLAGS_ROW_STREAMING) ending at the current
+   position is processed band by band, each band passing through all of them
+   while it is still in the CPU caches. Only the input of the first and the
+   output of the last module are full buffers, the intermediate results are
+   never materialized and thus not available in the pixelpipe cache.
+   Returns the number of modules in that run.
+*/
+static int _stream_chain_length(dt_dev_pixelpipe_t *pipe,
+                                const dt_iop_roi_t *roi,
+                                GList *modules,
+                                GList *pieces,
+                                int pos)
+{
+  if(!dt_pipe_is_export(pipe)
+     || !dt_pipe_no_mask_display(pipe)
+     || !dt_conf_get_bool("pixelpipe/streaming/enabled"))
+    return 0;
+
+#ifdef HAVE_OPENCL
+  if(_opencl_pipe_isok(pipe))
+    return 0;
+#endif
+
+  int count = 0;
+  for(; modules; modules = g_list_previous(modules), pieces = g_list_previous(pieces), pos--)
+  {
+    dt_dev_pixelpipe_iop_t *piece = pieces->data;
+    if(_skip_piece_on_tags(piece))
+      continue;
+
+    dt_iop_module_t *module = piece->module;
+    if(!(module->flags() & IOP_FLAGS_ROW_STREAMING)
+       || module->input_colorspace(module, pipe, piece) == IOP_CS_RAW
+       || _piece_wants_blending(piece)
+       || (piece->request_histogram & DT_REQUEST_ON)
+       || dt_dev_pixelpipe_diskcache_wanted(pipe, module, pos))
+      break;
+
+    // row bands need the same roi in and out
+    dt_iop_roi_t roi_in = *roi;
+    module->modify_roi_in(module, piece, roi, &roi_in);
+    if(memcmp(&roi_in, roi, sizeof(dt_iop_roi_t)))
+      break;
+
+    count++;
+  }
+  return count;
+}
+
+// rows per band, a multiple of 16 keeps all band starts aligned to DT_CACHELINE_BYTES
+static int _stream_band_rows(const int width)
+{
+  const size_t band_size = (size_t)MAX(64, dt_conf_get_int("pixelpipe/streaming/band_size"))
+                            * 1024 * dt_get_num_threads();
+  const size_t rows = band_size / ((size_t)width * 4 * sizeof(float));
+  return MAX(16, (int)MIN(rows, INT_MAX) & ~15);
+}
+
+static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
+                                           dt_develop_t *dev,
+                                           void **output,
+                                           void **cl_mem_output,
+                                           dt_iop_buffer_dsc_t **out_format,
+                                           const dt_iop_roi_t *roi_out,
+                                           GList *modules,
+                                           GList *pieces,
+                                           const int pos);
+
+// process the last count modules up to pos in row bands of rows height, band holds two of them
+static gboolean _pixelpipe_process_stream(dt_dev_pixelpipe_t *pipe,
+                                          dt_develop_t *dev,
+                                          void **output,
+                                          dt_iop_buffer_dsc_t **out_format,
+                                          const dt_iop_roi_t *roi,
+                                          GList *modules,
+                                          GList *pieces,
+                                          int pos,
+                                          const int count,
+                                          const dt_hash_t hash,
+                                          const size_t bufsize,
+                                          float *band,
+                                          const int rows)
+{
+  dt_dev_pixelpipe_iop_t **chain = g_newa(dt_dev_pixelpipe_iop_t *, count);
+  // pipe->dsc as seen by each module, so that processed_maximum is right for every band
+  dt_iop_buffer_dsc_t *dsc = g_newa(dt_iop_buffer_dsc_t, count);
+
+  for(int n = count; n > 0; modules = g_list_previous(modules), pieces = g_list_previous(pieces), pos--)
+  {
+    dt_dev_pixelpipe_iop_t *piece = pieces->data;
+    if(_skip_piece_on_tags(piece))
+      continue;
+    chain[--n] = piece;
+    piece->processed_roi_in = piece->processed_roi_out = *roi;
+    piece->module->position = pos;
+  }
+
+  void *input = NULL;
+  void *cl_mem_input = NULL;
+  dt_iop_buffer_dsc_t _input_format = { 0 };
+  dt_iop_buffer_dsc_t *input_format = &_input_format;
+
+  if(_dev_pixelpipe_process_rec(pipe, dev, &input, &cl_mem_input, &input_format, roi,
+                                modules, pieces, pos)
+     || _pipe_has_shutdown(pipe))
+  {
+    dt_free_align(band);
+    return TRUE;
+  }
+
+  dt_iop_module_t *last = chain[count - 1]->module;
+  dt_dev_pixelpipe_cache_get(pipe, hash, bufsize, output, out_format, last, FALSE);
+
+  dt_print_pipe(DT_DEBUG_PIPE,
+                "process stream", pipe, last, DT_DEVICE_CPU, roi, roi,
+                "%d modules from `%s%s', %d rows per band",
+                count, chain[0]->module->op, dt_iop_get_instance_id(chain[0]->module), rows);
+
+  dt_times_t start;
+  dt_get_perf_times(&start);
+  const gint64 trace_start = dt_trace_now();
+
+  const dt_iop_order_iccprofile_info_t *const work_profile = dt_ioppr_get_pipe_work_profile_info(pipe);
+  const size_t in_bpp = dt_iop_buffer_dsc_to_bpp(input_format);
+  const size_t out_bpp = dt_iop_buffer_dsc_to_bpp(*out_format);
+  float *scratch[2] = { band, band + (size_t)4 * roi->width * rows };
+
+  for(int y = 0; y < roi->height; y += rows)
+  {
+    if(_pipe_has_shutdown(pipe))
+    {
+      dt_dev_pixelpipe_invalidate_cacheline(pipe, *output, "stream shutdown");
+      dt_free_align(band);
+      return TRUE;
+    }
+
+    dt_iop_roi_t band_roi = *roi;
+    band_roi.y += y;
+    band_roi.height = MIN(rows, roi->height - y);
+
+    float *src = (float *)((uint8_t *)input + in_bpp * roi->width * y);
+    dt_iop_colorspace_type_t cst = input_format->cst;
+    for(int i = 0; i < count; i++)
+    {
+      dt_dev_pixelpipe_iop_t *piece = chain[i];
+      dt_iop_module_t *module = piece->module;
+
+      if(y == 0)
+      {
+        piece->dsc_out = piece->dsc_in = i ? pipe->dsc : *input_format;
+        module->output_format(module, pipe, piece, &piece->dsc_out);
+        dsc[i] = pipe->dsc = piece->dsc_out;
+      }
+      else
+        pipe->dsc = dsc[i];
+
+      const dt_iop_colorspace_type_t cst_to = module->input_colorspace(module, pipe, piece);
+      if(cst != cst_to)
+      {
+        // the input cacheline is left untouched
+        float *tmp = src == scratch[0] || src == scratch[1] ? src : scratch[0];
+        dt_ioppr_transform_image_colorspace(module, src, tmp,
+                                            band_roi.width, band_roi.height,
+                                            cst, cst_to, &cst, work_profile);
+        src = tmp;
+      }
+
+      float *dst = i == count - 1
+        ? (float *)((uint8_t *)*output + out_bpp * roi->width * y)
+        : (src == scratch[0] ? scratch[1] : scratch[0]);
+
+      module->process(module, piece, src, dst, &band_roi, &band_roi);
+
+      cst = pipe->dsc.cst = module->output_colorspace(module, pipe, piece);
+      if(y == 0)
+        piece->dsc_out = pipe->dsc;
+      src = dst;
+    }
+  }
+  dt_free_align(band);
+
+  **out_format = pipe->dsc = chain[count - 1]->dsc_out;
+
+  dt_show_times_f(&start, "[dev_pixelpipe]", "[%s] processed %d modules up to `%s%s' on CPU in row bands",
+                  dt_dev_pixelpipe_type_to_str(pipe->type), count,
+                  last->op, dt_iop_get_instance_id(last));
+
+  if(dt_trace_enabled())
+  {
+    char track[128];
+    _trace_track(pipe, track, sizeof(track));
+    char name[64];
+    snprintf(name, sizeof(name), "%d modules up to %s%s", count, last->op, dt_iop_get_instance_id(last));
+    dt_trace_complete(track, "module", name, trace_start,
+                      "\"device\":\"CPU\",\"threads\":%d,\"bands\":%d,\"roi_out\":" TRACE_ROI_FMT
+                      ",\"out_bytes\":%zu,\"band_bytes\":%zu,\"cache\":\"miss\"",
+                      (int)dt_get_num_threads(), (roi->height + rows - 1) / rows, TRACE_ROI(roi),
+                      bufsize, (size_t)2 * 4 * sizeof(float) * roi->width * rows);
+  }
+  return FALSE;
+}
+
 // recursive helper for process, returns TRUE in case of unfinished work or error
 static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
                                            dt_develop_t *dev,
@@ -2013,12 +2250,36 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
     dt_print_pipe(DT_DEBUG_PIPE,
                   "pipe data: cache HIT",
                   pipe, module, DT_DEVICE_NONE, &roi_in, NULL);
+    _trace_cache_hit(pipe, module, roi_out, "hit");
     // we're done! as colorpicker/scopes only work on gamma iop
     // input -- which is unavailable via cache -- there's no need to
     // run these
     return FALSE;
   }
 
+  // 2) exports might find the output of an expensive early module on disk
+  const gboolean disk_cache = dt_dev_pixelpipe_diskcache_wanted(pipe, module, pos);
+  const dt_hash_t disk_hash = disk_cache
+    ? dt_dev_pixelpipe_diskcache_hash(pipe, roi_out, pos)
+    : DT_INVALID_HASH;
+
+  if(disk_cache && dt_dev_pixelpipe_diskcache_available(disk_hash, bufsize))
+  {
+    dt_dev_pixelpipe_cache_get(pipe, hash, bufsize,
+                               output, out_format, module, FALSE);
+    if(dt_dev_pixelpipe_diskcache_load(disk_hash, *output, bufsize, *out_format))
+    {
+      pipe->dsc = piece->dsc_out = **out_format;
+      dt_print_pipe(DT_DEBUG_PIPE,
+                    "pipe data: disk cache HIT",
+                    pipe, module, DT_DEVICE_NONE, &roi_in, NULL,
+                    "hash=%" PRIx64, disk_hash);
+      _trace_cache_hit(pipe, module, roi_out, "disk");
+      return FALSE;
+    }
+    dt_dev_pixelpipe_invalidate_cacheline(pipe, *output, "disk cache read failed");
+  }
+
   // if history changed, zoomed ... stop pipe processing, reasons will be handled in dt_dev_process_image_job()
   if(_dev_pixelpipe_early_exit(dev, pipe))
     return TRUE;
@@ -2031,6 +2292,7 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
     // import input array with given scale and roi
     dt_times_t start;
     dt_get_perf_times(&start);
+    const gint64 trace_start = dt_trace_now();
 
     const gboolean aligned_input = dt_check_aligned(pipe->input);
 
@@ -2175,9 +2437,30 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
     dt_show_times_f(&start, "[dev_pixelpipe]",
                     "initing base buffer [%s]", dt_dev_pixelpipe_type_to_str(pipe->type));
 
+    if(dt_trace_enabled())
+    {
+      char track[128];
+      _trace_track(pipe, track, sizeof(track));
+      dt_trace_complete(track, "module", "input", trace_start,
+                        "\"roi_out\":" TRACE_ROI_FMT ",\"out_bytes\":%zu",
+                        TRACE_ROI(roi_out), bufsize);
+    }
+
     return FALSE;
   }
 
+  // 3a) exports process a run of point-wise modules ending here in row bands
+  const int stream = _stream_chain_length(pipe, roi_out, modules, pieces, pos);
+  if(stream > 1)
+  {
+    const int rows = _stream_band_rows(roi_out->width);
+    float *band = dt_alloc_align_float((size_t)2 * 4 * roi_out->width * rows);
+    if(band)
+      return _pixelpipe_process_stream(pipe, dev, output, out_format, roi_out,
+                                       modules, pieces, pos, stream,
+                                       hash, bufsize, band, rows);
+  }
+
   // 3b) still recurse from end of list to first, obtain output array in &input
 
   // get region of interest which is needed in input
@@ -2253,6 +2536,7 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
 
   dt_times_t start;
   dt_get_perf_times(&start);
+  const gint64 trace_start = dt_trace_now();
 
   dt_pixelpipe_flow_t pixelpipe_flow =
     (PIXELPIPE_FLOW_NONE | PIXELPIPE_FLOW_HISTOGRAM_NONE);
@@ -3063,9 +3347,54 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
           ? "GPU"
           : pixelpipe_flow & PIXELPIPE_FLOW_BLENDED_ON_CPU ? "CPU" : "");
 
+  if(dt_trace_enabled())
+  {
+    const gboolean on_gpu = pixelpipe_flow & PIXELPIPE_FLOW_PROCESSED_ON_GPU;
+    const size_t m_bpp = MAX(in_bpp, bpp);
+    const size_t m_size = (size_t)MAX(roi_in.width, roi_out->width) * MAX(roi_in.height, roi_out->height);
+    // working memory the module asks for in its tiling callback
+    const size_t est_bytes =
+      (size_t)((on_gpu ? tiling.factor_cl : tiling.factor) * m_size * m_bpp) + tiling.overhead;
+    char track[128];
+    _trace_track(pipe, track, sizeof(track));
+    char name[64];
+    snprintf(name, sizeof(name), "%s%s", module->op, dt_iop_get_instance_id(module));
+    dt_trace_complete(track, "module", name, trace_start,
+                      "\"device\":\"%s\",\"devid\":%d,\"threads\":%d,\"tiling\":%s,"
+                      "\"roi_in\":" TRACE_ROI_FMT ",\"roi_out\":" TRACE_ROI_FMT ","
+                      "\"out_bytes\":%zu,\"est_bytes\":%zu,\"blended\":%s,\"cache\":\"miss\"",
+                      on_gpu ? "GPU" : "CPU", pipe->devid, on_gpu ? 0 : (int)dt_get_num_threads(),
+                      pixelpipe_flow & PIXELPIPE_FLOW_PROCESSED_WITH_TILING ? "true" : "false",
+                      TRACE_ROI(&roi_in), TRACE_ROI(roi_out), bufsize, est_bytes,
+                      _piece_wants_blending(piece) ? "true" : "false");
+  }
+
   // in case we get this buffer from the cache in the future, cache some stuff:
   **out_format = piece->dsc_out = pipe->dsc;
 
+  if(disk_cache)
+  {
+    void *host = *output;
+#ifdef HAVE_OPENCL
+    if(*cl_mem_output != NULL)
+    {
+      host = dt_alloc_aligned(bufsize);
+      if(host
+         && _copy_image_to_host_err(pipe->devid, host, *cl_mem_output,
+                                    roi_out->width, roi_out->height, bpp,
+                                    "disk cache") != CL_SUCCESS)
+      {
+        dt_free_align(host);
+        host = NULL;
+      }
+    }
+#endif
+    if(host)
+      dt_dev_pixelpipe_diskcache_store(disk_hash, host, bufsize, *out_format);
+    if(host != *output)
+      dt_free_align(host);
+  }
+
   // special cases for active modules with available gui
   if(module
       && darktable.develop->gui_attached
@@ -3293,6 +3622,8 @@ gboolean dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe,
                                   const float scale,
                                   const int devid)
 {
+  const gint64 trace_start = dt_trace_now();
+
   /* If there was a recent unserved DT_DEV_PIXELPIPE_STOP_NODES shutdown request
      we should respect that for an early pipe exit,
      otherwise we mark the pipe as processing
@@ -3439,6 +3770,18 @@ restart:
     pipe->devid = DT_DEVICE_CPU;
   }
 
+  if(dt_trace_enabled())
+  {
+    char track[128];
+    _trace_track(pipe, track, sizeof(track));
+    gchar *filename = dt_trace_escape(pipe->image.filename);
+    dt_trace_complete(track, "pipe", "pipe run", trace_start,
+                      "\"file\":\"%s\",\"roi\":" TRACE_ROI_FMT ",\"opencl\":%s,\"error\":%s",
+                      filename, TRACE_ROI(&roi), pipe->opencl_enabled ? "true" : "false",
+                      err ? "true" : "false");
+    g_free(filename);
+  }
+
   // ... and in case of other errors ...
   if(err)
     return TRUE;
@@ -50,43 +50,6 @@ static void _list_remove_thumb(gpointer user_data)
   dt_thumbnail_destroy(thumb);
 }
 
-// get imgid from rowid
-static dt_imgid_t _thumb_get_imgid(const int rowid)
-{
-  dt_imgid_t id = NO_IMGID;
-  sqlite3_stmt *stmt;
-  gchar *query = g_strdup_printf
-    ("SELECT imgid"
-     " FROM memory.collected_images"
-     " WHERE rowid=%d", rowid);
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    id = sqlite3_column_int(stmt, 0);
-  }
-  g_free(query);
-  sqlite3_finalize(stmt);
-  return id;
-}
-// get rowid from imgid
-static int _thumb_get_rowid(const dt_imgid_t imgid)
-{
-  dt_imgid_t id = NO_IMGID;
-  sqlite3_stmt *stmt;
-  gchar *query = g_strdup_printf
-    ("SELECT rowid"
-     " FROM memory.collected_images"
-     " WHERE imgid=%d", imgid);
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    id = sqlite3_column_int(stmt, 0);
-  }
-  g_free(query);
-  sqlite3_finalize(stmt);
-  return id;
-}
-
 // compute thumb_size, thumbs_per_row and rows for the current widget size
 // return TRUE if something as changed (or forced) FALSE otherwise
 static gboolean _compute_sizes(dt_culling_t *table,
@@ -1246,7 +1209,7 @@ static void _dt_filmstrip_change(gpointer instance,
   dt_culling_t *table = (dt_culling_t *)user_data;
   if(!gtk_widget_get_visible(table->widget)) return;
 
-  table->offset = _thumb_get_rowid(imgid);
+  table->offset = dt_collection_index_get_rowid(imgid);
   dt_culling_full_redraw(table, TRUE);
   _thumbs_refocus(table);
 }
@@ -1430,12 +1393,12 @@ void dt_culling_init(dt_culling_t *table,
 
   // if no new offset is available until now, we continue with the fallback one
   if(!dt_is_valid_imgid(first_id))
-    first_id = _thumb_get_imgid(fallback_offset);
+    first_id = dt_collection_index_get_imgid(fallback_offset);
 
   // if this also fails we start at the beginning of the collection
   if(!dt_is_valid_imgid(first_id))
   {
-    first_id = _thumb_get_imgid(1);
+    first_id = dt_collection_index_get_imgid(1);
   }
 
   if(!dt_is_valid_imgid(first_id))
@@ -1468,7 +1431,7 @@ void dt_culling_init(dt_culling_t *table,
       first_id = NO_IMGID;
     }
     table->navigate_inside_selection = TRUE;
-    table->offset = _thumb_get_rowid(first_id);
+    table->offset = dt_collection_index_get_rowid(first_id);
     table->offset_imgid = first_id;
     return;
   }
@@ -1526,7 +1489,7 @@ void dt_culling_init(dt_culling_t *table,
       table->navigate_inside_selection = (!table->selection_sync && inside);
   }
 
-  table->offset = _thumb_get_rowid(first_id);
+  table->offset = dt_collection_index_get_rowid(first_id);
   table->offset_imgid = first_id;
 }
 
@@ -1761,7 +1724,7 @@ static gboolean _thumbs_recreate_list_at(dt_culling_t *table,
   {
     const dt_thumbnail_t *thumb = table->list->data;
     table->offset_imgid = thumb->imgid;
-    table->offset = _thumb_get_rowid(thumb->imgid);
+    table->offset = dt_collection_index_get_rowid(thumb->imgid);
   }
   return TRUE;
 }
@@ -2362,7 +2325,7 @@ gboolean dt_culling_key_move(dt_culling_t *table,
 void dt_culling_change_offset_image(dt_culling_t *table,
                                     const dt_imgid_t imgid)
 {
-  table->offset = _thumb_get_rowid(imgid);
+  table->offset = dt_collection_index_get_rowid(imgid);
   dt_culling_full_redraw(table, TRUE);
   _thumbs_refocus(table);
 }
@@ -229,39 +229,6 @@ static dt_thumbnail_t *_thumb_get_under_mouse(dt_thumbtable_t *table)
   return _thumb_get_at_pos(table, x, y);
 }
 
-// get imgid from rowid
-static dt_imgid_t _thumb_get_imgid(const int rowid)
-{
-  dt_imgid_t id = NO_IMGID;
-  sqlite3_stmt *stmt;
-  gchar *query = g_strdup_printf
-    ("SELECT imgid FROM memory.collected_images WHERE rowid=%d", rowid);
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    id = sqlite3_column_int(stmt, 0);
-  }
-  g_free(query);
-  sqlite3_finalize(stmt);
-  return id;
-}
-// get rowid from imgid
-static int _thumb_get_rowid(const dt_imgid_t imgid)
-{
-  int id = -1;
-  sqlite3_stmt *stmt;
-  gchar *query = g_strdup_printf
-    ("SELECT rowid FROM memory.collected_images WHERE imgid=%d", imgid);
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    id = sqlite3_column_int(stmt, 0);
-  }
-  g_free(query);
-  sqlite3_finalize(stmt);
-  return id;
-}
-
 // get the coordinate of the rectangular area used by all the loaded thumbs
 static void _pos_compute_area(dt_thumbtable_t *table)
 {
@@ -822,12 +789,12 @@ static gboolean _move(dt_thumbtable_t *table,
     table->offset =
       MAX(1,
           table->offset - (ceilf((posy + old_areay) / (float)table->thumb_size) * table->thumbs_per_row));
-    table->offset_imgid = _thumb_get_imgid(table->offset);
+    table->offset_imgid = dt_collection_index_get_imgid(table->offset);
   }
   else if(table->mode == DT_THUMBTABLE_MODE_FILMSTRIP)
   {
     table->offset = MAX(1, table->offset - posx / table->thumb_size);
-    table->offset_imgid = _thumb_get_imgid(table->offset);
+    table->offset_imgid = dt_collection_index_get_imgid(table->offset);
   }
   else if(table->mode == DT_THUMBTABLE_MODE_ZOOM)
   {
@@ -2079,7 +2046,7 @@ static gboolean _filmstrip_ensure_imgid_visibility(dt_thumbtable_t *table, const
   // loaded range and scroll exactly enough to bring it into view
   const dt_thumbnail_t *first = table->list->data;
   const dt_thumbnail_t *last = g_list_last(table->list)->data;
-  const int rowid = _thumb_get_rowid(imgid);
+  const int rowid = dt_collection_index_get_rowid(imgid);
   if(rowid < 1)
     return FALSE;
 
@@ -2292,7 +2259,7 @@ static void _dt_collection_changed_callback(gpointer instance,
       if(tmpoff != table->offset_imgid)
       {
         old_offset = table->offset_imgid;
-        const int active_rowid = _thumb_get_rowid(tmpoff);
+        const int active_rowid = dt_collection_index_get_rowid(tmpoff);
         if(active_rowid > 0)
           table->offset = active_rowid;
         table->offset_imgid = tmpoff;
@@ -2301,7 +2268,7 @@ static void _dt_collection_changed_callback(gpointer instance,
     }
     dt_imgid_t newid = table->offset_imgid;
     if(newid <= 0 && table->offset > 0)
-      newid = _thumb_get_imgid(table->offset);
+      newid = dt_collection_index_get_imgid(table->offset);
 
     // is the current offset imgid in the changed list
     gboolean in_list = FALSE;
@@ -2317,7 +2284,7 @@ static void _dt_collection_changed_callback(gpointer instance,
     if(in_list)
     {
       if(dt_is_valid_imgid(next)
-         && _thumb_get_rowid(table->offset_imgid) != table->offset)
+         && dt_collection_index_get_rowid(table->offset_imgid) != table->offset)
       {
         // if offset has changed, that means the offset img has
         // moved. So we use the next untouched image as offset but we
@@ -2370,7 +2337,7 @@ static void _dt_collection_changed_callback(gpointer instance,
     }
 
     // get the new rowid of the new offset image
-    int nrow = _thumb_get_rowid(newid);
+    int nrow = dt_collection_index_get_rowid(newid);
 
     // if we don't have a valid rowid that means the image with newid
     // doesn't exist in the new memory.collected_images as we still
@@ -2393,7 +2360,7 @@ static void _dt_collection_changed_callback(gpointer instance,
       for(const GList *l = g_list_next(actual); l; l = g_list_next(l))
       {
         dt_thumbnail_t *thumb = l->data;
-        nrow = _thumb_get_rowid(thumb->imgid);
+        nrow = dt_collection_index_get_rowid(thumb->imgid);
         if(nrow > 0)
         {
           newid = thumb->imgid;
@@ -2408,7 +2375,7 @@ static void _dt_collection_changed_callback(gpointer instance,
       for(const GList *l = g_list_previous(actual); l; l = g_list_previous(l))
       {
         dt_thumbnail_t *thumb = l->data;
-        nrow = _thumb_get_rowid(thumb->imgid);
+        nrow = dt_collection_index_get_rowid(thumb->imgid);
         if(nrow > 0)
         {
           newid = thumb->imgid;
@@ -2421,7 +2388,7 @@ static void _dt_collection_changed_callback(gpointer instance,
     if(nrow >= 1)
       table->offset_imgid = newid;
     else
-      table->offset_imgid = _thumb_get_imgid(1);
+      table->offset_imgid = dt_collection_index_get_imgid(1);
     table->offset = MAX(1, nrow);
     if(offset_changed)
       dt_conf_set_int("plugins/lighttable/collect/history_pos0", table->offset);
@@ -2442,7 +2409,7 @@ static void _dt_collection_changed_callback(gpointer instance,
     // if needed, we restore back the position of the filmstrip
     if(old_offset > 0 && old_offset != table->offset)
     {
-      const int tmpoff = _thumb_get_rowid(old_offset);
+      const int tmpoff = dt_collection_index_get_rowid(old_offset);
       if(tmpoff > 0)
       {
         table->offset = tmpoff;
@@ -2482,7 +2449,7 @@ static void _dt_collection_changed_callback(gpointer instance,
     const int nextpos = MAX(dt_conf_get_int("plugins/lighttable/collect/history_next_pos"),
                             1);
     table->offset = nextpos;
-    table->offset_imgid = _thumb_get_imgid(table->offset);
+    table->offset_imgid = dt_collection_index_get_imgid(table->offset);
     dt_conf_set_int("plugins/lighttable/collect/history_pos0", nextpos);
     dt_conf_set_int("plugins/lighttable/collect/history_next_pos", 0);
     dt_conf_set_int("lighttable/zoomable/last_offset", nextpos);
@@ -3256,7 +3223,7 @@ gboolean dt_thumbtable_set_offset_image(dt_thumbtable_t *table,
                                         const gboolean redraw)
 {
   table->offset_imgid = imgid;
-  return dt_thumbtable_set_offset(table, _thumb_get_rowid(imgid), redraw);
+  return dt_thumbtable_set_offset(table, dt_collection_index_get_rowid(imgid), redraw);
 }
 
 static void _accel_copy(dt_action_t *action)
@@ -3486,9 +3453,9 @@ gboolean dt_thumbtable_ensure_imgid_visibility(dt_thumbtable_t *table,
 {
   if(!dt_is_valid_imgid(imgid)) return FALSE;
   if(table->mode == DT_THUMBTABLE_MODE_FILEMANAGER)
-    return _filemanager_ensure_rowid_visibility(table, _thumb_get_rowid(imgid));
+    return _filemanager_ensure_rowid_visibility(table, dt_collection_index_get_rowid(imgid));
   else if(table->mode == DT_THUMBTABLE_MODE_ZOOM)
-    return _zoomable_ensure_rowid_visibility(table, _thumb_get_rowid(imgid));
+    return _zoomable_ensure_rowid_visibility(table, dt_collection_index_get_rowid(imgid));
   else if(table->mode == DT_THUMBTABLE_MODE_FILMSTRIP)
     return _filmstrip_ensure_imgid_visibility(table, imgid);
 
@@ -3551,9 +3518,9 @@ gboolean dt_thumbtable_check_imgid_visibility(dt_thumbtable_t *table,
     return FALSE;
 
   if(table->mode == DT_THUMBTABLE_MODE_FILEMANAGER)
-    return _filemanager_check_rowid_visibility(table, _thumb_get_rowid(imgid));
+    return _filemanager_check_rowid_visibility(table, dt_collection_index_get_rowid(imgid));
   else if(table->mode == DT_THUMBTABLE_MODE_ZOOM)
-    return _zoomable_check_rowid_visibility(table, _thumb_get_rowid(imgid));
+    return _zoomable_check_rowid_visibility(table, dt_collection_index_get_rowid(imgid));
 
   return FALSE;
 }
@@ -3566,8 +3533,8 @@ static dt_imgid_t _thumb_key_base(dt_thumbtable_t *table)
 {
   const dt_imgid_t keyid = table->key_pos;
   const dt_imgid_t selid = dt_selection_get_last_single_id(darktable.selection);
-  return dt_is_valid_imgid(keyid) && _thumb_get_rowid(keyid) > 0 ? keyid
-       : dt_is_valid_imgid(selid) && _thumb_get_rowid(selid) > 0 ? selid
+  return dt_is_valid_imgid(keyid) && dt_collection_index_get_rowid(keyid) > 0 ? keyid
+       : dt_is_valid_imgid(selid) && dt_collection_index_get_rowid(selid) > 0 ? selid
        : dt_control_get_mouse_over_id();
 }
 
@@ -3613,17 +3580,10 @@ static gboolean _filemanager_key_move(dt_thumbtable_t *table,
      || move == DT_THUMBTABLE_MOVE_END
      )
   {
-    baserowid = _thumb_get_rowid(baseid);
+    baserowid = dt_collection_index_get_rowid(baseid);
     newrowid = baserowid;
     // last rowid of the current collection
-    int maxrowid = 1;
-    sqlite3_stmt *stmt;
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "SELECT MAX(rowid) FROM memory.collected_images", -1,
-                                &stmt, NULL);
-    if(sqlite3_step(stmt) == SQLITE_ROW)
-      maxrowid = sqlite3_column_int(stmt, 0);
-    sqlite3_finalize(stmt);
+    const int maxrowid = MAX(1, dt_collection_index_get_count());
 
     switch(move)
     {
@@ -3668,7 +3628,7 @@ static gboolean _filemanager_key_move(dt_thumbtable_t *table,
   }
 
   // change image_over
-  const dt_imgid_t imgid = _thumb_get_imgid(newrowid);
+  const dt_imgid_t imgid = dt_collection_index_get_imgid(newrowid);
 
   dt_control_set_mouse_over_id(imgid);
 
@@ -3709,14 +3669,7 @@ static gboolean _zoomable_key_move(dt_thumbtable_t *table,
     moved = _zoomable_ensure_rowid_visibility(table, 1);
   else if(move == DT_THUMBTABLE_MOVE_END)
   {
-    int maxrowid = 1;
-    sqlite3_stmt *stmt;
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "SELECT MAX(rowid) FROM memory.collected_images",
-                                -1, &stmt, NULL);
-    if(sqlite3_step(stmt) == SQLITE_ROW)
-      maxrowid = sqlite3_column_int(stmt, 0);
-    sqlite3_finalize(stmt);
+    const int maxrowid = MAX(1, dt_collection_index_get_count());
     moved = _zoomable_ensure_rowid_visibility(table, maxrowid);
   }
   else if(move == DT_THUMBTABLE_MOVE_ALIGN)
@@ -17,6 +17,7 @@
 */
 
 #include <glib.h>    // for g_mkdir_with_parents, _
+#include <glib/gstdio.h> // for g_unlink
 #include <gtk/gtk.h> // for gtk_init_check
 #include <libintl.h> // for bind_textdomain_codeset, etc
 #include <limits.h>  // for PATH_MAX
@@ -44,7 +45,130 @@
 #include "win/main_wrapper.h"
 #endif
 
-static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip, const dt_mipmap_size_t max_mip, const dt_imgid_t min_imgid, const int32_t max_imgid)
+typedef struct dt_gencache_t
+{
+  dt_mipmap_size_t min_mip, max_mip;
+  GArray *ids;           // image ids to work on, ascending
+  gint next;             // index of the next image to hand out
+  gboolean *done;        // per index, set when the image is finished
+  size_t finished;       // number of finished images
+  size_t generated;      // ... of which needed at least one new thumbnail
+  size_t checkpoint;     // all images before this index are finished
+  double start, last_save;
+  gchar *progress_file;
+  dt_pthread_mutex_t lock;
+} dt_gencache_t;
+
+// the checkpoint holds the mip range and the last image id up to which the
+// cache is complete, so an interrupted run can be resumed with --resume
+static void _write_checkpoint(dt_gencache_t *g)
+{
+  if(g->checkpoint == 0) return;
+  gchar *content = g_strdup_printf("%d %d %d\n", g->min_mip, g->max_mip,
+                                   g_array_index(g->ids, dt_imgid_t, g->checkpoint - 1));
+  GError *error = NULL;
+  if(!g_file_set_contents(g->progress_file, content, -1, &error))
+  {
+    fprintf(stderr, "could not write progress file '%s': %s\n", g->progress_file, error->message);
+    g_error_free(error);
+  }
+  g_free(content);
+}
+
+static dt_imgid_t _read_checkpoint(const char *progress_file,
+                                   const dt_mipmap_size_t min_mip,
+                                   const dt_mipmap_size_t max_mip)
+{
+  gchar *content = NULL;
+  if(!g_file_get_contents(progress_file, &content, NULL, NULL)) return NO_IMGID;
+  int cmin = -1, cmax = -1, imgid = NO_IMGID;
+  const gboolean valid = sscanf(content, "%d %d %d", &cmin, &cmax, &imgid) == 3;
+  g_free(content);
+  if(!valid || cmin != min_mip || cmax != max_mip)
+  {
+    fprintf(stderr, _("warning: progress file '%s' is for another mip range, starting over\n"),
+            progress_file);
+    return NO_IMGID;
+  }
+  return imgid;
+}
+
+// returns TRUE if at least one thumbnail of the image had to be generated
+static gboolean _generate_image(const dt_gencache_t *g, const dt_imgid_t imgid)
+{
+  gboolean missing[DT_MIPMAP_NONE] = { FALSE };
+  gboolean any = FALSE;
+  for(dt_mipmap_size_t k = g->min_mip; k <= g->max_mip; k++)
+  {
+    // if a valid thumbnail is already on disc - do nothing
+    missing[k] = !dt_mipmap_cache_is_on_disk(imgid, k);
+    any |= missing[k];
+  }
+
+  if(any)
+  {
+    // develop the image once: keep the largest size locked in the cache (read
+    // back from disc if it is there already) so all smaller ones are
+    // downsampled from it instead of running the pipe again.
+    dt_mipmap_buffer_t top;
+    dt_mipmap_cache_get(&top, imgid, g->max_mip, DT_MIPMAP_BLOCKING, 'r');
+    for(int k = g->max_mip - 1; k >= (int)g->min_mip; k--)
+    {
+      if(!missing[k]) continue;
+      dt_mipmap_buffer_t buf;
+      dt_mipmap_cache_get(&buf, imgid, k, DT_MIPMAP_BLOCKING, 'r');
+      dt_mipmap_cache_release(&buf);
+    }
+    dt_mipmap_cache_release(&top);
+  }
+
+  // and immediately write thumbs to disc and remove from mipmap cache.
+  dt_mipmap_cache_evict(imgid);
+  // thumbnail in sync with image
+  dt_history_hash_set_mipmap(imgid);
+  return any;
+}
+
+static void _image_done(dt_gencache_t *g, const gint idx, const gboolean generated)
+{
+  const size_t count = g->ids->len;
+  const dt_imgid_t imgid = g_array_index(g->ids, dt_imgid_t, idx);
+
+  dt_pthread_mutex_lock(&g->lock);
+  g->done[idx] = TRUE;
+  g->finished++;
+  if(generated) g->generated++;
+
+  // images finish out of order, the checkpoint only moves over a
+  // contiguous run of finished ones
+  while(g->checkpoint < count && g->done[g->checkpoint]) g->checkpoint++;
+
+  const double now = dt_get_wtime();
+  const double rate = g->finished / MAX(now - g->start, 1e-3);
+  fprintf(stderr, "image %zu/%zu (%.02f%%) (id:%d, %.2f images/s, eta %.0fs)\n",
+          g->finished, count, 100.0 * g->finished / (float)count, imgid, rate,
+          (count - g->finished) / rate);
+  if(now - g->last_save > 5.0)
+  {
+    _write_checkpoint(g);
+    g->last_save = now;
+  }
+  dt_pthread_mutex_unlock(&g->lock);
+}
+
+static gpointer _worker(gpointer data)
+{
+  dt_gencache_t *g = (dt_gencache_t *)data;
+  gint idx;
+  while((idx = g_atomic_int_add(&g->next, 1)) < (gint)g->ids->len)
+  {
+    const gboolean generated = _generate_image(g, g_array_index(g->ids, dt_imgid_t, idx));
+    _image_done(g, idx, generated);
+  }
+  return NULL;
+}
+
+static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip, const dt_mipmap_size_t max_mip, dt_imgid_t min_imgid, const int32_t max_imgid, const int jobs, const gboolean resume)
 {
   fprintf(stderr, _("creating cache directories\n"));
   for(dt_mipmap_size_t k = min_mip; k <= max_mip; k++)
@@ -60,23 +184,36 @@ static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip, const dt_mip
     }
   }
 
-  // some progress counter
+  dt_gencache_t g = { 0 };
+  g.min_mip = min_mip;
+  g.max_mip = max_mip;
+  g.progress_file = g_strdup_printf("%s.d/generate-cache.progress", darktable.mipmap_cache->cachedir);
+
+  if(resume)
+  {
+    const dt_imgid_t last = _read_checkpoint(g.progress_file, min_mip, max_mip);
+    if(dt_is_valid_imgid(last) && last >= min_imgid)
+    {
+      fprintf(stderr, _("resuming after image id %d\n"), last);
+      min_imgid = last + 1;
+    }
+  }
+
+  // collect all images up front, the workers pick them in id order
   sqlite3_stmt *stmt;
-  size_t image_count = 0, counter = 0;
+  g.ids = g_array_new(FALSE, FALSE, sizeof(dt_imgid_t));
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT COUNT(*) FROM main.images WHERE id >= ?1 AND id <= ?2", -1, &stmt, 0);
+                              "SELECT id FROM main.images WHERE id >= ?1 AND id <= ?2 ORDER BY id", -1, &stmt, 0);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, min_imgid);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, max_imgid);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    image_count = sqlite3_column_int(stmt, 0);
-    sqlite3_finalize(stmt);
-  }
-  else
+  while(sqlite3_step(stmt) == SQLITE_ROW)
   {
-    return 1;
+    const dt_imgid_t imgid = sqlite3_column_int(stmt, 0);
+    g_array_append_val(g.ids, imgid);
   }
+  sqlite3_finalize(stmt);
 
+  const size_t image_count = g.ids->len;
   if(!image_count)
   {
     fprintf(stderr, _("warning: no images are matching the requested image id range\n"));
@@ -86,41 +223,35 @@ static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip, const dt_mip
     }
   }
 
-  // go through all images:
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT id, filename FROM main.images WHERE id >= ?1 AND id <= ?2", -1, &stmt, 0);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, min_imgid);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, max_imgid);
-  while(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    const dt_imgid_t imgid = sqlite3_column_int(stmt, 0);
-    const char *imgfilename = (const char*)sqlite3_column_text(stmt, 1);
-
-    counter++;
-    fprintf(stderr, "image %zu/%zu (%.02f%%) (id:%d, file=%s)\n", counter, image_count, 100.0 * counter / (float)image_count, imgid, imgfilename);
+  const int workers = CLAMP(jobs, 1, MAX((int)image_count, 1));
+  g.done = g_new0(gboolean, image_count + 1);
+  dt_pthread_mutex_init(&g.lock, NULL);
+  g.start = g.last_save = dt_get_wtime();
 
-    for(int k = max_mip; k >= min_mip && k >= 0; k--)
-    {
-      char filename[PATH_MAX] = { 0 };
-      snprintf(filename, sizeof(filename), "%s.d/%d/%d.jpg", darktable.mipmap_cache->cachedir, k, imgid);
-
-      // if a valid thumbnail file is already on disc - do nothing
-      if(dt_util_test_image_file(filename)) continue;
+  if(workers == 1)
+    _worker(&g);
+  else
+  {
+    GThread **threads = g_new(GThread *, workers);
+    for(int i = 0; i < workers; i++)
+      threads[i] = g_thread_new("generate-cache", _worker, &g);
+    for(int i = 0; i < workers; i++)
+      g_thread_join(threads[i]);
+    g_free(threads);
+  }
 
-      // else, generate thumbnail and store in mipmap cache.
-      dt_mipmap_buffer_t buf;
-      dt_mipmap_cache_get(&buf, imgid, k, DT_MIPMAP_BLOCKING, 'r');
-      dt_mipmap_cache_release(&buf);
-    }
+  // the whole range is done, a later --resume starts from the beginning
+  g_unlink(g.progress_file);
 
-    // and immediately write thumbs to disc and remove from mipmap cache.
-    dt_mipmap_cache_evict(imgid);
-    // thumbnail in sync with image
-    dt_history_hash_set_mipmap(imgid);
-  }
+  const double elapsed = dt_get_wtime() - g.start;
+  fprintf(stderr, "done: %zu images (%zu updated, %zu up to date) in %.1fs with %d %s, %.2f images/s\n",
+          g.finished, g.generated, g.finished - g.generated, elapsed, workers,
+          workers == 1 ? "thread" : "threads", g.finished / MAX(elapsed, 1e-3));
 
-  sqlite3_finalize(stmt);
-  fprintf(stderr, "done\n");
+  dt_pthread_mutex_destroy(&g.lock);
+  g_free(g.done);
+  g_free(g.progress_file);
+  g_array_free(g.ids, TRUE);
 
   return 0;
 }
@@ -131,13 +262,17 @@ static void usage(const char *progname)
           "usage: %s [-h, --help; --version]\n"
           "  [--min-mip <0-8> (default = 0)] [-m, --max-mip <0-8> (default = 2)]\n"
           "  [--min-imgid <N>] [--max-imgid <N>]\n"
+          "  [-j, --jobs <N> (default = 1, 0 = one per cpu)] [--resume]\n"
           "  [--core <darktable options>]\n"
           "\n"
           "When multiple mipmap sizes are requested, the biggest one is computed\n"
           "while the rest are quickly downsampled.\n"
           "\n"
           "The --min-imgid and --max-imgid specify the range of internal image ID\n"
-          "numbers to work on.\n",
+          "numbers to work on.\n"
+          "\n"
+          "--jobs sets the number of images processed at the same time. The progress\n"
+          "is saved in the cache directory, --resume continues an interrupted run.\n",
           progname);
 }
 
@@ -163,6 +298,8 @@ int main(int argc, char *arg[])
   dt_mipmap_size_t max_mip = DT_MIPMAP_2;
   dt_imgid_t min_imgid = NO_IMGID;
   int32_t max_imgid = INT32_MAX;
+  int jobs = 1;
+  gboolean resume = FALSE;
 
   int k;
   for(k = 1; k < argc; k++)
@@ -198,6 +335,15 @@ int main(int argc, char *arg[])
       k++;
       max_imgid = (int32_t)MIN(MAX(atoi(arg[k]), 0), INT32_MAX);
     }
+    else if((!strcmp(arg[k], "-j") || !strcmp(arg[k], "--jobs")) && argc > k + 1)
+    {
+      k++;
+      jobs = MAX(atoi(arg[k]), 0);
+    }
+    else if(!strcmp(arg[k], "--resume"))
+    {
+      resume = TRUE;
+    }
     else if(!strcmp(arg[k], "--core"))
     {
       // everything from here on should be passed to the core
@@ -251,7 +397,9 @@ int main(int argc, char *arg[])
 
   fprintf(stderr, _("creating complete lighttable thumbnail cache\n"));
 
-  if(generate_thumbnail_cache(min_mip, max_mip, min_imgid, max_imgid))
+  if(jobs == 0) jobs = dt_get_num_procs();
+
+  if(generate_thumbnail_cache(min_mip, max_mip, min_imgid, max_imgid, jobs, resume))
   {
     free(m_arg);
     exit(EXIT_FAILURE);
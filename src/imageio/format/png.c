@@ -723,7 +723,7 @@ void gui_reset(dt_imageio_module_format_t *self)
 
 int flags(dt_imageio_module_data_t *data)
 {
-  return FORMAT_FLAGS_SUPPORT_XMP;
+  return FORMAT_FLAGS_SUPPORT_XMP | FORMAT_FLAGS_PARALLEL_SAFE;
 }
 
 // clang-format off
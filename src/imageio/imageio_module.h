@@ -42,7 +42,8 @@ typedef enum dt_imageio_format_flags_t
 {
   FORMAT_FLAGS_SUPPORT_XMP = 1,
   FORMAT_FLAGS_NO_TMPFILE = 2,
-  FORMAT_FLAGS_SUPPORT_LAYERS = 4
+  FORMAT_FLAGS_SUPPORT_LAYERS = 4,
+  FORMAT_FLAGS_PARALLEL_SAFE = 8 // no state kept across the images of an export
 } dt_imageio_format_flags_t;
 
 /**
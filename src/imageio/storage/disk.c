@@ -356,14 +356,15 @@ int store(dt_imageio_module_storage_t *self,
     pattern);
 
   dt_image_full_path(imgid, input_dir, sizeof(input_dir), NULL);
-  // set variable values to expand them afterwards in darktable variables
-  dt_variables_set_max_width_height(d->vp, fdata->max_width, fdata->max_height);
-  dt_variables_set_upscale(d->vp, upscale);
 
   gboolean fail = FALSE;
   // we're potentially called in parallel. have sequence number synchronized:
   dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
   {
+    // set variable values to expand them afterwards in darktable variables
+    dt_variables_set_max_width_height(d->vp, fdata->max_width, fdata->max_height);
+    dt_variables_set_upscale(d->vp, upscale);
+
 try_again:
     // avoid braindead export which is bound to overwrite at random:
     if(variable_expand && total > 1 && !g_strrstr(pattern, "$"))
@@ -553,6 +554,12 @@ size_t params_size(dt_imageio_module_storage_t *self)
   return sizeof(dt_imageio_disk_t) - sizeof(void *);
 }
 
+gboolean parallel_safe(dt_imageio_module_storage_t *self)
+{
+  // the variables and the file name are handled under plugin_threadsafe
+  return TRUE;
+}
+
 void init(dt_imageio_module_storage_t *self)
 {
 #ifdef USE_LUA
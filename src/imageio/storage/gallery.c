@@ -426,7 +426,10 @@ int store(dt_imageio_module_storage_t *self,
   g_free(esc_relthumbfilename);
 
   pair->pos = num;
+  // store can be called in parallel, so synch access to the list
+  dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
   d->l = g_list_insert_sorted(d->l, pair, (GCompareFunc)sort_pos);
+  dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
 
   /* also export thumbnail: */
   // write with reduced resolution:
@@ -72,6 +72,8 @@ REQUIRED(int, store, struct dt_imageio_module_storage_t *self, struct dt_imageio
                      const gboolean export_masks,
                      const enum dt_colorspaces_color_profile_type_t icc_type, const gchar *icc_filename,
                      enum dt_iop_color_intent_t icc_intent, struct dt_export_metadata_t *metadata);
+/* TRUE if store() can be called for several images at once, the export is serial otherwise */
+OPTIONAL(gboolean, parallel_safe, struct dt_imageio_module_storage_t *self);
 /* called once at the end (after exporting all images), if implemented. */
 OPTIONAL(void, finalize_store, struct dt_imageio_module_storage_t *self, struct dt_imageio_module_data_t *data);
 
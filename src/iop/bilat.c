@@ -26,6 +26,7 @@
 #include "develop/imageop.h"
 #include "develop/imageop_math.h"
 #include "develop/imageop_gui.h"
+#include "develop/pixelpipe_cache.h"
 #include "develop/tiling.h"
 #include "gui/gtk.h"
 #include "gui/presets.h"
@@ -55,7 +56,15 @@ typedef struct dt_iop_bilat_params_t
   float midtone; // $MIN: 0.001 $MAX: 1.0 $DEFAULT: 0.5 $DESCRIPTION: "midtone range"
 } dt_iop_bilat_params_t;
 
-typedef dt_iop_bilat_params_t dt_iop_bilat_data_t;
+typedef struct dt_iop_bilat_data_t
+{
+  dt_iop_bilat_mode_t mode;
+  float sigma_r;
+  float sigma_s;
+  float detail;
+  float midtone;
+  local_laplacian_cache_t cache; // input pyramid of the last local laplacian run
+} dt_iop_bilat_data_t;
 
 typedef struct dt_iop_bilat_gui_data_t
 {
@@ -297,7 +306,13 @@ void commit_params(dt_iop_module_t *self,
 {
   dt_iop_bilat_params_t *p = (dt_iop_bilat_params_t *)p1;
   dt_iop_bilat_data_t *d = piece->data;
-  *d = *p;
+  d->mode = p->mode;
+  d->sigma_r = p->sigma_r;
+  d->sigma_s = p->sigma_s;
+  d->detail = p->detail;
+  d->midtone = p->midtone;
+  if(d->mode != s_mode_local_laplacian)
+    local_laplacian_cache_free(&d->cache);
 
 #ifdef HAVE_OPENCL
   if(d->mode == s_mode_bilateral)
@@ -321,6 +336,8 @@ void cleanup_pipe(dt_iop_module_t *self,
                   dt_dev_pixelpipe_t *pipe,
                   dt_dev_pixelpipe_iop_t *piece)
 {
+  dt_iop_bilat_data_t *d = piece->data;
+  local_laplacian_cache_free(&d->cache);
   free(piece->data);
   piece->data = NULL;
 }
@@ -360,8 +377,15 @@ void process(dt_iop_module_t *self,
   }
   else // s_mode_local_laplacian
   {
+    // while dragging the sliders in darkroom the input stays the same, so
+    // keep its pyramid. exports run once, don't hold on to the memory.
+    const gboolean cache = !dt_pipe_is_export(piece->pipe);
+    const dt_hash_t hash = cache
+      ? dt_dev_pixelpipe_cache_hash(roi_in, piece->pipe, g_list_index(piece->pipe->nodes, piece))
+      : DT_INVALID_HASH;
     local_laplacian(i, o, roi_in->width, roi_in->height,
-                    d->midtone, d->sigma_s, d->sigma_r, d->detail, 0);
+                    d->midtone, d->sigma_s, d->sigma_r, d->detail, 0,
+                    cache ? &d->cache : NULL, hash);
   }
 }
 
@@ -42,6 +42,12 @@
 // must be in synch with dt_colorspaces_color_profile_t
 #define DT_IOP_COLOR_ICC_LEN 512
 #define LUT_SAMPLES 0x10000
+// grid points per axis of the Lab table replacing lcms2 for LUT based profiles
+#define CLUT_LEVEL 49
+// points per axis at which the table is compared to lcms2, halfway between its nodes
+#define CLUT_CHECK_LEVEL 16
+// largest colour difference (CIE76) to lcms2 for the table to be used
+#define CLUT_MAX_DELTA_E 2.0f
 
 DT_MODULE_INTROSPECTION(5, dt_iop_colorout_params_t)
 
@@ -53,6 +59,8 @@ typedef struct dt_iop_colorout_data_t
   dt_colormatrix_t cmatrix;
   cmsHTRANSFORM *xform;
   float unbounded_coeffs[3][3]; // for extrapolation of shaper curves
+  float *clut;                  // xform sampled on a Lab grid, NULL if xform is used per pixel
+  dt_hash_t clut_hash;          // profiles, intent and flags the clut was sampled (or rejected) for
 } dt_iop_colorout_data_t;
 
 typedef struct dt_iop_colorout_global_data_t
@@ -97,7 +105,8 @@ int default_group()
 
 int flags()
 {
-  return IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_ONE_INSTANCE | IOP_FLAGS_WRITE_PIPECACHE_IN;
+  return IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_ONE_INSTANCE | IOP_FLAGS_WRITE_PIPECACHE_IN
+         | IOP_FLAGS_ROW_STREAMING;
 }
 
 dt_iop_colorspace_type_t default_colorspace(dt_iop_module_t *self,
@@ -517,6 +526,231 @@ static void _transform_lcms(const dt_iop_colorout_data_t *const d,
   dt_omploop_sfence();
 }
 
+static inline void _clut_tetrahedral(const float *const in,
+                                     float *const out,
+                                     const float *const restrict clut)
+{
+  const size_t level = CLUT_LEVEL;
+  const size_t level2 = level * level;
+  const float flevel_1 = (float)(level - 1);
+
+  // L in [0, 100], a and b in [-128, 128]
+  const dt_aligned_pixel_t pos = { CLIP(in[0] / 100.0f) * flevel_1,
+                                   CLIP((in[1] + 128.0f) / 256.0f) * flevel_1,
+                                   CLIP((in[2] + 128.0f) / 256.0f) * flevel_1,
+                                   0.0f };
+  DT_ALIGNED_PIXEL int ipos[4];
+  dt_aligned_pixel_t d;
+  for_each_channel(c)
+  {
+    ipos[c] = MIN((int)pos[c], CLUT_LEVEL - 2);
+    d[c] = pos[c] - ipos[c];
+  }
+
+  const float *const p000 = clut + 4 * (ipos[0] + ipos[1] * level + ipos[2] * level2);
+  const float *const p100 = p000 + 4;
+  const float *const p010 = p000 + 4 * level;
+  const float *const p110 = p010 + 4;
+  const float *const p001 = p000 + 4 * level2;
+  const float *const p101 = p001 + 4;
+  const float *const p011 = p010 + 4 * level2;
+  const float *const p111 = p011 + 4;
+
+  // select the tetrahedron, weights w0..w3 for the corners a, b
+  const float *pa, *pb;
+  float w0, w1, w2, w3;
+  if(d[0] > d[1])
+  {
+    if(d[1] > d[2])
+    {
+      pa = p100; pb = p110;
+      w0 = 1.0f - d[0]; w1 = d[0] - d[1]; w2 = d[1] - d[2]; w3 = d[2];
+    }
+    else if(d[0] > d[2])
+    {
+      pa = p100; pb = p101;
+      w0 = 1.0f - d[0]; w1 = d[0] - d[2]; w2 = d[2] - d[1]; w3 = d[1];
+    }
+    else
+    {
+      pa = p001; pb = p101;
+      w0 = 1.0f - d[2]; w1 = d[2] - d[0]; w2 = d[0] - d[1]; w3 = d[1];
+    }
+  }
+  else
+  {
+    if(d[2] > d[1])
+    {
+      pa = p001; pb = p011;
+      w0 = 1.0f - d[2]; w1 = d[2] - d[1]; w2 = d[1] - d[0]; w3 = d[0];
+    }
+    else if(d[2] > d[0])
+    {
+      pa = p010; pb = p011;
+      w0 = 1.0f - d[1]; w1 = d[1] - d[2]; w2 = d[2] - d[0]; w3 = d[0];
+    }
+    else
+    {
+      pa = p010; pb = p110;
+      w0 = 1.0f - d[1]; w1 = d[1] - d[0]; w2 = d[0] - d[2]; w3 = d[2];
+    }
+  }
+
+  for_each_channel(c, aligned(out))
+    out[c] = w0 * p000[c] + w1 * pa[c] + w2 * pb[c] + w3 * p111[c];
+}
+
+static void _transform_clut(const dt_iop_colorout_data_t *const d,
+                            float *const restrict out,
+                            const float *const restrict in,
+                            const size_t npixels)
+{
+  const float *const restrict clut = d->clut;
+  DT_OMP_FOR()
+  for(size_t k = 0; k < 4 * npixels; k += 4)
+  {
+    _clut_tetrahedral(in + k, out + k, clut);
+    out[k + 3] = in[k + 3];
+  }
+}
+
+// the contents of a profile, as a display profile can be replaced by another one
+// at the same address. DT_INVALID_HASH if the profile can't be serialized.
+static dt_hash_t _profile_hash(dt_hash_t hash, const cmsHPROFILE profile)
+{
+  cmsUInt32Number size;
+  if(!profile || !cmsSaveProfileToMem(profile, NULL, &size))
+    return DT_INVALID_HASH;
+
+  char *data = malloc(size);
+  if(data && cmsSaveProfileToMem(profile, data, &size))
+    hash = dt_hash(hash, data, size);
+  else
+    hash = DT_INVALID_HASH;
+  free(data);
+  return hash;
+}
+
+// compare the table to the transform between its nodes, where the interpolation
+// is least accurate. both results are taken back to Lab through the output profile.
+static gboolean _check_clut(const dt_iop_colorout_data_t *const d,
+                            const cmsHPROFILE output,
+                            const cmsHPROFILE Lab)
+{
+  cmsHTRANSFORM back = cmsCreateTransform(output, TYPE_RGBA_FLT, Lab, TYPE_LabA_FLT,
+                                          INTENT_RELATIVE_COLORIMETRIC, 0);
+  if(!back)
+    return FALSE;
+
+  const size_t level = CLUT_CHECK_LEVEL;
+  const size_t n = level * level * level;
+  float *const lab = dt_alloc_align_float(4 * 5 * n);
+  if(!lab)
+  {
+    cmsDeleteTransform(back);
+    return FALSE;
+  }
+  float *const exact = lab + 4 * n;
+  float *const approx = lab + 8 * n;
+  float *const exact_lab = lab + 12 * n;
+  float *const approx_lab = lab + 16 * n;
+
+  const float step = 1.0f / level;
+  for(size_t k = 0; k < n; k++)
+  {
+    lab[4 * k + 0] = 100.0f * (k % level + 0.5f) * step;
+    lab[4 * k + 1] = 256.0f * (k / level % level + 0.5f) * step - 128.0f;
+    lab[4 * k + 2] = 256.0f * (k / (level * level) + 0.5f) * step - 128.0f;
+    lab[4 * k + 3] = 0.0f;
+  }
+  cmsDoTransform(d->xform, lab, exact, n);
+  _transform_clut(d, approx, lab, n);
+  cmsDoTransform(back, exact, exact_lab, n);
+  cmsDoTransform(back, approx, approx_lab, n);
+  cmsDeleteTransform(back);
+
+  float max_de = 0.0f;
+  for(size_t k = 0; k < 4 * n; k += 4)
+  {
+    const float de = sqrtf(sqf(exact_lab[k] - approx_lab[k])
+                           + sqf(exact_lab[k + 1] - approx_lab[k + 1])
+                           + sqf(exact_lab[k + 2] - approx_lab[k + 2]));
+    max_de = fmaxf(max_de, de);
+  }
+  dt_free_align(lab);
+
+  dt_print(DT_DEBUG_PERF, "[colorout] %dx%dx%d table max delta E %.3f%s",
+           CLUT_LEVEL, CLUT_LEVEL, CLUT_LEVEL, max_de,
+           max_de > CLUT_MAX_DELTA_E ? ", using lcms2 per pixel" : "");
+  return max_de <= CLUT_MAX_DELTA_E;
+}
+
+// sample the lcms2 transform on a Lab grid, only done if profiles, intent or flags changed.
+// the table is dropped if it isn't close enough to the transform.
+static gboolean _sample_clut(dt_iop_colorout_data_t *d,
+                             const dt_hash_t hash,
+                             const cmsHPROFILE output,
+                             const cmsHPROFILE Lab)
+{
+  if(d->clut_hash == hash)
+    return d->clut != NULL;
+
+  const size_t level2 = CLUT_LEVEL * CLUT_LEVEL;
+  d->clut_hash = DT_INVALID_HASH;
+  if(!d->clut)
+    d->clut = dt_alloc_align_float(4 * level2 * CLUT_LEVEL);
+  if(!d->clut)
+    return FALSE;
+
+  dt_times_t start;
+  dt_get_perf_times(&start);
+
+  const float step = 1.0f / (CLUT_LEVEL - 1);
+  gboolean failed = FALSE;
+  DT_OMP_FOR(reduction(| : failed))
+  for(int k = 0; k < CLUT_LEVEL; k++)
+  {
+    float *lab = dt_alloc_align_float(4 * level2);
+    if(!lab)
+    {
+      failed = TRUE;
+      continue;
+    }
+    for(int j = 0; j < CLUT_LEVEL; j++)
+    {
+      for(int i = 0; i < CLUT_LEVEL; i++)
+      {
+        float *const px = lab + 4 * (i + j * CLUT_LEVEL);
+        px[0] = 100.0f * i * step;
+        px[1] = 256.0f * j * step - 128.0f;
+        px[2] = 256.0f * k * step - 128.0f;
+        px[3] = 0.0f;
+      }
+    }
+    float *const slice = d->clut + 4 * k * level2;
+    cmsDoTransform(d->xform, lab, slice, level2);
+    dt_free_align(lab);
+  }
+
+  if(failed)
+  {
+    dt_free_align(d->clut);
+    d->clut = NULL;
+    return FALSE;
+  }
+
+  dt_show_times_f(&start, "[colorout]", "sampling %dx%dx%d table", CLUT_LEVEL, CLUT_LEVEL, CLUT_LEVEL);
+
+  // remember rejected tables too, so they aren't sampled again
+  d->clut_hash = hash;
+  if(!_check_clut(d, output, Lab))
+  {
+    dt_free_align(d->clut);
+    d->clut = NULL;
+  }
+  return d->clut != NULL;
+}
+
 void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid,
              void *const ovoid, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
@@ -538,6 +772,10 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
     if(!_transform_cmatrix(d, out, (float*)ivoid, npixels))
       _process_fastpath_apply_tonecurves(self, piece, ovoid, roi_out);
   }
+  else if(d->clut)
+  {
+    _transform_clut(d, out, (float*)ivoid, npixels);
+  }
   else
   {
     _transform_lcms(d, out, (float*)ivoid, npixels);
@@ -733,6 +971,29 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
     }
   }
 
+  // lcms2 is slow evaluating LUT based profiles or softproofing on float data, so we sample the
+  // transform once and interpolate. Matrix profiles and the gamut check keep the exact per pixel path.
+  // this is done before a display profile can be replaced.
+  gboolean use_clut = d->xform
+                      && d->mode != DT_PROFILE_GAMUTCHECK
+                      && output_format == TYPE_RGBA_FLT
+                      && (softproof || !cmsIsMatrixShaper(output));
+  if(use_clut)
+  {
+    dt_hash_t hash = _profile_hash(DT_INITHASH, output);
+    hash = dt_hash(hash, &out_intent, sizeof(out_intent));
+    hash = dt_hash(hash, &transformFlags, sizeof(transformFlags));
+    if(softproof)
+      hash = _profile_hash(hash, softproof);
+    use_clut = hash != DT_INVALID_HASH && _sample_clut(d, hash, output, Lab);
+  }
+  if(!use_clut)
+  {
+    dt_free_align(d->clut);
+    d->clut = NULL;
+    d->clut_hash = DT_INVALID_HASH;
+  }
+
   if(out_type == DT_COLORSPACE_DISPLAY || out_type == DT_COLORSPACE_DISPLAY2)
     pthread_rwlock_unlock(&darktable.color_profiles->xprofile_lock);
 
@@ -777,6 +1038,7 @@ void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelp
     cmsDeleteTransform(d->xform);
     d->xform = NULL;
   }
+  dt_free_align(d->clut);
 
   free(piece->data);
   piece->data = NULL;
@@ -85,6 +85,7 @@ typedef struct dt_iop_contrast_data_t
   int radius_local;
   int iterations;
   float noise_bias;
+  dt_filter_workspace_t ws; // buffers of the surface blur, kept across runs
 } dt_iop_contrast_data_t;
 
 typedef enum dt_iop_details_display_t
@@ -161,7 +162,7 @@ static inline void compute_luminance_and_mask(const float *const restrict in,
                                               float *const restrict luminance,
                                               float *const restrict smoothed_luminance,
                                               const dt_iop_roi_t *const roi_in,
-                                              const dt_iop_contrast_data_t *const d)
+                                              dt_iop_contrast_data_t *const d)
 {
   size_t width = (size_t)roi_in->width;
   size_t height = (size_t)roi_in->height;
@@ -180,7 +181,7 @@ static inline void compute_luminance_and_mask(const float *const restrict in,
   // Then apply the smoothing filter on a copy
   memcpy(smoothed_luminance, luminance, npixels * sizeof(float));
 
-  fast_eigf_surface_blur(smoothed_luminance, width, height,
+  fast_eigf_surface_blur(&d->ws, smoothed_luminance, width, height,
                          d->radius_local, d->feathering, d->iterations,
                          DT_GF_BLENDING_LINEAR, 1.0f,
                          0.0f, NORM_MIN, 4.0f);
@@ -278,7 +279,7 @@ void process(dt_iop_module_t *self,
              const dt_iop_roi_t *const roi_in,
              const dt_iop_roi_t *const roi_out)
 {
-  const dt_iop_contrast_data_t *const d = piece->data;
+  dt_iop_contrast_data_t *const d = piece->data;
   dt_iop_contrast_gui_data_t *const g = self->gui_data;
 
   const float *const restrict in = (float *const)ivoid;
@@ -353,6 +354,23 @@ void commit_params(dt_iop_module_t *self,
   d->feathering = default_feathering * powf(2.0f, -p->edge_protection) / (p->filter_iterations * p->filter_iterations);
 }
 
+void init_pipe(dt_iop_module_t *self,
+               dt_dev_pixelpipe_t *pipe,
+               dt_dev_pixelpipe_iop_t *piece)
+{
+  piece->data = dt_calloc1_align_type(dt_iop_contrast_data_t);
+}
+
+void cleanup_pipe(dt_iop_module_t *self,
+                  dt_dev_pixelpipe_t *pipe,
+                  dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_contrast_data_t *d = piece->data;
+  dt_filter_workspace_free(&d->ws);
+  dt_free_align(piece->data);
+  piece->data = NULL;
+}
+
 static void show_details_callback(GtkWidget *togglebutton, dt_iop_module_t *self)
 {
   // early return if blend module is already displaying a mask
@@ -900,6 +900,91 @@ void process(dt_iop_module_t *self,
   }
 }
 
+// --bench-module demosaic times the bayer demosaicers on a synthetic mosaic
+// of the image size, independent of the image content and the chosen method
+void benchmark(dt_iop_module_t *self,
+               dt_dev_pixelpipe_iop_t *piece,
+               const void *const restrict ivoid,
+               void *const restrict ovoid,
+               const dt_iop_roi_t *const roi_in,
+               const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_demosaic_data_t *const d = piece->data;
+  const uint32_t filters = piece->filters;
+  const int width = roi_in->width;
+  const int height = roi_in->height;
+  if(filters == 0 || filters == 9u || (self->dev->image_storage.flags & DT_IMAGE_4BAYER)
+     || width < 16 || height < 16)
+    return;
+
+  float *const restrict in = dt_iop_image_alloc(width, height, 1);
+  float *const restrict out = dt_iop_image_alloc(width, height, 4);
+  if(!in || !out)
+  {
+    dt_free_align(in);
+    dt_free_align(out);
+    return;
+  }
+
+  // smooth gradients, hard edges every few dozen pixels and some hash noise
+  DT_OMP_FOR()
+  for(int row = 0; row < height; row++)
+  {
+    for(int col = 0; col < width; col++)
+    {
+      uint32_t h = (uint32_t)(row * width + col) * 2654435761u;
+      h ^= h >> 15;
+      const float noise = (h & 0xffff) / 65535.0f;
+      const float edge = ((col / 50 + row / 70) & 1) ? 0.2f : 0.0f;
+      const float c = FC(row, col, filters) == 1 ? 1.0f : 0.6f;
+      in[(size_t)row * width + col] = c * (0.3f + 0.2f * sinf(row * 0.05f) * cosf(col * 0.03f) + 0.02f * noise + edge);
+    }
+  }
+
+  const int methods[] = { DT_IOP_DEMOSAIC_PPG, DT_IOP_DEMOSAIC_RCD, DT_IOP_DEMOSAIC_LMMSE,
+                          DT_IOP_DEMOSAIC_AMAZE, DT_IOP_DEMOSAIC_VNG4 };
+  const int counter = 3;
+  const float mpix = (float)width * height / 1.0e6f;
+  const int old_muted = darktable.unmuted;
+
+  for(size_t k = 0; k < sizeof(methods) / sizeof(methods[0]); k++)
+  {
+    darktable.unmuted = 0;
+    dt_times_t start, end;
+    dt_get_times(&start);
+    for(int i = 0; i < counter; i++)
+    {
+      switch(methods[k])
+      {
+        case DT_IOP_DEMOSAIC_RCD:
+          rcd_demosaic(out, in, width, height, filters, 1.0f);
+          break;
+        case DT_IOP_DEMOSAIC_LMMSE:
+          lmmse_demosaic(out, in, width, height, filters, d->lmmse_refine, 1.0f);
+          break;
+        case DT_IOP_DEMOSAIC_AMAZE:
+          amaze_demosaic(in, out, width, height, filters, 1.0f);
+          break;
+        case DT_IOP_DEMOSAIC_VNG4:
+          vng_interpolate(out, in, width, height, filters, NULL, FALSE);
+          break;
+        default:
+          demosaic_ppg(out, in, width, height, filters, d->median_thrs, 100000);
+          break;
+      }
+    }
+    dt_get_times(&end);
+    darktable.unmuted = old_muted;
+    const float clock = (end.clock - start.clock) / (float)counter;
+    dt_print(DT_DEBUG_ALWAYS,
+             "[bench module demosaic] %-6s takes %8.5fs,%7.2fmpix,%9.3fpix/us",
+             _method_str(methods[k]), clock, mpix, mpix / clock);
+  }
+
+  dt_free_align(in);
+  dt_free_align(out);
+}
+
 #ifdef HAVE_OPENCL
 int process_cl(dt_iop_module_t *self,
                dt_dev_pixelpipe_iop_t *const piece,
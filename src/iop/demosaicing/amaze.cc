@@ -95,6 +95,10 @@ static inline float _xdivf(float d, int n)
 
 #define LIM(x, min, max) MAX(min, MIN(x, max))
 #define ULIM(x, y, z) ((y) < (z) ? LIM(x, y, z) : LIM(x, z, y))
+// index into the half size arrays of the site at indx + d, for the loops that step over every
+// other pixel of a row with indx = indx0 + 2 * k, indx1 = (indx0 >> 1) + k and odd = indx0 & 1.
+// same as (indx + d) >> 1 but stays affine in k, so that these loops vectorise
+#define HALF(d) (indx1 + (((d) + odd) >> 1))
 
 
 ////////////////////////////////////////////////////////////////
@@ -126,6 +130,7 @@ static inline float _xdivf(float d, int n)
 ////////////////////////////////////////////////////////////////
 
 
+__DT_CLONE_TARGETS__
 void amaze_demosaic(const float *const in,
                     float *out,
                     const int width,
@@ -263,7 +268,7 @@ void amaze_demosaic(const float *const in,
 
 // Main algorithm: Tile loop
 // use collapse(2) to collapse the 2 loops to one large loop, so there is better scaling
-    DT_OMP_PRAGMA(for SIMD() schedule(static) collapse(2) nowait)
+    DT_OMP_PRAGMA(for schedule(static) collapse(2) nowait)
 
     for(int top = -16; top < height; top += ts - 32)
     {
@@ -407,7 +412,8 @@ void amaze_demosaic(const float *const in,
 
         for(int rr = 4; rr < rr1 - 4; rr++)
         {
-          bool fcswitch = FC(rr, 4, filters) & 1;
+          // the colour of the first pixel in the row, the others alternate by column
+          const int fc4 = FC(rr, 4, filters) & 1;
 
           for(int cc = 4, indx = rr * ts + cc; cc < cc1 - 4; cc++, indx++)
           {
@@ -428,45 +434,6 @@ void amaze_demosaic(const float *const in,
             const float glha = cfa[indx - 1] + _xdiv2f(cfa[indx] - cfa[indx - 2]);
             const float grha = cfa[indx + 1] + _xdiv2f(cfa[indx] - cfa[indx + 2]);
 
-            // G interpolated in vert/hor directions using adaptive ratios
-            float guar, gdar, glar, grar;
-
-            if(fabsf(1.f - cru) < arthresh)
-            {
-              guar = cfa[indx] * cru;
-            }
-            else
-            {
-              guar = guha;
-            }
-
-            if(fabsf(1.f - crd) < arthresh)
-            {
-              gdar = cfa[indx] * crd;
-            }
-            else
-            {
-              gdar = gdha;
-            }
-
-            if(fabsf(1.f - crl) < arthresh)
-            {
-              glar = cfa[indx] * crl;
-            }
-            else
-            {
-              glar = glha;
-            }
-
-            if(fabsf(1.f - crr) < arthresh)
-            {
-              grar = cfa[indx] * crr;
-            }
-            else
-            {
-              grar = grha;
-            }
-
             // adaptive weights for vertical/horizontal directions
             const float hwt = dirwts1[indx - 1] / (dirwts1[indx - 1] + dirwts1[indx + 1]);
             const float vwt = dirwts0[indx - v1] / (dirwts0[indx + v1] + dirwts0[indx - v1]);
@@ -475,35 +442,21 @@ void amaze_demosaic(const float *const in,
             const float Gintvha = vwt * gdha + (1.f - vwt) * guha;
             const float Ginthha = hwt * grha + (1.f - hwt) * glha;
 
-            // interpolated colour differences
-            if(fcswitch)
-            {
-              vcd[indx] = cfa[indx] - (vwt * gdar + (1.f - vwt) * guar);
-              hcd[indx] = cfa[indx] - (hwt * grar + (1.f - hwt) * glar);
-              vcdalt[indx] = cfa[indx] - Gintvha;
-              hcdalt[indx] = cfa[indx] - Ginthha;
-            }
-            else
-            {
-              // interpolated colour differences
-              vcd[indx] = (vwt * gdar + (1.f - vwt) * guar) - cfa[indx];
-              hcd[indx] = (hwt * grar + (1.f - hwt) * glar) - cfa[indx];
-              vcdalt[indx] = Gintvha - cfa[indx];
-              hcdalt[indx] = Ginthha - cfa[indx];
-            }
-
-            fcswitch = !fcswitch;
+            // use HA if highlights are (nearly) clipped
+            const bool clipped = MAX(cfa[indx], MAX(Gintvha, Ginthha)) > clip_pt8;
 
-            if(cfa[indx] > clip_pt8 || Gintvha > clip_pt8 || Ginthha > clip_pt8)
-            {
-              // use HA if highlights are (nearly) clipped
-              guar = guha;
-              gdar = gdha;
-              glar = glha;
-              grar = grha;
-              vcd[indx] = vcdalt[indx];
-              hcd[indx] = hcdalt[indx];
-            }
+            // G interpolated in vert/hor directions using adaptive ratios
+            const float guar = !clipped && fabsf(1.f - cru) < arthresh ? cfa[indx] * cru : guha;
+            const float gdar = !clipped && fabsf(1.f - crd) < arthresh ? cfa[indx] * crd : gdha;
+            const float glar = !clipped && fabsf(1.f - crl) < arthresh ? cfa[indx] * crl : glha;
+            const float grar = !clipped && fabsf(1.f - crr) < arthresh ? cfa[indx] * crr : grha;
+
+            // interpolated colour differences, kept branch free so the loop vectorises
+            const float sign = (fc4 ^ (cc & 1)) ? 1.f : -1.f;
+            vcdalt[indx] = sign * (cfa[indx] - Gintvha);
+            hcdalt[indx] = sign * (cfa[indx] - Ginthha);
+            vcd[indx] = clipped ? vcdalt[indx] : sign * (cfa[indx] - (vwt * gdar + (1.f - vwt) * guar));
+            hcd[indx] = clipped ? hcdalt[indx] : sign * (cfa[indx] - (hwt * grar + (1.f - hwt) * glar));
 
             // differences of interpolations in opposite directions
             dgintv[indx] = MIN(sqrf(guha - gdha), sqrf(guar - gdar));
@@ -513,36 +466,88 @@ void amaze_demosaic(const float *const in,
 
         for(int rr = 4; rr < rr1 - 4; rr++)
         {
-          for(int cc = 4, indx = rr * ts + cc, c = FC(rr, cc, filters) & 1; cc < cc1 - 4; cc++, indx++)
+          const int fc4 = FC(rr, 4, filters) & 1;
+
+          // the vertical differences only depend on the rows above and below, so they can be
+          // processed for the whole row at once; the horizontal ones below depend on their
+          // already bounded left neighbour and have to stay sequential
+          DT_OMP_SIMD()
+          for(int cc = 4; cc < cc1 - 4; cc++)
           {
-            const float hcdvar = 3.f * (sqrf(hcd[indx - 2]) + sqrf(hcd[indx]) + sqrf(hcd[indx + 2]))
-                           - sqrf(hcd[indx - 2] + hcd[indx] + hcd[indx + 2]);
-            const float hcdaltvar = 3.f * (sqrf(hcdalt[indx - 2]) + sqrf(hcdalt[indx]) + sqrf(hcdalt[indx + 2]))
-                              - sqrf(hcdalt[indx - 2] + hcdalt[indx] + hcdalt[indx + 2]);
+            const int indx = rr * ts + cc;
             const float vcdvar = 3.f * (sqrf(vcd[indx - v2]) + sqrf(vcd[indx]) + sqrf(vcd[indx + v2]))
                            - sqrf(vcd[indx - v2] + vcd[indx] + vcd[indx + v2]);
             const float vcdaltvar = 3.f * (sqrf(vcdalt[indx - v2]) + sqrf(vcdalt[indx]) + sqrf(vcdalt[indx + v2]))
                               - sqrf(vcdalt[indx - v2] + vcdalt[indx] + vcdalt[indx + v2]);
 
             // choose the smallest variance; this yields a smoother interpolation
-            if(hcdaltvar < hcdvar)
-            {
-              hcd[indx] = hcdalt[indx];
+            float vcdv = vcdaltvar < vcdvar ? vcdalt[indx] : vcd[indx];
+
+            // bound the interpolation in regions of high saturation
+            if(fc4 ^ (cc & 1))
+            {                                 // G site
+              const float Gintv = -vcdv + cfa[indx]; // B or R
+
+              if(vcdv > 0)
+              {
+                if(3.f * vcdv > (Gintv + cfa[indx]))
+                {
+                  vcdv = -ULIM(Gintv, cfa[indx - v1], cfa[indx + v1]) + cfa[indx];
+                }
+                else
+                {
+                  const float vwt = 1.f - 3.f * vcdv / (eps + Gintv + cfa[indx]);
+                  vcdv = vwt * vcdv + (1.f - vwt) * (-ULIM(Gintv, cfa[indx - v1], cfa[indx + v1]) + cfa[indx]);
+                }
+              }
+
+              if(Gintv > clip_pt)
+              {
+                vcdv = -ULIM(Gintv, cfa[indx - v1], cfa[indx + v1]) + cfa[indx];
+              }
             }
+            else
+            { // R or B site
+              const float Gintv = vcdv + cfa[indx];
 
-            if(vcdaltvar < vcdvar)
+              if(vcdv < 0)
+              {
+                if(3.f * vcdv < -(Gintv + cfa[indx]))
+                {
+                  vcdv = ULIM(Gintv, cfa[indx - v1], cfa[indx + v1]) - cfa[indx];
+                }
+                else
+                {
+                  const float vwt = 1.f + 3.f * vcdv / (eps + Gintv + cfa[indx]);
+                  vcdv = vwt * vcdv + (1.f - vwt) * (ULIM(Gintv, cfa[indx - v1], cfa[indx + v1]) - cfa[indx]);
+                }
+              }
+
+              if(Gintv > clip_pt)
+              {
+                vcdv = ULIM(Gintv, cfa[indx - v1], cfa[indx + v1]) - cfa[indx];
+              }
+            }
+            vcd[indx] = vcdv;
+          }
+
+          for(int cc = 4, indx = rr * ts + cc, c = fc4; cc < cc1 - 4; cc++, indx++)
+          {
+            const float hcdvar = 3.f * (sqrf(hcd[indx - 2]) + sqrf(hcd[indx]) + sqrf(hcd[indx + 2]))
+                           - sqrf(hcd[indx - 2] + hcd[indx] + hcd[indx + 2]);
+            const float hcdaltvar = 3.f * (sqrf(hcdalt[indx - 2]) + sqrf(hcdalt[indx]) + sqrf(hcdalt[indx + 2]))
+                              - sqrf(hcdalt[indx - 2] + hcdalt[indx] + hcdalt[indx + 2]);
+
+            // choose the smallest variance; this yields a smoother interpolation
+            if(hcdaltvar < hcdvar)
             {
-              vcd[indx] = vcdalt[indx];
+              hcd[indx] = hcdalt[indx];
             }
 
             // bound the interpolation in regions of high saturation
-            // vertical and horizontal G interpolations
-            float Gintv, Ginth;
-
             if(c)
             {                                 // G site
-              Ginth = -hcd[indx] + cfa[indx]; // R or B
-              Gintv = -vcd[indx] + cfa[indx]; // B or R
+              const float Ginth = -hcd[indx] + cfa[indx]; // R or B
 
               if(hcd[indx] > 0)
               {
@@ -558,35 +563,14 @@ void amaze_demosaic(const float *const in,
                 }
               }
 
-              if(vcd[indx] > 0)
-              {
-                if(3.f * vcd[indx] > (Gintv + cfa[indx]))
-                {
-                  vcd[indx] = -ULIM(Gintv, cfa[indx - v1], cfa[indx + v1]) + cfa[indx];
-                }
-                else
-                {
-                  const float vwt = 1.f - 3.f * vcd[indx] / (eps + Gintv + cfa[indx]);
-                  vcd[indx] = vwt * vcd[indx]
-                              + (1.f - vwt) * (-ULIM(Gintv, cfa[indx - v1], cfa[indx + v1]) + cfa[indx]);
-                }
-              }
-
               if(Ginth > clip_pt)
               {
                 hcd[indx] = -ULIM(Ginth, cfa[indx - 1], cfa[indx + 1]) + cfa[indx];
               }
-
-              if(Gintv > clip_pt)
-              {
-                vcd[indx] = -ULIM(Gintv, cfa[indx - v1], cfa[indx + v1]) + cfa[indx];
-              }
             }
             else
             { // R or B site
-
-              Ginth = hcd[indx] + cfa[indx]; // interpolated G
-              Gintv = vcd[indx] + cfa[indx];
+              const float Ginth = hcd[indx] + cfa[indx]; // interpolated G
 
               if(hcd[indx] < 0)
               {
@@ -596,36 +580,17 @@ void amaze_demosaic(const float *const in,
                 }
                 else
                 {
-                  float hwt = 1.f + 3.f * hcd[indx] / (eps + Ginth + cfa[indx]);
+                  const float hwt = 1.f + 3.f * hcd[indx] / (eps + Ginth + cfa[indx]);
                   hcd[indx] = hwt * hcd[indx]
                               + (1.f - hwt) * (ULIM(Ginth, cfa[indx - 1], cfa[indx + 1]) - cfa[indx]);
                 }
               }
 
-              if(vcd[indx] < 0)
-              {
-                if(3.f * vcd[indx] < -(Gintv + cfa[indx]))
-                {
-                  vcd[indx] = ULIM(Gintv, cfa[indx - v1], cfa[indx + v1]) - cfa[indx];
-                }
-                else
-                {
-                  const float vwt = 1.f + 3.f * vcd[indx] / (eps + Gintv + cfa[indx]);
-                  vcd[indx] = vwt * vcd[indx]
-                              + (1.f - vwt) * (ULIM(Gintv, cfa[indx - v1], cfa[indx + v1]) - cfa[indx]);
-                }
-              }
-
               if(Ginth > clip_pt)
               {
                 hcd[indx] = ULIM(Ginth, cfa[indx - 1], cfa[indx + 1]) - cfa[indx];
               }
 
-              if(Gintv > clip_pt)
-              {
-                vcd[indx] = ULIM(Gintv, cfa[indx - v1], cfa[indx + v1]) - cfa[indx];
-              }
-
               cddiffsq[indx] = sqrf(vcd[indx] - hcd[indx]);
             }
 
@@ -633,11 +598,16 @@ void amaze_demosaic(const float *const in,
           }
         }
 
-
         for(int rr = 6; rr < rr1 - 6; rr++)
         {
-          for(int cc = 6 + (FC(rr, 2, filters) & 1), indx = rr * ts + cc; cc < cc1 - 6; cc += 2, indx += 2)
+          // step over the R/B sites by k, so that the simd pragma gets a loop in canonical form
+          const int cc0 = 6 + (FC(rr, 2, filters) & 1);
+          const int indx0 = rr * ts + cc0;
+          DT_OMP_SIMD()
+          for(int k = 0; k < (cc1 - 6 - cc0 + 1) / 2; k++)
           {
+            const int indx = indx0 + 2 * k;
+            const int indx1 = (indx0 >> 1) + k;
 
             // compute colour difference variances in cardinal directions
 
@@ -678,26 +648,23 @@ void amaze_demosaic(const float *const in,
             // if both agree on interpolation direction, choose the one with strongest directional
             // discrimination;
             // otherwise, choose the u/d and l/r difference fluctuation weights
-            if((0.5 - varwt) * (0.5 - diffwt) > 0 && fabsf(0.5f - diffwt) < fabsf(0.5f - varwt))
-            {
-              hvwt[indx >> 1] = varwt;
-            }
-            else
-            {
-              hvwt[indx >> 1] = diffwt;
-            }
+            hvwt[indx1] = (0.5f - varwt) * (0.5f - diffwt) > 0.f && fabsf(0.5f - diffwt) < fabsf(0.5f - varwt)
+                              ? varwt
+                              : diffwt;
           }
         }
 
         // precompute nyquist
         for(int rr = 6; rr < rr1 - 6; rr++)
         {
-          int cc = 6 + (FC(rr, 2, filters) & 1);
-          int indx = rr * ts + cc;
-
-          for(; cc < cc1 - 6; cc += 2, indx += 2)
+          const int cc0 = 6 + (FC(rr, 2, filters) & 1);
+          const int indx0 = rr * ts + cc0;
+          DT_OMP_SIMD()
+          for(int k = 0; k < (cc1 - 6 - cc0 + 1) / 2; k++)
           {
-            nyqutest[indx >> 1]
+            const int indx = indx0 + 2 * k;
+            const int indx1 = (indx0 >> 1) + k;
+            nyqutest[indx1]
                 = (gaussodd[0] * cddiffsq[indx]
                    + gaussodd[1] * (cddiffsq[(indx - m1)] + cddiffsq[(indx + p1)] + cddiffsq[(indx - p1)]
                                     + cddiffsq[(indx + m1)])
@@ -913,132 +880,87 @@ void amaze_demosaic(const float *const in,
 // diagonal interpolation correction
         for(int rr = 8; rr < rr1 - 8; rr++)
         {
-          for(int cc = 8 + (FC(rr, 2, filters) & 1), indx = rr * ts + cc, indx1 = indx >> 1; cc < cc1 - 8;
-              cc += 2, indx += 2, indx1++)
+          const int cc0 = 8 + (FC(rr, 2, filters) & 1);
+          const int indx0 = rr * ts + cc0;
+          const int odd = indx0 & 1;
+          DT_OMP_SIMD()
+          for(int k = 0; k < (cc1 - 8 - cc0 + 1) / 2; k++)
           {
+            const int indx = indx0 + 2 * k;
+            const int indx1 = (indx0 >> 1) + k;
 
             // diagonal colour ratios
-            float crse = _xmul2f(cfa[indx + m1]) / (eps + cfa[indx] + (cfa[indx + m2]));
-            float crnw = _xmul2f(cfa[indx - m1]) / (eps + cfa[indx] + (cfa[indx - m2]));
-            float crne = _xmul2f(cfa[indx + p1]) / (eps + cfa[indx] + (cfa[indx + p2]));
-            float crsw = _xmul2f(cfa[indx - p1]) / (eps + cfa[indx] + (cfa[indx - p2]));
-            // colour differences in diagonal directions
-            float rbse, rbnw, rbne, rbsw;
-
-            // assign B/R at R/B sites
-            if(fabsf(1.f - crse) < arthresh)
-            {
-              rbse = cfa[indx] * crse; // use this if more precise diag interp is necessary
-            }
-            else
-            {
-              rbse = (cfa[indx + m1]) + _xdiv2f(cfa[indx] - cfa[indx + m2]);
-            }
-
-            if(fabsf(1.f - crnw) < arthresh)
-            {
-              rbnw = cfa[indx] * crnw;
-            }
-            else
-            {
-              rbnw = (cfa[indx - m1]) + _xdiv2f(cfa[indx] - cfa[indx - m2]);
-            }
-
-            if(fabsf(1.f - crne) < arthresh)
-            {
-              rbne = cfa[indx] * crne;
-            }
-            else
-            {
-              rbne = (cfa[indx + p1]) + _xdiv2f(cfa[indx] - cfa[indx + p2]);
-            }
-
-            if(fabsf(1.f - crsw) < arthresh)
-            {
-              rbsw = cfa[indx] * crsw;
-            }
-            else
-            {
-              rbsw = (cfa[indx - p1]) + _xdiv2f(cfa[indx] - cfa[indx - p2]);
-            }
-
-            const float wtse = eps + delm[indx1] + delm[(indx + m1) >> 1]
-                         + delm[(indx + m2) >> 1]; // same as for wtu,wtd,wtl,wtr
-            const float wtnw = eps + delm[indx1] + delm[(indx - m1) >> 1] + delm[(indx - m2) >> 1];
-            const float wtne = eps + delp[indx1] + delp[(indx + p1) >> 1] + delp[(indx + p2) >> 1];
-            const float wtsw = eps + delp[indx1] + delp[(indx - p1) >> 1] + delp[(indx - p2) >> 1];
-
-
-            rbm[indx1] = (wtse * rbnw + wtnw * rbse) / (wtse + wtnw);
-            rbp[indx1] = (wtne * rbsw + wtsw * rbne) / (wtne + wtsw);
+            const float crse = _xmul2f(cfa[indx + m1]) / (eps + cfa[indx] + (cfa[indx + m2]));
+            const float crnw = _xmul2f(cfa[indx - m1]) / (eps + cfa[indx] + (cfa[indx - m2]));
+            const float crne = _xmul2f(cfa[indx + p1]) / (eps + cfa[indx] + (cfa[indx + p2]));
+            const float crsw = _xmul2f(cfa[indx - p1]) / (eps + cfa[indx] + (cfa[indx - p2]));
+
+            // colour differences in diagonal directions, assign B/R at R/B sites
+            const float rbse = fabsf(1.f - crse) < arthresh ? cfa[indx] * crse
+                                                            : (cfa[indx + m1]) + _xdiv2f(cfa[indx] - cfa[indx + m2]);
+            const float rbnw = fabsf(1.f - crnw) < arthresh ? cfa[indx] * crnw
+                                                            : (cfa[indx - m1]) + _xdiv2f(cfa[indx] - cfa[indx - m2]);
+            const float rbne = fabsf(1.f - crne) < arthresh ? cfa[indx] * crne
+                                                            : (cfa[indx + p1]) + _xdiv2f(cfa[indx] - cfa[indx + p2]);
+            const float rbsw = fabsf(1.f - crsw) < arthresh ? cfa[indx] * crsw
+                                                            : (cfa[indx - p1]) + _xdiv2f(cfa[indx] - cfa[indx - p2]);
+
+            const float wtse = eps + delm[indx1] + delm[HALF(m1)] + delm[HALF(m2)]; // same as for wtu,wtd,wtl,wtr
+            const float wtnw = eps + delm[indx1] + delm[HALF(-m1)] + delm[HALF(-m2)];
+            const float wtne = eps + delp[indx1] + delp[HALF(p1)] + delp[HALF(p2)];
+            const float wtsw = eps + delp[indx1] + delp[HALF(-p1)] + delp[HALF(-p2)];
+
+            const float rbmint = (wtse * rbnw + wtnw * rbse) / (wtse + wtnw);
+            const float rbpint = (wtne * rbsw + wtsw * rbne) / (wtne + wtsw);
 
             // variance of R-B in plus/minus directions
             const float rbvarm = epssq
-                  + (gausseven[0] * (Dgrbsq1m[(indx - v1) >> 1] + Dgrbsq1m[(indx - 1) >> 1]
-                                     + Dgrbsq1m[(indx + 1) >> 1] + Dgrbsq1m[(indx + v1) >> 1])
-                     + gausseven[1] * (Dgrbsq1m[(indx - v2 - 1) >> 1] + Dgrbsq1m[(indx - v2 + 1) >> 1]
-                                       + Dgrbsq1m[(indx - 2 - v1) >> 1] + Dgrbsq1m[(indx + 2 - v1) >> 1]
-                                       + Dgrbsq1m[(indx - 2 + v1) >> 1] + Dgrbsq1m[(indx + 2 + v1) >> 1]
-                                       + Dgrbsq1m[(indx + v2 - 1) >> 1] + Dgrbsq1m[(indx + v2 + 1) >> 1]));
+                  + (gausseven[0] * (Dgrbsq1m[HALF(-v1)] + Dgrbsq1m[HALF(-1)]
+                                     + Dgrbsq1m[HALF(1)] + Dgrbsq1m[HALF(v1)])
+                     + gausseven[1] * (Dgrbsq1m[HALF(-v2 - 1)] + Dgrbsq1m[HALF(-v2 + 1)]
+                                       + Dgrbsq1m[HALF(-2 - v1)] + Dgrbsq1m[HALF(2 - v1)]
+                                       + Dgrbsq1m[HALF(-2 + v1)] + Dgrbsq1m[HALF(2 + v1)]
+                                       + Dgrbsq1m[HALF(v2 - 1)] + Dgrbsq1m[HALF(v2 + 1)]));
             pmwt[indx1] = rbvarm
-                  / ((epssq + (gausseven[0] * (Dgrbsq1p[(indx - v1) >> 1] + Dgrbsq1p[(indx - 1) >> 1]
-                                               + Dgrbsq1p[(indx + 1) >> 1] + Dgrbsq1p[(indx + v1) >> 1])
+                  / ((epssq + (gausseven[0] * (Dgrbsq1p[HALF(-v1)] + Dgrbsq1p[HALF(-1)]
+                                               + Dgrbsq1p[HALF(1)] + Dgrbsq1p[HALF(v1)])
                                + gausseven[1]
-                                     * (Dgrbsq1p[(indx - v2 - 1) >> 1] + Dgrbsq1p[(indx - v2 + 1) >> 1]
-                                        + Dgrbsq1p[(indx - 2 - v1) >> 1] + Dgrbsq1p[(indx + 2 - v1) >> 1]
-                                        + Dgrbsq1p[(indx - 2 + v1) >> 1] + Dgrbsq1p[(indx + 2 + v1) >> 1]
-                                        + Dgrbsq1p[(indx + v2 - 1) >> 1] + Dgrbsq1p[(indx + v2 + 1) >> 1])))
+                                     * (Dgrbsq1p[HALF(-v2 - 1)] + Dgrbsq1p[HALF(-v2 + 1)]
+                                        + Dgrbsq1p[HALF(-2 - v1)] + Dgrbsq1p[HALF(2 - v1)]
+                                        + Dgrbsq1p[HALF(-2 + v1)] + Dgrbsq1p[HALF(2 + v1)]
+                                        + Dgrbsq1p[HALF(v2 - 1)] + Dgrbsq1p[HALF(v2 + 1)])))
                      + rbvarm);
 
             // bound the interpolation in regions of high saturation
-
-            if(rbp[indx1] < cfa[indx])
-            {
-              if(_xmul2f(rbp[indx1]) < cfa[indx])
-              {
-                rbp[indx1] = ULIM(rbp[indx1], cfa[indx - p1], cfa[indx + p1]);
-              }
-              else
-              {
-                const float pwt = _xmul2f(cfa[indx] - rbp[indx1]) / (eps + rbp[indx1] + cfa[indx]);
-                rbp[indx1] = pwt * rbp[indx1] + (1.f - pwt) * ULIM(rbp[indx1], cfa[indx - p1], cfa[indx + p1]);
-              }
-            }
-
-            if(rbm[indx1] < cfa[indx])
-            {
-              if(_xmul2f(rbm[indx1]) < cfa[indx])
-              {
-                rbm[indx1] = ULIM(rbm[indx1], cfa[indx - m1], cfa[indx + m1]);
-              }
-              else
-              {
-                const float mwt = _xmul2f(cfa[indx] - rbm[indx1]) / (eps + rbm[indx1] + cfa[indx]);
-                rbm[indx1] = mwt * rbm[indx1] + (1.f - mwt) * ULIM(rbm[indx1], cfa[indx - m1], cfa[indx + m1]);
-              }
-            }
-
-            if(rbp[indx1] > clip_pt)
-            {
-              rbp[indx1] = ULIM(rbp[indx1], cfa[indx - p1], cfa[indx + p1]);
-            }
-
-            if(rbm[indx1] > clip_pt)
-            {
-              rbm[indx1] = ULIM(rbm[indx1], cfa[indx - m1], cfa[indx + m1]);
-            }
+            const float rbpclip = ULIM(rbpint, cfa[indx - p1], cfa[indx + p1]);
+            const float pwt = _xmul2f(cfa[indx] - rbpint) / (eps + rbpint + cfa[indx]);
+            const float rbpbound = rbpint >= cfa[indx] ? rbpint
+                                 : _xmul2f(rbpint) < cfa[indx] ? rbpclip
+                                 : pwt * rbpint + (1.f - pwt) * rbpclip;
+            rbp[indx1] = rbpbound > clip_pt ? ULIM(rbpbound, cfa[indx - p1], cfa[indx + p1]) : rbpbound;
+
+            const float rbmclip = ULIM(rbmint, cfa[indx - m1], cfa[indx + m1]);
+            const float mwt = _xmul2f(cfa[indx] - rbmint) / (eps + rbmint + cfa[indx]);
+            const float rbmbound = rbmint >= cfa[indx] ? rbmint
+                                 : _xmul2f(rbmint) < cfa[indx] ? rbmclip
+                                 : mwt * rbmint + (1.f - mwt) * rbmclip;
+            rbm[indx1] = rbmbound > clip_pt ? ULIM(rbmbound, cfa[indx - m1], cfa[indx + m1]) : rbmbound;
           }
         }
 
         for(int rr = 10; rr < rr1 - 10; rr++)
-          for(int cc = 10 + (FC(rr, 2, filters) & 1), indx = rr * ts + cc, indx1 = indx >> 1; cc < cc1 - 10;
-              cc += 2, indx += 2, indx1++)
+        {
+          const int cc0 = 10 + (FC(rr, 2, filters) & 1);
+          const int indx0 = rr * ts + cc0;
+          const int odd = indx0 & 1;
+          DT_OMP_SIMD()
+          for(int k = 0; k < (cc1 - 10 - cc0 + 1) / 2; k++)
           {
+            const int indx = indx0 + 2 * k;
+            const int indx1 = (indx0 >> 1) + k;
 
             // first ask if one gets more directional discrimination from nearby B/R sites
-            const float pmwtalt = _xdivf(pmwt[(indx - m1) >> 1] + pmwt[(indx + p1) >> 1] + pmwt[(indx - p1) >> 1]
-                                      + pmwt[(indx + m1) >> 1],
-                                  2);
+            const float pmwtalt = _xdivf(pmwt[HALF(-m1)] + pmwt[HALF(p1)] + pmwt[HALF(-p1)] + pmwt[HALF(m1)], 2);
 
             if(fabsf(0.5f - pmwt[indx1]) < fabsf(0.5f - pmwtalt))
             {
@@ -1048,6 +970,7 @@ void amaze_demosaic(const float *const in,
             rbint[indx1] = _xdiv2f(cfa[indx] + rbm[indx1] * (1.f - pmwt[indx1])
                                   + rbp[indx1] * pmwt[indx1]); // this is R+B, interpolated
           }
+        }
 
         for(int rr = 12; rr < rr1 - 12; rr++)
           for(int cc = 12 + (FC(rr, 2, filters) & 1), indx = rr * ts + cc, indx1 = indx >> 1; cc < cc1 - 12;
@@ -1167,37 +1090,44 @@ void amaze_demosaic(const float *const in,
           }
 
         for(int rr = 14; rr < rr1 - 14; rr++)
-
-          for(int cc = 14 + (FC(rr, 2, filters) & 1), indx = rr * ts + cc, c = 1 - FC(rr, cc, filters) / 2;
-              cc < cc1 - 14; cc += 2, indx += 2)
+        {
+          const int cc0 = 14 + (FC(rr, 2, filters) & 1);
+          const int indx0 = rr * ts + cc0;
+          const int odd = indx0 & 1;
+          const int c = 1 - FC(rr, cc0, filters) / 2;
+          DT_OMP_SIMD()
+          for(int k = 0; k < (cc1 - 14 - cc0 + 1) / 2; k++)
           {
-            const float wtnw = 1.f / (eps + fabsf(Dgrb[c][(indx - m1) >> 1] - Dgrb[c][(indx + m1) >> 1])
-                                + fabsf(Dgrb[c][(indx - m1) >> 1] - Dgrb[c][(indx - m3) >> 1])
-                                + fabsf(Dgrb[c][(indx + m1) >> 1] - Dgrb[c][(indx - m3) >> 1]));
-            const float wtne = 1.f / (eps + fabsf(Dgrb[c][(indx + p1) >> 1] - Dgrb[c][(indx - p1) >> 1])
-                                + fabsf(Dgrb[c][(indx + p1) >> 1] - Dgrb[c][(indx + p3) >> 1])
-                                + fabsf(Dgrb[c][(indx - p1) >> 1] - Dgrb[c][(indx + p3) >> 1]));
-            const float wtsw = 1.f / (eps + fabsf(Dgrb[c][(indx - p1) >> 1] - Dgrb[c][(indx + p1) >> 1])
-                                + fabsf(Dgrb[c][(indx - p1) >> 1] - Dgrb[c][(indx + m3) >> 1])
-                                + fabsf(Dgrb[c][(indx + p1) >> 1] - Dgrb[c][(indx - p3) >> 1]));
-            const float wtse = 1.f / (eps + fabsf(Dgrb[c][(indx + m1) >> 1] - Dgrb[c][(indx - m1) >> 1])
-                                + fabsf(Dgrb[c][(indx + m1) >> 1] - Dgrb[c][(indx - p3) >> 1])
-                                + fabsf(Dgrb[c][(indx - m1) >> 1] - Dgrb[c][(indx + m3) >> 1]));
-
-            Dgrb[c][indx >> 1]
-                = (wtnw * (1.325f * Dgrb[c][(indx - m1) >> 1] - 0.175f * Dgrb[c][(indx - m3) >> 1]
-                           - 0.075f * Dgrb[c][(indx - m1 - 2) >> 1] - 0.075f * Dgrb[c][(indx - m1 - v2) >> 1])
-                   + wtne * (1.325f * Dgrb[c][(indx + p1) >> 1] - 0.175f * Dgrb[c][(indx + p3) >> 1]
-                             - 0.075f * Dgrb[c][(indx + p1 + 2) >> 1]
-                             - 0.075f * Dgrb[c][(indx + p1 + v2) >> 1])
-                   + wtsw * (1.325f * Dgrb[c][(indx - p1) >> 1] - 0.175f * Dgrb[c][(indx - p3) >> 1]
-                             - 0.075f * Dgrb[c][(indx - p1 - 2) >> 1]
-                             - 0.075f * Dgrb[c][(indx - p1 - v2) >> 1])
-                   + wtse * (1.325f * Dgrb[c][(indx + m1) >> 1] - 0.175f * Dgrb[c][(indx + m3) >> 1]
-                             - 0.075f * Dgrb[c][(indx + m1 + 2) >> 1]
-                             - 0.075f * Dgrb[c][(indx + m1 + v2) >> 1]))
+            const int indx1 = (indx0 >> 1) + k;
+
+            const float wtnw = 1.f / (eps + fabsf(Dgrb[c][HALF(-m1)] - Dgrb[c][HALF(m1)])
+                                + fabsf(Dgrb[c][HALF(-m1)] - Dgrb[c][HALF(-m3)])
+                                + fabsf(Dgrb[c][HALF(m1)] - Dgrb[c][HALF(-m3)]));
+            const float wtne = 1.f / (eps + fabsf(Dgrb[c][HALF(p1)] - Dgrb[c][HALF(-p1)])
+                                + fabsf(Dgrb[c][HALF(p1)] - Dgrb[c][HALF(p3)])
+                                + fabsf(Dgrb[c][HALF(-p1)] - Dgrb[c][HALF(p3)]));
+            const float wtsw = 1.f / (eps + fabsf(Dgrb[c][HALF(-p1)] - Dgrb[c][HALF(p1)])
+                                + fabsf(Dgrb[c][HALF(-p1)] - Dgrb[c][HALF(m3)])
+                                + fabsf(Dgrb[c][HALF(p1)] - Dgrb[c][HALF(-p3)]));
+            const float wtse = 1.f / (eps + fabsf(Dgrb[c][HALF(m1)] - Dgrb[c][HALF(-m1)])
+                                + fabsf(Dgrb[c][HALF(m1)] - Dgrb[c][HALF(-p3)])
+                                + fabsf(Dgrb[c][HALF(-m1)] - Dgrb[c][HALF(m3)]));
+
+            Dgrb[c][indx1]
+                = (wtnw * (1.325f * Dgrb[c][HALF(-m1)] - 0.175f * Dgrb[c][HALF(-m3)]
+                           - 0.075f * Dgrb[c][HALF(-m1 - 2)] - 0.075f * Dgrb[c][HALF(-m1 - v2)])
+                   + wtne * (1.325f * Dgrb[c][HALF(p1)] - 0.175f * Dgrb[c][HALF(p3)]
+                             - 0.075f * Dgrb[c][HALF(p1 + 2)]
+                             - 0.075f * Dgrb[c][HALF(p1 + v2)])
+                   + wtsw * (1.325f * Dgrb[c][HALF(-p1)] - 0.175f * Dgrb[c][HALF(-p3)]
+                             - 0.075f * Dgrb[c][HALF(-p1 - 2)]
+                             - 0.075f * Dgrb[c][HALF(-p1 - v2)])
+                   + wtse * (1.325f * Dgrb[c][HALF(m1)] - 0.175f * Dgrb[c][HALF(m3)]
+                             - 0.075f * Dgrb[c][HALF(m1 + 2)]
+                             - 0.075f * Dgrb[c][HALF(m1 + v2)]))
                   / (wtnw + wtne + wtsw + wtse);
           }
+        }
 
         for(int rr = 16; rr < rr1 - 16; rr++)
         {
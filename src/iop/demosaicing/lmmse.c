@@ -117,6 +117,7 @@ static inline float _calc_gamma(float val, float *table)
 }
 
 DT_OMP_DECLARE_SIMD(aligned(in, out : 64))
+__DT_CLONE_TARGETS__
 static void lmmse_demosaic(float *const restrict out,
                            const float *const restrict in,
                            const int width,
@@ -44,27 +44,13 @@
 *    x86/64 machines, tested on Xeon E-2288G, i5-8250U.
 */
 
-/* We don't want to use the -Ofast option in dt as it effects are not well specified and there have been issues
-   leading to crashes.
-   But we can use the 'fast-math' option in code sections if input data and algorithms are well defined.
-
-   We have defined input data and make sure there are no divide-by-zero or overflows by chosen eps
-   Reordering of instructions might lead to a slight loss of presision whigh is not significant here.
-   Not necessary in this code section
-     threadsafe handling of errno
-     signed zero handling
-     handling of math interrupts
-     handling of rounding
-     handling of overflows
-
-   The 'fp-contract=fast' option enables fused multiply&add if available
+/* No local '#pragma GCC optimize' in this file: code compiled with different optimize attributes
+   than common/math.h can't inline sqrf() or interpolatef(), leaving a call in every inner loop,
+   and those loops don't vectorise. Release builds already use fast-math and fp-contract.
+   For the same reason the loops use MAX() instead of fmaxf(), which has to honour NaN operands
+   without finite-math-only and doesn't vectorise. MAX(x, floor) maps a NaN x to floor like fmaxf().
 */
 
-#ifdef __GNUC__
-  #pragma GCC push_options
-  #pragma GCC optimize ("fp-contract=fast", "finite-math-only", "no-math-errno")
-#endif
-
 #define RCD_BORDER 10         // avoid tile-overlap errors
 #define RCD_MARGIN 9          // for the outermost tiles we can have a smaller outer border
 #define RCD_TILEVALID (DT_RCD_TILESIZE - 2 * RCD_BORDER)
@@ -79,7 +65,7 @@
 // We might have negative data in input and also want to normalise
 static inline float _safe_in(float a, float scale)
 {
-  return fmaxf(0.0f, a) * scale;
+  return MAX(a, 0.0f) * scale;
 }
 
 DT_OMP_DECLARE_SIMD(aligned(in, out : 64))
@@ -116,6 +102,7 @@ static void demosaic_box3(float *const restrict out,
 }
 
 DT_OMP_DECLARE_SIMD(aligned(in, out : 64))
+__DT_CLONE_TARGETS__
 static void rcd_demosaic(float *const restrict out,
                          const float *const restrict in,
                          const int width,
@@ -210,8 +197,8 @@ static void rcd_demosaic(float *const restrict out,
           }
           for(int col = 4, indx = row * DT_RCD_TILESIZE + col; col < tileCols - 4; col++, indx++ )
           {
-            const float V_Stat = fmaxf(epssq,      V0[col - 4] +      V1[col - 4] +      V2[col - 4]);
-            const float H_Stat = fmaxf(epssq, bufferH[col - 4] + bufferH[col - 3] + bufferH[col - 2]);
+            const float V_Stat = MAX(     V0[col - 4] +      V1[col - 4] +      V2[col - 4], epssq);
+            const float H_Stat = MAX(bufferH[col - 4] + bufferH[col - 3] + bufferH[col - 2], epssq);
             VH_Dir[indx] = V_Stat / ( V_Stat + H_Stat );
           }
           // rolling the line pointers
@@ -280,8 +267,8 @@ static void rcd_demosaic(float *const restrict out,
         {
           for(int col = 4 + (FC(row, 0, filters) & 1), indx = row * DT_RCD_TILESIZE + col, indx2 = indx / 2, indx3 = (indx - w1 - 1) / 2, indx4 = (indx + w1 - 1) / 2; col < tileCols - 4; col += 2, indx += 2, indx2++, indx3++, indx4++ )
           {
-            const float P_Stat = fmaxf(epssq, P_CDiff_Hpf[indx3]     + P_CDiff_Hpf[indx2] + P_CDiff_Hpf[indx4 + 1]);
-            const float Q_Stat = fmaxf(epssq, Q_CDiff_Hpf[indx3 + 1] + Q_CDiff_Hpf[indx2] + Q_CDiff_Hpf[indx4]);
+            const float P_Stat = MAX(P_CDiff_Hpf[indx3]     + P_CDiff_Hpf[indx2] + P_CDiff_Hpf[indx4 + 1], epssq);
+            const float Q_Stat = MAX(Q_CDiff_Hpf[indx3 + 1] + Q_CDiff_Hpf[indx2] + Q_CDiff_Hpf[indx4], epssq);
             PQ_Dir[indx2] = P_Stat / (P_Stat + Q_Stat);
           }
         }
@@ -374,9 +361,9 @@ static void rcd_demosaic(float *const restrict out,
         {
           for(int col = first_horizontal, idx = (row - rowStart) * DT_RCD_TILESIZE + col - colStart, o_idx = (row * width + col) * 4; col < last_horizontal; col++, o_idx += 4, idx++)
           {
-            out[o_idx]   = scaler * fmaxf(0.0f, rgb[0][idx]);
-            out[o_idx+1] = scaler * fmaxf(0.0f, rgb[1][idx]);
-            out[o_idx+2] = scaler * fmaxf(0.0f, rgb[2][idx]);
+            out[o_idx]   = scaler * MAX(rgb[0][idx], 0.0f);
+            out[o_idx+1] = scaler * MAX(rgb[1][idx], 0.0f);
+            out[o_idx+2] = scaler * MAX(rgb[2][idx], 0.0f);
             out[o_idx+3] = 0.0f;
           }
         }
@@ -391,11 +378,6 @@ static void rcd_demosaic(float *const restrict out,
   }
 }
 
-// revert rcd specific aggressive optimizing
-#ifdef __GNUC__
-  #pragma GCC pop_options
-#endif
-
 #ifdef HAVE_OPENCL
 static cl_int process_rcd_cl(dt_iop_module_t *self,
                              dt_dev_pixelpipe_iop_t *piece,
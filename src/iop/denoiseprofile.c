@@ -1774,7 +1774,8 @@ static void process_nlmeans(dt_iop_module_t *self,
                             const void *const ivoid,
                             void *const ovoid,
                             const dt_iop_roi_t *const roi_in,
-                            const dt_iop_roi_t *const roi_out)
+                            const dt_iop_roi_t *const roi_out,
+                            const nlmeans_denoise_t denoise)
 {
   // this is called for preview and full pipe separately, each with
   // its own pixelpipe piece.  get our data struct:
@@ -1816,8 +1817,10 @@ static void process_nlmeans(dt_iop_module_t *self,
                                       .patch_radius = P,
                                       .search_radius = K,
                                       .decimate = 0,
-                                      .norm = norm2 };
-  nlmeans_denoise(in, ovoid, roi_in, roi_out, &params);
+                                      .norm = norm2,
+                                      .engine = nlmeans_preferred_engine() };
+
+  denoise(in, ovoid, roi_in, roi_out, &params);
 
   dt_free_align(in);
   nlmeans_backtransform(d,ovoid,roi_in,scale,compensate_p,wb,aa,bb,p);
@@ -2606,7 +2609,7 @@ void process(dt_iop_module_t *self,
 
   if(d->mode == MODE_NLMEANS
      || d->mode == MODE_NLMEANS_AUTO)
-    process_nlmeans(self, piece, ivoid, ovoid, roi_in, roi_out);
+    process_nlmeans(self, piece, ivoid, ovoid, roi_in, roi_out, nlmeans_denoise);
   else if(d->mode == MODE_WAVELETS
           || d->mode == MODE_WAVELETS_AUTO)
     process_wavelets(self, piece, ivoid, ovoid, roi_in, roi_out,
@@ -2615,6 +2618,21 @@ void process(dt_iop_module_t *self,
     process_variance(self, piece, ivoid, ovoid, roi_in, roi_out);
 }
 
+// --bench-module denoiseprofile compares the cpu engines of non-local means
+void benchmark(dt_iop_module_t *self,
+               dt_dev_pixelpipe_iop_t *piece,
+               const void *const ivoid,
+               void *const ovoid,
+               const dt_iop_roi_t *const roi_in,
+               const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_denoiseprofile_data_t *const d = piece->data;
+
+  if(d->mode == MODE_NLMEANS
+     || d->mode == MODE_NLMEANS_AUTO)
+    process_nlmeans(self, piece, ivoid, ovoid, roi_in, roi_out, nlmeans_benchmark);
+}
+
 static inline unsigned infer_radius_from_profile(const float a)
 {
   return MIN((unsigned)(1.0f + a * 15000.0f + a * a * 300000.0f), 8);
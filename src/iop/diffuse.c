@@ -43,7 +43,7 @@
 #include "gui/presets.h"
 #include "iop/iop_api.h"
 
-DT_MODULE_INTROSPECTION(2, dt_iop_diffuse_params_t)
+DT_MODULE_INTROSPECTION(3, dt_iop_diffuse_params_t)
 
 #define MAX_NUM_SCALES 10
 typedef struct dt_iop_diffuse_params_t
@@ -70,6 +70,9 @@ typedef struct dt_iop_diffuse_params_t
   // v2
   int radius_center;        // $MIN: 0    $MAX: 1024 $DEFAULT: 0  $DESCRIPTION: "central radius"
 
+  // v3
+  gboolean multires;        // $DEFAULT: FALSE $DESCRIPTION: "multi-resolution solver"
+
   // new versions add params mandatorily at the end, so we can memcpy old parameters at the beginning
 
 } dt_iop_diffuse_params_t;
@@ -78,7 +81,8 @@ typedef struct dt_iop_diffuse_params_t
 typedef struct dt_iop_diffuse_gui_data_t
 {
   GtkWidget *iterations, *fourth, *third, *second, *radius, *radius_center, *sharpness, *threshold, *regularization, *first,
-      *anisotropy_first, *anisotropy_second, *anisotropy_third, *anisotropy_fourth, *regularization_first, *variance_threshold;
+      *anisotropy_first, *anisotropy_second, *anisotropy_third, *anisotropy_fourth, *regularization_first, *variance_threshold,
+      *multires;
 } dt_iop_diffuse_gui_data_t;
 
 typedef struct dt_iop_diffuse_global_data_t
@@ -229,6 +233,22 @@ int legacy_params(dt_iop_module_t *self,
     *new_version = 2;
     return 0;
   }
+  if(old_version == 2)
+  {
+    const dt_iop_diffuse_params_v2_t *o = (dt_iop_diffuse_params_v2_t *)old_params;
+    dt_iop_diffuse_params_t *n = malloc(sizeof(dt_iop_diffuse_params_t));
+
+    // copy common parameters
+    memcpy(n, o, sizeof(dt_iop_diffuse_params_v2_t));
+
+    // init only new parameters
+    n->multires = FALSE;
+
+    *new_params = n;
+    *new_params_size = sizeof(dt_iop_diffuse_params_t);
+    *new_version = 3;
+    return 0;
+  }
   return 1;
 }
 
@@ -790,7 +810,8 @@ void tiling_callback(dt_iop_module_t *self,
   const int max_filter_radius = (1 << scales);
 
   // in + out + 2 * tmp + 2 * LF + s details + grey mask
-  tiling->factor = 6.25f + scales;
+  // the multi-resolution solver adds 4 buffers and a mask at half size
+  tiling->factor = 6.25f + scales + (data->multires ? 1.0625f : 0.f);
   tiling->factor_cl = 6.25f + scales;
 
   tiling->maxbuf = 1.0f;
@@ -1159,7 +1180,9 @@ static inline gboolean wavelets_process(const float *const restrict in,
                                     const gboolean has_mask,
                                     float *const restrict HF[MAX_NUM_SCALES],
                                     float *const restrict LF_odd,
-                                    float *const restrict LF_even)
+                                    float *const restrict LF_even,
+                                    float *const restrict tempbuf,
+                                    const size_t padded_size)
 {
   gboolean success = TRUE;
 
@@ -1183,9 +1206,6 @@ static inline gboolean wavelets_process(const float *const restrict in,
   // https://jo.dreggn.org/home/2010_atrous.pdf the wavelets
   // decomposition here is the same as the equalizer/atrous module,
   float *restrict residual; // will store the temp buffer containing the last step of blur
-  // allocate a one-row temporary buffer for the decomposition
-  size_t padded_size;
-  float *const restrict tempbuf = dt_alloc_perthread_float(4 * width, &padded_size); //TODO: alloc in caller
   for(int s = 0; s < scales; ++s)
   {
     /* fprintf(stdout, "Wavelet decompose : scale %i\n", s); */
@@ -1225,7 +1245,6 @@ static inline gboolean wavelets_process(const float *const restrict in,
       dt_dump_pfm(name, buffer_out, width, height, 4 * sizeof(float), "diffuse");
     }
   }
-  dt_free_align(tempbuf);
 
   // will store the temp buffer NOT containing the last step of blur
   float *restrict temp = (residual == LF_even) ? LF_odd : LF_even;
@@ -1337,12 +1356,201 @@ static inline void inpaint_mask(float *const restrict inpainted,
   }
 }
 
-void process(dt_iop_module_t *self,
-             dt_dev_pixelpipe_iop_t *piece,
-             const void *const restrict ivoid,
-             void *const restrict ovoid,
-             const dt_iop_roi_t *const roi_in,
-             const dt_iop_roi_t *const roi_out)
+// run iterations of the solver, cycling between temp1 and temp2, the last one writes out
+static void _iterate(dt_dev_pixelpipe_iop_t *piece,
+                     const float *const in,
+                     float *const out,
+                     const uint8_t *const restrict mask,
+                     const size_t width,
+                     const size_t height,
+                     const dt_iop_diffuse_data_t *const data,
+                     const float final_radius,
+                     const float zoom,
+                     const gboolean has_mask,
+                     const int iterations,
+                     float *const restrict HF[MAX_NUM_SCALES],
+                     float *const temp1,
+                     float *const temp2,
+                     float *const restrict LF_odd,
+                     float *const restrict LF_even,
+                     float *const restrict tempbuf,
+                     const size_t padded_size)
+{
+  const int diffusion_scales = num_steps_to_reach_equivalent_sigma(B_SPLINE_SIGMA, final_radius);
+  const int scales = CLAMP(diffusion_scales, 1, MAX_NUM_SCALES);
+
+  const float *temp_in = NULL;
+  float *temp_out = NULL;
+
+  for(int it = 0; it < iterations && !dt_dev_piece_shutdown(piece, (iterations-it) > 5); it++)
+  {
+    if(it == 0)
+    {
+      temp_in = in;
+      temp_out = temp2;
+    }
+    else if(it % 2 == 0)
+    {
+      temp_in = temp1;
+      temp_out = temp2;
+    }
+    else
+    {
+      temp_in = temp2;
+      temp_out = temp1;
+    }
+
+    if(it == iterations - 1)
+      temp_out = out;
+
+    wavelets_process(temp_in, temp_out, mask, width, height,
+                     data, final_radius, zoom, scales, has_mask, HF, LF_odd, LF_even,
+                     tempbuf, padded_size);
+  }
+}
+
+// 2×2 box average, the mask is set if any of the 4 pixels is masked
+static inline void _downsample(float *const restrict coarse,
+                               uint8_t *const restrict coarse_mask,
+                               const float *const restrict in,
+                               const uint8_t *const restrict mask,
+                               const gboolean has_mask,
+                               const size_t width,
+                               const size_t height,
+                               const size_t c_width,
+                               const size_t c_height)
+{
+  DT_OMP_FOR()
+  for(size_t i = 0; i < c_height; i++)
+  {
+    const size_t r0 = 2 * i;
+    const size_t r1 = MIN(r0 + 1, height - 1);
+    for(size_t j = 0; j < c_width; j++)
+    {
+      const size_t c0 = 2 * j;
+      const size_t c1 = MIN(c0 + 1, width - 1);
+      const size_t k = i * c_width + j;
+      for_four_channels(c, aligned(coarse, in:64))
+        coarse[4 * k + c] = 0.25f * (in[4 * (r0 * width + c0) + c] + in[4 * (r0 * width + c1) + c]
+                                     + in[4 * (r1 * width + c0) + c] + in[4 * (r1 * width + c1) + c]);
+      if(has_mask)
+        coarse_mask[k] = mask[r0 * width + c0] || mask[r0 * width + c1]
+                         || mask[r1 * width + c0] || mask[r1 * width + c1];
+    }
+  }
+}
+
+// out = in + bilinearly upsampled (coarse_out - coarse_in), out may be in
+static inline void _upsample_delta(float *const out,
+                                   const float *const in,
+                                   const float *const restrict coarse_out,
+                                   const float *const restrict coarse_in,
+                                   const size_t width,
+                                   const size_t height,
+                                   const size_t c_width,
+                                   const size_t c_height)
+{
+  DT_OMP_FOR()
+  for(size_t i = 0; i < height; i++)
+  {
+    // centers of coarse pixels are at 2 * i + 0.5 in the full image
+    const float y = CLAMP(((float)i - 0.5f) * 0.5f, 0.f, (float)(c_height - 1));
+    const size_t y0 = (size_t)y;
+    const size_t y1 = MIN(y0 + 1, c_height - 1);
+    const float fy = y - y0;
+    for(size_t j = 0; j < width; j++)
+    {
+      const float x = CLAMP(((float)j - 0.5f) * 0.5f, 0.f, (float)(c_width - 1));
+      const size_t x0 = (size_t)x;
+      const size_t x1 = MIN(x0 + 1, c_width - 1);
+      const float fx = x - x0;
+      const size_t k00 = 4 * (y0 * c_width + x0);
+      const size_t k01 = 4 * (y0 * c_width + x1);
+      const size_t k10 = 4 * (y1 * c_width + x0);
+      const size_t k11 = 4 * (y1 * c_width + x1);
+      const size_t k = 4 * (i * width + j);
+      for_four_channels(c)
+      {
+        const float top = (1.f - fx) * (coarse_out[k00 + c] - coarse_in[k00 + c])
+                          + fx * (coarse_out[k01 + c] - coarse_in[k01 + c]);
+        const float bottom = (1.f - fx) * (coarse_out[k10 + c] - coarse_in[k10 + c])
+                             + fx * (coarse_out[k11 + c] - coarse_in[k11 + c]);
+        out[k + c] = in[k + c] + (1.f - fy) * top + fy * bottom;
+      }
+    }
+  }
+}
+
+// solve the diffusion from in to out. in is never written unless it is temp1.
+//
+// the multi-resolution solver runs most iterations at half resolution, which
+// is the same approximation the darkroom makes when zoomed out, and adds the
+// upsampled change to the full resolution input. the remaining quarter of
+// the iterations then restores the finest scale at full resolution.
+static void _solve(dt_dev_pixelpipe_iop_t *piece,
+                   const float *const in,
+                   float *const out,
+                   const uint8_t *const restrict mask,
+                   const size_t width,
+                   const size_t height,
+                   const dt_iop_diffuse_data_t *const data,
+                   const float final_radius,
+                   const float zoom,
+                   const gboolean has_mask,
+                   const int iterations,
+                   const gboolean multires,
+                   float *const restrict HF[MAX_NUM_SCALES],
+                   float *const temp1,
+                   float *const temp2,
+                   float *const restrict LF_odd,
+                   float *const restrict LF_even,
+                   float *const restrict tempbuf,
+                   const size_t padded_size)
+{
+  if(multires && iterations > 1 && width >= 64 && height >= 64)
+  {
+    const size_t c_width = (width + 1) / 2;
+    const size_t c_height = (height + 1) / 2;
+    const size_t c_size = c_width * c_height;
+    float *const c_in = dt_alloc_align_float(4 * c_size);
+    float *const c_out = dt_alloc_align_float(4 * c_size);
+    float *const c_temp1 = dt_alloc_align_float(4 * c_size);
+    float *const c_temp2 = dt_alloc_align_float(4 * c_size);
+    uint8_t *const c_mask = has_mask ? dt_alloc_align_uint8(c_size) : NULL;
+
+    const gboolean success = c_in && c_out && c_temp1 && c_temp2 && (c_mask || !has_mask);
+    if(success)
+    {
+      const int fine = MAX(1, iterations / 4);
+
+      _downsample(c_in, c_mask, in, mask, has_mask, width, height, c_width, c_height);
+      // the full size HF and LF buffers are large enough for the coarse image
+      _iterate(piece, c_in, c_out, c_mask, c_width, c_height, data, final_radius / 2.f, zoom * 2.f,
+               has_mask, iterations - fine, HF, c_temp1, c_temp2, LF_odd, LF_even, tempbuf, padded_size);
+      _upsample_delta(temp1, in, c_out, c_in, width, height, c_width, c_height);
+      _iterate(piece, temp1, out, mask, width, height, data, final_radius, zoom,
+               has_mask, fine, HF, temp1, temp2, LF_odd, LF_even, tempbuf, padded_size);
+    }
+
+    dt_free_align(c_in);
+    dt_free_align(c_out);
+    dt_free_align(c_temp1);
+    dt_free_align(c_temp2);
+    dt_free_align(c_mask);
+    if(success) return;
+  }
+
+  _iterate(piece, in, out, mask, width, height, data, final_radius, zoom,
+           has_mask, iterations, HF, temp1, temp2, LF_odd, LF_even, tempbuf, padded_size);
+}
+
+static void _process(dt_iop_module_t *self,
+                     dt_dev_pixelpipe_iop_t *piece,
+                     const void *const restrict ivoid,
+                     void *const restrict ovoid,
+                     const dt_iop_roi_t *const roi_in,
+                     const dt_iop_roi_t *const roi_out,
+                     const gboolean multires)
 {
   const gboolean fastmode = dt_pipe_is_fast(piece->pipe);
 
@@ -1368,10 +1576,11 @@ void process(dt_iop_module_t *self,
   // temp buffer for blurs. We will need to cycle between them for memory efficiency
   float *restrict LF_odd, *restrict LF_even;
 
-  float *restrict temp_in = NULL;
-  float *restrict temp_out = NULL;
+  // one-row temporary buffers for the wavelets decomposition
+  size_t padded_size;
+  float *const restrict tempbuf = dt_alloc_perthread_float(4 * width, &padded_size);
 
-  gboolean out_of_memory = !mask
+  gboolean out_of_memory = !mask || !tempbuf
     || !dt_iop_alloc_image_buffers(self, roi_in, roi_out,
                                  4 | DT_IMGSZ_OUTPUT, &temp1,
                                  4 | DT_IMGSZ_OUTPUT, &temp2,
@@ -1414,34 +1623,12 @@ void process(dt_iop_module_t *self,
     in = temp1;
   }
 
-  for(int it = 0; it < iterations && !dt_dev_piece_shutdown(piece, (iterations-it) > 5); it++)
-  {
-    if(it == 0)
-    {
-      temp_in = in;
-      temp_out = temp2;
-    }
-    else if(it % 2 == 0)
-    {
-      temp_in = temp1;
-      temp_out = temp2;
-    }
-    else
-    {
-      temp_in = temp2;
-      temp_out = temp1;
-    }
-
-    if(it == iterations - 1)
-      temp_out = out;
-
-    wavelets_process(temp_in, temp_out, mask,
-                     roi_out->width, roi_out->height,
-                     data, final_radius, scale, scales, has_mask, HF, LF_odd, LF_even);
-  }
+  _solve(piece, in, out, mask, width, height, data, final_radius, scale, has_mask, iterations,
+         multires, HF, temp1, temp2, LF_odd, LF_even, tempbuf, padded_size);
 
 finish:
   dt_free_align(mask);
+  dt_free_align(tempbuf);
   dt_free_align(temp1);
   dt_free_align(temp2);
   dt_free_align(LF_even);
@@ -1450,6 +1637,65 @@ finish:
     if(HF[s]) dt_free_align(HF[s]);
 }
 
+void process(dt_iop_module_t *self,
+             dt_dev_pixelpipe_iop_t *piece,
+             const void *const restrict ivoid,
+             void *const restrict ovoid,
+             const dt_iop_roi_t *const roi_in,
+             const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_diffuse_data_t *const data = piece->data;
+  _process(self, piece, ivoid, ovoid, roi_in, roi_out, data->multires);
+}
+
+// compare time and result of both solvers, enabled by `--bench-module diffuse`
+void benchmark(dt_iop_module_t *self,
+               dt_dev_pixelpipe_iop_t *piece,
+               const void *const restrict ivoid,
+               void *const restrict ovoid,
+               const dt_iop_roi_t *const roi_in,
+               const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_diffuse_data_t *const data = piece->data;
+  const size_t npixels = (size_t)roi_out->width * roi_out->height;
+  float *const out = (float *)ovoid;
+  float *const ref = dt_alloc_align_float(4 * npixels);
+  if(!ref) return;
+
+  const int old_muted = darktable.unmuted;
+  darktable.unmuted = 0;
+  dt_times_t start, mid, end;
+  dt_get_times(&start);
+  _process(self, piece, ivoid, ref, roi_in, roi_out, FALSE);
+  dt_get_times(&mid);
+  _process(self, piece, ivoid, out, roi_in, roi_out, TRUE);
+  dt_get_times(&end);
+  darktable.unmuted = old_muted;
+
+  float max_diff = 0.f;
+  double sum_diff = 0.0;
+  DT_OMP_FOR(reduction(max : max_diff) reduction(+ : sum_diff))
+  for(size_t k = 0; k < 4 * npixels; k += 4)
+  {
+    for(int c = 0; c < 3; c++)
+    {
+      const float diff = fabsf(out[k + c] - ref[k + c]);
+      max_diff = fmaxf(max_diff, diff);
+      sum_diff += diff;
+    }
+  }
+
+  const float mpix = npixels / 1.0e6;
+  const float plain = mid.clock - start.clock;
+  const float fast = end.clock - mid.clock;
+  dt_print(DT_DEBUG_ALWAYS,
+           "[bench module diffuse] %i iterations,%7.2fmpix: full resolution %.3fs,"
+           " multi-resolution %.3fs (%.2fx), max difference %.5f, mean %.6f",
+           MAX(data->iterations, 1), mpix, plain, fast, plain / fmaxf(fast, 1e-6f),
+           max_diff, sum_diff / (3.0 * npixels));
+  dt_free_align(ref);
+}
+
 #if HAVE_OPENCL
 static inline cl_int wavelets_process_cl(const int devid,
                                          cl_mem in,
@@ -1626,6 +1872,10 @@ int process_cl(dt_iop_module_t *self,
   if(fastmode)
     return dt_opencl_enqueue_copy_image(devid, dev_in, dev_out, CLIMG_ORIGIN, CLIMG_ORIGIN, region);
 
+  // the multi-resolution solver is only implemented on CPU
+  if(data->multires)
+    return DT_OPENCL_PROCESS_CL;
+
   cl_mem in = dev_in;
   cl_mem temp_in = NULL;
   cl_mem temp_out = NULL;
@@ -1770,6 +2020,13 @@ void gui_init(dt_iop_module_t *self)
        "if you plan on sharpening or inpainting, \n"
        "more iterations help reconstruction."));
 
+  g->multires = dt_bauhaus_toggle_from_params(self, "multires");
+  gtk_widget_set_tooltip_text
+    (g->multires,
+     _("run most iterations at half resolution and refine at full resolution.\n"
+       "this is a lot faster with many iterations but slightly less accurate\n"
+       "on the finest details. it is not available with OpenCL."));
+
   g->radius_center = dt_bauhaus_slider_from_params(self, "radius_center");
   dt_bauhaus_slider_set_soft_range(g->radius_center, 0., 512.);
   dt_bauhaus_slider_set_format(g->radius_center, _(" px"));
@@ -104,6 +104,7 @@ typedef struct dt_iop_exposure_data_t
 {
   dt_iop_exposure_params_t params;
   int deflicker;
+  float deflicker_exposure;       // computed without gui, NAN until then
   float black;
   float scale;
 } dt_iop_exposure_data_t;
@@ -139,7 +140,7 @@ int default_group()
 
 int flags()
 {
-  return IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_SUPPORTS_BLENDING;
+  return IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ROW_STREAMING;
 }
 
 dt_iop_colorspace_type_t default_colorspace(dt_iop_module_t *self,
@@ -495,12 +496,17 @@ static void _process_common_setup(dt_iop_module_t *self,
     }
     else
     {
-      uint32_t *histogram = NULL;
-      dt_dev_histogram_stats_t histogram_stats;
-      _deflicker_prepare_histogram(self, &histogram, &histogram_stats);
-      _compute_correction(self, &d->params, piece->pipe, histogram,
-                          &histogram_stats, &exposure);
-      dt_free_align(histogram);
+      // only once per commit, the pipe might process us in row bands
+      if(dt_isnan(d->deflicker_exposure))
+      {
+        uint32_t *histogram = NULL;
+        dt_dev_histogram_stats_t histogram_stats;
+        _deflicker_prepare_histogram(self, &histogram, &histogram_stats);
+        _compute_correction(self, &d->params, piece->pipe, histogram,
+                            &histogram_stats, &d->deflicker_exposure);
+        dt_free_align(histogram);
+      }
+      exposure = d->deflicker_exposure;
     }
 
     // second, show computed correction in UI.
@@ -635,6 +641,7 @@ void commit_params(dt_iop_module_t *self,
     d->params.exposure += _get_highlight_bias(self);
 
   d->deflicker = 0;
+  d->deflicker_exposure = NAN;
 
   if (self->gui_data)
   {
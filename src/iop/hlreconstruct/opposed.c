@@ -59,6 +59,48 @@ static inline size_t _raw_to_cmap(const size_t width, const size_t row, const si
   return (row / 3) * width + (col / 3);
 }
 
+// mark the mask tiles holding clipped data in any channel
+static void _mask_regions(dt_seg_regions_t *r,
+                          const char *mask,
+                          const size_t msize)
+{
+  DT_OMP_FOR()
+  for(int t = 0; t < r->twidth * r->theight; t++)
+  {
+    int xmin, xmax, ymin, ymax;
+    dt_seg_tile_box(r, t, 0, &xmin, &xmax, &ymin, &ymax);
+    char found = 0;
+    for(int row = ymin; row < ymax; row++)
+    {
+      for(int col = xmin; col < xmax; col++)
+      {
+        const size_t mx = (size_t)row * r->width + col;
+        found |= mask[mx] | mask[msize + mx] | mask[2*msize + mx];
+      }
+    }
+    r->mark[t] = found ? 1 : 0;
+  }
+  dt_seg_regions_update(r);
+}
+
+// photosites covered by mask tile t, the last row and column of tiles also take the remainder
+static inline void _mask_tile_to_raw(const dt_seg_regions_t *r,
+                                     const int t,
+                                     const size_t width,
+                                     const size_t height,
+                                     size_t *xmin,
+                                     size_t *xmax,
+                                     size_t *ymin,
+                                     size_t *ymax)
+{
+  int mxmin, mxmax, mymin, mymax;
+  dt_seg_tile_box(r, t, 0, &mxmin, &mxmax, &mymin, &mymax);
+  *xmin = 3 * mxmin;
+  *xmax = mxmax == r->width ? width : 3 * mxmax;
+  *ymin = 3 * mymin;
+  *ymax = mymax == r->height ? height : 3 * mymax;
+}
+
 static inline char _mask_dilated(const char *in, const size_t w1)
 {
   if(in[0])
@@ -117,7 +159,9 @@ static void _process_linear_opposed(dt_iop_module_t *self,
   }
   else
   {
-    char *mask = (quality) ? dt_calloc_aligned(6 * msize) : NULL;
+    dt_seg_regions_t regions;
+    const gboolean regerror = dt_seg_regions_init(&regions, mwidth, mheight);
+    char *mask = (quality && !regerror) ? dt_calloc_aligned(6 * msize) : NULL;
     if(mask)
     {
       gboolean anyclipped = FALSE;
@@ -148,31 +192,42 @@ static void _process_linear_opposed(dt_iop_module_t *self,
 
       if(anyclipped)
       {
-        DT_OMP_FOR(collapse(2))
-        for(size_t row = 3; row < mheight - 3; row++)
+        _mask_regions(&regions, mask, msize);
+        DT_OMP_FOR()
+        for(int t = 0; t < regions.count; t++)
         {
-          for(size_t col = 3; col < mwidth - 3; col++)
+          int xmin, xmax, ymin, ymax;
+          dt_seg_tile_box(&regions, regions.tile[t], 3, &xmin, &xmax, &ymin, &ymax);
+          for(size_t row = ymin; row < ymax; row++)
           {
-            const size_t mx = row * mwidth + col;
-            mask[3*msize + mx] = _mask_dilated(mask + mx, mwidth);
-            mask[4*msize + mx] = _mask_dilated(mask + msize + mx, mwidth);
-            mask[5*msize + mx] = _mask_dilated(mask + 2*msize + mx, mwidth);
+            for(size_t col = xmin; col < xmax; col++)
+            {
+              const size_t mx = row * mwidth + col;
+              mask[3*msize + mx] = _mask_dilated(mask + mx, mwidth);
+              mask[4*msize + mx] = _mask_dilated(mask + msize + mx, mwidth);
+              mask[5*msize + mx] = _mask_dilated(mask + 2*msize + mx, mwidth);
+            }
           }
         }
 
         DT_OMP_FOR(reduction(+ : sums, cnts))
-        for(size_t row = 3; row < height - 3; row++)
+        for(int t = 0; t < regions.count; t++)
         {
-          for(size_t col = 3; col < width - 3; col++)
+          size_t xmin, xmax, ymin, ymax;
+          _mask_tile_to_raw(&regions, regions.tile[t], width, height, &xmin, &xmax, &ymin, &ymax);
+          for(size_t row = MAX(3, ymin); row < MIN(height - 3, ymax); row++)
           {
-            const size_t idx = (row * width + col) * 4;
-            for_three_channels(c)
+            for(size_t col = MAX(3, xmin); col < MIN(width - 3, xmax); col++)
             {
-              const float inval = input[idx+c];
-              if((inval > 0.2f * clips[c]) && (inval < clips[c]) && (mask[(c+3) * msize + _raw_to_cmap(mwidth, row, col)]))
+              const size_t idx = (row * width + col) * 4;
+              for_three_channels(c)
               {
-                sums[c] += inval - _calc_linear_refavg(&input[idx], c);
-                cnts[c] += 1.0f;
+                const float inval = input[idx+c];
+                if((inval > 0.2f * clips[c]) && (inval < clips[c]) && (mask[(c+3) * msize + _raw_to_cmap(mwidth, row, col)]))
+                {
+                  sums[c] += inval - _calc_linear_refavg(&input[idx], c);
+                  cnts[c] += 1.0f;
+                }
               }
             }
           }
@@ -196,6 +251,7 @@ static void _process_linear_opposed(dt_iop_module_t *self,
       }
       dt_free_align(mask);
     }
+    dt_seg_regions_free(&regions);
   }
 
   DT_OMP_FOR(collapse(2))
@@ -261,7 +317,9 @@ static float *_process_opposed(dt_iop_module_t *self,
   }
   else
   {
-    char *mask = (quality) ? dt_calloc_aligned(6 * msize) : NULL;
+    dt_seg_regions_t regions;
+    const gboolean regerror = dt_seg_regions_init(&regions, mwidth, mheight);
+    char *mask = (quality && !regerror) ? dt_calloc_aligned(6 * msize) : NULL;
     if(mask)
     {
       gboolean anyclipped = FALSE;
@@ -298,37 +356,49 @@ static float *_process_opposed(dt_iop_module_t *self,
          The mask buffers holds data for each color channel, we dilate the mask buffer slightly
          to get those locations.
          If there are no clipped locations we keep the chrominance correction at 0 but make it valid
+         Both the dilation and the chrominance are only done in the tiles around clipped data.
         */
-        DT_OMP_FOR(collapse(2))
-        for(size_t row = 0; row < mheight; row++)
+        _mask_regions(&regions, mask, msize);
+        DT_OMP_FOR()
+        for(int t = 0; t < regions.count; t++)
         {
-          for(size_t col = 0; col < mwidth; col++)
+          int xmin, xmax, ymin, ymax;
+          dt_seg_tile_box(&regions, regions.tile[t], 0, &xmin, &xmax, &ymin, &ymax);
+          for(size_t row = ymin; row < ymax; row++)
           {
-            const size_t mx = row * mwidth + col;
-            const gboolean safe = col >= 3 && row >= 3 && col < mwidth - 4 && row < mheight - 4;
-            mask[3*msize + mx] = safe ? _mask_dilated(mask + mx, mwidth)          : mask[mx];
-            mask[4*msize + mx] = safe ? _mask_dilated(mask + msize + mx, mwidth)  : mask[mx + msize];
-            mask[5*msize + mx] = safe ? _mask_dilated(mask + 2*msize + mx, mwidth): mask[mx + 2*msize];
+            for(size_t col = xmin; col < xmax; col++)
+            {
+              const size_t mx = row * mwidth + col;
+              const gboolean safe = col >= 3 && row >= 3 && col < mwidth - 4 && row < mheight - 4;
+              mask[3*msize + mx] = safe ? _mask_dilated(mask + mx, mwidth)          : mask[mx];
+              mask[4*msize + mx] = safe ? _mask_dilated(mask + msize + mx, mwidth)  : mask[mx + msize];
+              mask[5*msize + mx] = safe ? _mask_dilated(mask + 2*msize + mx, mwidth): mask[mx + 2*msize];
+            }
           }
         }
 
         const dt_aligned_pixel_t lo_clips = { 0.2f * clips[0], 0.2f * clips[1], 0.2f * clips[2], 1.0f };
         /* After having the surrounding mask for each color channel we can calculate the chrominance corrections. */
-        DT_OMP_FOR(reduction(+ : sums, cnts) collapse(2))
-        for(size_t row = 0; row < roi_in->height; row++)
+        DT_OMP_FOR(reduction(+ : sums, cnts))
+        for(int t = 0; t < regions.count; t++)
         {
-          for(size_t col = 0; col < roi_in->width; col++)
+          size_t xmin, xmax, ymin, ymax;
+          _mask_tile_to_raw(&regions, regions.tile[t], roi_in->width, roi_in->height, &xmin, &xmax, &ymin, &ymax);
+          for(size_t row = ymin; row < ymax; row++)
           {
-            const size_t idx = row * roi_in->width + col;
-            const int color = fcol(row, col, filters, xtrans);
-            const float inval = input[idx];
-
-            /* we only use the unclipped photosites very close the true clipped data to calculate the chrominance offset */
-            if((inval < clips[color]) && (inval > lo_clips[color])
-               && (mask[(color+3) * msize + _raw_to_cmap(mwidth, row, col)]))
+            for(size_t col = xmin; col < xmax; col++)
             {
-              sums[color] += inval - _calc_refavg(input, xtrans, filters, row, col, roi_in, correction, TRUE);
-              cnts[color] += 1.0f;
+              const size_t idx = row * roi_in->width + col;
+              const int color = fcol(row, col, filters, xtrans);
+              const float inval = input[idx];
+
+              /* we only use the unclipped photosites very close the true clipped data to calculate the chrominance offset */
+              if((inval < clips[color]) && (inval > lo_clips[color])
+                 && (mask[(color+3) * msize + _raw_to_cmap(mwidth, row, col)]))
+              {
+                sums[color] += inval - _calc_refavg(input, xtrans, filters, row, col, roi_in, correction, TRUE);
+                cnts[color] += 1.0f;
+              }
             }
           }
         }
@@ -354,6 +424,7 @@ static float *_process_opposed(dt_iop_module_t *self,
           img_oppclipped ? "" : " unclipped");
     }
     dt_free_align(mask);
+    dt_seg_regions_free(&regions);
   }
 
   float *tmpout = keep ? dt_alloc_align_float(roi_in->width * roi_in->height) : NULL;
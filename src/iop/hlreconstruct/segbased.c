@@ -416,6 +416,23 @@ static inline size_t _raw_to_plane(const int width, const int row, const int col
   return (HL_BORDER + (row / 3)) * width + (col / 3) + HL_BORDER;
 }
 
+// photosites of the roi covered by plane tile t
+static inline void _tile_to_raw(const dt_seg_regions_t *r,
+                                const int t,
+                                const dt_iop_roi_t *const roi,
+                                int *xmin,
+                                int *xmax,
+                                int *ymin,
+                                int *ymax)
+{
+  int pxmin, pxmax, pymin, pymax;
+  dt_seg_tile_box(r, t, 0, &pxmin, &pxmax, &pymin, &pymax);
+  *xmin = MAX(1, 3 * (pxmin - HL_BORDER));
+  *xmax = MIN(roi->width - 1, 3 * (pxmax - HL_BORDER));
+  *ymin = MAX(1, 3 * (pymin - HL_BORDER));
+  *ymax = MIN(roi->height - 1, 3 * (pymax - HL_BORDER));
+}
+
 static void _masks_extend_border(float *const mask,
                                  const int width,
                                  const int height,
@@ -496,7 +513,9 @@ static void _process_segmentation(dt_dev_pixelpipe_iop_t *piece,
   for(int i = 0; i < HL_RGB_PLANES; i++)
     refavg[i] = plane[HL_SEGMENT_PLANES + i];
 
-  gboolean segerror = FALSE;
+  // tiles with clipped data in any color plane
+  dt_seg_regions_t clipped;
+  gboolean segerror = dt_seg_regions_init(&clipped, pwidth, pheight);
 
   dt_iop_segmentation_t isegments[HL_SEGMENT_PLANES];
   for(int i = 0; i < HL_SEGMENT_PLANES; i++)
@@ -508,6 +527,7 @@ static void _process_segmentation(dt_dev_pixelpipe_iop_t *piece,
     for(int i = 0; i < HL_SEGMENT_PLANES; i++)
       dt_segmentation_free_struct(&isegments[i]);
 
+    dt_seg_regions_free(&clipped);
     dt_free_align(fbuffer);
     return;
   }
@@ -569,6 +589,13 @@ static void _process_segmentation(dt_dev_pixelpipe_iop_t *piece,
   if((anyclipped < 20) && vmode == DT_HIGHLIGHTS_MASK_OFF)
     goto finish;
 
+  for(int p = 0; p < HL_SEGMENT_PLANES; p++)
+    dt_segmentation_find_regions(&isegments[p]);
+
+  for(int t = 0; t < clipped.twidth * clipped.theight; t++)
+    clipped.mark[t] = isegments[0].regions.mark[t] | isegments[1].regions.mark[t] | isegments[2].regions.mark[t];
+  dt_seg_regions_update(&clipped);
+
   for(int i = 0; i < HL_RGB_PLANES; i++)
     _masks_extend_border(plane[i], pwidth, pheight, HL_BORDER);
 
@@ -591,27 +618,32 @@ static void _process_segmentation(dt_dev_pixelpipe_iop_t *piece,
   for(int p = 0; p < HL_RGB_PLANES; p++)
     _calc_plane_candidates(plane[p], refavg[p], &isegments[p], cube_coeffs[p], d->candidating);
 
-  DT_OMP_FOR(collapse(2))
-  for(int row = 1; row < roi_in->height-1; row++)
+  DT_OMP_FOR()
+  for(int t = 0; t < clipped.count; t++)
   {
-    for(int col = 1; col < roi_in->width-1; col++)
+    int xmin, xmax, ymin, ymax;
+    _tile_to_raw(&clipped, clipped.tile[t], roi_in, &xmin, &xmax, &ymin, &ymax);
+    for(int row = ymin; row < ymax; row++)
     {
-      const size_t idx = (size_t)row * roi_in->width + col;
-      const float inval = fmaxf(0.0f, input[idx]);
-      const int color = fcol(row, col, filters, xtrans);
-      if(inval > clips[color])
+      for(int col = xmin; col < xmax; col++)
       {
-        const size_t o = _raw_to_plane(pwidth, row, col);
-        const uint32_t pid = _get_segment_id(&isegments[color], o);
-        if((pid > 1) && (pid < isegments[color].nr))
+        const size_t idx = (size_t)row * roi_in->width + col;
+        const float inval = fmaxf(0.0f, input[idx]);
+        const int color = fcol(row, col, filters, xtrans);
+        if(inval > clips[color])
         {
-          const float candidate = isegments[color].val1[pid];
-          if(candidate != 0.0f)
+          const size_t o = _raw_to_plane(pwidth, row, col);
+          const uint32_t pid = _get_segment_id(&isegments[color], o);
+          if((pid > 1) && (pid < isegments[color].nr))
           {
-            const float cand_reference = isegments[color].val2[pid];
-            const float refavg_here = _calc_refavg(input, xtrans, filters, row, col, roi_in, correction, FALSE);
-            const float oval = fcube(refavg_here + candidate - cand_reference);
-            tmpout[idx] = plane[color][o] = fmaxf(inval, oval);
+            const float candidate = isegments[color].val1[pid];
+            if(candidate != 0.0f)
+            {
+              const float cand_reference = isegments[color].val2[pid];
+              const float refavg_here = _calc_refavg(input, xtrans, filters, row, col, roi_in, correction, FALSE);
+              const float oval = fcube(refavg_here + candidate - cand_reference);
+              tmpout[idx] = plane[color][o] = fmaxf(inval, oval);
+            }
           }
         }
       }
@@ -744,15 +776,16 @@ static void _process_segmentation(dt_dev_pixelpipe_iop_t *piece,
     }
   }
 
-  dt_print(DT_DEBUG_PERF, "[segmentation report %-12s] %5.1fMpix, segments: %3i red, %3i green, %3i blue, %3i all, %4i allowed",
+  dt_print(DT_DEBUG_PERF, "[segmentation report %-12s] %5.1fMpix, segments: %3i red, %3i green, %3i blue, %3i all, %4i allowed, %i/%i tiles",
       dt_dev_pixelpipe_type_to_str(piece->pipe->type),
       (float) (roi_in->width * roi_in->height) / 1.0e6f, isegments[0].nr -2, isegments[1].nr-2, isegments[2].nr-2, isegments[3].nr-2,
-      segmentation_limit-2);
+      segmentation_limit-2, clipped.count, clipped.twidth * clipped.theight);
 
   finish:
 
   for(int i = 0; i < HL_SEGMENT_PLANES; i++)
     dt_segmentation_free_struct(&isegments[i]);
+  dt_seg_regions_free(&clipped);
   dt_free_align(fbuffer);
 }
 
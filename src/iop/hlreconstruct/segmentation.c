@@ -26,9 +26,15 @@
    - marks the segment border locations.
 
    Hanno Schwalm 2022/05
+
+   Most images have no or only a few small clipped areas. So we keep a coarse map of
+   DT_SEG_TILE sized tiles holding data, every tile next to one of those is also active.
+   Any operation reaching out from data less than DT_SEG_TILE locations stays inside the
+   active tiles and the expensive passes only visit them.
 */
 
 #define DT_SEG_ID_MASK 0x40000
+#define DT_SEG_TILE 32
 
 typedef struct dt_pos_t
 {
@@ -36,6 +42,17 @@ typedef struct dt_pos_t
   int ypos;
 } dt_pos_t;
 
+typedef struct dt_seg_regions_t
+{
+  int *tile;      // index of active tiles
+  uint8_t *mark;  // tiles holding data
+  int count;      // number of active tiles
+  int twidth;     // number of tiles per row
+  int theight;    // number of tile rows
+  int width;      // size of the covered plane
+  int height;
+} dt_seg_regions_t;
+
 typedef struct dt_iop_segmentation_t
 {
   uint32_t *data; // holding segment id's for every location
@@ -52,6 +69,7 @@ typedef struct dt_iop_segmentation_t
   int slots;      // available segment id's
   int width;
   int height;
+  dt_seg_regions_t regions; // tiles touched by the segmentation
 } dt_iop_segmentation_t;
 
 typedef struct dt_ff_stack_t
@@ -61,6 +79,75 @@ typedef struct dt_ff_stack_t
   dt_pos_t *el;
 } dt_ff_stack_t;
 
+static void dt_seg_regions_free(dt_seg_regions_t *r)
+{
+  dt_free_align(r->tile);
+  dt_free_align(r->mark);
+  memset(r, 0, sizeof(dt_seg_regions_t));
+}
+
+// returns TRUE in case of errors, all tiles are active after init
+static gboolean dt_seg_regions_init(dt_seg_regions_t *r,
+                                    const int width,
+                                    const int height)
+{
+  memset(r, 0, sizeof(dt_seg_regions_t));
+  const int twidth = (width + DT_SEG_TILE - 1) / DT_SEG_TILE;
+  const int theight = (height + DT_SEG_TILE - 1) / DT_SEG_TILE;
+  const int tiles = twidth * theight;
+  r->tile = dt_alloc_align_int(tiles);
+  r->mark = dt_calloc_aligned(tiles);
+  if(!r->tile || !r->mark)
+  {
+    dt_seg_regions_free(r);
+    return TRUE;
+  }
+
+  r->twidth = twidth;
+  r->theight = theight;
+  r->width = width;
+  r->height = height;
+  for(int t = 0; t < tiles; t++)
+    r->tile[t] = t;
+  r->count = tiles;
+  return FALSE;
+}
+
+// locations of tile t, leaving out a border
+static inline void dt_seg_tile_box(const dt_seg_regions_t *r,
+                                   const int t,
+                                   const int border,
+                                   int *xmin,
+                                   int *xmax,
+                                   int *ymin,
+                                   int *ymax)
+{
+  const int tx = t % r->twidth;
+  const int ty = t / r->twidth;
+  *xmin = MAX(border, tx * DT_SEG_TILE);
+  *xmax = MIN(r->width - border, (tx + 1) * DT_SEG_TILE);
+  *ymin = MAX(border, ty * DT_SEG_TILE);
+  *ymax = MIN(r->height - border, (ty + 1) * DT_SEG_TILE);
+}
+
+// the marked tiles and their neighbours become the active ones
+static void dt_seg_regions_update(dt_seg_regions_t *r)
+{
+  r->count = 0;
+  for(int ty = 0; ty < r->theight; ty++)
+  {
+    for(int tx = 0; tx < r->twidth; tx++)
+    {
+      uint8_t active = 0;
+      for(int y = MAX(0, ty - 1); y < MIN(r->theight, ty + 2); y++)
+        for(int x = MAX(0, tx - 1); x < MIN(r->twidth, tx + 2); x++)
+          active |= r->mark[y * r->twidth + x];
+      if(active)
+        r->tile[r->count++] = ty * r->twidth + tx;
+    }
+  }
+}
+
 static inline void _push_stack(int xpos, int ypos, dt_ff_stack_t *stack)
 {
   const int i = stack->pos;
@@ -211,17 +298,22 @@ static inline int _test_dilate(const uint32_t *img, const size_t i, const size_t
 static inline void _dilating(const uint32_t *img,
                              uint32_t *o,
                              const int w1,
-                             const int height,
+                             const dt_seg_regions_t *r,
                              const int border,
                              const int radius)
 {
-  DT_OMP_FOR(collapse(2))
-  for(int row = border; row < height - border; row++)
+  DT_OMP_FOR()
+  for(int t = 0; t < r->count; t++)
   {
-    for(int col = border; col < w1 - border; col++)
+    int xmin, xmax, ymin, ymax;
+    dt_seg_tile_box(r, r->tile[t], border, &xmin, &xmax, &ymin, &ymax);
+    for(int row = ymin; row < ymax; row++)
     {
-      const size_t i = (size_t)row*w1 + col;
-      o[i] = _test_dilate(img, i, w1, radius) ? 1 : 0;
+      for(int col = xmin; col < xmax; col++)
+      {
+        const size_t i = (size_t)row*w1 + col;
+        o[i] = _test_dilate(img, i, w1, radius) ? 1 : 0;
+      }
     }
   }
 }
@@ -282,17 +374,22 @@ static inline int _test_erode(const uint32_t *img, const size_t i, const size_t
 static inline void _eroding(const uint32_t *img,
                             uint32_t *o,
                             const int w1,
-                            const int height,
+                            const dt_seg_regions_t *r,
                             const int border,
                             const int radius)
 {
-  DT_OMP_FOR(collapse(2))
-  for(int row = border; row < height - border; row++)
+  DT_OMP_FOR()
+  for(int t = 0; t < r->count; t++)
   {
-    for(int col = border; col < w1 - border; col++)
+    int xmin, xmax, ymin, ymax;
+    dt_seg_tile_box(r, r->tile[t], border, &xmin, &xmax, &ymin, &ymax);
+    for(int row = ymin; row < ymax; row++)
     {
-      const size_t i = (size_t)row*w1 + col;
-      o[i] = _test_erode(img, i, w1, radius) ? 1 : 0;
+      for(int col = xmin; col < xmax; col++)
+      {
+        const size_t i = (size_t)row*w1 + col;
+        o[i] = _test_erode(img, i, w1, radius) ? 1 : 0;
+      }
     }
   }
 }
@@ -558,17 +655,23 @@ void dt_segmentize_plane(dt_iop_segmentation_t *seg)
     return;
   }
   const int border = seg->border;
+  const dt_seg_regions_t *r = &seg->regions;
   int id = 2;
-  for(int row = border; row < height - border; row++)
+  for(int t = 0; t < r->count; t++)
   {
-    for(int col = border; col < width - border; col++)
+    int xmin, xmax, ymin, ymax;
+    dt_seg_tile_box(r, r->tile[t], border, &xmin, &xmax, &ymin, &ymax);
+    for(int row = ymin; row < ymax; row++)
     {
-      if(id >= (seg->slots - 2))
-        goto finish;
-      if(seg->data[(size_t)width * row + col] == 1)
+      for(int col = xmin; col < xmax; col++)
       {
-        if(_floodfill_segmentize(row, col, seg, width, height, id, &stack))
-          id++;
+        if(id >= (seg->slots - 2))
+          goto finish;
+        if(seg->data[(size_t)width * row + col] == 1)
+        {
+          if(_floodfill_segmentize(row, col, seg, width, height, id, &stack))
+            id++;
+        }
       }
     }
   }
@@ -590,11 +693,11 @@ void dt_segments_combine(dt_iop_segmentation_t *seg, const int radius)
   const int border = seg->border;
   _intimage_borderfill(img, width, height, 0, border);
 
-  _dilating(img, seg->tmp, width, height, border, radius);
+  _dilating(img, seg->tmp, width, &seg->regions, border, radius);
   if(radius > 3)
   {
     _intimage_borderfill(seg->tmp, width, height, 1, border);
-    _eroding(seg->tmp, img, width, height, border, radius-3);
+    _eroding(seg->tmp, img, width, &seg->regions, border, radius-3);
   }
   else
     memcpy(img, seg->tmp, (size_t) width * height * sizeof(uint32_t));
@@ -602,6 +705,29 @@ void dt_segments_combine(dt_iop_segmentation_t *seg, const int radius)
   _intimage_borderfill(img, width, height, 0, border);
 }
 
+// restrict further processing to the tiles around data
+void dt_segmentation_find_regions(dt_iop_segmentation_t *seg)
+{
+  dt_seg_regions_t *r = &seg->regions;
+  const uint32_t *data = seg->data;
+  const int width = seg->width;
+
+  DT_OMP_FOR()
+  for(int t = 0; t < r->twidth * r->theight; t++)
+  {
+    int xmin, xmax, ymin, ymax;
+    dt_seg_tile_box(r, t, seg->border, &xmin, &xmax, &ymin, &ymax);
+    uint8_t found = 0;
+    for(int row = ymin; row < ymax && !found; row++)
+    {
+      for(int col = xmin; col < xmax; col++)
+        found |= data[(size_t)row * width + col] ? 1 : 0;
+    }
+    r->mark[t] = found;
+  }
+  dt_seg_regions_update(r);
+}
+
 void dt_segmentation_free_struct(dt_iop_segmentation_t *seg)
 {
   dt_free_align(seg->data);
@@ -613,6 +739,7 @@ void dt_segmentation_free_struct(dt_iop_segmentation_t *seg)
   dt_free_align(seg->ymax);
   dt_free_align(seg->val1);
   dt_free_align(seg->val2);
+  dt_seg_regions_free(&seg->regions);
   memset(seg, 0, sizeof(dt_iop_segmentation_t));
 }
 
@@ -628,7 +755,8 @@ gboolean dt_segmentation_init_struct(dt_iop_segmentation_t *seg,
   const size_t bsize = (size_t) width * height * sizeof(uint32_t);
 
   seg->data =   dt_calloc_aligned(bsize);
-  seg->tmp =    dt_alloc_aligned(bsize);
+  // tmp must be zero outside of the active tiles
+  seg->tmp =    dt_calloc_aligned(bsize);
   seg->size =   dt_alloc_align_int(slots);
   seg->xmin =   dt_alloc_align_int(slots);
   seg->xmax =   dt_alloc_align_int(slots);
@@ -636,8 +764,9 @@ gboolean dt_segmentation_init_struct(dt_iop_segmentation_t *seg,
   seg->ymax =   dt_alloc_align_int(slots);
   seg->val1 =   dt_alloc_align_float(slots);
   seg->val2 =   dt_alloc_align_float(slots);
+  const gboolean regerror = dt_seg_regions_init(&seg->regions, width, height);
 
-  if(!seg->data || !seg->tmp  || !seg->size
+  if(regerror   || !seg->data || !seg->tmp  || !seg->size
                 || !seg->xmin || !seg->xmax || !seg->ymin || !seg->ymax
                 || !seg->val1 || !seg->val2)
   {
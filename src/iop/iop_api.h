@@ -260,6 +260,14 @@ REQUIRED(void, process, struct dt_iop_module_t *self,
                         void *const o,
                         const struct dt_iop_roi_t *const roi_in,
                         const struct dt_iop_roi_t *const roi_out);
+/** optional timing of the module's cpu variants, run by --bench-module
+  * on the buffers of process() right before it. */
+OPTIONAL(void, benchmark, struct dt_iop_module_t *self,
+                          struct dt_dev_pixelpipe_iop_t *piece,
+                          const void *const i,
+                          void *const o,
+                          const struct dt_iop_roi_t *const roi_in,
+                          const struct dt_iop_roi_t *const roi_out);
 /** a tiling variant of process(). */
 DEFAULT(void, process_tiling, struct dt_iop_module_t *self,
                               struct dt_dev_pixelpipe_iop_t *piece,
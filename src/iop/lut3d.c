@@ -146,7 +146,7 @@ const char **description(dt_iop_module_t *self)
 
 int flags()
 {
-  return IOP_FLAGS_INCLUDE_IN_STYLES | IOP_FLAGS_SUPPORTS_BLENDING;
+  return IOP_FLAGS_INCLUDE_IN_STYLES | IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ROW_STREAMING;
 }
 
 int default_group()
@@ -228,11 +228,10 @@ int legacy_params(dt_iop_module_t *self,
 }
 
 // From `HaldCLUT_correct.c' by Eskil Steenberg (http://www.quelsolaar.com) (BSD licensed)
-static void _correct_pixel_trilinear(const float *const in,
-                                     float *const out,
-                                     const size_t pixel_nb,
-                                     const float *const restrict clut,
-                                     const uint16_t level)
+static inline void _lut_trilinear(const float *const input,
+                                  float *const output,
+                                  const float *const restrict clut,
+                                  const uint16_t level)
 {
   const int level_minus_2 = (level - 2);
   const size_t level2 = level * level;
@@ -241,68 +240,60 @@ static void _correct_pixel_trilinear(const float *const in,
   const size_t level2_stride = 3 * level2;
   const size_t level12_stride = 3 * (level + level2);
 
-  DT_OMP_FOR()
-  for(size_t k = 0; k < (size_t)(pixel_nb * 4); k+=4)
-  {
-    const float *const input = in + k;
-    float *const output = ((float *const)out) + k;
-
-    DT_ALIGNED_PIXEL int rgbi[4];
-    dt_aligned_pixel_t rgbd;
-    dt_aligned_pixel_t tmp1, tmp2, tmp3;
+  DT_ALIGNED_PIXEL int rgbi[4];
+  dt_aligned_pixel_t rgbd;
+  dt_aligned_pixel_t tmp1, tmp2, tmp3;
 
-    // scale the input according to grid size
-    for_each_channel(c, aligned(input))
-      rgbd[c] = CLIP(input[c]) * flevel_1;
-    // quantize to grid
-    for_each_channel(c)
-      rgbi[c] = (int)rgbd[c];
-    for_each_channel(c)
-      rgbi[c] = CLAMP(rgbi[c], 0, level_minus_2);
-    // compute deltas for each channel
-    for_each_channel(c)
-      rgbd[c] -= rgbi[c]; // delta red/green/blue
+  // scale the input according to grid size
+  for_each_channel(c, aligned(input))
+    rgbd[c] = CLIP(input[c]) * flevel_1;
+  // quantize to grid
+  for_each_channel(c)
+    rgbi[c] = (int)rgbd[c];
+  for_each_channel(c)
+    rgbi[c] = CLAMP(rgbi[c], 0, level_minus_2);
+  // compute deltas for each channel
+  for_each_channel(c)
+    rgbd[c] -= rgbi[c]; // delta red/green/blue
 
-    size_t color = rgbi[0] + level * rgbi[1] + level2 * rgbi[2];
+  size_t color = rgbi[0] + level * rgbi[1] + level2 * rgbi[2];
 
-    const size_t i = color * 3;  // P000
+  const size_t i = color * 3;  // P000
 
-    const float one_minus_rgbd0 = 1.0f - rgbd[0];
-    const float one_minus_rgbd1 = 1.0f - rgbd[1];
+  const float one_minus_rgbd0 = 1.0f - rgbd[0];
+  const float one_minus_rgbd1 = 1.0f - rgbd[1];
 
-    // process indexes of P000 to P111 in clut
-    for_each_channel(c) // P000 and P100
-      tmp1[c] = clut[i+c] * one_minus_rgbd0 + clut[i+3+c] * rgbd[0];
+  // process indexes of P000 to P111 in clut
+  for_each_channel(c) // P000 and P100
+    tmp1[c] = clut[i+c] * one_minus_rgbd0 + clut[i+3+c] * rgbd[0];
 
-    for_each_channel(c) // P010 and P110
-      tmp2[c] = clut[i+level1_stride+c] * one_minus_rgbd0 + clut[i+level1_stride+3+c] * rgbd[0];
+  for_each_channel(c) // P010 and P110
+    tmp2[c] = clut[i+level1_stride+c] * one_minus_rgbd0 + clut[i+level1_stride+3+c] * rgbd[0];
 
-    for_each_channel(c) // blend P000/P100 with P010/P110
-      tmp3[c] = tmp1[c] * one_minus_rgbd1 + tmp2[c] * rgbd[1];
+  for_each_channel(c) // blend P000/P100 with P010/P110
+    tmp3[c] = tmp1[c] * one_minus_rgbd1 + tmp2[c] * rgbd[1];
 
-    for_each_channel(c) // P001 and P101
-      tmp1[c] = clut[i+level2_stride+c] * one_minus_rgbd0 + clut[i+level2_stride+3+c] * rgbd[0];
+  for_each_channel(c) // P001 and P101
+    tmp1[c] = clut[i+level2_stride+c] * one_minus_rgbd0 + clut[i+level2_stride+3+c] * rgbd[0];
 
-    for_each_channel(c) // P011 and P111
-      tmp2[c] = clut[i+level12_stride+c] * one_minus_rgbd0 + clut[i+level12_stride+3+c] * rgbd[0];
+  for_each_channel(c) // P011 and P111
+    tmp2[c] = clut[i+level12_stride+c] * one_minus_rgbd0 + clut[i+level12_stride+3+c] * rgbd[0];
 
-    for_each_channel(c) // blend P001/P101 and P011/P111
-      tmp1[c] = tmp1[c] * one_minus_rgbd1 + tmp2[c] * rgbd[1];
+  for_each_channel(c) // blend P001/P101 and P011/P111
+    tmp1[c] = tmp1[c] * one_minus_rgbd1 + tmp2[c] * rgbd[1];
 
-    for_each_channel(c, aligned(output))
-      output[c] = tmp3[c] * (1.0f - rgbd[2]) + tmp1[c] * rgbd[2];
-    // not using non-temporal writes here, as those are substantially slower when in==out....
-    // (which is the case when performing a colorspace conversion)
- }
+  for_each_channel(c, aligned(output))
+    output[c] = tmp3[c] * (1.0f - rgbd[2]) + tmp1[c] * rgbd[2];
+  // not using non-temporal writes here, as those are substantially slower when in==out....
+  // (which is the case when performing a colorspace conversion)
 }
 
 // from OpenColorIO
 // https://github.com/imageworks/OpenColorIO/blob/master/src/OpenColorIO/ops/Lut3D/Lut3DOp.cpp
-static void _correct_pixel_tetrahedral(const float *const in,
-                                       float *const out,
-                                       const size_t pixel_nb,
-                                       const float *const restrict clut,
-                                       const uint16_t level)
+static inline void _lut_tetrahedral(const float *const input,
+                                    float *const output,
+                                    const float *const restrict clut,
+                                    const uint16_t level)
 {
   const size_t level2 = level * level;
   const size_t level1_stride = 3 * level;
@@ -310,154 +301,278 @@ static void _correct_pixel_tetrahedral(const float *const in,
   const size_t level12_stride = 3 * (level + level2);
   const float flevel_1 = (float)(level - 1);
 
-  DT_OMP_FOR()
-  for(size_t k = 0; k < (size_t)(pixel_nb * 4); k+=4)
-  {
-    const float *const input = in + k;
-    float *const output = ((float *const)out) + k;
+  dt_aligned_pixel_t rgbi;
+  dt_aligned_pixel_t rgbd;
+  for_each_channel(c)
+    rgbd[c] = CLIP(input[c]) * flevel_1;
 
-    dt_aligned_pixel_t rgbi;
-    dt_aligned_pixel_t rgbd;
-    for_each_channel(c)
-      rgbd[c] = CLIP(input[c]) * flevel_1;
+  for_each_channel(c)
+  {
+    rgbi[c] = CLAMP((int)rgbd[c], 0, level - 2);
+    rgbd[c] = rgbd[c] - rgbi[c]; // delta red/green/blue
+  }
 
-    for_each_channel(c)
+  // indexes of P000 to P111 in clut
+  const size_t color = rgbi[0] + rgbi[1] * level + rgbi[2] * level2;
+  const size_t i000 = color * 3;                     // P000
+  const size_t i100 = i000 + 3;                      // P100
+  const size_t i010 = i000 + level1_stride;          // P010
+  const size_t i110 = i010 + 3;                      // P110
+  const size_t i001 = i000 + level2_stride;          // P001
+  const size_t i101 = i001 + 3;                      // P101
+  const size_t i011 = i000 + level12_stride;         // P011
+  const size_t i111 = i011 + 3;                      // P111
+
+  if(rgbd[0] > rgbd[1])
+  {
+    if(rgbd[1] > rgbd[2])
     {
-      rgbi[c] = CLAMP((int)rgbd[c], 0, level - 2);
-      rgbd[c] = rgbd[c] - rgbi[c]; // delta red/green/blue
+      // rgbd[0] > rgbd[1] > rgbd[2]
+      for_each_channel(c, aligned(output))
+        output[c] = ((1-rgbd[0])*clut[i000+c] + (rgbd[0]-rgbd[1])*clut[i100+c]
+                    + (rgbd[1]-rgbd[2])*clut[i110+c] + rgbd[2]*clut[i111+c]);
     }
-
-    // indexes of P000 to P111 in clut
-    const size_t color = rgbi[0] + rgbi[1] * level + rgbi[2] * level2;
-    const size_t i000 = color * 3;                     // P000
-    const size_t i100 = i000 + 3;                      // P100
-    const size_t i010 = i000 + level1_stride;          // P010
-    const size_t i110 = i010 + 3;                      // P110
-    const size_t i001 = i000 + level2_stride;          // P001
-    const size_t i101 = i001 + 3;                      // P101
-    const size_t i011 = i000 + level12_stride;         // P011
-    const size_t i111 = i011 + 3;                      // P111
-
-    if(rgbd[0] > rgbd[1])
+    else if(rgbd[0] > rgbd[2])
     {
-      if(rgbd[1] > rgbd[2])
-      {
-        // rgbd[0] > rgbd[1] > rgbd[2]
-        for_each_channel(c, aligned(output))
-          output[c] = ((1-rgbd[0])*clut[i000+c] + (rgbd[0]-rgbd[1])*clut[i100+c]
-                      + (rgbd[1]-rgbd[2])*clut[i110+c] + rgbd[2]*clut[i111+c]);
-      }
-      else if(rgbd[0] > rgbd[2])
-      {
-        // rgbd[0] > rgbd[2] >= rgbd[1]
-        for_each_channel(c, aligned(output))
-          output[c] = ((1-rgbd[0])*clut[i000+c] + (rgbd[0]-rgbd[2])*clut[i100+c]
-                      + (rgbd[2]-rgbd[1])*clut[i101+c] + rgbd[1]*clut[i111+c]);
-      }
-      else
-      {
-        // rgbd[2] >= rgbd[0] > rgbd[2]
-        for_each_channel(c, aligned(output))
-          output[c] = ((1-rgbd[2])*clut[i000+c] + (rgbd[2]-rgbd[0])*clut[i001+c]
-                      + (rgbd[0]-rgbd[1])*clut[i101+c] + rgbd[1]*clut[i111+c]);
-      }
+      // rgbd[0] > rgbd[2] >= rgbd[1]
+      for_each_channel(c, aligned(output))
+        output[c] = ((1-rgbd[0])*clut[i000+c] + (rgbd[0]-rgbd[2])*clut[i100+c]
+                    + (rgbd[2]-rgbd[1])*clut[i101+c] + rgbd[1]*clut[i111+c]);
     }
     else
     {
-      if(rgbd[2] > rgbd[1])
-      {
-        // rgbd[2] > rgbd[1] >= rgbd[0]
-        for_each_channel(c, aligned(output))
-          output[c] = ((1-rgbd[2])*clut[i000+c] + (rgbd[2]-rgbd[1])*clut[i001+c]
-                      + (rgbd[1]-rgbd[0])*clut[i011+c] + rgbd[0]*clut[i111+c]);
-      }
-      else if(rgbd[2] > rgbd[0])
-      {
-        // rgbd[1] >= rgbd[2] > rgbd[0]
-        for_each_channel(c, aligned(output))
-          output[c] = ((1-rgbd[1])*clut[i000+c] + (rgbd[1]-rgbd[2])*clut[i010+c]
-                      + (rgbd[2]-rgbd[0])*clut[i011+c] + rgbd[0]*clut[i111+c]);
-      }
-      else
-      {
-        // rgbd[1] >= rgbd[0] >= rgbd[2]
-        for_each_channel(c, aligned(output))
-          output[c] = ((1-rgbd[1])*clut[i000+c] + (rgbd[1]-rgbd[0])*clut[i010+c]
-                      + (rgbd[0]-rgbd[2])*clut[i110+c] + rgbd[2]*clut[i111+c]);
-      }
+      // rgbd[2] >= rgbd[0] > rgbd[2]
+      for_each_channel(c, aligned(output))
+        output[c] = ((1-rgbd[2])*clut[i000+c] + (rgbd[2]-rgbd[0])*clut[i001+c]
+                    + (rgbd[0]-rgbd[1])*clut[i101+c] + rgbd[1]*clut[i111+c]);
+    }
+  }
+  else
+  {
+    if(rgbd[2] > rgbd[1])
+    {
+      // rgbd[2] > rgbd[1] >= rgbd[0]
+      for_each_channel(c, aligned(output))
+        output[c] = ((1-rgbd[2])*clut[i000+c] + (rgbd[2]-rgbd[1])*clut[i001+c]
+                    + (rgbd[1]-rgbd[0])*clut[i011+c] + rgbd[0]*clut[i111+c]);
+    }
+    else if(rgbd[2] > rgbd[0])
+    {
+      // rgbd[1] >= rgbd[2] > rgbd[0]
+      for_each_channel(c, aligned(output))
+        output[c] = ((1-rgbd[1])*clut[i000+c] + (rgbd[1]-rgbd[2])*clut[i010+c]
+                    + (rgbd[2]-rgbd[0])*clut[i011+c] + rgbd[0]*clut[i111+c]);
+    }
+    else
+    {
+      // rgbd[1] >= rgbd[0] >= rgbd[2]
+      for_each_channel(c, aligned(output))
+        output[c] = ((1-rgbd[1])*clut[i000+c] + (rgbd[1]-rgbd[0])*clut[i010+c]
+                    + (rgbd[0]-rgbd[2])*clut[i110+c] + rgbd[2]*clut[i111+c]);
     }
-    // not using non-temporal writes here, as those are substantially slower when in==out....
-    // (which is the case when performing a colorspace conversion)
   }
 }
 
 // from Study on the 3D Interpolation Models Used in Color Conversion
 // http://ijetch.org/papers/318-T860.pdf
-static void _correct_pixel_pyramid(const float *const in,
-                                   float *const out,
-                                   const size_t pixel_nb,
-                                   const float *const restrict clut,
-                                   const uint16_t level)
+static inline void _lut_pyramid(const float *const input,
+                                float *const output,
+                                const float *const restrict clut,
+                                const uint16_t level)
 {
   const int level2 = level * level;
   const float flevel_1 = (float)(level - 1);
 
-  DT_OMP_FOR()
-  for(size_t k = 0; k < (size_t)(pixel_nb * 4); k+=4)
-  {
-    const float *const input = in + k;
-    float *const output = ((float *const)out) + k;
+  DT_ALIGNED_PIXEL int rgbi[4];
+  dt_aligned_pixel_t rgbd;
+  // scale the input according to grid size
+  for_each_channel(c)
+    rgbd[c] = CLIP(input[c]) * flevel_1;
+  // clip coordinates to LUT grid
+  for_each_channel(c)
+    rgbi[c] = (int)rgbd[c];
+  for_each_channel(c)
+    rgbi[c] = CLAMP(rgbi[c], 0, level - 2);
+  // compute deltas for each channel
+  for_each_channel(c)
+    rgbd[c] -= rgbi[c];
 
-    DT_ALIGNED_PIXEL int rgbi[4];
-    dt_aligned_pixel_t rgbd;
-    // scale the input according to grid size
-    for_each_channel(c)
-      rgbd[c] = CLIP(input[c]) * flevel_1;
-    // clip coordinates to LUT grid
+  // indexes of P000 to P111 in clut
+  const int color = rgbi[0] + rgbi[1] * level + rgbi[2] * level2;
+  const size_t i000 = color * 3;                     // P000
+  const size_t i100 = i000 + 3;                      // P100
+  const size_t i010 = (color + level) * 3;           // P010
+  const size_t i110 = i010 + 3;                      // P110
+  const size_t i001 = (color + level2) * 3;          // P001
+  const size_t i101 = i001 + 3;                      // P101
+  const size_t i011 = (color + level + level2) * 3;  // P011
+  const size_t i111 = i011 + 3;                      // P111
+
+  dt_aligned_pixel_t outpx;
+  if(rgbd[1] > rgbd[0] && rgbd[2] > rgbd[0])
+  {
     for_each_channel(c)
-      rgbi[c] = (int)rgbd[c];
+      outpx[c] = (clut[i000+c] + (clut[i111+c]-clut[i011+c])*rgbd[0]
+                  + (clut[i010+c]-clut[i000+c])*rgbd[1] + (clut[i001+c]-clut[i000+c])*rgbd[2]
+                  + (clut[i011+c]-clut[i001+c]-clut[i010+c]+clut[i000+c])*rgbd[1]*rgbd[2]);
+  }
+  else if(rgbd[0] > rgbd[1] && rgbd[2] > rgbd[1])
+  {
     for_each_channel(c)
-      rgbi[c] = CLAMP(rgbi[c], 0, level - 2);
-    // compute deltas for each channel
+      outpx[c] = (clut[i000+c] + (clut[i100+c]-clut[i000+c])*rgbd[0]
+                  + (clut[i111+c]-clut[i101+c])*rgbd[1] + (clut[i001+c]-clut[i000+c])*rgbd[2]
+                  + (clut[i101+c]-clut[i001+c]-clut[i100+c]+clut[i000+c])*rgbd[0]*rgbd[2]);
+  }
+  else
+  {
     for_each_channel(c)
-      rgbd[c] -= rgbi[c];
+       outpx[c] = clut[i000+c] + (clut[i100+c]-clut[i000+c])*rgbd[0]
+                + (clut[i010+c]-clut[i000+c])*rgbd[1] + (clut[i111+c]-clut[i110+c])*rgbd[2]
+                + (clut[i110+c]-clut[i100+c]-clut[i010+c]+clut[i000+c])*rgbd[0]*rgbd[1];
+  }
+  copy_pixel(output, outpx);
+}
 
-  // indexes of P000 to P111 in clut
-    const int color = rgbi[0] + rgbi[1] * level + rgbi[2] * level2;
-    const size_t i000 = color * 3;                     // P000
-    const size_t i100 = i000 + 3;                      // P100
-    const size_t i010 = (color + level) * 3;           // P010
-    const size_t i110 = i010 + 3;                      // P110
-    const size_t i001 = (color + level2) * 3;          // P001
-    const size_t i101 = i001 + 3;                      // P101
-    const size_t i011 = (color + level + level2) * 3;  // P011
-    const size_t i111 = i011 + 3;                      // P111
-
-    dt_aligned_pixel_t outpx;
-    if(rgbd[1] > rgbd[0] && rgbd[2] > rgbd[0])
-    {
-      for_each_channel(c)
-        outpx[c] = (clut[i000+c] + (clut[i111+c]-clut[i011+c])*rgbd[0]
-                    + (clut[i010+c]-clut[i000+c])*rgbd[1] + (clut[i001+c]-clut[i000+c])*rgbd[2]
-                    + (clut[i011+c]-clut[i001+c]-clut[i010+c]+clut[i000+c])*rgbd[1]*rgbd[2]);
-    }
-    else if(rgbd[0] > rgbd[1] && rgbd[2] > rgbd[1])
-    {
-      for_each_channel(c)
-        outpx[c] = (clut[i000+c] + (clut[i100+c]-clut[i000+c])*rgbd[0]
-                    + (clut[i111+c]-clut[i101+c])*rgbd[1] + (clut[i001+c]-clut[i000+c])*rgbd[2]
-                    + (clut[i101+c]-clut[i001+c]-clut[i100+c]+clut[i000+c])*rgbd[0]*rgbd[2]);
-    }
-    else
-    {
-      for_each_channel(c)
-         outpx[c] = clut[i000+c] + (clut[i100+c]-clut[i000+c])*rgbd[0]
-                  + (clut[i010+c]-clut[i000+c])*rgbd[1] + (clut[i111+c]-clut[i110+c])*rgbd[2]
-                  + (clut[i110+c]-clut[i100+c]-clut[i010+c]+clut[i000+c])*rgbd[0]*rgbd[1];
-    }
-    // not using non-temporal writes here, as those are substantially slower when in==out....
-    // (which is the case when performing a colorspace conversion)
-    copy_pixel(output, outpx);
+// one loop per interpolation, so that the loop bodies don't branch on it
+__DT_CLONE_TARGETS__
+static void _correct_pixels(const float *const in,
+                            float *const out,
+                            const size_t pixel_nb,
+                            const float *const restrict clut,
+                            const uint16_t level,
+                            const dt_iop_lut3d_interpolation_t interpolation)
+{
+  switch(interpolation)
+  {
+    case DT_IOP_TETRAHEDRAL:
+      DT_OMP_FOR()
+      for(size_t k = 0; k < (size_t)(pixel_nb * 4); k+=4)
+        _lut_tetrahedral(in + k, out + k, clut, level);
+      break;
+    case DT_IOP_TRILINEAR:
+      DT_OMP_FOR()
+      for(size_t k = 0; k < (size_t)(pixel_nb * 4); k+=4)
+        _lut_trilinear(in + k, out + k, clut, level);
+      break;
+    default:
+      DT_OMP_FOR()
+      for(size_t k = 0; k < (size_t)(pixel_nb * 4); k+=4)
+        _lut_pyramid(in + k, out + k, clut, level);
+      break;
+  }
+}
+
+/* work profile <-> LUT profile conversion for matrix based profiles, done per
+   pixel together with the lookup instead of two extra passes over the image.
+*/
+typedef struct dt_iop_lut3d_transform_t
+{
+  dt_colormatrix_t to_lut;   // both transposed
+  dt_colormatrix_t from_lut;
+  const dt_iop_order_iccprofile_info_t *work;
+  const dt_iop_order_iccprofile_info_t *lut;
+} dt_iop_lut3d_transform_t;
+
+static gboolean _init_transform(dt_iop_lut3d_transform_t *t,
+                                const dt_iop_order_iccprofile_info_t *const work_profile,
+                                const dt_iop_order_iccprofile_info_t *const lut_profile)
+{
+  // profiles without matrices need lcms2
+  if(!dt_is_valid_colormatrix(work_profile->matrix_in[0][0])
+     || !dt_is_valid_colormatrix(work_profile->matrix_out[0][0])
+     || !dt_is_valid_colormatrix(lut_profile->matrix_in[0][0])
+     || !dt_is_valid_colormatrix(lut_profile->matrix_out[0][0]))
+    return FALSE;
+
+  // RGB -> XYZ -> RGB premultiplied into one matrix per direction
+  dt_colormatrix_t matrix;
+  dt_colormatrix_mul(matrix, lut_profile->matrix_out, work_profile->matrix_in);
+  transpose_3xSSE(matrix, t->to_lut);
+  dt_colormatrix_mul(matrix, work_profile->matrix_out, lut_profile->matrix_in);
+  transpose_3xSSE(matrix, t->from_lut);
+  t->work = work_profile;
+  t->lut = lut_profile;
+  return TRUE;
+}
+
+static inline void _work_to_lut(const float *const in,
+                                float *const rgb,
+                                const dt_iop_lut3d_transform_t *const t)
+{
+  const dt_iop_order_iccprofile_info_t *const work = t->work;
+  const dt_iop_order_iccprofile_info_t *const lut = t->lut;
+  dt_aligned_pixel_t tmp;
+
+  if(work->nonlinearlut)
+    dt_ioppr_apply_trc(in, tmp, work->lut_in, work->unbounded_coeffs_in, work->lutsize);
+  else
+    copy_pixel(tmp, in);
+  dt_apply_transposed_color_matrix(tmp, t->to_lut, rgb);
+  if(lut->nonlinearlut)
+    dt_ioppr_apply_trc(rgb, rgb, lut->lut_out, lut->unbounded_coeffs_out, lut->lutsize);
+}
+
+static inline void _lut_to_work(float *const tmp,
+                                float *const out,
+                                const float alpha,
+                                const dt_iop_lut3d_transform_t *const t)
+{
+  const dt_iop_order_iccprofile_info_t *const work = t->work;
+  const dt_iop_order_iccprofile_info_t *const lut = t->lut;
+  dt_aligned_pixel_t rgb;
+
+  if(lut->nonlinearlut)
+    dt_ioppr_apply_trc(tmp, tmp, lut->lut_in, lut->unbounded_coeffs_in, lut->lutsize);
+  dt_apply_transposed_color_matrix(tmp, t->from_lut, rgb);
+  if(work->nonlinearlut)
+    dt_ioppr_apply_trc(rgb, rgb, work->lut_out, work->unbounded_coeffs_out, work->lutsize);
+
+  rgb[3] = alpha;
+  copy_pixel(out, rgb);
+}
+
+// as _correct_pixels(), with the conversion to and from the LUT profile done per pixel
+__DT_CLONE_TARGETS__
+static void _correct_pixels_transform(const float *const in,
+                                      float *const out,
+                                      const size_t pixel_nb,
+                                      const float *const restrict clut,
+                                      const uint16_t level,
+                                      const dt_iop_lut3d_interpolation_t interpolation,
+                                      const dt_iop_lut3d_transform_t *const t)
+{
+  switch(interpolation)
+  {
+    case DT_IOP_TETRAHEDRAL:
+      DT_OMP_FOR()
+      for(size_t k = 0; k < (size_t)(pixel_nb * 4); k+=4)
+      {
+        dt_aligned_pixel_t rgb, tmp;
+        _work_to_lut(in + k, rgb, t);
+        _lut_tetrahedral(rgb, tmp, clut, level);
+        _lut_to_work(tmp, out + k, in[k+3], t);
+      }
+      break;
+    case DT_IOP_TRILINEAR:
+      DT_OMP_FOR()
+      for(size_t k = 0; k < (size_t)(pixel_nb * 4); k+=4)
+      {
+        dt_aligned_pixel_t rgb, tmp;
+        _work_to_lut(in + k, rgb, t);
+        _lut_trilinear(rgb, tmp, clut, level);
+        _lut_to_work(tmp, out + k, in[k+3], t);
+      }
+      break;
+    default:
+      DT_OMP_FOR()
+      for(size_t k = 0; k < (size_t)(pixel_nb * 4); k+=4)
+      {
+        dt_aligned_pixel_t rgb, tmp;
+        _work_to_lut(in + k, rgb, t);
+        _lut_pyramid(rgb, tmp, clut, level);
+        _lut_to_work(tmp, out + k, in[k+3], t);
+      }
+      break;
   }
 }
 
@@ -1122,52 +1237,118 @@ void tiling_callback(dt_iop_module_t *self,
   tiling->align = 1;
 }
 
+// the profile the LUT is defined in. returns whether the pixels have to be
+// converted to it, which isn't needed if the LUT is in the working space already
+static gboolean _get_profiles(dt_iop_module_t *self,
+                              const dt_iop_lut3d_data_t *const d,
+                              const dt_iop_order_iccprofile_info_t **work_profile,
+                              const dt_iop_order_iccprofile_info_t **lut_profile)
+{
+  const int colorspace
+    = (d->params.colorspace == DT_IOP_SRGB) ? DT_COLORSPACE_SRGB
+    : (d->params.colorspace == DT_IOP_REC709) ? DT_COLORSPACE_REC709
+    : (d->params.colorspace == DT_IOP_ARGB) ? DT_COLORSPACE_ADOBERGB
+    : (d->params.colorspace == DT_IOP_LIN_PROPHOTO) ? DT_COLORSPACE_PROPHOTO_RGB
+    : (d->params.colorspace == DT_IOP_LIN_REC709) ? DT_COLORSPACE_LIN_REC709
+    : DT_COLORSPACE_LIN_REC2020;
+  *lut_profile = dt_ioppr_add_profile_info_to_list(self->dev, colorspace, "", INTENT_PERCEPTUAL);
+  *work_profile = dt_ioppr_get_iop_work_profile_info(self, self->dev->iop);
+  return *work_profile && *lut_profile
+    && !((*work_profile)->type == (*lut_profile)->type
+         && !strcmp((*work_profile)->filename, (*lut_profile)->filename));
+}
+
+// --bench-module lut3d compares the interpolations, with and without the
+// fused conversion to the LUT profile
+void benchmark(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ibuf, void *const obuf,
+               const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_lut3d_data_t *d = piece->data;
+  const float *const in = (const float *)ibuf;
+  float *const out = (float *)obuf;
+  const size_t pixel_nb = (size_t)roi_in->width * roi_in->height;
+  const float *const clut = (float *)d->clut;
+  const uint16_t level = d->level;
+  if(!clut) return;
+
+  const dt_iop_order_iccprofile_info_t *work_profile;
+  const dt_iop_order_iccprofile_info_t *lut_profile;
+  dt_iop_lut3d_transform_t t;
+  const gboolean transform = _get_profiles(self, d, &work_profile, &lut_profile);
+  const gboolean fused = transform && _init_transform(&t, work_profile, lut_profile);
+
+  const char *names[] = { "tetrahedral", "trilinear", "pyramid" };
+  const int counter = 20;
+  const float mpix = pixel_nb / 1.0e6;
+  const int old_muted = darktable.unmuted;
+
+  for(dt_iop_lut3d_interpolation_t interpolation = DT_IOP_TETRAHEDRAL;
+      interpolation <= DT_IOP_PYRAMID;
+      interpolation++)
+  {
+    for(int variant = 0; variant < 3; variant++)
+    {
+      if(variant == 1 && !transform) continue;
+      if(variant == 2 && !fused) continue;
+      darktable.unmuted = 0;
+      dt_times_t start, end;
+      dt_get_times(&start);
+      for(int i = 0; i < counter; i++)
+      {
+        if(variant == 0)
+          _correct_pixels(in, out, pixel_nb, clut, level, interpolation);
+        else if(variant == 1)
+        {
+          dt_ioppr_transform_image_colorspace_rgb(in, out, pixel_nb, 1, work_profile, lut_profile, NULL);
+          _correct_pixels(out, out, pixel_nb, clut, level, interpolation);
+          dt_ioppr_transform_image_colorspace_rgb(out, out, pixel_nb, 1, lut_profile, work_profile, NULL);
+        }
+        else
+          _correct_pixels_transform(in, out, pixel_nb, clut, level, interpolation, &t);
+      }
+      dt_get_times(&end);
+      darktable.unmuted = old_muted;
+      const float clock = (end.clock - start.clock) / (float)counter;
+      dt_print(DT_DEBUG_ALWAYS,
+               "[bench module lut3d] %-11s %-16s takes %8.5fs,%7.2fmpix,%9.3fpix/us",
+               names[interpolation],
+               variant == 0 ? "lookup only" : variant == 1 ? "3 passes" : "fused",
+               clock, mpix, mpix / clock);
+    }
+  }
+}
+
 void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ibuf, void *const obuf,
              const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
   dt_iop_lut3d_data_t *d = piece->data;
   const int width = roi_in->width;
   const int height = roi_in->height;
+  const size_t pixel_nb = (size_t)width * height;
   const int ch = piece->colors;
   const float *const clut = (float *)d->clut;
   const uint16_t level = d->level;
-  const int interpolation = d->params.interpolation;
-  const int colorspace
-    = (d->params.colorspace == DT_IOP_SRGB) ? DT_COLORSPACE_SRGB
-    : (d->params.colorspace == DT_IOP_REC709) ? DT_COLORSPACE_REC709
-    : (d->params.colorspace == DT_IOP_ARGB) ? DT_COLORSPACE_ADOBERGB
-    : (d->params.colorspace == DT_IOP_LIN_PROPHOTO) ? DT_COLORSPACE_PROPHOTO_RGB
-    : (d->params.colorspace == DT_IOP_LIN_REC709) ? DT_COLORSPACE_LIN_REC709
-    : DT_COLORSPACE_LIN_REC2020;
-  const dt_iop_order_iccprofile_info_t *const lut_profile
-    = dt_ioppr_add_profile_info_to_list(self->dev, colorspace, "", INTENT_PERCEPTUAL);
-  const dt_iop_order_iccprofile_info_t *const work_profile
-    = dt_ioppr_get_iop_work_profile_info(self, self->dev->iop);
-  const gboolean transform = (work_profile != NULL && lut_profile != NULL) ? TRUE : FALSE;
+  const dt_iop_lut3d_interpolation_t interpolation = d->params.interpolation;
+  const dt_iop_order_iccprofile_info_t *work_profile;
+  const dt_iop_order_iccprofile_info_t *lut_profile;
+  const gboolean transform = _get_profiles(self, d, &work_profile, &lut_profile);
+  dt_iop_lut3d_transform_t t;
+  const gboolean fused = transform && _init_transform(&t, work_profile, lut_profile);
+
   if(clut)
   {
-    if(transform)
+    if(fused)
+      _correct_pixels_transform(ibuf, obuf, pixel_nb, clut, level, interpolation, &t);
+    else if(transform)
     {
       dt_ioppr_transform_image_colorspace_rgb(ibuf, obuf, width, height,
         work_profile, lut_profile, "work profile to LUT profile");
-      if(interpolation == DT_IOP_TETRAHEDRAL)
-        _correct_pixel_tetrahedral(obuf, obuf, (size_t)width * height, clut, level);
-      else if(interpolation == DT_IOP_TRILINEAR)
-        _correct_pixel_trilinear(obuf, obuf, (size_t)width * height, clut, level);
-      else
-        _correct_pixel_pyramid(obuf, obuf, (size_t)width * height, clut, level);
+      _correct_pixels(obuf, obuf, pixel_nb, clut, level, interpolation);
       dt_ioppr_transform_image_colorspace_rgb(obuf, obuf, width, height,
         lut_profile, work_profile, "LUT profile to work profile");
     }
     else
-    {
-      if(interpolation == DT_IOP_TETRAHEDRAL)
-        _correct_pixel_tetrahedral(ibuf, obuf, (size_t)width * height, clut, level);
-      else if(interpolation == DT_IOP_TRILINEAR)
-        _correct_pixel_trilinear(ibuf, obuf, (size_t)width * height, clut, level);
-      else
-        _correct_pixel_pyramid(ibuf, obuf, (size_t)width * height, clut, level);
-    }
+      _correct_pixels(ibuf, obuf, pixel_nb, clut, level, interpolation);
   }
   else  // no clut
   {
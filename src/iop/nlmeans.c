@@ -340,13 +340,13 @@ void tiling_callback(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
   tiling->align = 1;
 }
 
-void process(
-        dt_iop_module_t *self,
+static void _process(
         dt_dev_pixelpipe_iop_t *piece,
         const void *const ivoid,
         void *const ovoid,
         const dt_iop_roi_t *const roi_in,
-        const dt_iop_roi_t *const roi_out)
+        const dt_iop_roi_t *const roi_out,
+        const nlmeans_denoise_t denoise)
 {
   const dt_iop_nlmeans_params_t *const d = piece->data;
   if(!dt_iop_have_required_input_format(4 /*we need full-color pixels*/, piece->module, piece->colors,
@@ -376,9 +376,33 @@ void process(
                                       .patch_radius = P,
                                       .search_radius = K,
                                       .decimate = decimate,
-                                      .norm = norm2 };
+                                      .norm = norm2,
+                                      .engine = nlmeans_preferred_engine() };
+
+  denoise(ivoid, ovoid, roi_in, roi_out, &params);
+}
+
+void process(
+        dt_iop_module_t *self,
+        dt_dev_pixelpipe_iop_t *piece,
+        const void *const ivoid,
+        void *const ovoid,
+        const dt_iop_roi_t *const roi_in,
+        const dt_iop_roi_t *const roi_out)
+{
+  _process(piece, ivoid, ovoid, roi_in, roi_out, nlmeans_denoise);
+}
 
-  nlmeans_denoise(ivoid, ovoid, roi_in, roi_out, &params);
+// --bench-module nlmeans compares the cpu engines
+void benchmark(
+        dt_iop_module_t *self,
+        dt_dev_pixelpipe_iop_t *piece,
+        const void *const ivoid,
+        void *const ovoid,
+        const dt_iop_roi_t *const roi_in,
+        const dt_iop_roi_t *const roi_out)
+{
+  _process(piece, ivoid, ovoid, roi_in, roi_out, nlmeans_benchmark);
 }
 
 void init_global(dt_iop_module_so_t *self)
@@ -97,6 +97,7 @@
 #include "common/darktable.h"
 #include "common/fast_guided_filter.h"
 #include "common/eigf.h"
+#include "common/guided_filter.h"
 #include "common/interpolation.h"
 #include "common/luminance_mask.h"
 #include "common/opencl.h"
@@ -201,6 +202,7 @@ typedef struct dt_iop_toneequalizer_data_t
   int iterations;
   dt_iop_luminance_mask_method_t method;
   dt_iop_toneequalizer_filter_t details;
+  dt_filter_workspace_t ws; // buffers of the guided filters, kept across runs
 } dt_iop_toneequalizer_data_t;
 
 
@@ -877,7 +879,7 @@ static inline void compute_luminance_mask(const float *const restrict in,
                                           float *const restrict luminance,
                                           const size_t width,
                                           const size_t height,
-                                          const dt_iop_toneequalizer_data_t *const d)
+                                          dt_iop_toneequalizer_data_t *const d)
 {
   switch(d->details)
   {
@@ -894,7 +896,7 @@ static inline void compute_luminance_mask(const float *const restrict in,
       // Still no contrast boost
       luminance_mask(in, luminance, width, height,
                      d->method, d->exposure_boost, 0.0f, 1.0f);
-      fast_surface_blur(luminance, width, height, d->radius, d->feathering, d->iterations,
+      fast_surface_blur(&d->ws, luminance, width, height, d->radius, d->feathering, d->iterations,
                         DT_GF_BLENDING_GEOMEAN, d->scale, d->quantization,
                         exp2f(-14.0f), 4.0f);
       break;
@@ -911,7 +913,7 @@ static inline void compute_luminance_mask(const float *const restrict in,
       // the exposure boost should be used to make this assumption true
       luminance_mask(in, luminance, width, height, d->method, d->exposure_boost,
                      CONTRAST_FULCRUM, d->contrast_boost);
-      fast_surface_blur(luminance, width, height, d->radius, d->feathering, d->iterations,
+      fast_surface_blur(&d->ws, luminance, width, height, d->radius, d->feathering, d->iterations,
                         DT_GF_BLENDING_LINEAR, d->scale, d->quantization,
                         exp2f(-14.0f), 4.0f);
       break;
@@ -922,7 +924,7 @@ static inline void compute_luminance_mask(const float *const restrict in,
       // Still no contrast boost
       luminance_mask(in, luminance, width, height,
                      d->method, d->exposure_boost, 0.0f, 1.0f);
-      fast_eigf_surface_blur(luminance, width, height,
+      fast_eigf_surface_blur(&d->ws, luminance, width, height,
                              d->radius, d->feathering, d->iterations,
                              DT_GF_BLENDING_GEOMEAN, d->scale,
                              d->quantization, exp2f(-14.0f), 4.0f);
@@ -933,7 +935,7 @@ static inline void compute_luminance_mask(const float *const restrict in,
     {
       luminance_mask(in, luminance, width, height, d->method, d->exposure_boost,
                      CONTRAST_FULCRUM, d->contrast_boost);
-      fast_eigf_surface_blur(luminance, width, height,
+      fast_eigf_surface_blur(&d->ws, luminance, width, height,
                              d->radius, d->feathering, d->iterations,
                              DT_GF_BLENDING_LINEAR, d->scale,
                              d->quantization, exp2f(-14.0f), 4.0f);
@@ -949,6 +951,88 @@ static inline void compute_luminance_mask(const float *const restrict in,
   }
 }
 
+// --bench-module toneequal times the edge-aware filters as called by toneequal,
+// contrast & texture and blending feathering, each with per-call buffers and
+// with a kept workspace
+void benchmark(dt_iop_module_t *self,
+               dt_dev_pixelpipe_iop_t *piece,
+               const void *const restrict ivoid,
+               void *const restrict ovoid,
+               const dt_iop_roi_t *const roi_in,
+               const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_toneequalizer_data_t *const d = piece->data;
+  const float *const restrict in = (const float *)ivoid;
+  const size_t width = roi_in->width;
+  const size_t height = roi_in->height;
+  const size_t num_elem = width * height;
+  if(piece->colors != 4 || num_elem == 0) return;
+
+  float *const restrict luminance = dt_alloc_align_float(num_elem);
+  float *const restrict work = dt_alloc_align_float(num_elem);
+  if(!luminance || !work)
+  {
+    dt_free_align(luminance);
+    dt_free_align(work);
+    return;
+  }
+  luminance_mask(in, luminance, width, height, d->method, d->exposure_boost, 0.0f, 1.0f);
+
+  const char *names[] = { "guided", "eigf", "eigf no mask", "guided rgb" };
+  const int counter = 3;
+  const float mpix = (float)num_elem / 1.0e6f;
+  const int old_muted = darktable.unmuted;
+
+  for(int filter = 0; filter < 4; filter++)
+  {
+    for(int reuse = 0; reuse < 2; reuse++)
+    {
+      // guided_filter() keeps its buffers only across its own tiles
+      if(filter == 3 && reuse) continue;
+
+      dt_filter_workspace_t ws = { { NULL } };
+      dt_filter_workspace_t *const w = reuse ? &ws : NULL;
+      darktable.unmuted = 0;
+      dt_times_t start, end;
+      dt_get_times(&start);
+      for(int i = 0; i < counter; i++)
+      {
+        dt_iop_image_copy(work, luminance, num_elem);
+        switch(filter)
+        {
+          case 0:
+            fast_surface_blur(w, work, width, height, d->radius, d->feathering, d->iterations,
+                              DT_GF_BLENDING_LINEAR, d->scale, d->quantization, exp2f(-14.0f), 4.0f);
+            break;
+          case 1:
+            fast_eigf_surface_blur(w, work, width, height, d->radius, d->feathering, d->iterations,
+                                   DT_GF_BLENDING_LINEAR, d->scale, fmaxf(d->quantization, 0.01f),
+                                   exp2f(-14.0f), 4.0f);
+            break;
+          case 2:
+            fast_eigf_surface_blur(w, work, width, height, d->radius, d->feathering, d->iterations,
+                                   DT_GF_BLENDING_LINEAR, d->scale, 0.0f, exp2f(-14.0f), 4.0f);
+            break;
+          default:
+            guided_filter(in, luminance, work, width, height, 4, MAX(d->radius, 1),
+                          sqrtf(d->feathering), 1.0f, 0.0f, 1.0f);
+            break;
+        }
+      }
+      dt_get_times(&end);
+      darktable.unmuted = old_muted;
+      const float clock = (end.clock - start.clock) / (float)counter;
+      dt_print(DT_DEBUG_ALWAYS,
+               "[bench module toneequal] %-12s %-9s takes %8.5fs,%7.2fmpix,%9.3fpix/us",
+               names[filter], reuse ? "workspace" : "per call", clock, mpix, mpix / clock);
+      dt_filter_workspace_free(&ws);
+    }
+  }
+
+  dt_free_align(luminance);
+  dt_free_align(work);
+}
+
 /***
  * Actual transfer functions
  **/
@@ -1007,7 +1091,7 @@ void toneeq_process(dt_iop_module_t *self,
                     const dt_iop_roi_t *const roi_in,
                     const dt_iop_roi_t *const roi_out)
 {
-  const dt_iop_toneequalizer_data_t *const d = piece->data;
+  dt_iop_toneequalizer_data_t *const d = piece->data;
   dt_iop_toneequalizer_gui_data_t *const g = self->gui_data;
 
   const float *const restrict in = (float *const)ivoid;
@@ -1656,6 +1740,8 @@ void cleanup_pipe(dt_iop_module_t *self,
                   dt_dev_pixelpipe_t *pipe,
                   dt_dev_pixelpipe_iop_t *piece)
 {
+  dt_iop_toneequalizer_data_t *d = piece->data;
+  dt_filter_workspace_free(&d->ws);
   dt_free_align(piece->data);
   piece->data = NULL;
 }
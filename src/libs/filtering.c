@@ -118,6 +118,8 @@ typedef struct dt_lib_filtering_rule_t
   struct dt_lib_filtering_t *lib;
 } dt_lib_filtering_rule_t;
 
+#include "libs/filters/facets.c"
+
 typedef struct dt_lib_filtering_t
 {
   dt_lib_filtering_rule_t rule[DT_COLLECTION_MAX_RULES];
@@ -137,6 +139,7 @@ typedef struct dt_lib_filtering_t
   struct dt_lib_filtering_params_t *params;
 
   gchar *last_where_ext;
+  _facets_t facets;
 } dt_lib_filtering_t;
 
 typedef struct dt_lib_filtering_params_rule_t
@@ -1455,6 +1458,9 @@ static void _dt_collection_updated(gpointer instance, dt_collection_change_t que
   else
     g_free(where_ext);
 
+  // images may have changed even if the query is the same
+  _facets_invalidate(&d->facets);
+
   for(int i = 0; i <= d->nb_rules; i++)
   {
     _widget_update(&d->rule[i]);
@@ -2281,6 +2287,7 @@ void gui_cleanup(dt_lib_module_t *self)
 
   darktable.view_manager->proxy.module_filtering.module = NULL;
   free(d->params);
+  _facets_cleanup(&d->facets);
 
   /* TODO: Make sure we are cleaning up all allocations */
 
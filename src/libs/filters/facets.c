@@ -0,0 +1,181 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  This file contains the facet engine shared by the range filters of the filtering module.
+
+  Instead of one GROUP BY query per filter, all numeric properties are read with a single
+  scan of the images matching the current collection and counted here. The result is kept
+  until the collection query changes or the collection is flagged as changed (which also
+  happens when image properties are modified), so each collection change costs one scan
+  whatever the number of visible filters.
+*/
+
+typedef enum _facet_t
+{
+  _FACET_APERTURE = 0,
+  _FACET_EXPOSURE,
+  _FACET_EXPOSURE_BIAS,
+  _FACET_FOCAL_LENGTH,
+  _FACET_ISO,
+  _FACET_ASPECT_RATIO,
+  _FACET_RATING,
+  _FACET_LAST
+} _facet_t;
+
+typedef struct _facet_bin_t
+{
+  double value;
+  int count;
+} _facet_bin_t;
+
+typedef struct _facets_t
+{
+  gchar *where_ext;             // collection query the bins have been computed for, NULL if outdated
+  GArray *bins[_FACET_LAST];    // _facet_bin_t sorted by value, images without value first
+} _facets_t;
+
+static void _facets_invalidate(_facets_t *facets)
+{
+  g_free(facets->where_ext);
+  facets->where_ext = NULL;
+}
+
+static void _facets_cleanup(_facets_t *facets)
+{
+  _facets_invalidate(facets);
+  for(int k = 0; k < _FACET_LAST; k++)
+  {
+    if(facets->bins[k]) g_array_free(facets->bins[k], TRUE);
+    facets->bins[k] = NULL;
+  }
+}
+
+static int _facets_sort_double(gconstpointer a, gconstpointer b)
+{
+  const double da = *(const double *)a;
+  const double db = *(const double *)b;
+  return (da > db) - (da < db);
+}
+
+static void _facets_compute(_facets_t *facets, const gchar *where_ext)
+{
+  const double start = dt_get_wtime();
+
+  GArray *values[_FACET_LAST];
+  int nulls[_FACET_LAST] = { 0 };
+  for(int k = 0; k < _FACET_LAST; k++) values[k] = g_array_new(FALSE, FALSE, sizeof(double));
+
+  // the columns must follow the order of _facet_t.
+  // rounding is kept in sql so that the bins are the same than the ones used by the rules
+  // clang-format off
+  gchar *query = g_strdup_printf
+    ("SELECT ROUND(aperture,1), exposure, ROUND(exposure_bias,2),"
+     "       ROUND(focal_length,0), ROUND(iso,0), ROUND(aspect_ratio,2),"
+     "       CASE WHEN (flags & 8) == 8 THEN -1 ELSE (flags & 7) END"
+     " FROM main.images AS mi"
+     " WHERE %s",
+     where_ext);
+  // clang-format on
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  int nb = 0;
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    for(int k = 0; k < _FACET_LAST; k++)
+    {
+      if(sqlite3_column_type(stmt, k) == SQLITE_NULL)
+        nulls[k]++;
+      else
+      {
+        const double val = sqlite3_column_double(stmt, k);
+        g_array_append_val(values[k], val);
+      }
+    }
+    nb++;
+  }
+  sqlite3_finalize(stmt);
+  g_free(query);
+
+  // sort the values and count the identical ones
+  for(int k = 0; k < _FACET_LAST; k++)
+  {
+    if(facets->bins[k])
+      g_array_set_size(facets->bins[k], 0);
+    else
+      facets->bins[k] = g_array_new(FALSE, FALSE, sizeof(_facet_bin_t));
+
+    // images without value are shown as 0, as the GROUP BY queries did
+    if(nulls[k] > 0)
+    {
+      const _facet_bin_t bin = { 0.0, nulls[k] };
+      g_array_append_val(facets->bins[k], bin);
+    }
+
+    g_array_sort(values[k], _facets_sort_double);
+    const double *v = (double *)values[k]->data;
+    for(guint i = 0; i < values[k]->len;)
+    {
+      guint j = i + 1;
+      while(j < values[k]->len && v[j] == v[i]) j++;
+      const _facet_bin_t bin = { v[i], j - i };
+      g_array_append_val(facets->bins[k], bin);
+      i = j;
+    }
+    g_array_free(values[k], TRUE);
+  }
+
+  g_free(facets->where_ext);
+  facets->where_ext = g_strdup(where_ext);
+
+  dt_print(DT_DEBUG_PERF, "[filtering] facets of %d images computed in %.3f secs", nb,
+           dt_get_wtime() - start);
+}
+
+// returns the bins of the facet for the given collection query, computing all facets if needed
+static const GArray *_facets_get(_facets_t *facets, const gchar *where_ext, const _facet_t facet)
+{
+  if(!facets->where_ext || g_strcmp0(facets->where_ext, where_ext))
+    _facets_compute(facets, where_ext);
+  return facets->bins[facet];
+}
+
+// replace the blocks of the range widgets by the bins of the facet
+static void _facets_set_blocks(_facets_t *facets,
+                               const gchar *where_ext,
+                               const _facet_t facet,
+                               GtkDarktableRangeSelect *range,
+                               GtkDarktableRangeSelect *rangetop)
+{
+  const GArray *bins = _facets_get(facets, where_ext, facet);
+
+  dtgtk_range_select_reset_blocks(range);
+  if(rangetop) dtgtk_range_select_reset_blocks(rangetop);
+  for(guint i = 0; i < bins->len; i++)
+  {
+    const _facet_bin_t *bin = &g_array_index(bins, _facet_bin_t, i);
+    dtgtk_range_select_add_block(range, bin->value, bin->count);
+    if(rangetop) dtgtk_range_select_add_block(rangetop, bin->value, bin->count);
+  }
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -34,37 +34,22 @@ static gboolean _ratio_update(dt_lib_filtering_rule_t *rule)
 
   rule->manual_widget_set++;
   // first, we update the graph
-  char query[1024] = { 0 };
-  // clang-format off
-  g_snprintf(query, sizeof(query),
-             "SELECT ROUND(aspect_ratio,2), COUNT(*) AS count"
-             " FROM main.images AS mi"
-             " WHERE %s"
-             " GROUP BY ROUND(aspect_ratio,2)",
-             d->last_where_ext);
-  // clang-format on
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  _facets_set_blocks(&d->facets, d->last_where_ext, _FACET_ASPECT_RATIO, range, rangetop);
+
   int nb_portrait = 0;
   int nb_square = 0;
   int nb_landscape = 0;
-  dtgtk_range_select_reset_blocks(range);
-  if(rangetop) dtgtk_range_select_reset_blocks(rangetop);
-  while(sqlite3_step(stmt) == SQLITE_ROW)
+  const GArray *bins = _facets_get(&d->facets, d->last_where_ext, _FACET_ASPECT_RATIO);
+  for(guint i = 0; i < bins->len; i++)
   {
-    const double val = sqlite3_column_double(stmt, 0);
-    const int count = sqlite3_column_int(stmt, 1);
-    if(val < 1.0)
-      nb_portrait += count;
-    else if(val > 1.0)
-      nb_landscape += count;
+    const _facet_bin_t *bin = &g_array_index(bins, _facet_bin_t, i);
+    if(bin->value < 1.0)
+      nb_portrait += bin->count;
+    else if(bin->value > 1.0)
+      nb_landscape += bin->count;
     else
-      nb_square += count;
-
-    dtgtk_range_select_add_block(range, val, count);
-    if(rangetop) dtgtk_range_select_add_block(rangetop, val, count);
+      nb_square += bin->count;
   }
-  sqlite3_finalize(stmt);
 
   // predefined selections
   dtgtk_range_select_add_range_block(range, 1.0, 1.0, DT_RANGE_BOUND_MIN | DT_RANGE_BOUND_MAX, _("all images"),
@@ -141,12 +141,8 @@ static int generate_cache(lua_State *L)
 
   for(int k = max; k >= min && k >= 0; k--)
   {
-    char filename[PATH_MAX] = { 0 };
-    snprintf(filename, sizeof(filename),
-             "%s.d/%d/%d.jpg", darktable.mipmap_cache->cachedir, k, imgid);
-
-    // if a valid thumbnail file is already on disc - do nothing
-    if(dt_util_test_image_file(filename)) continue;
+    // if a valid thumbnail is already on disc - do nothing
+    if(dt_mipmap_cache_is_on_disk(imgid, k)) continue;
     // else, generate thumbnail and store in mipmap cache.
     dt_mipmap_buffer_t buf;
     dt_mipmap_cache_get(&buf, imgid, k, DT_MIPMAP_BLOCKING, 'r');
@@ -24,15 +24,19 @@
 #include "common/film.h"
 #include "common/image.h"
 #include "common/introspection.h"
+#include "common/iop_order.h"
+#include "common/mipmap_cache.h"
 #include "common/styles.h"
 #include "common/usermanual_url.h"
 #include "develop/develop.h"
 #include "develop/imageop.h"
+#include "develop/pixelpipe.h"
 #include "imageio/imageio_common.h"
 #include "imageio/imageio_module.h"
 
 #include <cairo/cairo.h>
 #include <json-glib/json-glib.h>
+#include <math.h>
 #include <sqlite3.h>
 #include <string.h>
 
@@ -533,14 +537,18 @@ char *dt_bridge_encode_params_hex(const char *op, void *fields_jsonobject, char
 
 static GHashTable *_path_cache = NULL; // path -> imgid (GINT_TO_POINTER)
 
+static dt_pthread_mutex_t _bridge_lock; // path cache and session list
+
 static dt_imgid_t _import(const char *path, char **err)
 {
   if(!path) { _seterr(err, "no input path or imgid provided"); return NO_IMGID; }
-  if(!_path_cache)
-    _path_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  dt_pthread_mutex_lock(&_bridge_lock);
   gpointer v = NULL;
   if(g_hash_table_lookup_extended(_path_cache, path, NULL, &v))
+  {
+    dt_pthread_mutex_unlock(&_bridge_lock);
     return (dt_imgid_t)GPOINTER_TO_INT(v);
+  }
   gchar *dir = g_path_get_dirname(path);
   dt_film_t film;
   const dt_filmid_t filmid = dt_film_new(&film, dir);
@@ -550,6 +558,7 @@ static dt_imgid_t _import(const char *path, char **err)
     g_hash_table_insert(_path_cache, g_strdup(path), GINT_TO_POINTER(id));
   else
     _seterr(err, "could not import '%s'", path);
+  dt_pthread_mutex_unlock(&_bridge_lock);
   return id;
 }
 
@@ -609,164 +618,337 @@ static gboolean _apply_entry(dt_develop_t *dev, JsonObject *entry, char **err)
   return TRUE;
 }
 
-// in-memory 8-bit RGB export "format" module; we render through this instead of
-// dt_imageio_preview() because that helper builds its surface via a GUI-only
-// cairo wrapper (dereferences darktable.gui->ppd) and crashes headless
-typedef struct
+// drop the history items above history_end, left over from a previous call
+static void _trim_history(dt_develop_t *dev)
 {
-  dt_imageio_module_data_t head;
-  int bpp;
-  uint8_t *buf;
-  uint32_t width, height;
-} _mcp_fmt_t;
-
-static int _mcp_write(dt_imageio_module_data_t *data, const char *filename,
-                      const void *in,
-                      const dt_colorspaces_color_profile_type_t over_type,
-                      const char *over_filename, void *exif, const int exif_len,
-                      const dt_imgid_t imgid, const int num, const int total,
-                      dt_dev_pixelpipe_t *pipe, const gboolean export_masks)
+  GList *tail = g_list_nth(dev->history, dev->history_end);
+  while(tail)
+  {
+    GList *next = g_list_next(tail);
+    dt_dev_free_history_item(tail->data);
+    dev->history = g_list_delete_link(dev->history, tail);
+    tail = next;
+  }
+}
+
+// append the requested edits to the history of dev
+static gboolean _apply_edits(dt_develop_t *dev, JsonArray *stack,
+                             gboolean disable_tone_mappers, char **err)
 {
-  _mcp_fmt_t *d = (_mcp_fmt_t *)data;
-  if(!in) return 1;
-  memcpy(d->buf, in, sizeof(uint32_t) * (size_t)data->width * data->height);
-  d->width = data->width;
-  d->height = data->height;
-  return 0;
+  if(disable_tone_mappers)
+  {
+    const char *tms[] = { "sigmoid", "filmicrgb", "basecurve", NULL };
+    for(int i = 0; tms[i]; i++)
+    {
+      dt_iop_module_t *m = dt_iop_get_module_by_op_priority(dev->iop, tms[i], 0);
+      if(m && m->enabled)
+      {
+        m->enabled = FALSE;
+        dt_dev_add_history_item_ext(dev, m, FALSE, TRUE);
+      }
+    }
+  }
+
+  const guint n_stack = stack ? json_array_get_length(stack) : 0;
+  for(guint i = 0; i < n_stack; i++)
+  {
+    JsonNode *en = json_array_get_element(stack, i);
+    if(!JSON_NODE_HOLDS_OBJECT(en))
+    {
+      _seterr(err, "stack[%u] is not an object", i);
+      return FALSE;
+    }
+    if(!_apply_entry(dev, json_node_get_object(en), err))
+      return FALSE;
+  }
+  return TRUE;
 }
-static int _mcp_bpp(dt_imageio_module_data_t *d)
+
+static void _free_cb(void *p) { g_free(p); }
+
+// ---------------------------------------------------------------------------
+// render sessions
+// ---------------------------------------------------------------------------
+
+// a session keeps the develop state, the full resolution input and the
+// pixelpipe of one image alive between calls. each call resets the history
+// to the image's own stack and appends the requested edits. as the pieces in
+// front of the first changed module keep their hash, the pipe cache serves
+// their output and a parameter sweep only recomputes the tail of the pipe.
+// the edits never reach the database, so the source image is untouched.
+typedef struct _mcp_session_t
 {
-  return 8;
+  dt_imgid_t imgid;
+  int history_end;          // as requested, -1 for the full history
+  int base_end;             // length of the image's own history
+  dt_develop_t dev;
+  dt_dev_pixelpipe_t pipe;
+  dt_pthread_mutex_t lock;  // one render at a time
+  gint refs;
+} _mcp_session_t;
+
+// a session holds the full resolution image and its cachelines, keep only
+// the most recently used ones
+#define MCP_MAX_SESSIONS 4
+
+static GList *_sessions = NULL; // most recently used first
+
+static void _session_unref(_mcp_session_t *s)
+{
+  if(!g_atomic_int_dec_and_test(&s->refs)) return;
+  dt_dev_pixelpipe_cleanup(&s->pipe);
+  dt_dev_cleanup(&s->dev);
+  dt_pthread_mutex_destroy(&s->lock);
+  g_free(s);
 }
-static int _mcp_levels(dt_imageio_module_data_t *d)
+
+static _mcp_session_t *_session_new(const dt_imgid_t imgid, const int history_end,
+                                    char **err)
 {
-  return IMAGEIO_RGB | IMAGEIO_INT8;
+  _mcp_session_t *s = g_malloc0(sizeof(_mcp_session_t));
+  s->imgid = imgid;
+  s->history_end = history_end;
+  s->refs = 1;
+
+  // the full buffer is only locked while rendering, check that it loads
+  dt_mipmap_buffer_t buf;
+  dt_mipmap_cache_get(&buf, imgid, DT_MIPMAP_FULL, DT_MIPMAP_BLOCKING, 'r');
+  const gboolean loaded = buf.buf && buf.width && buf.height;
+  dt_mipmap_cache_release(&buf);
+  if(!loaded)
+  {
+    g_free(s);
+    _seterr(err, "could not load image %d", imgid);
+    return NULL;
+  }
+
+  if(!dt_dev_pixelpipe_init_cached(&s->pipe, 0,
+                                   darktable.pipe_cache ? 12 : DT_PIPECACHE_MIN, 16))
+  {
+    dt_dev_pixelpipe_cleanup(&s->pipe);
+    g_free(s);
+    _seterr(err, "could not allocate the pixelpipe");
+    return NULL;
+  }
+  s->pipe.type = DT_DEV_PIXELPIPE_EXPORT;
+  s->pipe.levels = IMAGEIO_RGB | IMAGEIO_INT8;
+
+  dt_dev_init(&s->dev, FALSE);
+  dt_dev_load_image(&s->dev, imgid);
+  if(history_end != -1)
+    dt_dev_pop_history_items_ext(&s->dev, history_end);
+  _trim_history(&s->dev);
+  s->base_end = s->dev.history_end;
+  dt_ioppr_resync_modules_order(&s->dev);
+
+  dt_dev_pixelpipe_set_icc(&s->pipe, DT_COLORSPACE_DISPLAY, NULL, DT_INTENT_LAST);
+  dt_dev_pixelpipe_set_input(&s->pipe, &s->dev, NULL, buf.width, buf.height, buf.iscale);
+  dt_dev_pixelpipe_create_nodes(&s->pipe, &s->dev);
+
+  dt_pthread_mutex_init(&s->lock, NULL);
+  return s;
 }
-static const char *_mcp_mime(dt_imageio_module_data_t *d)
+
+// returns a referenced session for imgid, creating it if needed
+static _mcp_session_t *_session_get(const dt_imgid_t imgid, const int history_end,
+                                    char **err)
 {
-  return "memory";
+  dt_pthread_mutex_lock(&_bridge_lock);
+  for(GList *l = _sessions; l; l = g_list_next(l))
+  {
+    _mcp_session_t *s = l->data;
+    if(s->imgid == imgid && s->history_end == history_end)
+    {
+      _sessions = g_list_remove_link(_sessions, l);
+      _sessions = g_list_concat(l, _sessions);
+      g_atomic_int_inc(&s->refs);
+      dt_pthread_mutex_unlock(&_bridge_lock);
+      return s;
+    }
+  }
+  dt_pthread_mutex_unlock(&_bridge_lock);
+
+  // loading the raw takes a while, don't block the other workers. if two
+  // workers race for the same image both sessions work, the older one is
+  // simply evicted first
+  _mcp_session_t *s = _session_new(imgid, history_end, err);
+  if(!s) return NULL;
+
+  GList *evicted = NULL;
+  dt_pthread_mutex_lock(&_bridge_lock);
+  g_atomic_int_inc(&s->refs);
+  _sessions = g_list_prepend(_sessions, s);
+  while(g_list_length(_sessions) > MCP_MAX_SESSIONS)
+  {
+    GList *last = g_list_last(_sessions);
+    evicted = g_list_prepend(evicted, last->data);
+    _sessions = g_list_delete_link(_sessions, last);
+  }
+  dt_pthread_mutex_unlock(&_bridge_lock);
+
+  // sessions still rendering are freed by their last user
+  g_list_free_full(evicted, (GDestroyNotify)_session_unref);
+  return s;
+}
+
+// forget the sessions of imgid, used when its history changed in the library
+static void _session_drop(const dt_imgid_t imgid)
+{
+  GList *dropped = NULL;
+  dt_pthread_mutex_lock(&_bridge_lock);
+  GList *l = _sessions;
+  while(l)
+  {
+    GList *next = g_list_next(l);
+    _mcp_session_t *s = l->data;
+    if(s->imgid == imgid)
+    {
+      dropped = g_list_prepend(dropped, s);
+      _sessions = g_list_delete_link(_sessions, l);
+    }
+    l = next;
+  }
+  dt_pthread_mutex_unlock(&_bridge_lock);
+  g_list_free_full(dropped, (GDestroyNotify)_session_unref);
 }
-static void _free_cb(void *p) { g_free(p); }
 
-// render the committed history of `imgid` to a plain cairo RGB24 surface that
-// owns its pixel buffer (freed when the surface is destroyed)
-static cairo_surface_t *_render_to_surface(dt_imgid_t imgid, int w, int h,
-                                           int history_end, char **err)
+// render the session's image with the given edits to a plain cairo RGB24
+// surface that owns its pixel buffer (freed when the surface is destroyed).
+// the caller holds s->lock
+static cairo_surface_t *_session_render(_mcp_session_t *s, int w, int h,
+                                        JsonArray *stack,
+                                        gboolean disable_tone_mappers, char **err)
 {
   if(w <= 0) w = 1024;
   if(h <= 0) h = 1024;
 
-  dt_imageio_module_format_t fmt;
-  memset(&fmt, 0, sizeof(fmt));
-  fmt.mime = _mcp_mime;
-  fmt.levels = _mcp_levels;
-  fmt.bpp = _mcp_bpp;
-  fmt.write_image = _mcp_write;
-
-  _mcp_fmt_t dat;
-  memset(&dat, 0, sizeof(dat));
-  dat.head.max_width = w;
-  dat.head.max_height = h;
-  dat.head.width = w;
-  dat.head.height = h;
-  dat.head.style_append = TRUE;
-  dat.bpp = 8;
-  dat.buf = g_malloc0(sizeof(uint32_t) * (size_t)w * h);
-
-  // NB: dt_imageio_export_with_flags returns FALSE on success
-  const gboolean failed = dt_imageio_export_with_flags(
-      imgid, "memory", &fmt, (dt_imageio_module_data_t *)&dat,
-      TRUE, TRUE, FALSE /*hq*/, TRUE /*upscale*/, FALSE /*is_scaling*/, 1.0,
-      FALSE /*thumbnail*/, NULL /*filter*/, FALSE /*copy_meta*/, FALSE /*export_masks*/,
-      DT_COLORSPACE_DISPLAY, NULL, DT_INTENT_LAST, NULL, NULL,
-      1, 1, NULL /*metadata*/, history_end);
-
-  if(failed || dat.width == 0 || dat.height == 0)
+  dt_develop_t *dev = &s->dev;
+  dt_dev_pixelpipe_t *pipe = &s->pipe;
+  cairo_surface_t *surf = NULL;
+
+  const double start = dt_get_wtime();
+  const uint64_t hits = pipe->cache.hits;
+
+  // hold the full buffer for this render only, so that the image can be
+  // written or invalidated between two calls
+  dt_mipmap_buffer_t buf;
+  dt_mipmap_cache_get(&buf, s->imgid, DT_MIPMAP_FULL, DT_MIPMAP_BLOCKING, 'r');
+  if(!buf.buf || !buf.width || !buf.height)
   {
-    g_free(dat.buf);
-    _seterr(err, "render failed (invalid image or pipeline)");
+    dt_mipmap_cache_release(&buf);
+    _seterr(err, "could not load image %d", s->imgid);
     return NULL;
   }
+  dt_dev_pixelpipe_set_input(pipe, dev, (float *)buf.buf, buf.width, buf.height, buf.iscale);
+
+  // back to the image's own history, dropping the edits of the last call
+  dt_dev_pop_history_items_ext(dev, s->base_end);
+  _trim_history(dev);
+
+  if(!_apply_edits(dev, stack, disable_tone_mappers, err))
+    goto done;
+
+  dt_dev_pixelpipe_synch_all(pipe, dev);
+  dt_dev_pixelpipe_get_dimensions(pipe, dev, pipe->iwidth, pipe->iheight,
+                                  &pipe->processed_width, &pipe->processed_height);
+  if(pipe->processed_width < 1 || pipe->processed_height < 1)
+  {
+    _seterr(err, "render failed (invalid image or pipeline)");
+    goto done;
+  }
+
+  // like the export used before the sessions, the image is upscaled to
+  // the requested size
+  const double scale = fmin((double)w / pipe->processed_width,
+                            (double)h / pipe->processed_height);
+  const int pw = MAX(1, (int)floor(scale * pipe->processed_width));
+  const int ph = MAX(1, (int)floor(scale * pipe->processed_height));
+
+  // like a low quality export: downscale right after demosaic, and let the
+  // pipe hand out 8-bit display byte order data
+  dt_dev_pixelpipe_iop_t *finalscale = NULL;
+  for(GList *nodes = g_list_last(pipe->nodes); nodes; nodes = g_list_previous(nodes))
+  {
+    dt_dev_pixelpipe_iop_t *node = nodes->data;
+    if(dt_iop_module_is_finalscale(node->module))
+    {
+      finalscale = node;
+      break;
+    }
+  }
+  if(finalscale) finalscale->enabled = FALSE;
+  const gboolean failed = dt_dev_pixelpipe_process(pipe, dev, 0, 0, pw, ph, scale,
+                                                   DT_DEVICE_NONE);
+  if(finalscale) finalscale->enabled = TRUE;
+
+  if(failed || !pipe->backbuf)
+  {
+    _seterr(err, "render failed (invalid image or pipeline)");
+    goto done;
+  }
 
-  const int stride = cairo_format_stride_for_width(CAIRO_FORMAT_RGB24, dat.width);
-  cairo_surface_t *surf =
-    cairo_image_surface_create_for_data(dat.buf, CAIRO_FORMAT_RGB24, dat.width,
-                                        dat.height, stride);
+  const int stride = cairo_format_stride_for_width(CAIRO_FORMAT_RGB24, pw);
+  uint8_t *data = g_malloc((size_t)stride * ph);
+  for(int y = 0; y < ph; y++)
+    memcpy(data + (size_t)y * stride,
+           (const uint8_t *)pipe->backbuf + sizeof(uint32_t) * pw * y,
+           sizeof(uint32_t) * pw);
+
+  surf = cairo_image_surface_create_for_data(data, CAIRO_FORMAT_RGB24, pw, ph, stride);
   if(cairo_surface_status(surf) != CAIRO_STATUS_SUCCESS)
   {
     cairo_surface_destroy(surf);
-    g_free(dat.buf);
+    surf = NULL;
+    g_free(data);
     _seterr(err, "cairo surface creation failed");
-    return NULL;
+    goto done;
   }
   static const cairo_user_data_key_t key;
-  cairo_surface_set_user_data(surf, &key, dat.buf, _free_cb);
+  cairo_surface_set_user_data(surf, &key, data, _free_cb);
+
+  dt_print(DT_DEBUG_PERF, "[darktable-mcp] image %d rendered at %dx%d in %.3f secs,"
+           " %" PRIu64 " pipe cache hits",
+           s->imgid, pw, ph, dt_get_wtime() - start, pipe->cache.hits - hits);
+
+done:
+  pipe->input = NULL;
+  dt_mipmap_cache_release(&buf);
   return surf;
 }
 
-// import/resolve, apply the optional edit stack on a throwaway duplicate, and
-// render to a cairo surface; sets *dup_out to the duplicate imgid (or NO_IMGID)
-// which the caller must dt_image_remove() after using the surface
+// import/resolve the input and render it with the optional edit stack
 static cairo_surface_t *_render_surface(const char *path, int imgid_in, int width,
                                         int height, JsonArray *stack,
                                         gboolean disable_tone_mappers, int history_end,
-                                        dt_imgid_t *dup_out, char **err)
+                                        char **err)
 {
-  *dup_out = NO_IMGID;
   const dt_imgid_t base = (imgid_in > 0) ? (dt_imgid_t)imgid_in : _import(path, err);
   if(!dt_is_valid_imgid(base)) return NULL;
 
-  const guint n_stack = stack ? json_array_get_length(stack) : 0;
-  const gboolean has_edits = disable_tone_mappers || n_stack > 0;
-  dt_imgid_t work = base;
-
-  if(has_edits)
-  {
-    const dt_imgid_t dup = dt_image_duplicate(base);
-    if(!dt_is_valid_imgid(dup))
-    {
-      _seterr(err, "could not duplicate image for editing");
-      return NULL;
-    }
-    *dup_out = dup;
-    work = dup;
-
-    dt_develop_t dev;
-    dt_dev_init(&dev, FALSE);
-    dt_dev_load_image(&dev, work);
-
-    if(disable_tone_mappers)
-    {
-      const char *tms[] = { "sigmoid", "filmicrgb", "basecurve", NULL };
-      for(int i = 0; tms[i]; i++)
-      {
-        dt_iop_module_t *m = dt_iop_get_module_by_op_priority(dev.iop, tms[i], 0);
-        if(m && m->enabled)
-        {
-          m->enabled = FALSE;
-          dt_dev_add_history_item_ext(&dev, m, FALSE, TRUE);
-        }
-      }
-    }
+  _mcp_session_t *s = _session_get(base, history_end, err);
+  if(!s) return NULL;
 
-    for(guint i = 0; i < n_stack; i++)
-    {
-      JsonNode *en = json_array_get_element(stack, i);
-      if(!JSON_NODE_HOLDS_OBJECT(en)
-         || !_apply_entry(&dev, json_node_get_object(en), err))
-      {
-        if(JSON_NODE_HOLDS_OBJECT(en) == FALSE)
-          _seterr(err, "stack[%u] is not an object", i);
-        dt_dev_cleanup(&dev);
-        return NULL;
-      }
-    }
+  dt_pthread_mutex_lock(&s->lock);
+  cairo_surface_t *surf = _session_render(s, width, height, stack,
+                                          disable_tone_mappers, err);
+  dt_pthread_mutex_unlock(&s->lock);
+  _session_unref(s);
+  return surf;
+}
 
-    dt_dev_write_history_ext(&dev, work);
-    dt_dev_cleanup(&dev);
-  }
+void dt_bridge_init(void)
+{
+  dt_pthread_mutex_init(&_bridge_lock, NULL);
+  _path_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+}
 
-  return _render_to_surface(work, width, height, history_end, err);
+void dt_bridge_cleanup(void)
+{
+  g_list_free_full(_sessions, (GDestroyNotify)_session_unref);
+  _sessions = NULL;
+  g_hash_table_destroy(_path_cache);
+  _path_cache = NULL;
+  dt_pthread_mutex_destroy(&_bridge_lock);
 }
 
 static cairo_status_t _png_writer(void *closure, const unsigned char *data,
@@ -776,44 +958,43 @@ static cairo_status_t _png_writer(void *closure, const unsigned char *data,
   return CAIRO_STATUS_SUCCESS;
 }
 
+static GByteArray *_surface_to_png(cairo_surface_t *surf)
+{
+  GByteArray *buf = g_byte_array_new();
+  if(cairo_surface_write_to_png_stream(surf, _png_writer, buf) == CAIRO_STATUS_SUCCESS)
+    return buf;
+  g_byte_array_free(buf, TRUE);
+  return NULL;
+}
+
 gboolean dt_bridge_render_png(const char *path, int imgid_in, int width, int height,
                               void *stack_jsonarray, gboolean disable_tone_mappers,
                               int history_end, uint8_t **png_out, size_t *png_len,
                               char **err)
 {
-  dt_imgid_t dup = NO_IMGID;
   cairo_surface_t *surf = _render_surface(path, imgid_in, width, height,
                                           (JsonArray *)stack_jsonarray,
                                           disable_tone_mappers,
-                                          history_end, &dup, err);
+                                          history_end, err);
   gboolean ok = FALSE;
   if(surf)
   {
-    GByteArray *buf = g_byte_array_new();
-    if(cairo_surface_write_to_png_stream(surf, _png_writer, buf) == CAIRO_STATUS_SUCCESS)
+    GByteArray *buf = _surface_to_png(surf);
+    if(buf)
     {
       *png_len = buf->len;
       *png_out = g_byte_array_free(buf, FALSE); // hand raw bytes to caller
       ok = TRUE;
     }
-    else { g_byte_array_free(buf, TRUE); _seterr(err, "PNG encoding failed"); }
+    else _seterr(err, "PNG encoding failed");
     cairo_surface_destroy(surf);
   }
-  if(dt_is_valid_imgid(dup)) dt_image_remove(dup);
   return ok;
 }
 
-char *dt_bridge_image_stats_json(const char *path, int imgid_in, int width, int height,
-                                 void *stack_jsonarray, gboolean disable_tone_mappers,
-                                 int history_end, char **err)
+// append per-channel statistics of surf as { width, height, channels } to jb
+static void _add_surface_stats(JsonBuilder *jb, cairo_surface_t *surf)
 {
-  dt_imgid_t dup = NO_IMGID;
-  cairo_surface_t *surf = _render_surface(path, imgid_in, width > 0 ? width : 512,
-                                          height > 0 ? height : 512,
-                                          (JsonArray *)stack_jsonarray,
-                                          disable_tone_mappers, history_end, &dup, err);
-  if(!surf) return NULL;
-
   cairo_surface_flush(surf);
   const int w = cairo_image_surface_get_width(surf);
   const int h = cairo_image_surface_get_height(surf);
@@ -837,7 +1018,6 @@ char *dt_bridge_image_stats_json(const char *path, int imgid_in, int width, int
   }
 
   static const char *chan[3] = { "r", "g", "b" };
-  JsonBuilder *jb = json_builder_new();
   json_builder_begin_object(jb);
   json_builder_set_member_name(jb, "width");
   json_builder_add_int_value(jb, w);
@@ -889,11 +1069,221 @@ char *dt_bridge_image_stats_json(const char *path, int imgid_in, int width, int
   }
   json_builder_end_object(jb);
   json_builder_end_object(jb);
+}
 
+char *dt_bridge_image_stats_json(const char *path, int imgid_in, int width, int height,
+                                 void *stack_jsonarray, gboolean disable_tone_mappers,
+                                 int history_end, char **err)
+{
+  cairo_surface_t *surf = _render_surface(path, imgid_in, width > 0 ? width : 512,
+                                          height > 0 ? height : 512,
+                                          (JsonArray *)stack_jsonarray,
+                                          disable_tone_mappers, history_end, err);
+  if(!surf) return NULL;
+
+  JsonBuilder *jb = json_builder_new();
+  _add_surface_stats(jb, surf);
   char *out = _builder_to_string(jb);
   g_object_unref(jb);
   cairo_surface_destroy(surf);
-  if(dt_is_valid_imgid(dup)) dt_image_remove(dup);
+  return out;
+}
+
+#define MCP_MAX_VARIANTS 64
+
+static const char *_entry_op(JsonObject *e)
+{
+  return json_object_has_member(e, "operation")
+    ? json_object_get_string_member(e, "operation") : NULL;
+}
+
+static int _entry_multi_priority(JsonObject *e)
+{
+  return json_object_has_member(e, "multi_priority")
+    ? (int)json_object_get_int_member(e, "multi_priority") : 0;
+}
+
+static gboolean _same_instance(JsonObject *a, JsonObject *b)
+{
+  const char *opa = _entry_op(a);
+  const char *opb = _entry_op(b);
+  return opa && opb && !strcmp(opa, opb)
+    && _entry_multi_priority(a) == _entry_multi_priority(b);
+}
+
+// overlay a variant on the base stack: an entry for an operation/instance
+// already in the base overrides it (params merged field-wise, a blob_hex
+// replaces the params altogether), other entries are appended
+static JsonArray *_merge_variant(JsonArray *base, JsonArray *variant)
+{
+  JsonArray *out = json_array_new();
+  const guint nb = base ? json_array_get_length(base) : 0;
+  const guint nv = json_array_get_length(variant);
+  gboolean *used = g_new0(gboolean, nv);
+
+  for(guint i = 0; i < nb; i++)
+  {
+    JsonNode *bn = json_array_get_element(base, i);
+    if(!JSON_NODE_HOLDS_OBJECT(bn))
+    {
+      json_array_add_element(out, json_node_copy(bn));
+      continue;
+    }
+    JsonNode *merged = json_node_copy(bn);
+    JsonObject *m = json_node_get_object(merged);
+    for(guint j = 0; j < nv; j++)
+    {
+      JsonNode *vn = json_array_get_element(variant, j);
+      if(!JSON_NODE_HOLDS_OBJECT(vn) || !_same_instance(m, json_node_get_object(vn)))
+        continue;
+      JsonObject *v = json_node_get_object(vn);
+      used[j] = TRUE;
+
+      if(json_object_has_member(v, "blob_hex"))
+        json_object_remove_member(m, "params");
+      else if(json_object_has_member(v, "params"))
+        json_object_remove_member(m, "blob_hex");
+
+      GList *members = json_object_get_members(v);
+      for(GList *it = members; it; it = g_list_next(it))
+      {
+        const char *name = it->data;
+        JsonNode *src = json_object_get_member(v, name);
+        JsonNode *dst = json_object_get_member(m, name);
+        if(!strcmp(name, "params") && JSON_NODE_HOLDS_OBJECT(src)
+           && dst && JSON_NODE_HOLDS_OBJECT(dst))
+        {
+          JsonObject *dp = json_node_get_object(dst);
+          JsonObject *sp = json_node_get_object(src);
+          GList *fields = json_object_get_members(sp);
+          for(GList *f = fields; f; f = g_list_next(f))
+            json_object_set_member(dp, f->data,
+                                   json_node_copy(json_object_get_member(sp, f->data)));
+          g_list_free(fields);
+        }
+        else
+          json_object_set_member(m, name, json_node_copy(src));
+      }
+      g_list_free(members);
+    }
+    json_array_add_element(out, merged);
+  }
+
+  for(guint j = 0; j < nv; j++)
+    if(!used[j])
+      json_array_add_element(out, json_node_copy(json_array_get_element(variant, j)));
+
+  g_free(used);
+  return out;
+}
+
+char *dt_bridge_sweep_json(const char *path, int imgid_in, int width, int height,
+                           void *stack_jsonarray, void *variants_jsonarray,
+                           gboolean disable_tone_mappers, int history_end,
+                           GPtrArray **pngs, char **err)
+{
+  JsonArray *base_stack = (JsonArray *)stack_jsonarray;
+  JsonArray *variants = (JsonArray *)variants_jsonarray;
+  const guint n = variants ? json_array_get_length(variants) : 0;
+  if(n == 0)
+  {
+    _seterr(err, "sweep needs at least one variant");
+    return NULL;
+  }
+  if(n > MCP_MAX_VARIANTS)
+  {
+    _seterr(err, "too many variants (%u > %d)", n, MCP_MAX_VARIANTS);
+    return NULL;
+  }
+  for(guint i = 0; i < n; i++)
+    if(!JSON_NODE_HOLDS_ARRAY(json_array_get_element(variants, i)))
+    {
+      _seterr(err, "variant %u is not an array of stack entries", i);
+      return NULL;
+    }
+
+  const dt_imgid_t base = (imgid_in > 0) ? (dt_imgid_t)imgid_in : _import(path, err);
+  if(!dt_is_valid_imgid(base)) return NULL;
+
+  _mcp_session_t *s = _session_get(base, history_end, err);
+  if(!s) return NULL;
+
+  const int w = width > 0 ? width : 512;
+  const int h = height > 0 ? height : 512;
+  if(pngs) *pngs = g_ptr_array_new_with_free_func((GDestroyNotify)g_byte_array_unref);
+
+  JsonBuilder *jb = json_builder_new();
+  json_builder_begin_object(jb);
+  json_builder_set_member_name(jb, "variants");
+  json_builder_begin_array(jb);
+
+  gboolean ok = TRUE;
+  const double start = dt_get_wtime();
+  // keep the session for the whole sweep, so that the variants follow each
+  // other in the pipe and share the cached lines up to the first module
+  // they differ in
+  dt_pthread_mutex_lock(&s->lock);
+  const uint64_t hits = s->pipe.cache.hits;
+  for(guint i = 0; i < n && ok; i++)
+  {
+    JsonArray *stack =
+      _merge_variant(base_stack, json_node_get_array(json_array_get_element(variants, i)));
+    cairo_surface_t *surf = _session_render(s, w, h, stack, disable_tone_mappers, err);
+    json_array_unref(stack);
+    if(!surf)
+    {
+      if(err && *err)
+      {
+        char *e = *err;
+        *err = g_strdup_printf("variant %u: %s", i, e);
+        g_free(e);
+      }
+      ok = FALSE;
+      break;
+    }
+
+    json_builder_begin_object(jb);
+    json_builder_set_member_name(jb, "variant");
+    json_builder_add_int_value(jb, i);
+    json_builder_set_member_name(jb, "stats");
+    _add_surface_stats(jb, surf);
+    json_builder_end_object(jb);
+
+    if(pngs)
+    {
+      GByteArray *png = _surface_to_png(surf);
+      if(png)
+        g_ptr_array_add(*pngs, png);
+      else
+      {
+        _seterr(err, "variant %u: PNG encoding failed", i);
+        ok = FALSE;
+      }
+    }
+    cairo_surface_destroy(surf);
+  }
+  const uint64_t sweep_hits = s->pipe.cache.hits - hits;
+  dt_pthread_mutex_unlock(&s->lock);
+  _session_unref(s);
+
+  const double secs = dt_get_wtime() - start;
+  dt_print(DT_DEBUG_PERF, "[darktable-mcp] sweep of %u variants on image %d in %.3f secs,"
+           " %" PRIu64 " pipe cache hits", n, base, secs, sweep_hits);
+
+  json_builder_end_array(jb);
+  json_builder_set_member_name(jb, "seconds");
+  json_builder_add_double_value(jb, secs);
+  json_builder_set_member_name(jb, "cache_hits");
+  json_builder_add_int_value(jb, (gint64)sweep_hits);
+  json_builder_end_object(jb);
+
+  char *out = ok ? _builder_to_string(jb) : NULL;
+  g_object_unref(jb);
+  if(!ok && pngs)
+  {
+    g_ptr_array_free(*pngs, TRUE);
+    *pngs = NULL;
+  }
   return out;
 }
 
@@ -1030,6 +1420,7 @@ gboolean dt_bridge_apply_style(const char *name, int imgid, gboolean overwrite,
     return FALSE;
   }
   dt_styles_apply_to_image(name, FALSE, overwrite, (dt_imgid_t)imgid);
+  _session_drop((dt_imgid_t)imgid);
   return TRUE;
 }
 
@@ -1062,11 +1453,10 @@ gboolean dt_bridge_export_png(const char *in_path, int imgid_in, int width, int
                               int history_end, const char *out_path, char **err)
 {
   if(!out_path) { _seterr(err, "export: need 'out_path'"); return FALSE; }
-  dt_imgid_t dup = NO_IMGID;
   cairo_surface_t *surf = _render_surface(in_path, imgid_in, width, height,
                                           (JsonArray *)stack_jsonarray,
                                           disable_tone_mappers,
-                                          history_end, &dup, err);
+                                          history_end, err);
   gboolean ok = FALSE;
   if(surf)
   {
@@ -1074,6 +1464,5 @@ gboolean dt_bridge_export_png(const char *in_path, int imgid_in, int width, int
     if(!ok) _seterr(err, "could not write PNG to '%s'", out_path);
     cairo_surface_destroy(surf);
   }
-  if(dt_is_valid_imgid(dup)) dt_image_remove(dup);
   return ok;
 }
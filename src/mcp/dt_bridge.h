@@ -25,6 +25,12 @@
 #include <glib.h>
 #include <stdint.h>
 
+/** set up the import cache and render sessions, call after dt_init */
+void dt_bridge_init(void);
+
+/** release the render sessions, call before dt_cleanup */
+void dt_bridge_cleanup(void);
+
 // the *_json helpers return a newly-allocated string (free with g_free), or
 // NULL on error with *err set to a g_malloc'd message
 
@@ -42,8 +48,10 @@ char *dt_bridge_decode_params_json(const char *op, const char *blob_hex, char **
 char *dt_bridge_encode_params_hex(const char *op, void *fields_jsonobject, char **err);
 
 /** render a raw (by path or imgid) through the base pipeline plus an optional
-    module `stack` (JsonArray*), on a throwaway duplicate so the source is
-    untouched; on success hands back a g_malloc'd PNG in png_out / png_len */
+    module `stack` (JsonArray*); the edits only live in a render session kept
+    per image, so the source is untouched and a following call with other
+    stack params only recomputes the modules from the first changed one on.
+    on success hands back a g_malloc'd PNG in png_out / png_len. thread safe */
 gboolean dt_bridge_render_png(const char *path, int imgid_in, int width, int height,
                               void *stack_jsonarray, gboolean disable_tone_mappers,
                               int history_end, uint8_t **png_out, size_t *png_len,
@@ -54,6 +62,17 @@ char *dt_bridge_image_stats_json(const char *path, int imgid_in, int width, int
                                  void *stack_jsonarray, gboolean disable_tone_mappers,
                                  int history_end, char **err);
 
+/** render every entry of `variants` (a JsonArray* of stack arrays, each
+    overlaid on `stack` by operation and multi_priority) back to back in the
+    image's render session, so they share the pipe cache up to the first
+    module they differ in. returns { variants:[{ variant, stats }], seconds,
+    cache_hits } and, when pngs is set, a GPtrArray of GByteArray PNGs in
+    variant order. thread safe */
+char *dt_bridge_sweep_json(const char *path, int imgid_in, int width, int height,
+                           void *stack_jsonarray, void *variants_jsonarray,
+                           gboolean disable_tone_mappers, int history_end,
+                           GPtrArray **pngs, char **err);
+
 // --- library (catalog) tools ---
 
 /** JSON array of { imgid, path } for images in the current library */
@@ -18,6 +18,7 @@
 
 #include "common/darktable.h"
 #include "common/file_location.h"
+#include "mcp/dt_bridge.h"
 #include "mcp/mcp_jsonrpc.h"
 #include "mcp/mcp_tools.h"
 
@@ -67,6 +68,11 @@ int main(int argc, char **argv)
   const int n_core = argc - core_start;
   char **core = (n_core > 0) ? &argv[core_start] : NULL;
 
+  // number of tool calls processed concurrently, 0 picks a default after dt_init
+  int workers = 0;
+  for(int i = 1; i + 1 < core_start; i++)
+    if(!g_strcmp0(argv[i], "--workers")) workers = MAX(atoi(argv[i + 1]), 1);
+
   // build the synthetic argv, injecting defaults only when the user did not
   // supply them: a throwaway in-memory library and no sidecar writes
   GPtrArray *m = g_ptr_array_new();
@@ -108,7 +114,14 @@ int main(int argc, char **argv)
             tools_file);
   g_free(tools_file);
 
-  mcp_jsonrpc_loop(stdin, proto_out ? proto_out : stdout);
+  // every render session holds a full resolution image and a pipe, so stay
+  // well below the number of cores by default
+  if(workers == 0)
+    workers = CLAMP((int)dt_get_num_procs() / 4, 1, 4);
+
+  dt_bridge_init();
+  mcp_jsonrpc_loop(stdin, proto_out ? proto_out : stdout, workers);
+  dt_bridge_cleanup();
 
   dt_cleanup();
   if(proto_out) fflush(proto_out);
@@ -41,6 +41,9 @@
 // stdio default of one JSON object per line)
 static gboolean _use_framing = FALSE;
 
+// tool calls may answer from the worker pool, keep the messages whole
+static GMutex _out_lock;
+
 // ---------------------------------------------------------------------------
 // output
 // ---------------------------------------------------------------------------
@@ -51,10 +54,12 @@ static void _send_node(FILE *out, JsonNode *root)
   json_generator_set_root(gen, root);
   gsize len = 0;
   gchar *s = json_generator_to_data(gen, &len);
+  g_mutex_lock(&_out_lock);
   if(_use_framing) fprintf(out, "Content-Length: %zu\r\n\r\n", (size_t)len);
   fwrite(s, 1, len, out);
   if(!_use_framing) fputc('\n', out);
   fflush(out);
+  g_mutex_unlock(&_out_lock);
   g_free(s);
   g_object_unref(gen);
 }
@@ -163,6 +168,24 @@ static void _handle_tools_call(FILE *out, JsonNode *id, JsonObject *req)
   _send_result(out, id, result);
 }
 
+// a tools/call handed to the worker pool; the parser owns the request
+typedef struct _tool_call_t
+{
+  FILE *out;
+  JsonParser *parser;
+} _tool_call_t;
+
+static void _tool_call_worker(gpointer data, gpointer user_data)
+{
+  _tool_call_t *call = data;
+  JsonObject *req = json_node_get_object(json_parser_get_root(call->parser));
+  JsonNode *id = json_object_has_member(req, "id")
+                   ? json_object_get_member(req, "id") : NULL;
+  _handle_tools_call(call->out, id, req);
+  g_object_unref(call->parser);
+  g_free(call);
+}
+
 // ---------------------------------------------------------------------------
 // read loop
 // ---------------------------------------------------------------------------
@@ -172,13 +195,20 @@ static void _rstrip(char *s, ssize_t *n)
   while(*n > 0 && (s[*n - 1] == '\n' || s[*n - 1] == '\r')) s[--(*n)] = '\0';
 }
 
-void mcp_jsonrpc_loop(FILE *in, FILE *out)
+void mcp_jsonrpc_loop(FILE *in, FILE *out, int workers)
 {
   char *line = NULL;
   size_t cap = 0;
   ssize_t n;
   gboolean done = FALSE;
 
+  // tool calls (renders mostly) run concurrently, everything else is
+  // answered right away. responses may thus come out of order, which
+  // JSON-RPC allows as they carry the request id
+  GThreadPool *pool = workers > 1
+    ? g_thread_pool_new(_tool_call_worker, NULL, workers, FALSE, NULL)
+    : NULL;
+
   while(!done && (n = getline(&line, &cap, in)) != -1)
   {
     _rstrip(line, &n);
@@ -238,6 +268,13 @@ void mcp_jsonrpc_loop(FILE *in, FILE *out)
       _send_result(out, id, _initialize_result());
     else if(!strcmp(method, "tools/list"))
       _send_result(out, id, _tools_list_result());
+    else if(!strcmp(method, "tools/call") && pool)
+    {
+      _tool_call_t *call = g_new(_tool_call_t, 1);
+      call->out = out;
+      call->parser = g_object_ref(parser);
+      g_thread_pool_push(pool, call, NULL);
+    }
     else if(!strcmp(method, "tools/call"))
       _handle_tools_call(out, id, req);
     else if(!strcmp(method, "ping"))
@@ -246,6 +283,9 @@ void mcp_jsonrpc_loop(FILE *in, FILE *out)
       { /* notifications get no response */ }
     else if(!strcmp(method, "shutdown"))
     {
+      // answer the pending tool calls first
+      if(pool) g_thread_pool_free(pool, FALSE, TRUE);
+      pool = NULL;
       _send_result(out, id, _empty_object());
       done = TRUE;
     }
@@ -256,5 +296,6 @@ void mcp_jsonrpc_loop(FILE *in, FILE *out)
     g_free(framed_msg);
   }
 
+  if(pool) g_thread_pool_free(pool, FALSE, TRUE);
   g_free(line);
 }
@@ -21,5 +21,7 @@
 #include <stdio.h>
 
 /** blocking MCP (JSON-RPC 2.0 over stdio) event loop: reads requests from `in`,
-    writes responses to `out`, returns on EOF or a `shutdown` request */
-void mcp_jsonrpc_loop(FILE *in, FILE *out);
+    writes responses to `out`, returns on EOF or a `shutdown` request once all
+    pending calls are answered. with workers > 1 that many tools/call requests
+    are processed concurrently */
+void mcp_jsonrpc_loop(FILE *in, FILE *out, int workers);
@@ -231,6 +231,54 @@ static JsonNode *_tool_image_stats(JsonObject *args)
   return r;
 }
 
+static JsonNode *_tool_sweep(JsonObject *args)
+{
+  const char *path; int imgid, w, h, he; gboolean dtm; JsonArray *stack;
+  if(!_parse_render_inputs(args, &path, &imgid, &w, &h, &he, &dtm, &stack))
+    return _text_result("sweep: provide input.path or input.imgid", TRUE);
+  JsonArray *variants = NULL;
+  if(json_object_has_member(args, "variants"))
+  {
+    JsonNode *vn = json_object_get_member(args, "variants");
+    if(JSON_NODE_HOLDS_ARRAY(vn)) variants = json_node_get_array(vn);
+  }
+  if(!variants) return _text_result("sweep: missing required array 'variants'", TRUE);
+
+  GPtrArray *pngs = NULL;
+  char *err = NULL;
+  char *json = dt_bridge_sweep_json(path, imgid, w, h, stack, variants, dtm, he,
+                                    _arg_bool(args, "renders", FALSE) ? &pngs : NULL,
+                                    &err);
+  if(!json)
+  {
+    JsonNode *r = _text_result(err ? err : "sweep failed", TRUE);
+    g_free(err);
+    return r;
+  }
+  JsonNode *r = _text_result(json, FALSE);
+  g_free(json);
+
+  // one image block per variant, in variant order, after the statistics
+  if(pngs)
+  {
+    JsonArray *content =
+      json_object_get_array_member(json_node_get_object(r), "content");
+    for(guint i = 0; i < pngs->len; i++)
+    {
+      GByteArray *png = g_ptr_array_index(pngs, i);
+      gchar *b64 = g_base64_encode(png->data, png->len);
+      JsonObject *block = json_object_new();
+      json_object_set_string_member(block, "type", "image");
+      json_object_set_string_member(block, "mimeType", "image/png");
+      json_object_set_string_member(block, "data", b64);
+      g_free(b64);
+      json_array_add_object_element(content, block);
+    }
+    g_ptr_array_free(pngs, TRUE);
+  }
+  return r;
+}
+
 static JsonNode *_json_text_or_err(char *json, char *err)
 {
   if(!json)
@@ -328,6 +376,7 @@ static const mcp_handler_t _handlers[] = {
   { "encode_params", _tool_encode_params },
   { "render",        _tool_render },
   { "image_stats",   _tool_image_stats },
+  { "sweep",         _tool_sweep },
   { "list_images",   _tool_list_images },
   { "get_history",   _tool_get_history },
   { "list_styles",   _tool_list_styles },